@@ -0,0 +1,87 @@
+// ****************************************************************************
+//
+//    Copyright (c) 2014, Seth Billings, Russell Taylor, Johns Hopkins University
+//    All rights reserved.
+//
+//    Redistribution and use in source and binary forms, with or without
+//    modification, are permitted provided that the following conditions are
+//    met:
+//
+//    1. Redistributions of source code must retain the above copyright
+//    notice, this list of conditions and the following disclaimer.
+//
+//    2. Redistributions in binary form must reproduce the above copyright
+//    notice, this list of conditions and the following disclaimer in the
+//    documentation and/or other materials provided with the distribution.
+//
+//    3. Neither the name of the copyright holder nor the names of its
+//    contributors may be used to endorse or promote products derived from
+//    this software without specific prior written permission.
+//
+//    THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+//    "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+//    LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+//    A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+//    HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+//    SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+//    LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+//    DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+//    THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+//    (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+//    OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//  
+// ****************************************************************************
+
+#include "AllocationCounter.h"
+
+#ifdef ENABLE_ALLOCATION_COUNTER
+
+#include <cstdlib>
+#include <new>
+#include <atomic>
+
+namespace
+{
+  std::atomic<unsigned long long> allocationCount(0);
+
+  void *CountedAlloc(std::size_t size)
+  {
+    allocationCount.fetch_add(1, std::memory_order_relaxed);
+    if (size == 0) size = 1;
+    void *p = std::malloc(size);
+    if (!p) throw std::bad_alloc();
+    return p;
+  }
+}
+
+void *operator new(std::size_t size) { return CountedAlloc(size); }
+void *operator new[](std::size_t size) { return CountedAlloc(size); }
+void *operator new(std::size_t size, const std::nothrow_t &) throw()
+{
+  allocationCount.fetch_add(1, std::memory_order_relaxed);
+  return std::malloc(size ? size : 1);
+}
+void *operator new[](std::size_t size, const std::nothrow_t &) throw()
+{
+  allocationCount.fetch_add(1, std::memory_order_relaxed);
+  return std::malloc(size ? size : 1);
+}
+void operator delete(void *p) throw() { std::free(p); }
+void operator delete[](void *p) throw() { std::free(p); }
+void operator delete(void *p, const std::nothrow_t &) throw() { std::free(p); }
+void operator delete[](void *p, const std::nothrow_t &) throw() { std::free(p); }
+
+bool AllocationCounterEnabled() { return true; }
+
+unsigned long long AllocationCount()
+{
+  return allocationCount.load(std::memory_order_relaxed);
+}
+
+#else
+
+bool AllocationCounterEnabled() { return false; }
+
+unsigned long long AllocationCount() { return 0; }
+
+#endif // ENABLE_ALLOCATION_COUNTER
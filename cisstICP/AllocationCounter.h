@@ -0,0 +1,58 @@
+// ****************************************************************************
+//
+//    Copyright (c) 2014, Seth Billings, Russell Taylor, Johns Hopkins University
+//    All rights reserved.
+//
+//    Redistribution and use in source and binary forms, with or without
+//    modification, are permitted provided that the following conditions are
+//    met:
+//
+//    1. Redistributions of source code must retain the above copyright
+//    notice, this list of conditions and the following disclaimer.
+//
+//    2. Redistributions in binary form must reproduce the above copyright
+//    notice, this list of conditions and the following disclaimer in the
+//    documentation and/or other materials provided with the distribution.
+//
+//    3. Neither the name of the copyright holder nor the names of its
+//    contributors may be used to endorse or promote products derived from
+//    this software without specific prior written permission.
+//
+//    THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+//    "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+//    LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+//    A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+//    HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+//    SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+//    LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+//    DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+//    THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+//    (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+//    OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//  
+// ****************************************************************************
+#ifndef _AllocationCounter_h
+#define _AllocationCounter_h
+
+// Heap allocation instrumentation
+//
+//  When the library is compiled with ENABLE_ALLOCATION_COUNTER (CMake option
+//  of the same name), the global operator new / new[] are replaced by
+//  versions that count each call before forwarding to malloc. The counter is
+//  shared by all threads and covers every allocation made by the process,
+//  including those made by cisst, dlib and the std library.
+//
+//  Without the option these functions are stubs: the counter is never
+//  incremented and AllocationCounterEnabled() returns false.
+//
+//  Usage: take the difference of AllocationCount() before and after the code
+//         of interest (see cisstICP::IterateICP())
+//
+
+// true if the library was compiled with allocation counting
+bool AllocationCounterEnabled();
+
+// number of heap allocations made through operator new since program start
+unsigned long long AllocationCount();
+
+#endif
@@ -0,0 +1,124 @@
+// ****************************************************************************
+//
+//    Copyright (c) 2014, Seth Billings, Russell Taylor, Johns Hopkins University
+//    All rights reserved.
+//
+//    Redistribution and use in source and binary forms, with or without
+//    modification, are permitted provided that the following conditions are
+//    met:
+//
+//    1. Redistributions of source code must retain the above copyright
+//    notice, this list of conditions and the following disclaimer.
+//
+//    2. Redistributions in binary form must reproduce the above copyright
+//    notice, this list of conditions and the following disclaimer in the
+//    documentation and/or other materials provided with the distribution.
+//
+//    3. Neither the name of the copyright holder nor the names of its
+//    contributors may be used to endorse or promote products derived from
+//    this software without specific prior written permission.
+//
+//    THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+//    "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+//    LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+//    A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+//    HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+//    SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+//    LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+//    DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+//    THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+//    (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+//    OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//  
+// ****************************************************************************
+
+#include "CovBatchKernels.h"
+#include "SimdSupport.h"
+
+// scalar kernels
+#define COV_BATCH_KERNEL(name) name##_Scalar
+#include "CovBatchKernels.inl"
+#undef COV_BATCH_KERNEL
+
+// SIMD kernels (see CovBatchKernels_SIMD.cpp)
+#if defined(CISSTICP_SIMD_AVX2) || defined(CISSTICP_SIMD_AVX512)
+void ComputeCovEigenDecomposition_Batch_SIMD(
+  const double *M, int count, double *eigenValues, double *eigenVectors);
+void ComputeCovEigenValues_Batch_SIMD(
+  const double *M, int count, double *eigenValues);
+void ComputeCovDecomposition_Batch_SIMD(
+  const double *M, int count, double *Minv, double *det_M);
+void Calc_RMRt_Batch_SIMD(
+  const double *R, const double *M, int count, double *RMRt);
+void ComputePointCovariance_Batch_SIMD(
+  const double *norms, int count,
+  double normPrllVar, double normPerpVar, double *M);
+void ComputePointCovariance_Batch_SIMD(
+  const double *norms, int count,
+  const double *normPrllVar, const double *normPerpVar, double *M);
+
+#define COV_BATCH_DISPATCH(name, args) \
+  if (SimdKernelsSupported()) name##_SIMD args; else name##_Scalar args
+#else
+#define COV_BATCH_DISPATCH(name, args) name##_Scalar args
+#endif
+
+
+// the kernels take the matrices as arrays of doubles
+//  (vct3x3 and vct3 store their elements contiguously, row major)
+
+void ComputeCovEigenDecomposition_Batch(
+  const vct3x3 *M, int count, vct3 *eigenValues, vct3x3 *eigenVectors)
+{
+  if (count <= 0) return;
+  COV_BATCH_DISPATCH(ComputeCovEigenDecomposition_Batch,
+    (M->Pointer(), count, eigenValues->Pointer(), eigenVectors->Pointer()));
+}
+
+void ComputeCovEigenValues_Batch(
+  const vct3x3 *M, int count, vct3 *eigenValues)
+{
+  if (count <= 0) return;
+  COV_BATCH_DISPATCH(ComputeCovEigenValues_Batch,
+    (M->Pointer(), count, eigenValues->Pointer()));
+}
+
+void ComputeCovDecomposition_Batch(
+  const vct3x3 *M, int count, vct3x3 *Minv, double *det_M)
+{
+  if (count <= 0) return;
+  COV_BATCH_DISPATCH(ComputeCovDecomposition_Batch,
+    (M->Pointer(), count, Minv->Pointer(), det_M));
+}
+
+void ComputeCovInverse_Batch(
+  const vct3x3 *M, int count, vct3x3 *Minv)
+{
+  ComputeCovDecomposition_Batch(M, count, Minv, NULL);
+}
+
+void Calc_RMRt_Batch(
+  const vct3x3 &R, const vct3x3 *M, int count, vct3x3 *RMRt)
+{
+  if (count <= 0) return;
+  COV_BATCH_DISPATCH(Calc_RMRt_Batch,
+    (R.Pointer(), M->Pointer(), count, RMRt->Pointer()));
+}
+
+void ComputePointCovariance_Batch(
+  const vct3 *norms, int count,
+  double normPrllVar, double normPerpVar, vct3x3 *M)
+{
+  if (count <= 0) return;
+  COV_BATCH_DISPATCH(ComputePointCovariance_Batch,
+    (norms->Pointer(), count, normPrllVar, normPerpVar, M->Pointer()));
+}
+
+void ComputePointCovariance_Batch(
+  const vct3 *norms, int count,
+  const double *normPrllVar, const double *normPerpVar, vct3x3 *M)
+{
+  if (count <= 0) return;
+  COV_BATCH_DISPATCH(ComputePointCovariance_Batch,
+    (norms->Pointer(), count, normPrllVar, normPerpVar, M->Pointer()));
+}
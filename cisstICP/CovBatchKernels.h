@@ -0,0 +1,84 @@
+// ****************************************************************************
+//
+//    Copyright (c) 2014, Seth Billings, Russell Taylor, Johns Hopkins University
+//    All rights reserved.
+//
+//    Redistribution and use in source and binary forms, with or without
+//    modification, are permitted provided that the following conditions are
+//    met:
+//
+//    1. Redistributions of source code must retain the above copyright
+//    notice, this list of conditions and the following disclaimer.
+//
+//    2. Redistributions in binary form must reproduce the above copyright
+//    notice, this list of conditions and the following disclaimer in the
+//    documentation and/or other materials provided with the distribution.
+//
+//    3. Neither the name of the copyright holder nor the names of its
+//    contributors may be used to endorse or promote products derived from
+//    this software without specific prior written permission.
+//
+//    THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+//    "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+//    LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+//    A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+//    HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+//    SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+//    LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+//    DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+//    THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+//    (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+//    OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//  
+// ****************************************************************************
+#ifndef _CovBatchKernels_h
+#define _CovBatchKernels_h
+
+#include <cisstVector.h>
+
+// Batched 3x3 covariance kernels
+//
+//  Batched counterparts of the per-matrix routines of utilities.h for
+//  arrays of symmetric 3x3 matrices. Each block of matrices is loaded into
+//  structure-of-arrays registers in packed symmetric form (xx, xy, xz, yy,
+//  yz, zz) and processed with AVX2 or AVX-512 instructions when the library
+//  is built with these kernels (USE_AVX2 / USE_AVX512 build options) and the
+//  processor supports them. The remaining matrices, and the other builds and
+//  processors, use the scalar instantiation of the same kernel, which is the
+//  reference implementation.
+//
+//  Only the upper triangle of the input matrices is read; outputs may not
+//  alias inputs.
+//
+
+// closed-form (trigonometric) symmetric eigen solver
+//  eigen values in descending order
+//  eigen vectors listed by column and has determinant = 1 (i.e. a rotation matrix)
+void ComputeCovEigenDecomposition_Batch(
+  const vct3x3 *M, int count, vct3 *eigenValues, vct3x3 *eigenVectors);
+// eigen values in descending order
+//  NOTE: without the eigen vectors, the eigen values are not refined and
+//        are accurate to ~sqrt(machine eps) near repeated eigen values
+void ComputeCovEigenValues_Batch(
+  const vct3x3 *M, int count, vct3 *eigenValues);
+
+// inverse and determinant of symmetric positive definite matrices
+void ComputeCovDecomposition_Batch(
+  const vct3x3 *M, int count, vct3x3 *Minv, double *det_M);
+void ComputeCovInverse_Batch(
+  const vct3x3 *M, int count, vct3x3 *Minv);
+
+// R*M*R' for a common rotation R
+void Calc_RMRt_Batch(
+  const vct3x3 &R, const vct3x3 *M, int count, vct3x3 *RMRt);
+
+// noise covariances having different noise magnitude in-plane vs.
+//  out-of-plane for the given (unit) plane norms (see ComputePointCovariance())
+void ComputePointCovariance_Batch(
+  const vct3 *norms, int count,
+  double normPrllVar, double normPerpVar, vct3x3 *M);
+void ComputePointCovariance_Batch(
+  const vct3 *norms, int count,
+  const double *normPrllVar, const double *normPerpVar, vct3x3 *M);
+
+#endif
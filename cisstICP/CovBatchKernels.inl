@@ -0,0 +1,661 @@
+// ****************************************************************************
+//
+//    Copyright (c) 2014, Seth Billings, Russell Taylor, Johns Hopkins University
+//    All rights reserved.
+//
+//    Redistribution and use in source and binary forms, with or without
+//    modification, are permitted provided that the following conditions are
+//    met:
+//
+//    1. Redistributions of source code must retain the above copyright
+//    notice, this list of conditions and the following disclaimer.
+//
+//    2. Redistributions in binary form must reproduce the above copyright
+//    notice, this list of conditions and the following disclaimer in the
+//    documentation and/or other materials provided with the distribution.
+//
+//    3. Neither the name of the copyright holder nor the names of its
+//    contributors may be used to endorse or promote products derived from
+//    this software without specific prior written permission.
+//
+//    THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+//    "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+//    LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+//    A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+//    HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+//    SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+//    LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+//    DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+//    THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+//    (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+//    OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//  
+// ****************************************************************************
+
+// Batched 3x3 covariance kernels (see CovBatchKernels.h)
+//
+//  This file is compiled twice: by CovBatchKernels.cpp for the scalar
+//  kernels, and by CovBatchKernels_SIMD.cpp, with the SIMD instruction set
+//  enabled, for the SIMD kernels. The including file defines
+//  COV_BATCH_KERNEL(name) to give the entry points of each a distinct name.
+//
+//  The SIMD build must not instantiate inline or template code of other
+//  headers (e.g. cisstVector): the linker may keep that SIMD copy for the
+//  whole program, which then fails on processors without the instruction
+//  set. The entry points therefore take the matrices as arrays of doubles
+//  (9 per matrix, row major; 3 per vector) and only the C math and
+//  intrinsics headers are included.
+//
+
+#include <math.h>
+#include <float.h>
+
+#define ENABLE_PARALLELIZATION
+
+// SIMD width of the batched kernels
+//  (set by the instruction sets enabled for the compiler, e.g. by
+//   the USE_AVX2 / USE_AVX512 build options for CovBatchKernels_SIMD.cpp)
+#if defined(__AVX512F__)
+#include <immintrin.h>
+#define COV_SIMD_WIDTH 8
+#elif defined(__AVX2__)
+#include <immintrin.h>
+#define COV_SIMD_WIDTH 4
+#else
+#define COV_SIMD_WIDTH 1
+#endif
+
+// min number of SIMD blocks for a batch to be split across threads
+#define COV_BATCH_PARALLEL_BLOCKS 64
+
+namespace {
+
+  //--- Batched Kernel Operations ---//
+  //
+  // Each kernel is written once in terms of these operations and
+  //  instantiated for a single matrix (double) and for the SIMD vector type.
+  //
+
+  template <class V> inline V Const(double a);
+  template <> inline double Const<double>(double a) { return a; }
+
+  inline double LoadStrided(const double *p, int, double) { return *p; }
+  inline void   StoreStrided(double *p, int, double a) { *p = a; }
+  inline double Add(double a, double b) { return a + b; }
+  inline double Sub(double a, double b) { return a - b; }
+  inline double Mul(double a, double b) { return a * b; }
+  inline double Div(double a, double b) { return a / b; }
+  inline double Min(double a, double b) { return a < b ? a : b; }
+  inline double Max(double a, double b) { return a > b ? a : b; }
+  inline double Abs(double a) { return fabs(a); }
+  inline double Sqrt(double a) { return sqrt(a); }
+  inline double Acos(double a) { return acos(a); }
+  inline double Cos(double a) { return cos(a); }
+  inline bool   Greater(double a, double b) { return a > b; }
+  inline bool   GreaterEq(double a, double b) { return a >= b; }
+  inline double Select(bool mask, double a, double b) { return mask ? a : b; }
+
+#if COV_SIMD_WIDTH == 8
+  typedef __m512d SimdVec;
+  typedef __mmask8 SimdMask;
+  template <> inline SimdVec Const<SimdVec>(double a) { return _mm512_set1_pd(a); }
+  inline SimdVec LoadStrided(const double *p, int s, SimdVec)
+  {
+    return _mm512_set_pd(p[7 * s], p[6 * s], p[5 * s], p[4 * s], p[3 * s], p[2 * s], p[s], p[0]);
+  }
+  inline void StoreStrided(double *p, int s, SimdVec a)
+  {
+    double t[8];
+    _mm512_storeu_pd(t, a);
+    for (int k = 0; k < 8; k++) p[k * s] = t[k];
+  }
+  inline SimdVec Add(SimdVec a, SimdVec b) { return _mm512_add_pd(a, b); }
+  inline SimdVec Sub(SimdVec a, SimdVec b) { return _mm512_sub_pd(a, b); }
+  inline SimdVec Mul(SimdVec a, SimdVec b) { return _mm512_mul_pd(a, b); }
+  inline SimdVec Div(SimdVec a, SimdVec b) { return _mm512_div_pd(a, b); }
+  inline SimdVec Min(SimdVec a, SimdVec b) { return _mm512_min_pd(a, b); }
+  inline SimdVec Max(SimdVec a, SimdVec b) { return _mm512_max_pd(a, b); }
+  inline SimdVec Abs(SimdVec a) { return _mm512_max_pd(a, _mm512_sub_pd(_mm512_setzero_pd(), a)); }
+  inline SimdVec Sqrt(SimdVec a) { return _mm512_sqrt_pd(a); }
+  inline SimdMask Greater(SimdVec a, SimdVec b) { return _mm512_cmp_pd_mask(a, b, _CMP_GT_OQ); }
+  inline SimdMask GreaterEq(SimdVec a, SimdVec b) { return _mm512_cmp_pd_mask(a, b, _CMP_GE_OQ); }
+  inline SimdVec Select(SimdMask mask, SimdVec a, SimdVec b) { return _mm512_mask_blend_pd(mask, b, a); }
+#elif COV_SIMD_WIDTH == 4
+  typedef __m256d SimdVec;
+  typedef __m256d SimdMask;
+  template <> inline SimdVec Const<SimdVec>(double a) { return _mm256_set1_pd(a); }
+  inline SimdVec LoadStrided(const double *p, int s, SimdVec)
+  {
+    return _mm256_set_pd(p[3 * s], p[2 * s], p[s], p[0]);
+  }
+  inline void StoreStrided(double *p, int s, SimdVec a)
+  {
+    double t[4];
+    _mm256_storeu_pd(t, a);
+    for (int k = 0; k < 4; k++) p[k * s] = t[k];
+  }
+  inline SimdVec Add(SimdVec a, SimdVec b) { return _mm256_add_pd(a, b); }
+  inline SimdVec Sub(SimdVec a, SimdVec b) { return _mm256_sub_pd(a, b); }
+  inline SimdVec Mul(SimdVec a, SimdVec b) { return _mm256_mul_pd(a, b); }
+  inline SimdVec Div(SimdVec a, SimdVec b) { return _mm256_div_pd(a, b); }
+  inline SimdVec Min(SimdVec a, SimdVec b) { return _mm256_min_pd(a, b); }
+  inline SimdVec Max(SimdVec a, SimdVec b) { return _mm256_max_pd(a, b); }
+  inline SimdVec Abs(SimdVec a) { return _mm256_max_pd(a, _mm256_sub_pd(_mm256_setzero_pd(), a)); }
+  inline SimdVec Sqrt(SimdVec a) { return _mm256_sqrt_pd(a); }
+  inline SimdMask Greater(SimdVec a, SimdVec b) { return _mm256_cmp_pd(a, b, _CMP_GT_OQ); }
+  inline SimdMask GreaterEq(SimdVec a, SimdVec b) { return _mm256_cmp_pd(a, b, _CMP_GE_OQ); }
+  inline SimdVec Select(SimdMask mask, SimdVec a, SimdVec b) { return _mm256_blendv_pd(b, a, mask); }
+#else
+  typedef double SimdVec;
+#endif
+
+#if COV_SIMD_WIDTH > 1
+  // no SIMD instructions for the trigonometric functions => apply per lane
+  inline SimdVec Acos(SimdVec a)
+  {
+    double t[COV_SIMD_WIDTH];
+    StoreStrided(t, 1, a);
+    for (int k = 0; k < COV_SIMD_WIDTH; k++) t[k] = acos(t[k]);
+    return LoadStrided(t, 1, a);
+  }
+  inline SimdVec Cos(SimdVec a)
+  {
+    double t[COV_SIMD_WIDTH];
+    StoreStrided(t, 1, a);
+    for (int k = 0; k < COV_SIMD_WIDTH; k++) t[k] = cos(t[k]);
+    return LoadStrided(t, 1, a);
+  }
+#endif
+
+  // symmetric 3x3 matrix in packed form
+  template <class V>
+  struct Sym3
+  {
+    V xx, xy, xz, yy, yz, zz;
+  };
+
+  // upper triangle of the row-major 3x3 matrix at p (matrices spaced 9 apart)
+  template <class V>
+  inline Sym3<V> LoadSym3(const double *p)
+  {
+    Sym3<V> m;
+    V t = V();
+    m.xx = LoadStrided(p + 0, 9, t);
+    m.xy = LoadStrided(p + 1, 9, t);
+    m.xz = LoadStrided(p + 2, 9, t);
+    m.yy = LoadStrided(p + 4, 9, t);
+    m.yz = LoadStrided(p + 5, 9, t);
+    m.zz = LoadStrided(p + 8, 9, t);
+    return m;
+  }
+
+  template <class V>
+  inline void StoreSym3(double *p, const Sym3<V> &m)
+  {
+    StoreStrided(p + 0, 9, m.xx);
+    StoreStrided(p + 1, 9, m.xy);
+    StoreStrided(p + 2, 9, m.xz);
+    StoreStrided(p + 3, 9, m.xy);
+    StoreStrided(p + 4, 9, m.yy);
+    StoreStrided(p + 5, 9, m.yz);
+    StoreStrided(p + 6, 9, m.xz);
+    StoreStrided(p + 7, 9, m.yz);
+    StoreStrided(p + 8, 9, m.zz);
+  }
+
+  template <class V>
+  inline void Cross(const V a[3], const V b[3], V c[3])
+  {
+    c[0] = Sub(Mul(a[1], b[2]), Mul(a[2], b[1]));
+    c[1] = Sub(Mul(a[2], b[0]), Mul(a[0], b[2]));
+    c[2] = Sub(Mul(a[0], b[1]), Mul(a[1], b[0]));
+  }
+
+  template <class V>
+  inline V Dot(const V a[3], const V b[3])
+  {
+    return Add(Add(Mul(a[0], b[0]), Mul(a[1], b[1])), Mul(a[2], b[2]));
+  }
+
+  template <class V>
+  inline void MulSym3(const Sym3<V> &m, const V x[3], V y[3])
+  {
+    y[0] = Add(Add(Mul(m.xx, x[0]), Mul(m.xy, x[1])), Mul(m.xz, x[2]));
+    y[1] = Add(Add(Mul(m.xy, x[0]), Mul(m.yy, x[1])), Mul(m.yz, x[2]));
+    y[2] = Add(Add(Mul(m.xz, x[0]), Mul(m.yz, x[1])), Mul(m.zz, x[2]));
+  }
+
+
+  //--- Kernels ---//
+
+  // eigen values of a symmetric matrix (descending)
+  //  Trigonometric solution of the characteristic polynomial of
+  //    B = (M - q*I)/p,  q = trace(M)/3,  p = sqrt(trace((M - q*I)^2)/6)
+  //  whose eigen values are 2*cos(acos(det(B)/2)/3 + 2*pi*k/3)
+  //  halfDet receives det(B)/2 (clamped to [-1,1])
+  template <class V>
+  inline void EigenValuesSym3(const Sym3<V> &m, V eval[3], V &halfDet)
+  {
+    V zero = Const<V>(0.0);
+    V one = Const<V>(1.0);
+    V tiny = Const<V>(DBL_MIN);
+
+    V q = Mul(Add(Add(m.xx, m.yy), m.zz), Const<V>(1.0 / 3.0));
+    V b00 = Sub(m.xx, q);
+    V b11 = Sub(m.yy, q);
+    V b22 = Sub(m.zz, q);
+    V offDiag = Add(Add(Mul(m.xy, m.xy), Mul(m.xz, m.xz)), Mul(m.yz, m.yz));
+    V p2 = Add(Add(Add(Mul(b00, b00), Mul(b11, b11)), Mul(b22, b22)), Add(offDiag, offDiag));
+    V p = Sqrt(Mul(p2, Const<V>(1.0 / 6.0)));
+    V pSafe = Max(p, tiny);
+
+    // det(B)/2
+    V c00 = Sub(Mul(b11, b22), Mul(m.yz, m.yz));
+    V c01 = Sub(Mul(m.yz, m.xz), Mul(m.xy, b22));
+    V c02 = Sub(Mul(m.xy, m.yz), Mul(b11, m.xz));
+    V detB = Add(Add(Mul(b00, c00), Mul(m.xy, c01)), Mul(m.xz, c02));
+    halfDet = Div(Mul(detB, Const<V>(0.5)), Mul(Mul(pSafe, pSafe), pSafe));
+    halfDet = Min(Max(halfDet, Const<V>(-1.0)), one);
+    // isotropic matrix (p = 0) => all eigen values equal q
+    halfDet = Select(Greater(p, tiny), halfDet, zero);
+
+    V angle = Mul(Acos(halfDet), Const<V>(1.0 / 3.0));
+    V beta2 = Mul(Const<V>(2.0), Cos(angle));
+    V beta0 = Mul(Const<V>(2.0), Cos(Add(angle, Const<V>(2.0943951023931954923))));  // + 2*pi/3
+    V beta1 = Sub(zero, Add(beta0, beta2));
+    eval[0] = Add(q, Mul(p, beta2));
+    eval[1] = Add(q, Mul(p, beta1));
+    eval[2] = Add(q, Mul(p, beta0));
+  }
+
+  // unit eigen vector of an eigen value of multiplicity 1
+  //  (the largest cross product of two rows of M - eval*I)
+  template <class V>
+  inline void EigenVectorDistinct(const Sym3<V> &m, V eval, V evec[3])
+  {
+    V r0[3] = { Sub(m.xx, eval), m.xy, m.xz };
+    V r1[3] = { m.xy, Sub(m.yy, eval), m.yz };
+    V r2[3] = { m.xz, m.yz, Sub(m.zz, eval) };
+    V c01[3], c02[3], c12[3];
+    Cross(r0, r1, c01);
+    Cross(r0, r2, c02);
+    Cross(r1, r2, c12);
+    V d01 = Dot(c01, c01);
+    V d02 = Dot(c02, c02);
+    V d12 = Dot(c12, c12);
+
+    V dmax = d01;
+    V best[3] = { c01[0], c01[1], c01[2] };
+    for (int k = 0; k < 3; k++) best[k] = Select(Greater(d02, dmax), c02[k], best[k]);
+    dmax = Max(d02, dmax);
+    for (int k = 0; k < 3; k++) best[k] = Select(Greater(d12, dmax), c12[k], best[k]);
+    dmax = Max(d12, dmax);
+
+    // all rows parallel only for an isotropic matrix => any axis will do
+    V tiny = Const<V>(DBL_MIN);
+    V valid = Max(dmax, tiny);
+    V invLen = Div(Const<V>(1.0), Sqrt(valid));
+    evec[0] = Select(Greater(dmax, tiny), Mul(best[0], invLen), Const<V>(1.0));
+    evec[1] = Select(Greater(dmax, tiny), Mul(best[1], invLen), Const<V>(0.0));
+    evec[2] = Select(Greater(dmax, tiny), Mul(best[2], invLen), Const<V>(0.0));
+  }
+
+  // unit eigen vector orthogonal to evec0 of the eigen value eval
+  //  solved in the plane orthogonal to evec0, which is robust to
+  //  repeated eigen values
+  template <class V>
+  inline void EigenVectorOrthogonal(const Sym3<V> &m, const V evec0[3], V eval, V evec[3])
+  {
+    V zero = Const<V>(0.0);
+    V one = Const<V>(1.0);
+
+    // orthonormal basis {U, W} of the plane orthogonal to evec0
+    V U[3], W[3];
+    V invA = Div(one, Sqrt(Add(Mul(evec0[0], evec0[0]), Mul(evec0[2], evec0[2]))));
+    V invB = Div(one, Sqrt(Add(Mul(evec0[1], evec0[1]), Mul(evec0[2], evec0[2]))));
+    V useX = Sub(Abs(evec0[0]), Abs(evec0[1]));
+    U[0] = Select(GreaterEq(useX, zero), Mul(Sub(zero, evec0[2]), invA), zero);
+    U[1] = Select(GreaterEq(useX, zero), zero, Mul(evec0[2], invB));
+    U[2] = Select(GreaterEq(useX, zero), Mul(evec0[0], invA), Mul(Sub(zero, evec0[1]), invB));
+    Cross(evec0, U, W);
+
+    // 2x2 problem  [U W]'*(M - eval*I)*[U W]
+    V MU[3], MW[3];
+    MulSym3(m, U, MU);
+    MulSym3(m, W, MW);
+    V m00 = Sub(Dot(U, MU), eval);
+    V m01 = Dot(U, MW);
+    V m11 = Sub(Dot(W, MW), eval);
+    V a00 = Abs(m00), a01 = Abs(m01), a11 = Abs(m11);
+
+    // null vector of the larger row
+    //  row (m00, m01) if |m00| >= |m11|:  c*(m01, -m00) normalized
+    //  row (m01, m11) otherwise:          c*(m11, -m01) normalized
+    V useRow0 = Sub(a00, a11);
+    V r0 = Select(GreaterEq(useRow0, zero), m00, m11);
+    V r1 = m01;
+    V ar0 = Abs(r0), ar1 = a01;
+    V t = Select(GreaterEq(ar0, ar1), Div(r1, r0), Div(r0, r1));
+    V c = Div(one, Sqrt(Add(one, Mul(t, t))));
+    // normalized (r0, r1)
+    V n0 = Select(GreaterEq(ar0, ar1), c, Mul(t, c));
+    V n1 = Select(GreaterEq(ar0, ar1), Mul(t, c), c);
+    // plane coordinates of the null vector
+    //  row 0: (m01, -m00)   row 1: (m11, -m01)
+    V su = Select(GreaterEq(useRow0, zero), n1, n0);
+    V sw = Select(GreaterEq(useRow0, zero), n0, n1);
+    V maxAbs = Max(ar0, ar1);
+    for (int k = 0; k < 3; k++)
+    {
+      V v = Sub(Mul(su, U[k]), Mul(sw, W[k]));
+      evec[k] = Select(Greater(maxAbs, zero), v, U[k]);
+    }
+  }
+
+  // eigen decomposition of a symmetric matrix
+  //  eigen values in descending order; eigen vectors by column with
+  //  determinant = 1
+  template <class V>
+  inline void EigenDecompositionSym3(const Sym3<V> &m0, V eval[3], V evec[3][3])
+  {
+    // scale to unit max element to protect against over/underflow
+    V tiny = Const<V>(DBL_MIN);
+    V scale = Max(Max(Max(Abs(m0.xx), Abs(m0.xy)), Max(Abs(m0.xz), Abs(m0.yy))),
+      Max(Abs(m0.yz), Abs(m0.zz)));
+    scale = Select(Greater(scale, tiny), scale, Const<V>(1.0));
+    V invScale = Div(Const<V>(1.0), scale);
+    Sym3<V> m;
+    m.xx = Mul(m0.xx, invScale);
+    m.xy = Mul(m0.xy, invScale);
+    m.xz = Mul(m0.xz, invScale);
+    m.yy = Mul(m0.yy, invScale);
+    m.yz = Mul(m0.yz, invScale);
+    m.zz = Mul(m0.zz, invScale);
+
+    V halfDet;
+    EigenValuesSym3(m, eval, halfDet);
+
+    // the eigen value farthest from the middle one has multiplicity 1:
+    //  the largest if det(B) >= 0, the smallest otherwise
+    V zero = Const<V>(0.0);
+    V distinctIsMax = Sub(halfDet, zero);
+    V evalA = Select(GreaterEq(distinctIsMax, zero), eval[0], eval[2]);
+    V va[3], vb[3], vab[3], vba[3];
+    EigenVectorDistinct(m, evalA, va);
+    EigenVectorOrthogonal(m, va, eval[1], vb);
+    Cross(va, vb, vab);
+    Cross(vb, va, vba);
+
+    // columns: [va vb va x vb] or [vb x va  vb  va]
+    for (int k = 0; k < 3; k++)
+    {
+      evec[k][0] = Select(GreaterEq(distinctIsMax, zero), va[k], vba[k]);
+      evec[k][1] = vb[k];
+      evec[k][2] = Select(GreaterEq(distinctIsMax, zero), vab[k], va[k]);
+    }
+
+    // refine the eigen values by their Rayleigh quotients
+    //  (the trigonometric solution loses accuracy near repeated eigen values)
+    for (int c = 0; c < 3; c++)
+    {
+      V v[3] = { evec[0][c], evec[1][c], evec[2][c] };
+      V Mv[3];
+      MulSym3(m, v, Mv);
+      eval[c] = Mul(Dot(v, Mv), scale);
+    }
+  }
+
+  template <class V>
+  inline void EigenDecompositionKernel(const double *M, double *eigenValues, double *eigenVectors, int i)
+  {
+    Sym3<V> m = LoadSym3<V>(M + 9 * i);
+    V eval[3], evec[3][3];
+    EigenDecompositionSym3(m, eval, evec);
+    for (int k = 0; k < 3; k++)
+    {
+      StoreStrided(eigenValues + 3 * i + k, 3, eval[k]);
+    }
+    if (eigenVectors)
+    {
+      for (int r = 0; r < 3; r++)
+      {
+        for (int c = 0; c < 3; c++)
+        {
+          StoreStrided(eigenVectors + 9 * i + 3 * r + c, 9, evec[r][c]);
+        }
+      }
+    }
+  }
+
+  template <class V>
+  inline void EigenValuesKernel(const double *M, double *eigenValues, int i)
+  {
+    Sym3<V> m0 = LoadSym3<V>(M + 9 * i);
+    V tiny = Const<V>(DBL_MIN);
+    V scale = Max(Max(Max(Abs(m0.xx), Abs(m0.xy)), Max(Abs(m0.xz), Abs(m0.yy))),
+      Max(Abs(m0.yz), Abs(m0.zz)));
+    scale = Select(Greater(scale, tiny), scale, Const<V>(1.0));
+    V invScale = Div(Const<V>(1.0), scale);
+    Sym3<V> m;
+    m.xx = Mul(m0.xx, invScale);
+    m.xy = Mul(m0.xy, invScale);
+    m.xz = Mul(m0.xz, invScale);
+    m.yy = Mul(m0.yy, invScale);
+    m.yz = Mul(m0.yz, invScale);
+    m.zz = Mul(m0.zz, invScale);
+    V eval[3], halfDet;
+    EigenValuesSym3(m, eval, halfDet);
+    for (int k = 0; k < 3; k++)
+    {
+      StoreStrided(eigenValues + 3 * i + k, 3, Mul(eval[k], scale));
+    }
+  }
+
+  // inverse (by cofactors) and determinant of a symmetric matrix
+  template <class V>
+  inline void InverseKernel(const double *M, double *Minv, double *det_M, int i)
+  {
+    Sym3<V> m = LoadSym3<V>(M + 9 * i);
+    Sym3<V> c;
+    c.xx = Sub(Mul(m.yy, m.zz), Mul(m.yz, m.yz));
+    c.xy = Sub(Mul(m.xz, m.yz), Mul(m.xy, m.zz));
+    c.xz = Sub(Mul(m.xy, m.yz), Mul(m.xz, m.yy));
+    c.yy = Sub(Mul(m.xx, m.zz), Mul(m.xz, m.xz));
+    c.yz = Sub(Mul(m.xy, m.xz), Mul(m.xx, m.yz));
+    c.zz = Sub(Mul(m.xx, m.yy), Mul(m.xy, m.xy));
+    V det = Add(Add(Mul(m.xx, c.xx), Mul(m.xy, c.xy)), Mul(m.xz, c.xz));
+    V invDet = Div(Const<V>(1.0), det);
+    c.xx = Mul(c.xx, invDet);
+    c.xy = Mul(c.xy, invDet);
+    c.xz = Mul(c.xz, invDet);
+    c.yy = Mul(c.yy, invDet);
+    c.yz = Mul(c.yz, invDet);
+    c.zz = Mul(c.zz, invDet);
+    StoreSym3(Minv + 9 * i, c);
+    if (det_M)
+    {
+      StoreStrided(det_M + i, 1, det);
+    }
+  }
+
+  // R*M*R'
+  template <class V>
+  inline void RMRtKernel(const double *R, const double *M, double *RMRt, int i)
+  {
+    Sym3<V> m = LoadSym3<V>(M + 9 * i);
+    V Rv[3][3];
+    for (int r = 0; r < 3; r++)
+    {
+      for (int c = 0; c < 3; c++)
+      {
+        Rv[r][c] = Const<V>(R[3 * r + c]);
+      }
+    }
+    // T = M*R'   (columns of T = M * rows of R)
+    V T[3][3];
+    for (int c = 0; c < 3; c++)
+    {
+      V y[3];
+      MulSym3(m, Rv[c], y);
+      T[0][c] = y[0];
+      T[1][c] = y[1];
+      T[2][c] = y[2];
+    }
+    Sym3<V> o;
+    V t0[3] = { T[0][0], T[1][0], T[2][0] };
+    V t1[3] = { T[0][1], T[1][1], T[2][1] };
+    V t2[3] = { T[0][2], T[1][2], T[2][2] };
+    o.xx = Dot(Rv[0], t0);
+    o.xy = Dot(Rv[0], t1);
+    o.xz = Dot(Rv[0], t2);
+    o.yy = Dot(Rv[1], t1);
+    o.yz = Dot(Rv[1], t2);
+    o.zz = Dot(Rv[2], t2);
+    StoreSym3(RMRt + 9 * i, o);
+  }
+
+  // perp*I + (prll - perp)*n*n'
+  template <class V>
+  inline void PointCovarianceKernel(
+    const double *norms, V prll, V perp, double *M, int i)
+  {
+    V t = V();
+    V nx = LoadStrided(norms + 3 * i + 0, 3, t);
+    V ny = LoadStrided(norms + 3 * i + 1, 3, t);
+    V nz = LoadStrided(norms + 3 * i + 2, 3, t);
+    V d = Sub(prll, perp);
+    Sym3<V> m;
+    m.xx = Add(perp, Mul(d, Mul(nx, nx)));
+    m.xy = Mul(d, Mul(nx, ny));
+    m.xz = Mul(d, Mul(nx, nz));
+    m.yy = Add(perp, Mul(d, Mul(ny, ny)));
+    m.yz = Mul(d, Mul(ny, nz));
+    m.zz = Add(perp, Mul(d, Mul(nz, nz)));
+    StoreSym3(M + 9 * i, m);
+  }
+
+  // batch driver: whole SIMD blocks (split across threads for large
+  //  batches) followed by the remaining matrices one at a time
+  template <class Kernel>
+  void RunBatch(const Kernel &kernel, int count)
+  {
+    int nBlocks = count / COV_SIMD_WIDTH;
+#ifdef ENABLE_PARALLELIZATION
+#pragma omp parallel for if (nBlocks > COV_BATCH_PARALLEL_BLOCKS)
+#endif
+    for (int b = 0; b < nBlocks; b++)
+    {
+      kernel.template Run<SimdVec>(b * COV_SIMD_WIDTH);
+    }
+    for (int i = nBlocks * COV_SIMD_WIDTH; i < count; i++)
+    {
+      kernel.template Run<double>(i);
+    }
+  }
+
+  struct EigenDecompositionBatch
+  {
+    const double *M; double *eigenValues; double *eigenVectors;
+    template <class V> void Run(int i) const
+    {
+      EigenDecompositionKernel<V>(M, eigenValues, eigenVectors, i);
+    }
+  };
+
+  struct EigenValuesBatch
+  {
+    const double *M; double *eigenValues;
+    template <class V> void Run(int i) const
+    {
+      EigenValuesKernel<V>(M, eigenValues, i);
+    }
+  };
+
+  struct InverseBatch
+  {
+    const double *M; double *Minv; double *det_M;
+    template <class V> void Run(int i) const
+    {
+      InverseKernel<V>(M, Minv, det_M, i);
+    }
+  };
+
+  struct RMRtBatch
+  {
+    const double *R; const double *M; double *RMRt;
+    template <class V> void Run(int i) const
+    {
+      RMRtKernel<V>(R, M, RMRt, i);
+    }
+  };
+
+  struct PointCovarianceBatch
+  {
+    const double *norms; double prll; double perp; double *M;
+    template <class V> void Run(int i) const
+    {
+      PointCovarianceKernel<V>(norms, Const<V>(prll), Const<V>(perp), M, i);
+    }
+  };
+
+  struct PointCovarianceArrayBatch
+  {
+    const double *norms; const double *prll; const double *perp; double *M;
+    template <class V> void Run(int i) const
+    {
+      PointCovarianceKernel<V>(norms, LoadStrided(prll + i, 1, V()), LoadStrided(perp + i, 1, V()), M, i);
+    }
+  };
+
+} // namespace
+
+
+void COV_BATCH_KERNEL(ComputeCovEigenDecomposition_Batch)(
+  const double *M, int count, double *eigenValues, double *eigenVectors)
+{
+  if (count <= 0) return;
+  EigenDecompositionBatch kernel = { M, eigenValues, eigenVectors };
+  RunBatch(kernel, count);
+}
+
+void COV_BATCH_KERNEL(ComputeCovEigenValues_Batch)(
+  const double *M, int count, double *eigenValues)
+{
+  if (count <= 0) return;
+  EigenValuesBatch kernel = { M, eigenValues };
+  RunBatch(kernel, count);
+}
+
+void COV_BATCH_KERNEL(ComputeCovDecomposition_Batch)(
+  const double *M, int count, double *Minv, double *det_M)
+{
+  if (count <= 0) return;
+  InverseBatch kernel = { M, Minv, det_M };
+  RunBatch(kernel, count);
+}
+
+void COV_BATCH_KERNEL(Calc_RMRt_Batch)(
+  const double *R, const double *M, int count, double *RMRt)
+{
+  if (count <= 0) return;
+  RMRtBatch kernel = { R, M, RMRt };
+  RunBatch(kernel, count);
+}
+
+void COV_BATCH_KERNEL(ComputePointCovariance_Batch)(
+  const double *norms, int count,
+  double normPrllVar, double normPerpVar, double *M)
+{
+  if (count <= 0) return;
+  PointCovarianceBatch kernel = { norms, normPrllVar, normPerpVar, M };
+  RunBatch(kernel, count);
+}
+
+void COV_BATCH_KERNEL(ComputePointCovariance_Batch)(
+  const double *norms, int count,
+  const double *normPrllVar, const double *normPerpVar, double *M)
+{
+  if (count <= 0) return;
+  PointCovarianceArrayBatch kernel = { norms, normPrllVar, normPerpVar, M };
+  RunBatch(kernel, count);
+}
@@ -0,0 +1,132 @@
+// ****************************************************************************
+//
+//    Copyright (c) 2014, Seth Billings, Russell Taylor, Johns Hopkins University
+//    All rights reserved.
+//
+//    Redistribution and use in source and binary forms, with or without
+//    modification, are permitted provided that the following conditions are
+//    met:
+//
+//    1. Redistributions of source code must retain the above copyright
+//    notice, this list of conditions and the following disclaimer.
+//
+//    2. Redistributions in binary form must reproduce the above copyright
+//    notice, this list of conditions and the following disclaimer in the
+//    documentation and/or other materials provided with the distribution.
+//
+//    3. Neither the name of the copyright holder nor the names of its
+//    contributors may be used to endorse or promote products derived from
+//    this software without specific prior written permission.
+//
+//    THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+//    "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+//    LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+//    A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+//    HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+//    SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+//    LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+//    DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+//    THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+//    (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+//    OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//  
+// ****************************************************************************
+
+#include "CovDecompositionCache.h"
+#include "utilities.h"
+#include "CovBatchKernels.h"
+
+#define ENABLE_PARALLELIZATION
+
+void CovDecompositionCache::SetCovariances(const vctDynamicVector<vct3x3> &M)
+{
+  unsigned int n = (unsigned int)M.size();
+  eigValues.SetSize(n);
+  eigVectors.SetSize(n);
+  invM.SetSize(n);
+  detM.SetSize(n);
+  inv_R_Msigma2_Rt.SetSize(n);
+  det_R_Msigma2_Rt.SetSize(n);
+
+  ComputeCovEigenDecomposition_Batch(M.Pointer(), n, eigValues.Pointer(), eigVectors.Pointer());
+
+  int i;
+#ifdef ENABLE_PARALLELIZATION
+#pragma omp parallel for
+#endif
+  for (i = 0; i < (int)n; i++)
+  {
+    // Minv = V*diag(1/S)*V'
+    vct3x3 V_Sinv;
+    V_Sinv.Column(0) = eigVectors[i].Column(0) / eigValues[i][0];
+    V_Sinv.Column(1) = eigVectors[i].Column(1) / eigValues[i][1];
+    V_Sinv.Column(2) = eigVectors[i].Column(2) / eigValues[i][2];
+    invM[i] = V_Sinv * eigVectors[i].TransposeRef();
+    detM[i] = eigValues[i].ProductOfElements();
+  }
+
+  bValid = false;
+  nUpdates = 0;
+  nReuses = 0;
+}
+
+bool CovDecompositionCache::Update(const vctRot3 &R, double sigma2)
+{
+  if (bValid && sigma2 == keySigma2 && R.Equal(keyR))
+  {
+    nReuses++;
+    return false;
+  }
+
+  int i;
+  int n = (int)size();
+#ifdef ENABLE_PARALLELIZATION
+#pragma omp parallel for
+#endif
+  for (i = 0; i < n; i++)
+  {
+    // (R*(M + sigma2*I)*R')^-1 = (R*V)*diag(1/(S + sigma2))*(R*V)'
+    vct3 S(eigValues[i] + sigma2);
+    vct3x3 RV(R * eigVectors[i]);
+    vct3x3 RV_Sinv;
+    RV_Sinv.Column(0) = RV.Column(0) / S[0];
+    RV_Sinv.Column(1) = RV.Column(1) / S[1];
+    RV_Sinv.Column(2) = RV.Column(2) / S[2];
+    inv_R_Msigma2_Rt[i] = RV_Sinv * RV.TransposeRef();
+    det_R_Msigma2_Rt[i] = S.ProductOfElements();
+  }
+
+  keyR = R;
+  keySigma2 = sigma2;
+  bValid = true;
+  nUpdates++;
+  return true;
+}
+
+void CovDecompositionCache::Decompose(unsigned int i, double sigma2,
+  vct3x3 &Minv, vct3x3 &N, vct3x3 &Ninv,
+  double &Dmin, double &Emin) const
+{
+  const vct3 &S0 = eigValues.Element(i);
+  const vct3x3 &V = eigVectors.Element(i);
+  vct3 S(S0 + sigma2);
+
+  // Minv = V*diag(1/S)*V'
+  vct3x3 V_Sinv;
+  V_Sinv.Column(0) = V.Column(0) / S[0];
+  V_Sinv.Column(1) = V.Column(1) / S[1];
+  V_Sinv.Column(2) = V.Column(2) / S[2];
+  Minv.Assign(V_Sinv * V.TransposeRef());
+
+  // Minv = N'*N    Dinv = sqrt(S)
+  vct3 Dinv(sqrt(S[0]), sqrt(S[1]), sqrt(S[2]));
+  N.Row(0) = V.Column(0) / Dinv[0];
+  N.Row(1) = V.Column(1) / Dinv[1];
+  N.Row(2) = V.Column(2) / Dinv[2];
+  Ninv.Column(0) = V.Column(0)*Dinv[0];
+  Ninv.Column(1) = V.Column(1)*Dinv[1];
+  Ninv.Column(2) = V.Column(2)*Dinv[2];
+
+  Emin = 1.0 / S[0];
+  Dmin = 1.0 / Dinv[0];
+}
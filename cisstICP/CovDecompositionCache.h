@@ -0,0 +1,114 @@
+// ****************************************************************************
+//
+//    Copyright (c) 2014, Seth Billings, Russell Taylor, Johns Hopkins University
+//    All rights reserved.
+//
+//    Redistribution and use in source and binary forms, with or without
+//    modification, are permitted provided that the following conditions are
+//    met:
+//
+//    1. Redistributions of source code must retain the above copyright
+//    notice, this list of conditions and the following disclaimer.
+//
+//    2. Redistributions in binary form must reproduce the above copyright
+//    notice, this list of conditions and the following disclaimer in the
+//    documentation and/or other materials provided with the distribution.
+//
+//    3. Neither the name of the copyright holder nor the names of its
+//    contributors may be used to endorse or promote products derived from
+//    this software without specific prior written permission.
+//
+//    THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+//    "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+//    LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+//    A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+//    HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+//    SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+//    LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+//    DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+//    THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+//    (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+//    OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//  
+// ****************************************************************************
+#ifndef _CovDecompositionCache_h
+#define _CovDecompositionCache_h
+
+#include <cisstVector.h>
+
+// Per-sample covariance decompositions shared by the phases of an iteration
+//
+//  The sample covariances M[i] are eigen-decomposed once, when they are set:
+//    M[i] = V[i]*diag(S[i])*V[i]'
+//  A covariance of the form  R*(M[i] + sigma2*I)*R'  has eigenvectors R*V[i]
+//  and eigenvalues S[i] + sigma2, so its inverse and determinant follow from
+//  the stored decomposition without solving a new eigen problem.
+//
+//  Update(R, sigma2) recomputes the rotated inverses only when the rotation
+//  or sigma2 differ from those of the previous update. Both usually change
+//  every iteration, so the saving is mainly the eigen solve that each update
+//  avoids, rather than reuse of a previous key.
+//
+class CovDecompositionCache
+{
+
+protected:
+
+  vctDynamicVector<vct3>    eigValues;    // eigen values of M[i] (descending)
+  vctDynamicVector<vct3x3>  eigVectors;   // eigen vectors of M[i] (by column)
+  vctDynamicVector<vct3x3>  invM;         // M[i]^-1
+  vctDynamicVector<double>  detM;         // |M[i]|
+
+  // decompositions for the current key
+  vctDynamicVector<vct3x3>  inv_R_Msigma2_Rt;   // (R*(M[i] + sigma2*I)*R')^-1
+  vctDynamicVector<double>  det_R_Msigma2_Rt;   // |R*(M[i] + sigma2*I)*R'|
+  vctRot3 keyR;
+  double  keySigma2;
+  bool    bValid;
+
+  // statistics
+  unsigned int nUpdates;    // key changes (rotated inverses recomputed)
+  unsigned int nReuses;     // update requests served from the cache
+
+public:
+
+  CovDecompositionCache() :
+    keySigma2(0.0),
+    bValid(false),
+    nUpdates(0),
+    nReuses(0)
+  {}
+
+  // decompose the covariances (invalidates the current key)
+  void SetCovariances(const vctDynamicVector<vct3x3> &M);
+
+  // set the key for Inverse() and Determinant()
+  //  returns true if the decompositions were recomputed
+  bool Update(const vctRot3 &R, double sigma2);
+
+  void Invalidate() { bValid = false; }
+
+  unsigned int size() const { return (unsigned int)eigValues.size(); }
+
+  // decomposition of R*(M[i] + sigma2*I)*R' for the current key
+  const vct3x3 &Inverse(unsigned int i) const { return inv_R_Msigma2_Rt.Element(i); }
+  double Determinant(unsigned int i) const { return det_R_Msigma2_Rt.Element(i); }
+
+  // decomposition of M[i] (independent of the key)
+  const vct3x3 &SampleInverse(unsigned int i) const { return invM.Element(i); }
+  double SampleDeterminant(unsigned int i) const { return detM.Element(i); }
+  const vct3 &EigenValues(unsigned int i) const { return eigValues.Element(i); }
+  const vct3x3 &EigenVectors(unsigned int i) const { return eigVectors.Element(i); }
+
+  // decomposition of M[i] + sigma2*I in the form used by the Kent noise model
+  //   Minv = N'*N     N = D*V'     Ninv = V*inv(D)
+  //   Dmin ~ sqrt of smallest eigenvalue of Minv,  Emin = Dmin^2
+  void Decompose(unsigned int i, double sigma2,
+    vct3x3 &Minv, vct3x3 &N, vct3x3 &Ninv,
+    double &Dmin, double &Emin) const;
+
+  unsigned int NumUpdates() const { return nUpdates; }
+  unsigned int NumReuses() const { return nReuses; }
+};
+
+#endif
@@ -36,11 +36,132 @@
 #include <stdio.h>
 #include <limits>
 #include <fstream>
+#include <vector>
 
 #include <cisstVector.h>
 #include <cisstCommon.h>
 //#include <cisstNumerical/nmrLSSolver.h>
 
+#define ENABLE_PARALLELIZATION
+
+// nodes having fewer datums than this have their subtree constructed
+//  as a single task
+#define DIRPDTREE2D_SUBTREE_THRESH 4096
+
+// number of consecutive points of a batch search assigned to a thread
+//  at a time
+#define DIRPDTREE2D_BATCH_CHUNK_SIZE 16
+
+
+void DirPDTree2DBase::ConstructTree(int countThresh, double diagThresh, bool bUseOBB)
+{
+    int i;
+
+    // precompute the datum sort points and orientations
+    ConstructSortPoints.SetSize(NData);
+    ConstructNorms.SetSize(NData);
+#ifdef ENABLE_PARALLELIZATION
+#pragma omp parallel for
+#endif
+    for (i = 0; i < NData; i++)
+    {
+        ConstructSortPoints[i] = DatumSortPoint(i);
+        ConstructNorms[i] = DatumNorm(i);
+    }
+
+    Top = new DirPDTree2DNode(DataIndices, NData, this, NULL, bUseOBB, 0);
+    NNodes = 1;
+
+    // split the upper levels of the tree one level at a time
+    std::vector<DirPDTree2DNode*> level(1, Top);
+    std::vector<char> isSplit;
+    while (!level.empty())
+    {
+        int nLevel = (int)level.size();
+        isSplit.assign(nLevel, 0);
+#ifdef ENABLE_PARALLELIZATION
+#pragma omp parallel for schedule(dynamic)
+#endif
+        for (i = 0; i < nLevel; i++)
+        {
+            if (level[i]->NumData() < DIRPDTREE2D_SUBTREE_THRESH)
+            {
+                level[i]->ConstructTree(countThresh, diagThresh);
+            }
+            else
+            {
+                isSplit[i] = level[i]->SplitNode(countThresh, diagThresh);
+            }
+        }
+
+        std::vector<DirPDTree2DNode*> nextLevel;
+        for (i = 0; i < nLevel; i++)
+        {
+            if (isSplit[i])
+            {
+                nextLevel.push_back(level[i]->LEq);
+                nextLevel.push_back(level[i]->More);
+            }
+        }
+        level.swap(nextLevel);
+    }
+    treeDepth = Top->CompleteUpperTree(DIRPDTREE2D_SUBTREE_THRESH);
+
+    ConstructSortPoints.SetSize(0);
+    ConstructNorms.SetSize(0);
+
+    BuildDatumLeaves();
+}
+
+void DirPDTree2DBase::BuildDatumLeaves()
+{
+  DatumLeaves.SetSize(NData);
+  DatumLeaves.SetAll(NULL);
+  MapDatumLeaves(Top);
+}
+
+void DirPDTree2DBase::MapDatumLeaves(DirPDTree2DNode *pNode)
+{
+  if (pNode->IsTerminalNode())
+  {
+    for (int i = 0; i < pNode->NData; i++)
+    {
+      DatumLeaves[pNode->Datum(i)] = pNode;
+    }
+    return;
+  }
+  MapDatumLeaves(pNode->LEq);
+  MapDatumLeaves(pNode->More);
+}
+
+// Search the leaf node of the previous match, then the sibling subtree of
+//  each node on the path from this leaf up to the root
+int DirPDTree2DBase::FindClosestDatumFromLeaf(
+  const vct2 &v, const vct2 &n,
+  vct2 &closestPoint, vct2 &closestPointNorm,
+  DirPDTree2DNode *pLeaf,
+  double &ErrorBound,
+  unsigned int &numNodesVisited,
+  unsigned int &numNodesSearched)
+{
+  int ClosestDatum = pLeaf->FindClosestDatum(v, n, closestPoint, closestPointNorm,
+    ErrorBound, numNodesVisited, numNodesSearched);
+
+  for (DirPDTree2DNode *pNode = pLeaf; pNode->Parent; pNode = pNode->Parent)
+  {
+    DirPDTree2DNode *pParent = pNode->Parent;
+    DirPDTree2DNode *pSibling = (pNode == pParent->LEq) ? pParent->More : pParent->LEq;
+    int datum = pSibling->FindClosestDatum(v, n, closestPoint, closestPointNorm,
+      ErrorBound, numNodesVisited, numNodesSearched);
+    if (datum >= 0)
+    {
+      ClosestDatum = datum;
+    }
+  }
+
+  return ClosestDatum;
+}
+
 
 // quickly find an approximate initial match by dropping straight down the
 //   tree to the node containing the sample point and picking a datum from there
@@ -88,7 +209,12 @@ int DirPDTree2DBase::FindClosestDatum(
     //int datum = Top->FindClosestDatum( v, n, closestPoint, closestPointNorm, matchError, numNodesVisited, numNodesSearched );
 
     int datum;
-    if (treeDepth > 0)
+    if (bSearchFromPrevLeaf && treeDepth > 0 && DatumLeaves.size() == (size_t)NData)
+    {
+      datum = FindClosestDatumFromLeaf(v, n, closestPoint, closestPointNorm, DatumLeaves[prevDatum],
+        matchError, numNodesVisited, numNodesSearched);
+    }
+    else if (treeDepth > 0)
     {
       // As an optimization, we can directly search the children of the root, in order
       //  to save a node bounds check, since all datums must lie within the root node
@@ -151,6 +277,75 @@ int DirPDTree2DBase::FindClosestDatum(
     return datum;
 }
 
+void DirPDTree2DBase::FindClosestDatums(
+    const vctDynamicVector<vct2> &points, const vctDynamicVector<vct2> &norms,
+    const vctDynamicVector<int> &prevDatums,
+    vctDynamicVector<int> &outDatums,
+    vctDynamicVector<vct2> &outPoints, vctDynamicVector<vct2> &outNorms,
+    vctDoubleVec &outErrors,
+    PDTreeSearchStats &stats,
+    DirPDTreeMatchCallback *pCallback)
+{
+    unsigned int nPts = points.size();
+    assert(norms.size() == nPts && prevDatums.size() == nPts);
+
+    // Note: outDatums may be the same vector as prevDatums, which
+    //       always has the correct size
+    if (outDatums.size() != nPts) outDatums.SetSize(nPts);
+    if (outPoints.size() != nPts) outPoints.SetSize(nPts);
+    if (outNorms.size() != nPts) outNorms.SetSize(nPts);
+    if (outErrors.size() != nPts) outErrors.SetSize(nPts);
+
+    stats.Reset();
+
+    // the samples are searched in parallel only if the callback vouches
+    //  that the state of the sample being searched is kept per thread
+    int numThreads = 1;
+#ifdef ENABLE_PARALLELIZATION
+    if (pCallback && pCallback->ParallelMatchSafe())
+    {
+      numThreads = omp_get_max_threads();
+    }
+#endif
+    if (pCallback) pCallback->ReserveSearchThreads(numThreads);
+
+    int nSearch = (int)nPts;
+#ifdef ENABLE_PARALLELIZATION
+#pragma omp parallel num_threads(numThreads)
+#endif
+    {
+      // statistics of this thread's searches
+      PDTreeSearchStats threadStats;
+      unsigned int nodesSearched;
+
+      int s;
+#ifdef ENABLE_PARALLELIZATION
+#pragma omp for schedule(dynamic, DIRPDTREE2D_BATCH_CHUNK_SIZE)
+#endif
+      for (s = 0; s < nSearch; s++)
+      {
+        if (pCallback) pCallback->SamplePreMatch(s);
+
+        outDatums.Element(s) = FindClosestDatum(
+          points.Element(s), norms.Element(s),
+          outPoints.Element(s), outNorms.Element(s),
+          prevDatums.Element(s),
+          outErrors.Element(s),
+          nodesSearched);
+        threadStats.Add(nodesSearched);
+
+        if (pCallback) pCallback->SamplePostMatch(s);
+      }
+
+      // the merged statistics are node counts, so they do not depend on
+      //  the order in which the threads are merged
+#ifdef ENABLE_PARALLELIZATION
+#pragma omp critical (DirPDTree2DBase_FindClosestDatums)
+#endif
+      stats.Merge(threadStats);
+    }
+}
+
 // Exhaustive linear search of all datums in the tree for validation of closest datum
 int DirPDTree2DBase::ValidateClosestDatum(
     const vct2 &v, const vct2 &n,
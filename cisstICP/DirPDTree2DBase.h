@@ -44,6 +44,7 @@
 #include "BoundingBox2D.h"
 #include "DirPDTree2DNode.h"
 #include "alg2D_DirPDTree.h"
+#include "PDTreeSearchContext.h"
 
 
 class DirPDTree2DBase
@@ -82,6 +83,18 @@ public:
   int NData;
   int NNodes;
   int treeDepth;
+
+  // leaf node holding each datum
+  //  (used to resume a search from the leaf of the previous match)
+  vctDynamicVector<DirPDTree2DNode*> DatumLeaves;
+  bool bSearchFromPrevLeaf;
+
+  // Tree construction data
+  //  the sort point and orientation of each datum are computed once prior
+  //  to construction rather than at every node; these are released once the
+  //  tree is built
+  vctDynamicVector<vct2> ConstructSortPoints;
+  vctDynamicVector<vct2> ConstructNorms;
   
 
   //--- Methods ---//
@@ -91,7 +104,8 @@ public:
   // constructors
   DirPDTree2DBase() :
     NData(0), NNodes(0), treeDepth(0),
-    DataIndices(NULL), Top(NULL), algorithm(NULL)
+    DataIndices(NULL), Top(NULL), algorithm(NULL),
+    bSearchFromPrevLeaf(true)
   {
 #ifdef DebugDirPDTree2D
     //debugFile = fopen("D:/Code/Repos_Git/SinusProject/MATLAB/debugDirPDTree.txt", "w");
@@ -125,6 +139,26 @@ public:
     double &matchError,
     unsigned int &numNodesSearched);
 
+  // Start each search from the leaf node holding the previous datum rather
+  //  than from the root (default: on; see PDTreeBase::SetSearchFromPreviousLeaf())
+  void SetSearchFromPreviousLeaf(bool enable) { bSearchFromPrevLeaf = enable; };
+
+  // Find the datum having lowest match error for each of a set of points
+  //  The callback (if given) is called before and after the search of each
+  //  point. The oriented search algorithms hold the state of the sample being
+  //  searched, so the points are searched in parallel only if the callback
+  //  keeps that state per thread (see DirPDTreeMatchCallback::ParallelMatchSafe());
+  //  otherwise they are searched serially.
+  //  prevDatums may be the same vector as outDatums.
+  void FindClosestDatums(
+    const vctDynamicVector<vct2> &points, const vctDynamicVector<vct2> &norms,
+    const vctDynamicVector<int> &prevDatums,
+    vctDynamicVector<int> &outDatums,
+    vctDynamicVector<vct2> &outPoints, vctDynamicVector<vct2> &outNorms,
+    vctDoubleVec &outErrors,
+    PDTreeSearchStats &stats,
+    DirPDTreeMatchCallback *pCallback = NULL);
+
   // quickly computes a nearby (not best matching) datum point
   //  used for initializing the closest datums prior to
   //  performing a true tree search
@@ -136,6 +170,20 @@ public:
   int NumNodes() const { return NNodes; };
   int TreeDepth() const { return treeDepth; };
 
+  // set the leaf node of each datum (called once the tree is built)
+  void  BuildDatumLeaves();
+  void  MapDatumLeaves(DirPDTree2DNode *pNode);
+
+  // search from the leaf node of the previous datum
+  //  (see DirPDTreeBase::FindClosestDatumFromLeaf())
+  int   FindClosestDatumFromLeaf(
+    const vct2 &v, const vct2 &n,
+    vct2 &closestPoint, vct2 &closestPointNorm,
+    DirPDTree2DNode *pLeaf,
+    double &ErrorBound,
+    unsigned int &numNodesVisited,
+    unsigned int &numNodesSearched);
+
   // debug routines
   int   ValidateClosestDatum(const vct2 &v, const vct2 &n, vct2 &closestPoint, vct2 &closestPointNorm);
   int   FindTerminalNode(int datum, DirPDTree2DNode **termNode);
@@ -152,6 +200,25 @@ public:
   virtual void  EnlargeBounds(const vctFrm2& F, int datum, BoundingBox2D& BB) const = 0;
   virtual void  EnlargeBounds(int datum, BoundingBox2D& BB) const = 0;
 
+protected:
+
+  // Builds the tree from the datum index array
+  //  (called by the derived class constructor once NData and DataIndices
+  //   are set; see PDTreeBase::ConstructTree())
+  void ConstructTree(int countThresh, double diagThresh, bool bUseOBB);
+
+  // datum routines used during tree construction
+  const vct2& ConstructSortPoint(int datum) const
+  {
+    return ConstructSortPoints.Element(datum);
+  }
+  const vct2& ConstructDatumNorm(int datum) const
+  {
+    return ConstructNorms.Element(datum);
+  }
+
+public:
+
   //virtual void  Print(FILE* chan, int indent);
   //virtual void  PrintDatum(FILE* chan, int indent, int datum);
 
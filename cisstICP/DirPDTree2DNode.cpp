@@ -43,6 +43,8 @@
 #include "DirPDTree2DBase.h"
 #include "utilities2D.h"
 
+#define ENABLE_PARALLELIZATION
+
 DirPDTree2DNode::DirPDTree2DNode(
   int* pDataIndexArray,
   int numIndexes,
@@ -72,7 +74,7 @@ DirPDTree2DNode::DirPDTree2DNode(
     vct2x2  M;
     for (int i = 0; i < NData; i++)
     {
-      p = MyTree->DatumSortPoint(Datum(i));
+      p = MyTree->ConstructSortPoint(Datum(i));
       // accumulate positions
       posSum += p;
       // accumulate covariances
@@ -105,7 +107,7 @@ DirPDTree2DNode::DirPDTree2DNode(
     for (int i = 0; i < NData; i++)
     {
       // accumulate positions
-      posSum += MyTree->DatumSortPoint(Datum(i));;
+      posSum += MyTree->ConstructSortPoint(Datum(i));
 
       // add datum to node
       MyTree->EnlargeBounds(Datum(i), Bounds);
@@ -129,13 +131,41 @@ DirPDTree2DNode::~DirPDTree2DNode()
 
 // returns tree depth
 int DirPDTree2DNode::ConstructTree(int CountThresh, double DiagThresh)
+{
+  if (!SplitNode(CountThresh, DiagThresh))
+  { // leaf node
+    return myDepth;
+  }
+
+  // construct subtrees of the child nodes
+  int depthL, depthR;
+  depthL = LEq->ConstructTree(CountThresh, DiagThresh);
+  depthR = More->ConstructTree(CountThresh, DiagThresh);
+
+  // finish construction of this node
+  myDepth = (depthL > depthR ? depthL : depthR) + 1;
+
+  // compute orientation statistics
+  Nsum = LEq->Nsum + More->Nsum;
+  Navg = ComputeOrientationAverage(Nsum);
+  dThetaMax = ComputeOrientationThetaMax(Navg);
+
+  return myDepth;
+}
+
+// creates the two child nodes of this node, leaving the subtrees of the
+//  children unconstructed; returns false if this is a leaf node
+//  (in which case the leaf node is completed)
+// NOTE: the children use disjoint ranges of the data index array, so their
+//       subtrees may be constructed concurrently
+bool DirPDTree2DNode::SplitNode(int CountThresh, double DiagThresh)
 {
   // Check leaf node condition
   if (NumData() <= CountThresh || Bounds.DiagonalLength() < DiagThresh)
   { // leaf node
     ConstructLeaf();
     myDepth = 0;
-    return myDepth;
+    return false;
   }
 
   // Not a leaf => sort node for splitting
@@ -149,22 +179,8 @@ int DirPDTree2DNode::ConstructTree(int CountThresh, double DiagThresh)
   {
     ConstructLeaf();
     myDepth = 0;  // we decide to stop here and not split any further
-    return myDepth;
+    return false;
   }
-//  // Double check that data split into two nodes
-//  if (topLEq == NumData() || topLEq == 0)
-//  { // all data allocated to only one node
-//    // need this in case count threshold = 1
-//    // TODO: avoid this case by NumData()<=CountThresh above
-//    // BUG: this sometimes occurs when multiple data exists in the node
-//#ifdef DebugDirPDTree2D
-//    fprintf(MyTree->debugFile, "ERROR! all data splits to one node; topLEq=%d\tNdata=%d\tDiagLen=%f\n", 
-//      topLEq, NumData(), Bounds.DiagonalLength());
-//#endif
-//    ConstructLeaf();
-//    myDepth = 0;  // we decide to stop here and not split any further
-//    return myDepth;
-//  }
 
 #ifdef DebugDirPDTree2D
   fprintf(MyTree->debugFile2, "NNodeL=%d\tNNodeR=%d\n", topLEq, NumData() - topLEq);
@@ -174,15 +190,28 @@ int DirPDTree2DNode::ConstructTree(int CountThresh, double DiagThresh)
 #endif
 
   // create child nodes
-  int depthL, depthR;
-
   LEq = new DirPDTree2DNode(DataIndices, topLEq, MyTree, this, bUsingOBB, (splitDim + 1) % 2);
-  MyTree->NNodes++;
-  depthL = LEq->ConstructTree(CountThresh, DiagThresh);
-
   More = new DirPDTree2DNode(&DataIndices[topLEq], NumData() - topLEq, MyTree, this, bUsingOBB, (splitDim + 1) % 2);
-  MyTree->NNodes++;
-  depthR = More->ConstructTree(CountThresh, DiagThresh);
+#ifdef ENABLE_PARALLELIZATION
+#pragma omp atomic
+#endif
+  MyTree->NNodes += 2;
+
+  return true;
+}
+
+// completes the nodes above the subtrees that were constructed
+//  separately (see DirPDTree2DBase::ConstructTree()); returns tree depth
+int DirPDTree2DNode::CompleteUpperTree(int SubtreeThresh)
+{
+  if (NumData() < SubtreeThresh || IsTerminalNode())
+  { // already completed by the subtree construction
+    return myDepth;
+  }
+
+  int depthL, depthR;
+  depthL = LEq->CompleteUpperTree(SubtreeThresh);
+  depthR = More->CompleteUpperTree(SubtreeThresh);
 
   // finish construction of this node
   myDepth = (depthL > depthR ? depthL : depthR) + 1;
@@ -220,11 +249,11 @@ int DirPDTree2DNode::SortNodeForSplit()
     vct2 r = F.Rotation().Row(0);
     double px = F.Translation()[0];
     for (int k = 0; k < top; k++) {
-      Ck = MyTree->DatumSortPoint(Datum(k)); // 3D coordinate in global coord system
+      Ck = MyTree->ConstructSortPoint(Datum(k)); // 3D coordinate in global coord system
       double kx = r*Ck + px;  // compute the x coordinate in local coord system
       if (kx > 0) { // this one needs to go to the end of the line
         while ((--top) > k) {
-          Ct = MyTree->DatumSortPoint(Datum(top));
+          Ct = MyTree->ConstructSortPoint(Datum(top));
           double tx = r*Ct + px;
           if (tx <= 0) {
             int Temp = Datum(k);
@@ -245,12 +274,12 @@ int DirPDTree2DNode::SortNodeForSplit()
     double splitPoint = posAvg.Element(splitDim);
     for (int k = 0; k < top; k++)
     {
-      Ck = MyTree->DatumSortPoint(Datum(k)).Element(splitDim);
+      Ck = MyTree->ConstructSortPoint(Datum(k)).Element(splitDim);
       if (Ck > splitPoint)
       { // this one needs to go to the end of the line
         while ((--top) > k)
         {
-          Ct = MyTree->DatumSortPoint(Datum(top)).Element(splitDim);
+          Ct = MyTree->ConstructSortPoint(Datum(top)).Element(splitDim);
           if (Ct <= splitPoint)
           {
             int Temp = Datum(k);
@@ -341,7 +370,7 @@ vct2 DirPDTree2DNode::ComputeOrientationSum()
   vct2 Nsum(0.0);
   for (int i = 0; i < NumData(); i++)
   {
-    Nsum += MyTree->DatumNorm(Datum(i));
+    Nsum += MyTree->ConstructDatumNorm(Datum(i));
     //int datum = Datum(i);
     //vct2 datumNorm = MyTree->DatumNorm(datum);
     //Nsum += datumNorm;    
@@ -357,7 +386,7 @@ double DirPDTree2DNode::ComputeOrientationThetaMax(vct2 Navg)
   double Theta;
   for (int i = 0; i < NumData(); i++)
   {
-    Theta = acos(MyTree->DatumNorm(Datum(i)).DotProduct(Navg));
+    Theta = acos(MyTree->ConstructDatumNorm(Datum(i)).DotProduct(Navg));
     if (Theta > dThetaMax) { dThetaMax = Theta; }
   }
 #ifdef DebugDirPDTree2D
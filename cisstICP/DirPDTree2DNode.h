@@ -153,6 +153,8 @@ public:
   inline int   IsTerminalNode() const { return LEq == NULL; };
 
   int   ConstructTree(int CountThresh, double DiagThresh);
+  bool  SplitNode(int CountThresh, double DiagThresh);
+  int   CompleteUpperTree(int SubtreeThresh);
 
   DirPDTree2DNode* GetChildSplitNode(const vct2 &datumPos);
 
@@ -50,9 +50,7 @@ DirPDTree2D_Edges::DirPDTree2D_Edges(
     DataIndices[i]=i;
   }
 
-  Top = new DirPDTree2DNode(DataIndices, NData, this, NULL, bUseOBB, 0);
-  NNodes = 1;
-  treeDepth = Top->ConstructTree(countThresh,diagThresh);
+  ConstructTree(countThresh, diagThresh, bUseOBB);
 
 #ifdef DebugDirPDTree2D
   fprintf(debugFile, "Directional Mesh Cov Tree built: NNodes=%d  NData=%d  TreeDepth=%d\n", NumNodes(), NumData(), TreeDepth());
@@ -37,11 +37,469 @@
 #include <stdio.h>
 #include <limits>
 #include <fstream>
+#include <vector>
+#include <string.h>
 
 #include <cisstVector.h>
 #include <cisstCommon.h>
 //#include <cisstNumerical/nmrLSSolver.h>
 
+#include "PDTreeFile.h"
+#include "ICPTrace.h"
+
+#define ENABLE_PARALLELIZATION
+
+// nodes having fewer datums than this have their subtree constructed
+//  as a single task
+#define DIRPDTREE_SUBTREE_THRESH 4096
+
+// number of consecutive points of a batch search assigned to a thread
+//  at a time
+#define DIRPDTREE_BATCH_CHUNK_SIZE 16
+
+
+void DirPDTreeBase::ConstructTree(int countThresh, double diagThresh)
+{
+  ICPTRACE_SCOPE("ConstructTree", "datums", NData);
+  int i;
+
+  constructCountThresh = countThresh;
+  constructDiagThresh = diagThresh;
+
+  // precompute the datum sort points, orientations and bounding points
+  nConstructBoundPoints = NumDatumBoundPoints();
+  ConstructSortPoints.SetSize(NData);
+  ConstructNorms.SetSize(NData);
+  ConstructBoundPoints.SetSize(NData*nConstructBoundPoints);
+#ifdef ENABLE_PARALLELIZATION
+#pragma omp parallel for
+#endif
+  for (i = 0; i < NData; i++)
+  {
+    ConstructSortPoints[i] = DatumSortPoint(i);
+    ConstructNorms[i] = DatumNorm(i);
+    if (nConstructBoundPoints > 0)
+    {
+      DatumBoundPoints(i, ConstructBoundPoints.Pointer(i*nConstructBoundPoints));
+    }
+  }
+
+  Top = new DirPDTreeNode(DataIndices, NData, this, NULL);
+  NNodes = 1;
+
+  // split the upper levels of the tree one level at a time
+  std::vector<DirPDTreeNode*> level(1, Top);
+  std::vector<char> isSplit;
+  while (!level.empty())
+  {
+    int nLevel = (int)level.size();
+    isSplit.assign(nLevel, 0);
+#ifdef ENABLE_PARALLELIZATION
+#pragma omp parallel for schedule(dynamic)
+#endif
+    for (i = 0; i < nLevel; i++)
+    {
+      if (level[i]->NumData() < DIRPDTREE_SUBTREE_THRESH)
+      {
+        level[i]->ConstructSubtree(countThresh, diagThresh);
+      }
+      else
+      {
+        isSplit[i] = level[i]->SplitNode(countThresh, diagThresh);
+      }
+    }
+
+    std::vector<DirPDTreeNode*> nextLevel;
+    for (i = 0; i < nLevel; i++)
+    {
+      if (isSplit[i])
+      {
+        nextLevel.push_back(level[i]->pLEq);
+        nextLevel.push_back(level[i]->pMore);
+      }
+    }
+    level.swap(nextLevel);
+  }
+  treeDepth = Top->CompleteUpperSubtree(DIRPDTREE_SUBTREE_THRESH);
+
+  ConstructSortPoints.SetSize(0);
+  ConstructNorms.SetSize(0);
+  ConstructBoundPoints.SetSize(0);
+
+  BuildDatumLeaves();
+  buildQuality = TreeQuality();
+}
+
+int DirPDTreeBase::RefitBounds(const vctDynamicVector<char> *pMoved, double margin)
+{
+  int i;
+
+  // nodes of the tree in breadth-first order
+  //  (the children of a node follow it in the list)
+  std::vector<DirPDTreeNode*> nodes;
+  std::vector<int> firstChild;
+  nodes.reserve(NNodes);
+  nodes.push_back(Top);
+  for (size_t k = 0; k < nodes.size(); k++)
+  {
+    if (nodes[k]->IsTerminalNode())
+    {
+      firstChild.push_back(-1);
+    }
+    else
+    {
+      firstChild.push_back((int)nodes.size());
+      nodes.push_back(nodes[k]->pLEq);
+      nodes.push_back(nodes[k]->pMore);
+    }
+  }
+  int nNodes = (int)nodes.size();
+
+  // flag the nodes holding a moved datum, from the leaves up
+  std::vector<char> refit(nNodes, pMoved ? 0 : 1);
+  if (pMoved)
+  {
+#ifdef ENABLE_PARALLELIZATION
+#pragma omp parallel for schedule(dynamic, 64)
+#endif
+    for (i = 0; i < nNodes; i++)
+    {
+      if (firstChild[i] < 0)
+      {
+        for (int d = 0; d < nodes[i]->NData; d++)
+        {
+          if ((*pMoved)[nodes[i]->Datum(d)])
+          {
+            refit[i] = 1;
+            break;
+          }
+        }
+      }
+    }
+    for (i = nNodes - 1; i >= 0; i--)
+    {
+      if (firstChild[i] >= 0)
+      {
+        refit[i] = refit[firstChild[i]] | refit[firstChild[i] + 1];
+      }
+    }
+  }
+  int nRefit = 0;
+  for (i = 0; i < nNodes; i++)
+  {
+    nRefit += refit[i];
+  }
+  if (nRefit == 0)
+  {
+    return 0;
+  }
+
+  // precompute the datum bounding points (as for construction)
+  nConstructBoundPoints = NumDatumBoundPoints();
+  ConstructBoundPoints.SetSize(NData*nConstructBoundPoints);
+  if (nConstructBoundPoints > 0)
+  {
+#ifdef ENABLE_PARALLELIZATION
+#pragma omp parallel for
+#endif
+    for (i = 0; i < NData; i++)
+    {
+      DatumBoundPoints(i, ConstructBoundPoints.Pointer(i*nConstructBoundPoints));
+    }
+  }
+
+  // bounds are recomputed from the datums since the child bounds
+  //  are in the frames of the child nodes
+#ifdef ENABLE_PARALLELIZATION
+#pragma omp parallel for schedule(dynamic)
+#endif
+  for (i = 0; i < nNodes; i++)
+  {
+    if (refit[i])
+    {
+      DirPDTreeNode *pNode = nodes[i];
+      BoundingBox BB;
+      for (int d = 0; d < pNode->NData; d++)
+      {
+        ConstructEnlargeBounds(pNode->F, pNode->Datum(d), BB);
+      }
+      BB.EnlargeBy(margin);
+      pNode->Bounds = BB;
+    }
+  }
+  ConstructBoundPoints.SetSize(0);
+
+  return nRefit;
+}
+
+namespace {
+
+  double BoundsArea(const BoundingBox &BB)
+  {
+    vct3 d = BB.Diagonal();
+    return 2.0*(d[0] * d[1] + d[1] * d[2] + d[2] * d[0]);
+  }
+
+  double SumBoundsArea(const DirPDTreeNode *pNode)
+  {
+    double area = BoundsArea(pNode->Bounds);
+    if (!pNode->IsTerminalNode())
+    {
+      area += SumBoundsArea(pNode->pLEq) + SumBoundsArea(pNode->pMore);
+    }
+    return area;
+  }
+
+}
+
+double DirPDTreeBase::TreeQuality() const
+{
+  if (!Top) return 1.0;
+  double rootArea = BoundsArea(Top->Bounds);
+  if (rootArea <= 0.0) return 1.0;
+  return SumBoundsArea(Top) / rootArea;
+}
+
+void DirPDTreeBase::RebuildTree()
+{
+  if (Top)
+  {
+    delete Top;
+    Top = NULL;
+  }
+  ConstructTree(constructCountThresh, constructDiagThresh);
+}
+
+void DirPDTreeBase::BuildDatumLeaves()
+{
+  DatumLeaves.SetSize(NData);
+  DatumLeaves.SetAll(NULL);
+  MapDatumLeaves(Top);
+}
+
+void DirPDTreeBase::MapDatumLeaves(DirPDTreeNode *pNode)
+{
+  if (pNode->IsTerminalNode())
+  {
+    for (int i = 0; i < pNode->NData; i++)
+    {
+      DatumLeaves[pNode->Datum(i)] = pNode;
+    }
+    return;
+  }
+  MapDatumLeaves(pNode->pLEq);
+  MapDatumLeaves(pNode->pMore);
+}
+
+namespace {
+
+  // file sections
+  const unsigned int DirPDTreeFileTag_Info = PDTREE_FILE_TAG('I','N','F','O');
+  const unsigned int DirPDTreeFileTag_Nodes = PDTREE_FILE_TAG('N','O','D','E');
+  const unsigned int DirPDTreeFileTag_DataIndices = PDTREE_FILE_TAG('D','I','D','X');
+
+  struct DirPDTreeFileInfo
+  {
+    int NData;
+    int NNodes;
+    int treeDepth;
+    int reserved;
+    unsigned long long datumFingerprint;  // see DatumFingerprint()
+  };
+
+  // node record; nodes are stored in depth-first order such that
+  //  the LEq child of a node immediately follows its parent
+  struct DirPDTreeFileNode
+  {
+    double R[9];          // rotation of node frame (row-major)
+    double t[3];          // translation of node frame
+    double MinCorner[3];  // node bounds
+    double MaxCorner[3];
+    double Navg[3];       // node orientation bounds
+    double dThetaMax;
+    int More;             // index of More child (-1 for a leaf node)
+    int DataBegin;        // offset of node datums in the data index array
+    int NData;
+    int myDepth;
+  };
+
+  void SaveSubtree(const DirPDTreeNode *pNode, const int *pDataIndices,
+                   std::vector<DirPDTreeFileNode> &nodes)
+  {
+    int index = (int)nodes.size();
+    nodes.push_back(DirPDTreeFileNode());
+    DirPDTreeFileNode &rec = nodes.back();
+    memset(&rec, 0, sizeof(DirPDTreeFileNode));
+    for (int r = 0; r < 3; r++)
+    {
+      for (int c = 0; c < 3; c++)
+      {
+        rec.R[3 * r + c] = pNode->F.Rotation().Element(r, c);
+      }
+      rec.t[r] = pNode->F.Translation().Element(r);
+      rec.MinCorner[r] = pNode->Bounds.MinCorner.Element(r);
+      rec.MaxCorner[r] = pNode->Bounds.MaxCorner.Element(r);
+      rec.Navg[r] = pNode->Navg.Element(r);
+    }
+    rec.dThetaMax = pNode->dThetaMax;
+    rec.More = -1;
+    rec.DataBegin = (int)(pNode->pDataIndices - pDataIndices);
+    rec.NData = pNode->NData;
+    rec.myDepth = pNode->myDepth;
+
+    if (!pNode->IsTerminalNode())
+    {
+      SaveSubtree(pNode->pLEq, pDataIndices, nodes);
+      int more = (int)nodes.size();
+      SaveSubtree(pNode->pMore, pDataIndices, nodes);
+      nodes[index].More = more;   // (node array may have been resized)
+    }
+  }
+
+  // checks that the node records form a depth-first tree over the datums
+  //  and that the data indices are datum indices, so that the tree may be
+  //  built from them without further checks
+  bool ValidFileNodes(const DirPDTreeFileNode *nodes, int NNodes,
+                      const int *pDataIndices, int NData)
+  {
+    if (nodes[0].DataBegin != 0 || nodes[0].NData != NData)
+    {
+      return false;
+    }
+    for (int i = 0; i < NNodes; i++)
+    {
+      const DirPDTreeFileNode &rec = nodes[i];
+      if (rec.DataBegin < 0 || rec.NData <= 0 || rec.DataBegin > NData - rec.NData)
+      {
+        return false;
+      }
+      // child indices follow the parent (so that loading terminates)
+      if (rec.More >= 0 && (rec.More <= i + 1 || rec.More >= NNodes))
+      {
+        return false;
+      }
+    }
+    for (int i = 0; i < NData; i++)
+    {
+      if (pDataIndices[i] < 0 || pDataIndices[i] >= NData)
+      {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  DirPDTreeNode* LoadSubtree(const DirPDTreeFileNode *nodes, int index,
+                             DirPDTreeBase *pTree, int *pDataIndices, DirPDTreeNode *pParent)
+  {
+    const DirPDTreeFileNode &rec = nodes[index];
+    DirPDTreeNode *pNode = new DirPDTreeNode(0.0);
+    pNode->pMyTree = pTree;
+    pNode->pParent = pParent;
+    pNode->pDataIndices = pDataIndices + rec.DataBegin;
+    pNode->NData = rec.NData;
+    pNode->myDepth = rec.myDepth;
+    for (int r = 0; r < 3; r++)
+    {
+      for (int c = 0; c < 3; c++)
+      {
+        pNode->F.Rotation().Element(r, c) = rec.R[3 * r + c];
+      }
+      pNode->F.Translation().Element(r) = rec.t[r];
+      pNode->Bounds.MinCorner.Element(r) = rec.MinCorner[r];
+      pNode->Bounds.MaxCorner.Element(r) = rec.MaxCorner[r];
+      pNode->Navg.Element(r) = rec.Navg[r];
+    }
+    pNode->dThetaMax = rec.dThetaMax;
+
+    if (rec.More >= 0)
+    {
+      pNode->pLEq = LoadSubtree(nodes, index + 1, pTree, pDataIndices, pNode);
+      pNode->pMore = LoadSubtree(nodes, rec.More, pTree, pDataIndices, pNode);
+    }
+    return pNode;
+  }
+
+}
+
+int DirPDTreeBase::Save(const std::string &filePath) const
+{
+  DirPDTreeFileInfo info;
+  info.NData = NData;
+  info.NNodes = NNodes;
+  info.treeDepth = treeDepth;
+  info.reserved = 0;
+  info.datumFingerprint = DatumFingerprint();
+
+  std::vector<DirPDTreeFileNode> nodes;
+  nodes.reserve(NNodes);
+  SaveSubtree(Top, DataIndices, nodes);
+
+  PDTreeFileWriter file(PDTREE_FILE_DIRPDTREE);
+  file.AddSection(DirPDTreeFileTag_Info, &info, sizeof(DirPDTreeFileInfo));
+  file.AddSection(DirPDTreeFileTag_Nodes, &nodes[0], nodes.size()*sizeof(DirPDTreeFileNode));
+  file.AddSection(DirPDTreeFileTag_DataIndices, DataIndices, NData*sizeof(int));
+  SaveDatumData(file);
+
+  return file.Write(filePath);
+}
+
+int DirPDTreeBase::Load(const std::string &filePath)
+{
+  PDTreeFileReader file;
+  if (file.Open(filePath, PDTREE_FILE_DIRPDTREE))
+  {
+    return -1;
+  }
+
+  const DirPDTreeFileInfo *pInfo = (const DirPDTreeFileInfo*)
+    file.FindSection(DirPDTreeFileTag_Info, sizeof(DirPDTreeFileInfo), "INFO");
+  if (!pInfo) return -1;
+  if (pInfo->NData != NData || pInfo->NNodes <= 0)
+  {
+    std::cout << "ERROR: PD tree file was saved for " << pInfo->NData
+      << " datums, but this tree has " << NData << " datums: " << filePath << std::endl;
+    return -1;
+  }
+  if (pInfo->datumFingerprint != DatumFingerprint())
+  {
+    std::cout << "ERROR: PD tree file was saved for different datums: " << filePath << std::endl;
+    return -1;
+  }
+  const DirPDTreeFileNode *pNodes = (const DirPDTreeFileNode*)
+    file.FindSection(DirPDTreeFileTag_Nodes, pInfo->NNodes*sizeof(DirPDTreeFileNode), "NODE");
+  const int *pDataIndices = (const int*)
+    file.FindSection(DirPDTreeFileTag_DataIndices, NData*sizeof(int), "DIDX");
+  if (!pNodes || !pDataIndices) return -1;
+  if (!ValidFileNodes(pNodes, pInfo->NNodes, pDataIndices, NData))
+  {
+    std::cout << "ERROR: PD tree file holds an invalid tree: " << filePath << std::endl;
+    return -1;
+  }
+
+  // load the new tree and the datum data before replacing the current tree,
+  //  so that the current tree is unchanged if the load fails
+  //  (the new nodes point into DataIndices, which is overwritten below)
+  DirPDTreeNode *pLoaded = LoadSubtree(pNodes, 0, this, DataIndices, NULL);
+  if (LoadDatumData(file))
+  {
+    delete pLoaded;
+    return -1;
+  }
+
+  // replace the current tree
+  if (Top) delete Top;
+  memcpy(DataIndices, pDataIndices, NData*sizeof(int));
+  Top = pLoaded;
+  NNodes = pInfo->NNodes;
+  treeDepth = pInfo->treeDepth;
+  BuildDatumLeaves();
+  buildQuality = TreeQuality();
+
+  return 0;
+}
+
+
 // quickly find an approximate initial match by dropping straight down the
 //   tree to the node containing the sample point and picking a datum from there
 int DirPDTreeBase::FastInitializeProximalDatum(
@@ -77,18 +535,32 @@ int DirPDTreeBase::FindClosestDatum(
   int prevDatum,
   double &matchError,
   unsigned int &numNodesSearched,
-  double currentMatchError)
+  double currentMatchError,
+  unsigned int *pNumNodesVisited,
+  unsigned int *pNumDatumsTested)
 {
   unsigned int numNodesVisited = 0;
+  unsigned int numDatumsTested = 0;
   numNodesSearched = 0;
 
+  // the leaf of the previous datum is a good place to start the search
+  //  even if that datum is no longer feasible
+  DirPDTreeNode *pPrevLeaf = NULL;
+  if (bSearchFromPrevLeaf && prevDatum >= 0 && treeDepth > 0
+    && DatumLeaves.size() == (size_t)NData)
+  {
+    pPrevLeaf = DatumLeaves[prevDatum];
+  }
+
   // check if previous match was feasible
   // SDB: by specifying a good starting datum (such as previous closest datum)
   //      the search for new closest datum is more efficient because
   //      the bounds value will be a good initial guess => fewer datums are
   //      closely searched.
+  double prevMatchError = currentMatchError;
   if (prevDatum >= 0)
   { // previous match was feasible, make sure it is still feasible
+    numDatumsTested++;
     //  set error bound to a big number so that this call returns
     //  false only if the datum is infeasible rather than if the datum
     //  cannot be closer
@@ -101,6 +573,7 @@ int DirPDTreeBase::FindClosestDatum(
     else
     {
       double tmpMatchError = pAlgorithm->FindClosestPointOnDatum(v, n, closestPoint, closestPointNorm, prevDatum);
+      prevMatchError = tmpMatchError;
       // update the new current matchError
       matchError = tmpMatchError < currentMatchError ? tmpMatchError : currentMatchError;
     }
@@ -114,7 +587,12 @@ int DirPDTreeBase::FindClosestDatum(
   // check on the root => it is more efficient to explicitly search each child node of the
   // root rather than searching the root node itself.
   int datum;
-  if (treeDepth > 0)
+  if (pPrevLeaf)
+  {
+    datum = FindClosestDatumFromLeaf(v, n, closestPoint, closestPointNorm, pPrevLeaf,
+      matchError, numNodesVisited, numNodesSearched, numDatumsTested);
+  }
+  else if (treeDepth > 0)
   {
     // 1st call to pLEq updates both distance bound and closest point
     //  before 2nd call to pMore. If pMore returns (-1), then pMore had
@@ -122,23 +600,140 @@ int DirPDTreeBase::FindClosestDatum(
     //  the return value of pLEq (whether that is -1 or a closer datum index)
     int ClosestLEq = -1;
     int ClosestMore = -1;
-    ClosestLEq = Top->pLEq->FindClosestDatum(v, n, closestPoint, closestPointNorm, matchError, numNodesVisited, numNodesSearched);
-    ClosestMore = Top->pMore->FindClosestDatum(v, n, closestPoint, closestPointNorm, matchError, numNodesVisited, numNodesSearched);
+    ClosestLEq = Top->pLEq->FindClosestDatum(v, n, closestPoint, closestPointNorm, matchError, numNodesVisited, numNodesSearched, numDatumsTested);
+    ClosestMore = Top->pMore->FindClosestDatum(v, n, closestPoint, closestPointNorm, matchError, numNodesVisited, numNodesSearched, numDatumsTested);
     datum = (ClosestMore < 0) ? ClosestLEq : ClosestMore;
   }
   else
   { // if there is only one node, we must start from the root
-    datum = Top->FindClosestDatum(v, n, closestPoint, closestPointNorm, matchError, numNodesVisited, numNodesSearched);
+    datum = Top->FindClosestDatum(v, n, closestPoint, closestPointNorm, matchError, numNodesVisited, numNodesSearched, numDatumsTested);
   }
   if (datum < 0)
   {
     datum = prevDatum;  // no feasible datum found closer than previous datum
+    // (the previous datum's error may exceed the current match error given)
+    matchError = prevMatchError;
   }
 
   //std::cout << "numNodesVisited: " << numNodesVisited << "\tnumNodesSearched: " << numNodesSearched << std::endl;
+  if (pNumNodesVisited) *pNumNodesVisited = numNodesVisited;
+  if (pNumDatumsTested) *pNumDatumsTested = numDatumsTested;
   return datum;
 }
 
+// Search the leaf node of the previous match, then the sibling subtree of
+//  each node on the path from this leaf up to the root
+//  (see PDTreeBase::FindClosestDatumFromLeaf())
+//  The node tests of the oriented search algorithms do not depend on the
+//  nodes tested before them, so the nodes on the path are not tested.
+int DirPDTreeBase::FindClosestDatumFromLeaf(
+  const vct3 &v, const vct3 &n,
+  vct3 &closestPoint, vct3 &closestPointNorm,
+  DirPDTreeNode *pLeaf,
+  double &ErrorBound,
+  unsigned int &numNodesVisited,
+  unsigned int &numNodesSearched,
+  unsigned int &numDatumsTested)
+{
+  int ClosestDatum = pLeaf->FindClosestDatum(v, n, closestPoint, closestPointNorm,
+    ErrorBound, numNodesVisited, numNodesSearched, numDatumsTested);
+
+  for (DirPDTreeNode *pNode = pLeaf; pNode->pParent; pNode = pNode->pParent)
+  {
+    DirPDTreeNode *pParent = pNode->pParent;
+    DirPDTreeNode *pSibling = (pNode == pParent->pLEq) ? pParent->pMore : pParent->pLEq;
+    int datum = pSibling->FindClosestDatum(v, n, closestPoint, closestPointNorm,
+      ErrorBound, numNodesVisited, numNodesSearched, numDatumsTested);
+    if (datum >= 0)
+    {
+      ClosestDatum = datum;
+    }
+  }
+
+  return ClosestDatum;
+}
+
+void DirPDTreeBase::FindClosestDatums(
+  const vctDynamicVector<vct3> &points, const vctDynamicVector<vct3> &norms,
+  const vctDynamicVector<int> &prevDatums,
+  vctDynamicVector<int> &outDatums,
+  vctDynamicVector<vct3> &outPoints, vctDynamicVector<vct3> &outNorms,
+  vctDoubleVec &outErrors,
+  PDTreeSearchStats &stats,
+  DirPDTreeMatchCallback *pCallback,
+  const vctDynamicVector<unsigned int> *pSearchOrder)
+{
+  unsigned int nPts = points.size();
+  assert(norms.size() == nPts && prevDatums.size() == nPts);
+  assert(!pSearchOrder || pSearchOrder->size() == nPts);
+
+  // Note: outDatums may be the same vector as prevDatums, which
+  //       always has the correct size
+  if (outDatums.size() != nPts) outDatums.SetSize(nPts);
+  if (outPoints.size() != nPts) outPoints.SetSize(nPts);
+  if (outNorms.size() != nPts) outNorms.SetSize(nPts);
+  if (outErrors.size() != nPts) outErrors.SetSize(nPts);
+
+  stats.Reset();
+
+  // the samples are searched in parallel only if the callback vouches
+  //  that the state of the sample being searched is kept per thread
+  int numThreads = 1;
+#ifdef ENABLE_PARALLELIZATION
+  if (pCallback && pCallback->ParallelMatchSafe())
+  {
+    numThreads = omp_get_max_threads();
+  }
+#endif
+  if (pCallback) pCallback->ReserveSearchThreads(numThreads);
+
+  int nSearch = (int)nPts;
+#ifdef ENABLE_PARALLELIZATION
+#pragma omp parallel num_threads(numThreads)
+#endif
+  {
+    ICPTRACE_SCOPE("FindClosestDatums thread");
+
+    // statistics of this thread's searches
+    PDTreeSearchStats threadStats;
+    unsigned int nodesSearched, nodesVisited, datumsTested;
+
+    int k;
+#ifdef ENABLE_PARALLELIZATION
+#pragma omp for schedule(dynamic, DIRPDTREE_BATCH_CHUNK_SIZE)
+#endif
+    for (k = 0; k < nSearch; k++)
+    {
+      unsigned int s = pSearchOrder ? pSearchOrder->Element(k) : k;
+
+      double errorCap = std::numeric_limits<double>::max();
+      if (pCallback)
+      {
+        pCallback->SamplePreMatch(s);
+        errorCap = pCallback->SampleMatchErrorCap(s);
+      }
+
+      outDatums.Element(s) = FindClosestDatum(
+        points.Element(s), norms.Element(s),
+        outPoints.Element(s), outNorms.Element(s),
+        prevDatums.Element(s),
+        outErrors.Element(s),
+        nodesSearched, errorCap,
+        &nodesVisited, &datumsTested);
+      threadStats.Add(nodesSearched, nodesVisited, datumsTested);
+
+      if (pCallback) pCallback->SamplePostMatch(s);
+    }
+
+    // the merged statistics are node counts, so they do not depend on
+    //  the order in which the threads are merged
+#ifdef ENABLE_PARALLELIZATION
+#pragma omp critical (DirPDTreeBase_FindClosestDatums)
+#endif
+    stats.Merge(threadStats);
+  }
+}
+
 // Exhaustive linear search of all datums in the tree for validation of closest datum
 int DirPDTreeBase::ValidateClosestDatum(
   const vct3 &v, const vct3 &n,
@@ -44,6 +44,10 @@
 #include "BoundingBox.h"
 #include "DirPDTreeNode.h"
 #include "algDirPDTree.h"
+#include "PDTreeSearchContext.h"
+
+class PDTreeFileWriter;   // forward declerations
+class PDTreeFileReader;   //  ''
 
 //#define DebugDirPDTree
 
@@ -83,6 +87,25 @@ protected:
   int* DataIndices;
   DirPDTreeNode *Top;
 
+  // leaf node holding each datum
+  //  (used to resume a search from the leaf of the previous match)
+  vctDynamicVector<DirPDTreeNode*> DatumLeaves;
+  bool bSearchFromPrevLeaf;
+
+  // Tree construction data
+  //  the sort point, orientation and bounding points (e.g. triangle vertices)
+  //  of each datum are computed once prior to construction rather than at
+  //  every node; these are released once the tree is built
+  vctDynamicVector<vct3> ConstructSortPoints;
+  vctDynamicVector<vct3> ConstructNorms;
+  vctDynamicVector<vct3> ConstructBoundPoints;
+  int nConstructBoundPoints;  // bounding points per datum
+
+  // construction parameters (used by RebuildTree())
+  int    constructCountThresh;
+  double constructDiagThresh;
+  double buildQuality;        // TreeQuality() of the tree when built or loaded
+
 
   //--- Methods ---//
 
@@ -91,7 +114,11 @@ public:
   // constructors
   DirPDTreeBase(): 
       NData(0), NNodes(0), treeDepth(0), 
-      DataIndices(NULL), Top(NULL), pAlgorithm(NULL)
+      DataIndices(NULL), Top(NULL), 
+      bSearchFromPrevLeaf(true),
+      nConstructBoundPoints(0),
+      constructCountThresh(5), constructDiagThresh(5.0), buildQuality(1.0),
+      pAlgorithm(NULL)
   { 
 #ifdef DebugDirPDTree
     debugFile = fopen("../ICP_TestData/LastRun/debugDirPDTree.txt","w");
@@ -112,21 +139,66 @@ public:
 
   // Return the index for the datum in the tree that has lowest match error for
   //  the given point and set the closest point values
+  //  Only datums having lower error than currentMatchError are searched for;
+  //  if none is found, the previous datum and its error are returned.
+  //  The number of nodes visited and datums tested are returned if requested.
   int FindClosestDatum(
     const vct3 &v, const vct3 &n,
     vct3 &closestPoint, vct3 &closestPointNorm,
     int prevDatum,
     double &matchError,
     unsigned int &numNodesSearched,
-    double currentMatchError = std::numeric_limits<double>::max());
+    double currentMatchError = std::numeric_limits<double>::max(),
+    unsigned int *pNumNodesVisited = NULL,
+    unsigned int *pNumDatumsTested = NULL);
+
+  // Start each search from the leaf node holding the previous datum rather
+  //  than from the root (default: on; see PDTreeBase::SetSearchFromPreviousLeaf())
+  void SetSearchFromPreviousLeaf(bool enable) { bSearchFromPrevLeaf = enable; };
+
+  // Find the datum having lowest match error for each of a set of points
+  //  The callback (if given) is called before and after the search of each
+  //  point. The oriented search algorithms hold the state of the sample being
+  //  searched, so the points are searched in parallel only if the callback
+  //  keeps that state per thread (see DirPDTreeMatchCallback::ParallelMatchSafe());
+  //  otherwise they are searched serially.
+  //  The callback also sets the current match error of each search
+  //  (see FindClosestDatum() and DirPDTreeMatchCallback::SampleMatchErrorCap()).
+  //  prevDatums may be the same vector as outDatums.
+  //  If a search order is given, the points are searched in that order
+  //  (see PDTreeBase::FindClosestDatums()).
+  void FindClosestDatums(
+    const vctDynamicVector<vct3> &points, const vctDynamicVector<vct3> &norms,
+    const vctDynamicVector<int> &prevDatums,
+    vctDynamicVector<int> &outDatums,
+    vctDynamicVector<vct3> &outPoints, vctDynamicVector<vct3> &outNorms,
+    vctDoubleVec &outErrors,
+    PDTreeSearchStats &stats,
+    DirPDTreeMatchCallback *pCallback = NULL,
+    const vctDynamicVector<unsigned int> *pSearchOrder = NULL);
 
   // Compute the match error for a given datum
   double ComputeDatumMatchError( const vct3 &v, const vct3 &n, int datum);
 
+  // Refit the node bounds to the current datum positions, keeping the tree
+  //  structure, node frames and orientation bounds; returns the number of
+  //  nodes refit (see PDTreeBase::RefitBounds())
+  int RefitBounds(const vctDynamicVector<char> *pMoved = NULL, double margin = 0.0);
+
+  // tree quality and rebuild (see PDTreeBase::TreeQuality())
+  double TreeQuality() const;
+  double RelativeTreeQuality() const { return TreeQuality() / buildQuality; }
+  void RebuildTree();
+
   int NumData() const { return NData; };
   int NumNodes() const { return NNodes; };
   int TreeDepth() const { return treeDepth; };
 
+  // Save the constructed tree to a binary file, or load a tree previously
+  //  saved for the same datums (see PDTreeBase::Save()); returns 0 on success
+  int   Save(const std::string &filePath) const;
+  int   Load(const std::string &filePath);
+
   // debug routines
   int   ValidateClosestDatum( const vct3 &v, const vct3 &n,
                               vct3 &closestPoint, vct3 &closestPointNorm);
@@ -142,6 +214,69 @@ public:
   virtual vct3  DatumNorm(int datum) = 0;      // datum orientation (normal vector)
   virtual void  EnlargeBounds(const vctFrm3& F, int datum, BoundingBox& BB) const = 0;
 
+  // points whose bounding box in any frame equals the bounds set by
+  //  EnlargeBounds() for this datum (e.g. the triangle vertices)
+  //  (if not defined, EnlargeBounds() is used during construction)
+  virtual int   NumDatumBoundPoints() const { return 0; }
+  virtual void  DatumBoundPoints(int datum, vct3 *pts) const {}
+
+protected:
+
+  // set the leaf node of each datum (called once the tree is built)
+  void  BuildDatumLeaves();
+  void  MapDatumLeaves(DirPDTreeNode *pNode);
+
+  // search from the leaf node of the previous datum
+  int   FindClosestDatumFromLeaf(
+    const vct3 &v, const vct3 &n,
+    vct3 &closestPoint, vct3 &closestPointNorm,
+    DirPDTreeNode *pLeaf,
+    double &ErrorBound,
+    unsigned int &numNodesVisited,
+    unsigned int &numNodesSearched,
+    unsigned int &numDatumsTested);
+
+  // save / load datum-specific search data with the tree (returns 0 on success)
+  //  Load() calls LoadDatumData() before it replaces the current tree; on
+  //  failure the datum data must be left unchanged
+  virtual void  SaveDatumData(PDTreeFileWriter &file) const {}
+  virtual int   LoadDatumData(const PDTreeFileReader &file) { return 0; }
+
+  // hash of the datum geometry saved with the tree, so that a file saved
+  //  for other datums of the same count is rejected on load
+  //  (0 if the derived tree type does not define one)
+  virtual unsigned long long DatumFingerprint() const { return 0; }
+
+  // Builds the tree from the datum index array
+  //  (called by the derived class constructor once NData and DataIndices
+  //   are set; see PDTreeBase::ConstructTree())
+  void ConstructTree(int countThresh, double diagThresh);
+
+  // datum routines used during tree construction
+  const vct3& ConstructSortPoint(int datum) const
+  {
+    return ConstructSortPoints.Element(datum);
+  }
+  const vct3& ConstructDatumNorm(int datum) const
+  {
+    return ConstructNorms.Element(datum);
+  }
+  void ConstructEnlargeBounds(const vctFrm3& F, int datum, BoundingBox& BB) const
+  {
+    if (nConstructBoundPoints > 0)
+    {
+      const vct3 *pts = ConstructBoundPoints.Pointer(datum*nConstructBoundPoints);
+      for (int k = 0; k < nConstructBoundPoints; k++)
+      {
+        BB.Include(F*pts[k]);
+      }
+    }
+    else
+    {
+      EnlargeBounds(F, datum, BB);
+    }
+  }
+
 };
 
 #endif // _DirPDTreeBase_h
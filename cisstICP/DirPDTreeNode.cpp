@@ -44,6 +44,8 @@
 #include "DirPDTreeBase.h"
 #include "utilities.h"
 
+#define ENABLE_PARALLELIZATION
+
 DirPDTreeNode::DirPDTreeNode(
   int* pDataIndexArray,
   int numIndexes,
@@ -67,7 +69,7 @@ DirPDTreeNode::DirPDTreeNode(
     //  (and since we want the bounds to completely hold all of this datum)
     //  we must place the enlarge bounds function at the tree level where
     //  the datum type is known.
-    pMyTree->EnlargeBounds(F, Datum(i), Bounds);
+    pMyTree->ConstructEnlargeBounds(F, Datum(i), Bounds);
   }
   //std::stringstream ss;
   //ss << F.Rotation().Row(0) << " " << F.Rotation().Row(1) << " " 
@@ -140,7 +142,7 @@ vctFrm3 DirPDTreeNode::ComputeCovFrame(int i0, int i1)
 
 void DirPDTreeNode::AccumulateCentroid(int datum, vct3 &sum) const
 {
-  sum += pMyTree->DatumSortPoint(datum);
+  sum += pMyTree->ConstructSortPoint(datum);
 }
 
 // NOTE: providing the M argument is not important for the calling function,
@@ -148,8 +150,8 @@ void DirPDTreeNode::AccumulateCentroid(int datum, vct3 &sum) const
 //       have to be re-allocated N times
 void DirPDTreeNode::AccumulateVariances(int datum, const vct3 &mean, vctDouble3x3 &C) const
 {
-  static vctDouble3x3 M;
-  vct3 d = pMyTree->DatumSortPoint(datum) - mean;
+  vctDouble3x3 M;
+  vct3 d = pMyTree->ConstructSortPoint(datum) - mean;
   M.OuterProductOf(d, d);
   C += M;
 }
@@ -158,17 +160,15 @@ void DirPDTreeNode::AccumulateVariances(int datum, const vct3 &mean, vctDouble3x
 int DirPDTreeNode::SortNodeForSplit()
 {
   int top = NData;
-  static int callNumber = 0;
-  callNumber++;
   vct3 Ck; vct3 Ct;
   vct3 r = F.Rotation().Row(0);
   double px = F.Translation()[0];
   for (int k = 0; k < top; k++) {
-    Ck = pMyTree->DatumSortPoint(Datum(k)); // 3D coordinate of datum in global coord system
+    Ck = pMyTree->ConstructSortPoint(Datum(k)); // 3D coordinate of datum in global coord system
     double kx = r*Ck + px;  // compute the x coordinate in local coord system
     if (kx > 0) { // this one needs to go to the end of the line
       while ((--top) > k) {
-        Ct = pMyTree->DatumSortPoint(Datum(top));
+        Ct = pMyTree->ConstructSortPoint(Datum(top));
         double tx = r*Ct + px;
         if (tx <= 0) {
           int Temp = Datum(k);
@@ -200,7 +200,7 @@ vct3 DirPDTreeNode::ComputeOrientationParams()
   vct3 Nsum(0.0);
   for (int i = 0; i < NumData(); i++)
   {
-    Nsum += pMyTree->DatumNorm(Datum(i));
+    Nsum += pMyTree->ConstructDatumNorm(Datum(i));
   }
   if (Nsum.Norm() < 1e-10)
   { // prevent division by zero
@@ -218,7 +218,7 @@ vct3 DirPDTreeNode::ComputeOrientationParams()
   double Theta;
   for (int i = 0; i < NumData(); i++)
   {
-    n = pMyTree->DatumNorm(Datum(i));
+    n = pMyTree->ConstructDatumNorm(Datum(i));
     Theta = acos(n.DotProduct(Navg));
     if (Theta > dThetaMax) { dThetaMax = Theta; }
   }
@@ -232,6 +232,27 @@ vct3 DirPDTreeNode::ComputeOrientationParams()
 // returns tree depth
 int DirPDTreeNode::ConstructSubtree(int CountThresh, double DiagThresh) {
 
+  if (!SplitNode(CountThresh, DiagThresh))
+  { // leaf node
+    return myDepth;
+  }
+
+  int depthL, depthR;
+  depthL = pLEq->ConstructSubtree(CountThresh, DiagThresh);
+  depthR = pMore->ConstructSubtree(CountThresh, DiagThresh);
+
+  myDepth = (depthL > depthR ? depthL : depthR) + 1;
+  ComputeOrientationParams(); // TODO: speed up this one by using NSum from children
+  return myDepth;
+}
+
+// creates the two child nodes of this node, leaving the subtrees of the
+//  children unconstructed; returns false if this is a leaf node
+//  (in which case the leaf node is completed)
+// NOTE: the children use disjoint ranges of the data index array, so their
+//       subtrees may be constructed concurrently
+bool DirPDTreeNode::SplitNode(int CountThresh, double DiagThresh) {
+
   if (NumData() < CountThresh || Bounds.DiagonalLength() < DiagThresh)
   { // leaf node
 #ifdef DebugDirPDTree
@@ -239,7 +260,7 @@ int DirPDTreeNode::ConstructSubtree(int CountThresh, double DiagThresh) {
 #endif    
     ComputeOrientationParams();
     myDepth = 0;
-    return myDepth;
+    return false;
   }
 
   int topLEq = SortNodeForSplit();
@@ -253,7 +274,7 @@ int DirPDTreeNode::ConstructSubtree(int CountThresh, double DiagThresh) {
 #endif
     ComputeOrientationParams();
     myDepth = 0;  // stop here and do not split any further
-    return 0;
+    return false;
   }
 
 #ifdef DebugDirPDTree
@@ -262,19 +283,33 @@ int DirPDTreeNode::ConstructSubtree(int CountThresh, double DiagThresh) {
 
   assert (topLEq>0&&topLEq<NumData());
 
-  int depthL, depthR;
   pLEq = new DirPDTreeNode(pDataIndices, topLEq, pMyTree, this);
-  pMyTree->NNodes++;
-  depthL = pLEq->ConstructSubtree(CountThresh, DiagThresh);
-
   pMore = new DirPDTreeNode(&pDataIndices[topLEq], NumData() - topLEq, pMyTree, this);
-  pMyTree->NNodes++;
-  depthR = pMore->ConstructSubtree(CountThresh, DiagThresh);
+#ifdef ENABLE_PARALLELIZATION
+#pragma omp atomic
+#endif
+  pMyTree->NNodes += 2;
+
+  return true;
+}
+
+// completes the nodes above the subtrees that were constructed
+//  separately (see DirPDTreeBase::ConstructTree()); returns tree depth
+int DirPDTreeNode::CompleteUpperSubtree(int SubtreeThresh) {
+
+  if (NumData() < SubtreeThresh || IsTerminalNode())
+  { // already completed by the subtree construction
+    return myDepth;
+  }
+
+  int depthL, depthR;
+  depthL = pLEq->CompleteUpperSubtree(SubtreeThresh);
+  depthR = pMore->CompleteUpperSubtree(SubtreeThresh);
 
   myDepth = (depthL > depthR ? depthL : depthR) + 1;
-  ComputeOrientationParams(); // TODO: speed up this one by using NSum from children
+  ComputeOrientationParams();
   return myDepth;
-  }
+}
 
 // Check if a datum in this node has a lower match error than the error bound
 //  If a lower match error is found, set the new closest point, update error
@@ -285,7 +320,8 @@ int DirPDTreeNode::FindClosestDatum(
   vct3 &closestPoint, vct3 &closestPointNorm,
   double &ErrorBound,
   unsigned int &numNodesVisited,
-  unsigned int &numNodesSearched)
+  unsigned int &numNodesSearched,
+  unsigned int &numDatumsTested)
 {
   numNodesVisited++;
 
@@ -301,6 +337,7 @@ int DirPDTreeNode::FindClosestDatum(
 
   if (IsTerminalNode())
   { // a leaf node => look at each datum in the node
+    numDatumsTested += NData;
     for (int i = 0; i < NData; i++)
     {
       int datum = Datum(i);
@@ -333,8 +370,8 @@ int DirPDTreeNode::FindClosestDatum(
   //  before 2nd call to pMore. If pMore returns (-1), then pMore had
   //  nothing better than pLEq and the resulting datum should be
   //  the return value of pLEq (whether that is -1 or a closer datum index)
-  ClosestLEq = pLEq->FindClosestDatum(v, n, closestPoint, closestPointNorm, ErrorBound, numNodesVisited, numNodesSearched);
-  ClosestMore = pMore->FindClosestDatum(v, n, closestPoint, closestPointNorm, ErrorBound, numNodesVisited, numNodesSearched);
+  ClosestLEq = pLEq->FindClosestDatum(v, n, closestPoint, closestPointNorm, ErrorBound, numNodesVisited, numNodesSearched, numDatumsTested);
+  ClosestMore = pMore->FindClosestDatum(v, n, closestPoint, closestPointNorm, ErrorBound, numNodesVisited, numNodesSearched, numDatumsTested);
   ClosestDatum = (ClosestMore < 0) ? ClosestLEq : ClosestMore;
   return ClosestDatum;
 }
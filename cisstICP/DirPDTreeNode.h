@@ -107,7 +107,8 @@ public:
     vct3 &closestPoint, vct3 &closestPointNorm,
     double &ErrorBound,
     unsigned int &numNodesVisited, 
-    unsigned int &numNodesSearched);
+    unsigned int &numNodesSearched,
+    unsigned int &numDatumsTested);
 
   int   NumData() const { return NData; };
   int   IsTerminalNode() const { return pLEq == NULL; };
@@ -115,6 +116,8 @@ public:
   int     SortNodeForSplit();
   vctFrm3 ComputeCovFrame(int i0, int i1);
   int     ConstructSubtree(int CountThresh, double DiagThresh);
+  bool    SplitNode(int CountThresh, double DiagThresh);
+  int     CompleteUpperSubtree(int SubtreeThresh);
 
   void  AccumulateCentroid(int datum, vct3 &sum) const;
   void  AccumulateVariances(int datum, const vct3 &mean, vctDouble3x3 &C) const;
@@ -32,9 +32,11 @@
 //  
 // ****************************************************************************
 #include "DirPDTree_Mesh.h"
+#include "PDTreeFile.h"
 
 
 DirPDTree_Mesh::DirPDTree_Mesh( cisstMesh mesh, int countThresh, double diagThresh )
+  : pTCPS(NULL)
 { 
   this->mesh = mesh;
 
@@ -44,17 +46,39 @@ DirPDTree_Mesh::DirPDTree_Mesh( cisstMesh mesh, int countThresh, double diagThre
   { 
     DataIndices[i]=i;
   }
-  Top = new DirPDTreeNode(DataIndices,NData,this,NULL);
-  NNodes = 0; NNodes++;
-  treeDepth = Top->ConstructSubtree(countThresh,diagThresh);
+  ConstructTree(countThresh, diagThresh);
 
 #ifdef DebugDirPDTree
   fprintf(debugFile, "Directional Mesh Cov Tree built: NNodes=%d  NData=%d  TreeDepth=%d\n", NumNodes(), NumData(), TreeDepth());
 #endif
 }
 
+DirPDTree_Mesh::DirPDTree_Mesh( cisstMesh mesh, const std::string &treeFile,
+                                int countThresh, double diagThresh )
+  : pTCPS(NULL)
+{
+  this->mesh = mesh;
+
+  NData = mesh.NumTriangles();
+  DataIndices = new int[NData];
+  constructCountThresh = countThresh;   // for RebuildTree()
+  constructDiagThresh = diagThresh;
+
+  if (Load(treeFile))
+  {
+    std::cout << "WARNING: failed to load PD tree file; constructing the tree instead" << std::endl;
+    if (Top) { delete Top; Top = NULL; }
+    for (int i = 0; i < NData; i++)
+    {
+      DataIndices[i] = i;
+    }
+    ConstructTree(countThresh, diagThresh);
+  }
+}
+
 DirPDTree_Mesh::~DirPDTree_Mesh()
 {
+  if (pTCPS) delete pTCPS;
   if (Top) delete Top;
   if (DataIndices) delete DataIndices;
 }
@@ -84,6 +108,43 @@ void DirPDTree_Mesh::EnlargeBounds(const vctFrm3& F, int datum, BoundingBox& BB)
   BB.Include(F*v3);
 }
 
+void DirPDTree_Mesh::DatumBoundPoints(int datum, vct3 *pts) const
+{
+  mesh.FaceCoords(datum, pts[0], pts[1], pts[2]);
+}
+
+void DirPDTree_Mesh::SaveDatumData(PDTreeFileWriter &file) const
+{
+  if (pTCPS)
+  {
+    pTCPS->Save(file);
+  }
+  else
+  {
+    TriangleClosestPointSolver TCPS(mesh);
+    TCPS.Save(file);
+  }
+}
+
+int DirPDTree_Mesh::LoadDatumData(const PDTreeFileReader &file)
+{
+  TriangleClosestPointSolver *pLoaded = new TriangleClosestPointSolver();
+  int rv = pLoaded->Load(file, mesh);
+  if (rv != 0)
+  { // no solver data in file, or not valid for this mesh
+    delete pLoaded;
+    return rv < 0 ? -1 : 0;
+  }
+  if (pTCPS) delete pTCPS;
+  pTCPS = pLoaded;
+  return 0;
+}
+
+unsigned long long DirPDTree_Mesh::DatumFingerprint() const
+{
+  return TriangleClosestPointSolver::MeshFingerprint(mesh);
+}
+
 void DirPDTree_Mesh::EnlargeBounds(const vctFrm3& F, DirPDTreeNode *pNode) const
 {
 	if (!pNode->IsTerminalNode())
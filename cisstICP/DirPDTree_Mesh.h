@@ -37,6 +37,7 @@
 
 #include "DirPDTreeBase.h"
 #include "cisstMesh.h"
+#include "TriangleClosestPointSolver.h"
 
 
 class DirPDTree_Mesh : public DirPDTreeBase
@@ -54,6 +55,14 @@ public:
   cisstMesh mesh;
   BoundingBox Bounds;
 
+protected:
+
+  // triangle solver precomputations loaded with the tree
+  //  (NULL if the tree was not loaded from a file)
+  TriangleClosestPointSolver *pTCPS;
+
+public:
+
 
   //-- Methods --//
 
@@ -64,9 +73,19 @@ public:
   //  diagThreh - min physical size of subdivided node
 	DirPDTree_Mesh(cisstMesh mesh, int nThresh, double diagThresh);
 
+  // constructor
+  //  loads the tree from a file previously saved for this mesh; the tree
+  //  is constructed instead if the file cannot be loaded
+  //  treeFile  - PD tree file (see DirPDTreeBase::Save())
+	DirPDTree_Mesh(cisstMesh mesh, const std::string &treeFile, int nThresh, double diagThresh);
+
   // destructor
   virtual ~DirPDTree_Mesh();
 
+  // triangle solver precomputations loaded with the tree, for use
+  //  by the search algorithms (NULL if not available)
+  const TriangleClosestPointSolver* PrecomputedTCPS() const { return pTCPS; }
+
 
   //-- Base Class Method Overrides --//
 
@@ -77,25 +96,31 @@ public:
 	virtual void EnlargeBounds(const vctFrm3& F) const;
 	virtual void EnlargeBounds(const vctFrm3& F, DirPDTreeNode *pNode) const;
 	virtual void EnlargeBounds(const vctFrm3& F, int datum, BoundingBox& BB) const;
+	virtual int  NumDatumBoundPoints() const { return 3; }
+	virtual void DatumBoundPoints(int datum, vct3 *pts) const;
+
+protected:
+
+	virtual void SaveDatumData(PDTreeFileWriter &file) const;
+	virtual int  LoadDatumData(const PDTreeFileReader &file);
+	virtual unsigned long long DatumFingerprint() const;
+
+public:
 
 	//--- Noise Model Methods ---//
 
-	vct3x3& DatumCov(int datum)       // return measurement noise model for this datum
+	void DatumCov(int datum, vct3x3 &M)       // return measurement noise model for this datum
 	{
-		return mesh.TriangleCov[datum];
+		mesh.TriangleCovariance(datum, M);
 	}
-	vct3x3* DatumCovPtr(int datum)    // return measurement noise model for this datum
+	void AddDatumCov(int datum, vct3x3 &M)    // add measurement noise model for this datum
 	{
-		return &(mesh.TriangleCov[datum]);
+		mesh.AddTriangleCovariance(datum, M);
 	}
 
-	vct3& DatumCovEig(int datum)         // return measurement noise model for this datum
-	{
-		return mesh.TriangleCovEig[datum];
-	}
-	vct3* DatumCovEigPtr(int datum)      // return measurement noise model for this datum
+	vct3 DatumCovEig(int datum)         // return measurement noise model eigenvalues for this datum
 	{
-		return &(mesh.TriangleCovEig[datum]);
+		return mesh.TriangleCovarianceEig(datum);
 	}
 };
 
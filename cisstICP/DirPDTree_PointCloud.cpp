@@ -49,9 +49,7 @@ pointCloud(pointCloud)
   { 
     DataIndices[i]=i;
   }
-  Top = new DirPDTreeNode(DataIndices,NData,this,NULL);
-  NNodes = 0; NNodes++;
-  treeDepth = Top->ConstructSubtree(nThresh,diagThresh);
+  ConstructTree(nThresh, diagThresh);
 
 #ifdef DebugDirPDTree
   fprintf(debugFile, "Directional Point Cloud Cov Tree built: NNodes=%d  NData=%d  TreeDepth=%d\n", NumNodes(), NumData(), TreeDepth());
@@ -78,3 +76,8 @@ void DirPDTree_PointCloud::EnlargeBounds(const vctFrm3& F, int datum, BoundingBo
 { 
   BB.Include(F*pointCloud.points.Element(datum));
 }
+
+void DirPDTree_PointCloud::DatumBoundPoints(int datum, vct3 *pts) const
+{
+  pts[0] = pointCloud.points.Element(datum);
+}
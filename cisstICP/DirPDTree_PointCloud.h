@@ -74,6 +74,8 @@ public:
 	virtual vct3 DatumNorm(int datum);       // return normal orientation of this datum
 
 	virtual void EnlargeBounds(const vctFrm3& F, int datum, BoundingBox& BB) const;
+	virtual int  NumDatumBoundPoints() const { return 1; }
+	virtual void DatumBoundPoints(int datum, vct3 *pts) const;
 };
 
 #endif
@@ -0,0 +1,557 @@
+// ****************************************************************************
+//
+//    Copyright (c) 2014, Seth Billings, Russell Taylor, Johns Hopkins University
+//    All rights reserved.
+//
+//    Redistribution and use in source and binary forms, with or without
+//    modification, are permitted provided that the following conditions are
+//    met:
+//
+//    1. Redistributions of source code must retain the above copyright
+//    notice, this list of conditions and the following disclaimer.
+//
+//    2. Redistributions in binary form must reproduce the above copyright
+//    notice, this list of conditions and the following disclaimer in the
+//    documentation and/or other materials provided with the distribution.
+//
+//    3. Neither the name of the copyright holder nor the names of its
+//    contributors may be used to endorse or promote products derived from
+//    this software without specific prior written permission.
+//
+//    THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+//    "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+//    LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+//    A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+//    HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+//    SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+//    LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+//    DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+//    THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+//    (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+//    OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//  
+// ****************************************************************************
+
+#include "DistanceField_Mesh.h"
+
+#include <limits>
+#include <algorithm>
+#include <omp.h>
+
+#include "ICPTrace.h"
+
+#define ENABLE_PARALLELIZATION
+
+// number of points assigned to a thread at a time in a batch search
+#define DISTFIELD_BATCH_CHUNK_SIZE 16
+
+namespace {
+
+  // distance between two bounding boxes (0 if they overlap)
+  double BoxDistance(const BoundingBox &a, const BoundingBox &b)
+  {
+    double sqrDist = 0.0;
+    for (int i = 0; i < 3; i++)
+    {
+      double gap = a.MinCorner[i] - b.MaxCorner[i];
+      if (gap < b.MinCorner[i] - a.MaxCorner[i]) gap = b.MinCorner[i] - a.MaxCorner[i];
+      if (gap > 0.0) sqrDist += gap*gap;
+    }
+    return sqrt(sqrDist);
+  }
+
+  // candidate triangles are sorted by their distance from the cell center
+  typedef std::pair<double, int> Candidate;
+
+  // appends the triangles binned in the coarse cells whose index differs
+  //  from that of the given cell by rMin to rMax along some axis (and by
+  //  at most rMax along every axis); a triangle binned in several of these
+  //  cells is appended once for each
+  void AppendBinnedTriangles(
+    const vctInt3 &numCoarse, const vctInt3 &cell, int rMin, int rMax,
+    const std::vector<int> &binStart, const std::vector<int> &binTriangles,
+    std::vector<int> &triangles)
+  {
+    int lo[3], hi[3];
+    for (int a = 0; a < 3; a++)
+    {
+      lo[a] = std::max(cell[a] - rMax, 0);
+      hi[a] = std::min(cell[a] + rMax, numCoarse[a] - 1);
+    }
+    for (int k = lo[2]; k <= hi[2]; k++)
+    {
+      for (int j = lo[1]; j <= hi[1]; j++)
+      {
+        int rjk = std::max(abs(j - cell[1]), abs(k - cell[2]));
+        for (int i = lo[0]; i <= hi[0]; i++)
+        {
+          if (std::max(rjk, abs(i - cell[0])) < rMin) continue;
+          int c = i + numCoarse[0] * (j + numCoarse[1] * k);
+          for (int n = binStart[c]; n < binStart[c + 1]; n++)
+          {
+            triangles.push_back(binTriangles[n]);
+          }
+        }
+      }
+    }
+  }
+
+} // namespace anonymous
+
+
+DistanceField_Mesh::DistanceField_Mesh(
+  cisstMesh &mesh,
+  PDTree_Mesh *pTree,
+  double cellSize,
+  double bandWidth,
+  int maxFarCandidates)
+  : MeshP(&mesh), pTree(pTree), Bounds(),
+  TCPS(*(pTree->SearchTCPS())),
+  cellSize(cellSize),
+  coarseSize(cellSize*DISTFIELD_BLOCK_CELLS),
+  bandWidth(bandWidth),
+  maxFarCandidates(maxFarCandidates),
+  numFarCells(0), numBlocks(0),
+  numFallbackCells(0), avgCandidates(0.0)
+{
+  Build();
+}
+
+void DistanceField_Mesh::Build()
+{
+  ICPTRACE_SCOPE("BuildDistanceField");
+  const int B = DISTFIELD_BLOCK_CELLS;
+  const int nFine = B*B*B;
+  int nTri = MeshP->NumTriangles();
+
+  // grid bounds
+  vctDynamicVector<BoundingBox> triBounds(nTri);
+  Bounds = BoundingBox();
+  for (int t = 0; t < nTri; t++)
+  {
+    for (int vx = 0; vx < 3; vx++)
+    {
+      triBounds[t].Include(MeshP->FaceCoord(t, vx));
+    }
+    Bounds.Include(triBounds[t]);
+  }
+  Bounds.EnlargeBy(bandWidth);
+  vct3 extent = Bounds.Diagonal();
+  for (int i = 0; i < 3; i++)
+  {
+    numCoarse[i] = (int)ceil(extent[i] / coarseSize);
+    if (numCoarse[i] < 1) numCoarse[i] = 1;
+    Bounds.MaxCorner[i] = Bounds.MinCorner[i] + numCoarse[i] * coarseSize;
+  }
+  int nCoarse = numCoarse[0] * numCoarse[1] * numCoarse[2];
+  int c;
+
+  // bin the triangles into the coarse cells overlapped by their bounds
+  //  (the triangles of coarse cell c are stored at positions
+  //   [binStart[c], binStart[c+1]) of binTriangles)
+  std::vector<int> binStart(nCoarse + 1, 0);
+  std::vector<int> binTriangles;
+  std::vector<vctInt3> triCellMin(nTri), triCellMax(nTri);
+  for (int t = 0; t < nTri; t++)
+  {
+    for (int i = 0; i < 3; i++)
+    {
+      triCellMin[t][i] = std::min(std::max(
+        (int)floor((triBounds[t].MinCorner[i] - Bounds.MinCorner[i]) / coarseSize), 0), numCoarse[i] - 1);
+      triCellMax[t][i] = std::min(std::max(
+        (int)floor((triBounds[t].MaxCorner[i] - Bounds.MinCorner[i]) / coarseSize), 0), numCoarse[i] - 1);
+    }
+  }
+  for (int pass = 0; pass < 2; pass++)
+  {
+    // count the triangles of each cell, then fill the bins
+    if (pass == 1)
+    {
+      for (c = 0; c < nCoarse; c++)
+      {
+        binStart[c + 1] += binStart[c];
+      }
+      binTriangles.resize(binStart[nCoarse]);
+    }
+    std::vector<int> binFill(binStart.begin(), binStart.end() - 1);
+    for (int t = 0; t < nTri; t++)
+    {
+      for (int k = triCellMin[t][2]; k <= triCellMax[t][2]; k++)
+      {
+        for (int j = triCellMin[t][1]; j <= triCellMax[t][1]; j++)
+        {
+          for (int i = triCellMin[t][0]; i <= triCellMax[t][0]; i++)
+          {
+            int cb = i + numCoarse[0] * (j + numCoarse[1] * k);
+            if (pass == 0) binStart[cb + 1]++;
+            else binTriangles[binFill[cb]++] = t;
+          }
+        }
+      }
+    }
+  }
+
+  // candidates of the coarse cells
+  std::vector< std::vector<int> > coarseDatums(nCoarse);
+  std::vector< std::vector<double> > coarseDists(nCoarse);
+  std::vector<double> coarseLowerBound(nCoarse);
+#ifdef ENABLE_PARALLELIZATION
+#pragma omp parallel for schedule(dynamic)
+#endif
+  for (c = 0; c < nCoarse; c++)
+  {
+    int i = c % numCoarse[0];
+    int j = (c / numCoarse[0]) % numCoarse[1];
+    int k = c / (numCoarse[0] * numCoarse[1]);
+    vct3 minCorner = Bounds.MinCorner + vct3((double)i, (double)j, (double)k) * coarseSize;
+    BoundingBox cellBounds(minCorner, minCorner + coarseSize);
+    coarseLowerBound[c] = ComputeCoarseCandidates(
+      vctInt3(i, j, k), cellBounds, triBounds, binStart, binTriangles,
+      coarseDatums[c], coarseDists[c]);
+  }
+
+  // subdivide the coarse cells within the band width of the surface and
+  //  keep the short candidate lists of the remaining cells
+  coarseCells.SetSize(nCoarse);
+  std::vector<int> blockCoarse;
+  numFarCells = 0;
+  numFallbackCells = 0;
+  for (c = 0; c < nCoarse; c++)
+  {
+    if (coarseLowerBound[c] <= bandWidth)
+    {
+      coarseCells[c] = -2 - (int)blockCoarse.size();
+      blockCoarse.push_back(c);
+    }
+    else if ((int)coarseDatums[c].size() <= maxFarCandidates)
+    {
+      coarseCells[c] = numFarCells++;
+    }
+    else
+    {
+      coarseCells[c] = DISTFIELD_FALLBACK;
+      numFallbackCells++;
+    }
+  }
+  numBlocks = (int)blockCoarse.size();
+
+  // candidates of the fine cells
+  std::vector< std::vector<int> > fineDatums(numBlocks*nFine);
+  std::vector< std::vector<double> > fineDists(numBlocks*nFine);
+  int b;
+#ifdef ENABLE_PARALLELIZATION
+#pragma omp parallel for schedule(dynamic)
+#endif
+  for (b = 0; b < numBlocks; b++)
+  {
+    int cb = blockCoarse[b];
+    int i = cb % numCoarse[0];
+    int j = (cb / numCoarse[0]) % numCoarse[1];
+    int k = cb / (numCoarse[0] * numCoarse[1]);
+    vct3 minCorner = Bounds.MinCorner + vct3((double)i, (double)j, (double)k) * coarseSize;
+    vct3 coarseCenter = minCorner + 0.5*coarseSize;
+    for (int f = 0; f < nFine; f++)
+    {
+      vct3 center = minCorner + vct3(
+        f % B + 0.5, (f / B) % B + 0.5, f / (B*B) + 0.5) * cellSize;
+      ComputeFineCandidates(center, coarseCenter,
+        coarseDatums[cb], coarseDists[cb],
+        fineDatums[b*nFine + f], fineDists[b*nFine + f]);
+    }
+  }
+
+  // pack the candidate lists
+  int nCells = numFarCells + numBlocks*nFine;
+  cellStart.SetSize(nCells + 1);
+  int nCand = 0;
+  int cell = 0;
+  for (c = 0; c < nCoarse; c++)
+  {
+    if (coarseCells[c] >= 0)
+    {
+      cellStart[cell++] = nCand;
+      nCand += (int)coarseDatums[c].size();
+    }
+  }
+  for (int f = 0; f < numBlocks*nFine; f++)
+  {
+    cellStart[cell++] = nCand;
+    nCand += (int)fineDatums[f].size();
+  }
+  cellStart[nCells] = nCand;
+
+  candDatums.SetSize(nCand);
+  candDists.SetSize(nCand);
+  cell = 0;
+  for (c = 0; c < nCoarse; c++)
+  {
+    if (coarseCells[c] >= 0)
+    {
+      for (size_t n = 0; n < coarseDatums[c].size(); n++)
+      {
+        candDatums[cellStart[cell] + n] = coarseDatums[c][n];
+        candDists[cellStart[cell] + n] = coarseDists[c][n];
+      }
+      cell++;
+    }
+  }
+  for (int f = 0; f < numBlocks*nFine; f++)
+  {
+    for (size_t n = 0; n < fineDatums[f].size(); n++)
+    {
+      candDatums[cellStart[cell] + n] = fineDatums[f][n];
+      candDists[cellStart[cell] + n] = fineDists[f][n];
+    }
+    cell++;
+  }
+  avgCandidates = nCells > 0 ? (double)nCand / (double)nCells : 0.0;
+}
+
+double DistanceField_Mesh::ComputeCoarseCandidates(
+  const vctInt3 &cellIndex,
+  const BoundingBox &cellBounds,
+  const vctDynamicVector<BoundingBox> &triBounds,
+  const std::vector<int> &binStart,
+  const std::vector<int> &binTriangles,
+  std::vector<int> &datums,
+  std::vector<double> &dists)
+{
+  vct3 center = cellBounds.MidPoint();
+  double halfDiag = 0.5*cellBounds.DiagonalLength();
+  int maxRing = std::max(numCoarse[0], std::max(numCoarse[1], numCoarse[2]));
+
+  // upper bound on the distance from any point in the cell to the surface
+  //  (by the triangles of the nearest ring of coarse cells holding any)
+  std::vector<int> binned;
+  double nearDist = std::numeric_limits<double>::max();
+  for (int r = 0; r <= maxRing && binned.empty(); r++)
+  {
+    AppendBinnedTriangles(numCoarse, cellIndex, r, r, binStart, binTriangles, binned);
+    for (size_t n = 0; n < binned.size(); n++)
+    {
+      double dist = TriangleDistance(center, binned[n]);
+      if (dist < nearDist) nearDist = dist;
+    }
+  }
+  if (binned.empty())
+  { // no triangles
+    datums.clear();
+    dists.clear();
+    return std::numeric_limits<double>::max();
+  }
+  double maxDist = nearDist + halfDiag;
+
+  // any triangle closest to a point in the cell lies within this bound
+  //  of the cell, and so overlaps one of the coarse cells within
+  //  maxDist / coarseSize + 1 cells of this cell
+  int R = std::min((int)(maxDist / coarseSize) + 1, maxRing);
+  binned.clear();
+  AppendBinnedTriangles(numCoarse, cellIndex, 0, R, binStart, binTriangles, binned);
+  std::sort(binned.begin(), binned.end());
+  binned.erase(std::unique(binned.begin(), binned.end()), binned.end());
+  std::vector<Candidate> cand;
+  for (size_t n = 0; n < binned.size(); n++)
+  {
+    int t = binned[n];
+    if (BoxDistance(cellBounds, triBounds[t]) <= maxDist)
+    {
+      cand.push_back(Candidate(TriangleDistance(center, t), t));
+    }
+  }
+  std::sort(cand.begin(), cand.end());
+
+  // every point in the cell is within minDist + halfDiag of the triangle
+  //  closest to the cell center; triangles whose distance from the cell
+  //  exceeds this bound are not closest to any point in the cell
+  double minDist = cand.empty() ? 0.0 : cand[0].first;
+  double maxLowerBound = minDist + halfDiag;
+  double lowerBound = std::numeric_limits<double>::max();
+  datums.clear();
+  dists.clear();
+  for (size_t n = 0; n < cand.size(); n++)
+  {
+    if (cand[n].first - halfDiag > maxLowerBound) break;
+    double cellDist = BoxDistance(cellBounds, triBounds[cand[n].second]);
+    if (cellDist < cand[n].first - halfDiag) cellDist = cand[n].first - halfDiag;
+    if (cellDist > maxLowerBound) continue;
+    datums.push_back(cand[n].second);
+    dists.push_back(cand[n].first);
+    if (cellDist < lowerBound) lowerBound = cellDist;
+  }
+  return lowerBound;
+}
+
+void DistanceField_Mesh::ComputeFineCandidates(
+  const vct3 &center,
+  const vct3 &coarseCenter,
+  const std::vector<int> &coarseDatums,
+  const std::vector<double> &coarseDists,
+  std::vector<int> &datums,
+  std::vector<double> &dists)
+{
+  double halfDiag = 0.5*sqrt(3.0)*cellSize;
+  double offset = (center - coarseCenter).Norm();
+
+  // the coarse candidates are sorted by their distance from the coarse
+  //  cell center, which bounds their distance from this cell center
+  std::vector<Candidate> cand;
+  double minDist = std::numeric_limits<double>::max();
+  for (size_t n = 0; n < coarseDatums.size(); n++)
+  {
+    if (coarseDists[n] - offset > minDist + 2.0*halfDiag) break;
+    double dist = TriangleDistance(center, coarseDatums[n]);
+    if (dist < minDist) minDist = dist;
+    cand.push_back(Candidate(dist, coarseDatums[n]));
+  }
+  std::sort(cand.begin(), cand.end());
+
+  datums.clear();
+  dists.clear();
+  for (size_t n = 0; n < cand.size(); n++)
+  {
+    if (cand[n].first > minDist + 2.0*halfDiag) break;
+    datums.push_back(cand[n].second);
+    dists.push_back(cand[n].first);
+  }
+}
+
+int DistanceField_Mesh::FindClosestDatum(
+  const vct3 &v,
+  vct3 &closestPoint,
+  int prevDatum,
+  double &matchError,
+  PDTreeSearchContext &ctx)
+{
+  const int B = DISTFIELD_BLOCK_CELLS;
+
+  // find the coarse cell of this point
+  vct3 x = (v - Bounds.MinCorner) / coarseSize;
+  int idx[3];
+  for (int i = 0; i < 3; i++)
+  {
+    if (!(x[i] >= 0.0 && x[i] < numCoarse[i]))
+    { // outside the grid
+      return pTree->FindClosestDatum(v, closestPoint, prevDatum, matchError, ctx);
+    }
+    idx[i] = (int)x[i];
+    if (idx[i] >= numCoarse[i]) idx[i] = numCoarse[i] - 1;
+  }
+  int cc = coarseCells[idx[0] + numCoarse[0] * (idx[1] + numCoarse[1] * idx[2])];
+  if (cc == DISTFIELD_FALLBACK)
+  {
+    return pTree->FindClosestDatum(v, closestPoint, prevDatum, matchError, ctx);
+  }
+
+  int cell;
+  vct3 center;
+  if (cc >= 0)
+  { // far-field cell
+    cell = cc;
+    center = Bounds.MinCorner + vct3(idx[0] + 0.5, idx[1] + 0.5, idx[2] + 0.5) * coarseSize;
+  }
+  else
+  { // narrow-band cell
+    int fdx[3];
+    for (int i = 0; i < 3; i++)
+    {
+      fdx[i] = (int)((x[i] - idx[i]) * B);
+      if (fdx[i] >= B) fdx[i] = B - 1;
+      if (fdx[i] < 0) fdx[i] = 0;
+    }
+    cell = numFarCells + (-2 - cc)*B*B*B + fdx[0] + B * (fdx[1] + B * fdx[2]);
+    center = Bounds.MinCorner + vct3(
+      idx[0] * B + fdx[0] + 0.5,
+      idx[1] * B + fdx[1] + 0.5,
+      idx[2] * B + fdx[2] + 0.5) * cellSize;
+  }
+
+  // refine the candidates in order of their distance from the cell center,
+  //  until this bounds out the remaining candidates
+  double offset = (v - center).Norm();
+  int datum = -1;
+  double bestDist = std::numeric_limits<double>::max();
+  vct3 closest;
+  ctx.ResetStats();
+  for (int n = cellStart[cell]; n < cellStart[cell + 1]; n++)
+  {
+    if (candDists[n] - offset >= bestDist) break;
+    TCPS.FindClosestPointOnTriangle(v, candDatums[n], closest);
+    double dist = (v - closest).Norm();
+    ctx.numNodesSearched++;
+    if (dist < bestDist)
+    {
+      bestDist = dist;
+      datum = candDatums[n];
+      closestPoint = closest;
+    }
+  }
+  ctx.numNodesVisited = ctx.numNodesSearched;
+  ctx.numDatumsTested = ctx.numNodesSearched;
+  ctx.ErrorBound = bestDist;
+  matchError = bestDist;
+  return datum;
+}
+
+void DistanceField_Mesh::FindClosestDatums(
+  const vctDynamicVector<vct3> &points,
+  const vctDynamicVector<int> &prevDatums,
+  vctDynamicVector<int> &outDatums,
+  vctDynamicVector<vct3> &outPoints,
+  vctDoubleVec &outErrors,
+  PDTreeSearchStats &stats,
+  PDTreeMatchCallback *pCallback,
+  const vctDynamicVector<unsigned int> *pSearchOrder,
+  algPDTree *pSearchAlgorithm)
+{
+  int nPts = (int)points.size();
+  int nSearch = pSearchOrder ? (int)pSearchOrder->size() : nPts;
+  assert(prevDatums.size() == points.size());
+  assert(!pSearchOrder || pSearchOrder->size() <= points.size());
+
+  // Note: outDatums may be the same vector as prevDatums, which
+  //       always has the correct size
+  if (outDatums.size() != points.size()) outDatums.SetSize(nPts);
+  if (outPoints.size() != points.size()) outPoints.SetSize(nPts);
+  if (outErrors.size() != points.size()) outErrors.SetSize(nPts);
+
+  stats.Reset();
+
+#ifdef ENABLE_PARALLELIZATION
+#pragma omp parallel
+#endif
+  {
+    ICPTRACE_SCOPE("FindClosestDatums thread");
+
+    // statistics of this thread's searches
+    PDTreeSearchStats threadStats;
+
+    int k;
+#ifdef ENABLE_PARALLELIZATION
+#pragma omp for schedule(dynamic, DISTFIELD_BATCH_CHUNK_SIZE)
+#endif
+    for (k = 0; k < nSearch; k++)
+    {
+      int s = pSearchOrder ? (int)pSearchOrder->Element(k) : k;
+
+      PDTreeSearchContext ctx;
+      ctx.sampleIndex = s;
+      ctx.pAlgorithm = pSearchAlgorithm;
+
+      if (pCallback) pCallback->SamplePreMatch(s, ctx);
+
+      int datum = FindClosestDatum(
+        points.Element(s), outPoints.Element(s),
+        prevDatums.Element(s), outErrors.Element(s), ctx);
+      outDatums.Element(s) = datum;
+
+      threadStats.Add(ctx);
+
+      if (pCallback) pCallback->SamplePostMatch(s, ctx);
+    }
+
+#ifdef ENABLE_PARALLELIZATION
+#pragma omp critical (DistanceField_Mesh_FindClosestDatums)
+#endif
+    stats.Merge(threadStats);
+  }
+}
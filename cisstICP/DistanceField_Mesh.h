@@ -0,0 +1,208 @@
+// ****************************************************************************
+//
+//    Copyright (c) 2014, Seth Billings, Russell Taylor, Johns Hopkins University
+//    All rights reserved.
+//
+//    Redistribution and use in source and binary forms, with or without
+//    modification, are permitted provided that the following conditions are
+//    met:
+//
+//    1. Redistributions of source code must retain the above copyright
+//    notice, this list of conditions and the following disclaimer.
+//
+//    2. Redistributions in binary form must reproduce the above copyright
+//    notice, this list of conditions and the following disclaimer in the
+//    documentation and/or other materials provided with the distribution.
+//
+//    3. Neither the name of the copyright holder nor the names of its
+//    contributors may be used to endorse or promote products derived from
+//    this software without specific prior written permission.
+//
+//    THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+//    "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+//    LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+//    A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+//    HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+//    SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+//    LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+//    DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+//    THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+//    (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+//    OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//  
+// ****************************************************************************
+#ifndef _DistanceField_Mesh_h
+#define _DistanceField_Mesh_h
+
+#include <vector>
+#include <cisstVector.h>
+#include "cisstMesh.h"
+#include "BoundingBox.h"
+#include "PDTree_Mesh.h"
+#include "TriangleClosestPointSolver.h"
+
+// number of fine cells along each axis of a narrow-band block
+//  (each coarse cell near the surface is subdivided into a block of
+//   DISTFIELD_BLOCK_CELLS^3 fine cells)
+#define DISTFIELD_BLOCK_CELLS 8
+
+// coarse cell whose points are searched using the PD tree
+#define DISTFIELD_FALLBACK -1
+
+class DistanceField_Mesh
+{
+  //
+  // This class implements a sparse voxel grid accelerating the closest point
+  //  search on a static mesh.
+  //
+  // The grid is made of coarse cells covering the mesh bounds enlarged by the
+  //  band width. Coarse cells within the band width of the surface are
+  //  subdivided into blocks of fine cells (the narrow band); the remaining
+  //  coarse cells form the far field.
+  // Each cell stores the list of triangles that may be closest to some point
+  //  within the cell, sorted by their distance from the cell center (the
+  //  list holds a single triangle where the closest triangle is the same for
+  //  the entire cell). A query refines the triangles of its cell in order
+  //  of this distance, stopping once the distance from the cell center
+  //  minus the distance of the query from the cell center exceeds the best
+  //  match found; most queries refine only one or two triangles.
+  // Far-field cells whose list is longer than the candidate limit, and points
+  //  outside the grid, are searched using the PD tree of the mesh.
+  //
+  // The match found is the closest point on the mesh, as for the PD tree
+  //  search using the closest point algorithm (see algPDTree_CP_Mesh); if
+  //  the closest point lies on an edge shared by two triangles, either
+  //  triangle may be returned as the match datum.
+  //
+  // NOTE: the grid must be rebuilt if the mesh is modified
+  //
+
+  //--- Variables ---//
+
+public:
+
+  cisstMesh   *MeshP;
+  PDTree_Mesh *pTree;   // tree searched for points not covered by the grid
+
+  BoundingBox Bounds;   // bounds of the grid
+
+protected:
+
+  TriangleClosestPointSolver &TCPS;   // solver of the tree (see PDTree_Mesh::SearchTCPS())
+
+  double cellSize;        // edge length of a fine cell
+  double coarseSize;      // edge length of a coarse cell
+  double bandWidth;       // max distance of the narrow band from the surface
+  int    maxFarCandidates;
+
+  vctInt3 numCoarse;      // number of coarse cells along each axis
+
+  // index of each far-field coarse cell in the cell list (see below);
+  //  a coarse cell subdivided into fine block b holds -2-b, and a coarse
+  //  cell searched using the tree holds DISTFIELD_FALLBACK
+  vctDynamicVector<int> coarseCells;
+
+  // candidate lists of all cells (far-field coarse cells followed by the fine
+  //  cells of each block); the list of cell c is stored at positions
+  //  [cellStart[c], cellStart[c+1]) of the candidate arrays
+  vctDynamicVector<int>     cellStart;
+  vctDynamicVector<int>     candDatums;   // candidate triangles
+  vctDoubleVec              candDists;    // distance of the candidate from the cell center
+  int numFarCells;                        // number of far-field cells in the cell list
+  int numBlocks;                          // number of fine blocks
+
+  // statistics of the grid
+  int numFallbackCells;
+  double avgCandidates;
+
+
+  //--- Methods ---//
+
+public:
+
+  // constructor
+  //  mesh        - target shape (the mesh of the PD tree)
+  //  pTree       - PD tree of the mesh, searched for points not covered by the grid
+  //                (its triangle solver is shared, see PDTree_Mesh::SearchTCPS())
+  //  cellSize    - edge length of the narrow-band cells
+  //  bandWidth   - distance from the surface covered by narrow-band cells
+  //  maxFarCandidates - max candidate triangles of a far-field cell; points
+  //                in cells with more candidates are searched using the tree
+  DistanceField_Mesh(
+    cisstMesh &mesh,
+    PDTree_Mesh *pTree,
+    double cellSize,
+    double bandWidth,
+    int maxFarCandidates = 32);
+
+  // destructor
+  virtual ~DistanceField_Mesh() {}
+
+  // Returns the index of the triangle closest to the given point and sets the
+  //  closest point and the distance to it
+  //  (the tree is searched using the given context when the point is not
+  //   covered by the grid; the context is otherwise unused)
+  int FindClosestDatum(
+    const vct3 &v,
+    vct3 &closestPoint,
+    int prevDatum,
+    double &matchError,
+    PDTreeSearchContext &ctx);
+
+  // Finds the closest triangle for each of a set of points
+  //  (same interface as PDTreeBase::FindClosestDatums(); the statistics
+  //   count the triangles refined by the grid searches, or the nodes
+  //   searched for points searched using the tree)
+  void FindClosestDatums(
+    const vctDynamicVector<vct3> &points,
+    const vctDynamicVector<int> &prevDatums,
+    vctDynamicVector<int> &outDatums,
+    vctDynamicVector<vct3> &outPoints,
+    vctDoubleVec &outErrors,
+    PDTreeSearchStats &stats,
+    PDTreeMatchCallback *pCallback = NULL,
+    const vctDynamicVector<unsigned int> *pSearchOrder = NULL,
+    algPDTree *pSearchAlgorithm = NULL);
+
+  int NumBlocks() const { return numBlocks; }
+  int NumCells() const { return (int)cellStart.size() - 1; }
+  int NumCandidates() const { return (int)candDatums.size(); }
+  int NumFallbackCells() const { return numFallbackCells; }
+  double AvgCandidates() const { return avgCandidates; }
+
+protected:
+
+  void  Build();
+
+  // find the candidate triangles of a coarse cell
+  //  (returns the lower bound on the distance of the cell from the surface)
+  //  cellIndex   - index of the cell along each axis
+  //  binStart, binTriangles - triangles overlapping each coarse cell (see Build())
+  double ComputeCoarseCandidates(
+    const vctInt3 &cellIndex,
+    const BoundingBox &cellBounds,
+    const vctDynamicVector<BoundingBox> &triBounds,
+    const std::vector<int> &binStart,
+    const std::vector<int> &binTriangles,
+    std::vector<int> &datums,
+    std::vector<double> &dists);
+
+  // select the candidates of a fine cell from those of its coarse cell
+  void  ComputeFineCandidates(
+    const vct3 &center,
+    const vct3 &coarseCenter,
+    const std::vector<int> &coarseDatums,
+    const std::vector<double> &coarseDists,
+    std::vector<int> &datums,
+    std::vector<double> &dists);
+
+  // distance from a point to a triangle
+  double TriangleDistance(const vct3 &v, int datum)
+  {
+    vct3 closest;
+    TCPS.FindClosestPointOnTriangle(v, datum, closest);
+    return (v - closest).Norm();
+  }
+};
+
+#endif
@@ -103,18 +103,18 @@ int Ellipsoid_OBB_Intersection_Solver::Test_Ellipsoid_OBB_Intersection(
   //  Note:  face, vertex, and edge numbers for parallelpiped elements are derived
   //         directly from the affine mapped bounding box elements
   //
-  static vct3 Fv;
-  static vctFrm3 Finv;
-  static vct3x3 Ns;
-  static vct3 m;
-  static vct3 nx,ny,nz;
-  static vct3 Vx_,Vy_,Vz_;
-  static vct3 Vxpos,Vypos,Vzpos;
-  static vct3 Vxneg,Vyneg,Vzneg;
-  static vct3 m_Vxp, m_Vxn;
-  static vct3 Vyp_Vzp, Vyp_Vzn, Vyn_Vzn, Vyn_Vzp;
-  static vct3 Nx,Ny,Nz;
-  static vct3 p0,p1,p2,p3,p4,p5,p6,p7;
+  vct3 Fv;
+  vctFrm3 Finv;
+  vct3x3 Ns;
+  vct3 m;
+  vct3 nx,ny,nz;
+  vct3 Vx_,Vy_,Vz_;
+  vct3 Vxpos,Vypos,Vzpos;
+  vct3 Vxneg,Vyneg,Vzneg;
+  vct3 m_Vxp, m_Vxn;
+  vct3 Vyp_Vzp, Vyp_Vzn, Vyn_Vzn, Vyn_Vzp;
+  vct3 Nx,Ny,Nz;
+  vct3 p0,p1,p2,p3,p4,p5,p6,p7;
   //static vct3x3 Anode_sphere;
   //static vct3 Tnode_sphere;
   //static vct3 Edge0Norm, Edge1Norm;
@@ -382,15 +382,15 @@ bool Ellipsoid_OBB_Intersection_Solver::IntersectionSphereFace(
                               const vct3 &v2, const vct3 &v3,
                               double radius, double sqrRadius)
 {
-  // static variables for run-time efficiency
-  static int vsblEdges[2];
-  static int numVsblEdges, numProcessedEdges;
-  static double q_signed_mag;
-  static vct3 q;
-  static unsigned int maxEl;
-  static double sqrDist;
+  // working variables
+  int vsblEdges[2];
+  int numVsblEdges, numProcessedEdges;
+  double q_signed_mag;
+  vct3 q;
+  unsigned int maxEl;
+  double sqrDist;
   //static double radius;
-  static double n_0,n_1,n_2,nmax;
+  double n_0,n_1,n_2,nmax;
 
   // Quick escape
   //  check distance from origin to face plane
@@ -555,7 +555,7 @@ bool Ellipsoid_OBB_Intersection_Solver::IntersectionSphereFace(
   //  in the node coordinate space.
   // Note: it appears this multiplication takes longer than all the extra
   //       manipulations performed in the standard method.
-  static vct3 qnode;
+  vct3 qnode;
   qnode = Anode_sphere*q + Tnode_sphere;
   numVsblEdges = 0;
 
@@ -850,15 +850,15 @@ int Ellipsoid_OBB_Intersection_Solver::FindVisibleEdges(
                                            int *vsblEdges,
                                            bool ccwSequence )
 {
-  static int numVsblEdges;
-  static double e00,e01;  // edge vectors
-  static double e10,e11;
-  static double e20,e21;
-  static double e30,e31;
-  static double n00,n01;  // edge normals
-  static double n10,n11;
-  static double n20,n21;
-  static double n30,n31;
+  int numVsblEdges;
+  double e00,e01;  // edge vectors
+  double e10,e11;
+  double e20,e21;
+  double e30,e31;
+  double n00,n01;  // edge normals
+  double n10,n11;
+  double n20,n21;
+  double n30,n31;
 
   numVsblEdges = 0;
 
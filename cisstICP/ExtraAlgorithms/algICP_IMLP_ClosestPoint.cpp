@@ -35,6 +35,7 @@
 #include "algICP_IMLP_ClosestPoint.h"
 #include "cisstICP.h"
 #include "PDTreeNode.h"
+#include "PDTreeFlat.h"
 #include "RegisterP2P.h"
 #include "Ellipsoid_OBB_Intersection_Solver.h"
 #include "utilities.h"
@@ -124,9 +125,23 @@ double algICP_IMLP_ClosestPoint::ICP_EvaluateErrorFunction()
 int algICP_IMLP_ClosestPoint::NodeMightBeCloser(
   const vct3 &v,
   PDTreeNode *node,
-  double ErrorBound)
+  double ErrorBound,
+  PDTreeSearchContext &ctx)
 {
 
   vct3 Fv = node->F*v;  // transform point into local coordinate system of node
   return node->Bounds.Includes(Fv, sqrt(ErrorBound));
 }
+
+// same check as above, read directly from the flattened node
+int algICP_IMLP_ClosestPoint::FlatNodeMightBeCloser(
+  const vct3 &v,
+  const PDTreeFlat &tree,
+  int node,
+  double ErrorBound,
+  PDTreeSearchContext &ctx)
+{
+  const PDTreeFlat::Node &n = tree.GetNode(node);
+  vct3 Fv = n.F*v;  // transform point into local coordinate system of node
+  return n.Bounds.Includes(Fv, sqrt(ErrorBound));
+}
@@ -40,7 +40,8 @@
 double algICP_IMLP_ClosestPoint_Mesh::FindClosestPointOnDatum( 
   const vct3 &point,
   vct3 &closest,
-  int datum )
+  int datum,
+  PDTreeSearchContext &ctx)
 {
   // find closest point on triangle by Euclidean distance
   TCPS.FindClosestPointOnTriangle(point, datum, closest);
@@ -54,7 +55,8 @@ double algICP_IMLP_ClosestPoint_Mesh::FindClosestPointOnDatum(
 int algICP_IMLP_ClosestPoint_Mesh::DatumMightBeCloser( 
   const vct3 &point,
   int datum,
-  double ErrorBound)
+  double ErrorBound,
+  PDTreeSearchContext &ctx)
 { 
   return true;
 }
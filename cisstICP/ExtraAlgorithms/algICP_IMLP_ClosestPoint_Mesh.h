@@ -49,7 +49,7 @@ class algICP_IMLP_ClosestPoint_Mesh : public algICP_IMLP_ClosestPoint
 
 protected:
 
-  TriangleClosestPointSolver TCPS;
+  TriangleClosestPointSolver &TCPS;   // shared by the algorithms of the tree (see PDTree_Mesh::SearchTCPS())
   PDTree_Mesh *pTree;
   cisstMesh *pMesh;
 
@@ -69,13 +69,13 @@ public:
     : algICP_IMLP_ClosestPoint(pTree, samplePts, sampleCov, sampleMsmtCov, outlierChiSquareThreshold, sigma2Max),
     pTree(pTree),
     pMesh(pTree->MeshP),
-	TCPS(*(pTree->MeshP))
+	TCPS(*(pTree->SearchTCPS()))
   {};
 
 
   //-- PD Tree Methods --//
 
-	double  FindClosestPointOnDatum( const vct3 &v, vct3 &closest, int datum);
-	int     DatumMightBeCloser( const vct3 &v, int datum, double ErrorBound);
+	double  FindClosestPointOnDatum( const vct3 &v, vct3 &closest, int datum, PDTreeSearchContext &ctx);
+	int     DatumMightBeCloser( const vct3 &v, int datum, double ErrorBound, PDTreeSearchContext &ctx);
 };
 #endif
@@ -40,7 +40,8 @@
 double algICP_IMLP_ClosestPoint_PointCloud::FindClosestPointOnDatum(
   const vct3 &v,
   vct3 &closest,
-  int datum)
+  int datum,
+  PDTreeSearchContext &ctx)
 {
   // Return square distance to the datum point as match error
   closest = pTree->pointCloud.points.Element(datum);
@@ -52,7 +53,8 @@ double algICP_IMLP_ClosestPoint_PointCloud::FindClosestPointOnDatum(
 int algICP_IMLP_ClosestPoint_PointCloud::DatumMightBeCloser(
   const vct3 &v,
   int datum,
-  double ErrorBound)
+  double ErrorBound,
+  PDTreeSearchContext &ctx)
 {
   return true;
 }
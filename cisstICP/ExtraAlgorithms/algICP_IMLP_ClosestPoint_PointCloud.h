@@ -69,8 +69,8 @@ public:
 
   //--- PD Tree Interface Methods ---//
 
-  double  FindClosestPointOnDatum(const vct3 &v, vct3 &closest, int datum);
-  int     DatumMightBeCloser(const vct3 &v, int datum, double ErrorBound);
+  double  FindClosestPointOnDatum(const vct3 &v, vct3 &closest, int datum, PDTreeSearchContext &ctx);
+  int     DatumMightBeCloser(const vct3 &v, int datum, double ErrorBound, PDTreeSearchContext &ctx);
 
 };
 #endif
@@ -34,6 +34,7 @@
 #include "algICP_IMLP_MahalDist.h"
 #include "cisstICP.h"
 #include "PDTreeNode.h"
+#include "PDTreeFlat.h"
 #include "RegisterP2P.h"
 #include "Ellipsoid_OBB_Intersection_Solver.h"
 #include "utilities.h"
@@ -122,7 +123,8 @@ double algICP_IMLP_MahalDist::ICP_EvaluateErrorFunction()
 //  than the error bound
 int algICP_IMLP_MahalDist::NodeMightBeCloser( const vct3 &v,
                                                PDTreeNode *node,
-                                               double ErrorBound )
+                                               double ErrorBound,
+                                               PDTreeSearchContext &ctx )
 {
 #define NODE_SIMPLE_ELLIPSOID_BOUNDS
 #ifdef NODE_SIMPLE_ELLIPSOID_BOUNDS
@@ -140,12 +142,12 @@ int algICP_IMLP_MahalDist::NodeMightBeCloser( const vct3 &v,
   { // isotropic noise model for first iteration
     // M = Mx + NodeEigMax*I = 2*I = V*S*V'  =>  S = 2*I, V = I
     // Minv = N'*N = I*(1/2)*I  =>  N = sqrt(1/2)*I = 0.7071*I
-    N = I_7071;
+    ctx.N = I_7071;
     // Dmin:
     //  M = Mx + NodeEigMax*I = 2*I = V*S*V'  =>  S = 2*I, V = I
     //  Dinv[0] = sqrt(S[0]) = sqrt(2)
     //  Dmin = 1/Dinv[0] = 1/sqrt(2) = sqrt(1/2) = 0.7071
-    Dmin = 0.7071;
+    ctx.Dmin = 0.7071;
     //MinLogM = 2.0794; // log(|I+I|) = log(2*2*2) = 2.0794
   }
   else
@@ -157,7 +159,7 @@ int algICP_IMLP_MahalDist::NodeMightBeCloser( const vct3 &v,
     //   effective match covariances in the nodes rather than in the algorithm class)
     if (!node->bUseParentEigMaxBound)
     {
-      ComputeNodeMatchCov(node);
+      ComputeNodeMatchCov(node, ctx);
     }
     //// update log bound for this node if it does not share a
     ////  common log bound with its parent
@@ -185,7 +187,38 @@ int algICP_IMLP_MahalDist::NodeMightBeCloser( const vct3 &v,
   // Test intersection between the ellipsoid and the oriented bounding
   //  box of the node
   return IntersectionSolver.Test_Ellipsoid_OBB_Intersection( v, node->Bounds, node->F, 
-                                                             NodeErrorBound, N, Dmin );
+                                                             NodeErrorBound, ctx.N, ctx.Dmin );
 
 #endif // NODE_SIMPLE_ELLIPSOID_BOUNDS
 }
+
+// same check as above (NODE_SIMPLE_ELLIPSOID_BOUNDS), read directly from the
+//  flattened node
+int algICP_IMLP_MahalDist::FlatNodeMightBeCloser( const vct3 &v,
+                                                  const PDTreeFlat &tree,
+                                                  int node,
+                                                  double ErrorBound,
+                                                  PDTreeSearchContext &ctx )
+{
+  const PDTreeFlat::Node &n = tree.GetNode(node);
+  if (n.NData <= 3)
+  { return 1; }
+
+  if (bFirstIter_Matches)
+  { // isotropic noise model for first iteration
+    static const vct3x3 I_7071(vct3x3::Eye()*0.7071);
+    ctx.N = I_7071;
+    ctx.Dmin = 0.7071;
+  }
+  else
+  { // noise model defined by node
+    const PDTreeFlat::NodeNoise &noise = tree.GetNodeNoise(node);
+    if (!noise.bUseParentEigMaxBound)
+    {
+      ComputeNodeMatchCov(noise.EigMax, ctx);
+    }
+  }
+
+  return IntersectionSolver.Test_Ellipsoid_OBB_Intersection( v, n.Bounds, n.F,
+                                                             ErrorBound, ctx.N, ctx.Dmin );
+}
@@ -77,17 +77,27 @@ public:
   int  NodeMightBeCloser(
     const vct3 &v,
     PDTreeNode *node,
-    double ErrorBound);
+    double ErrorBound,
+    PDTreeSearchContext &ctx);
+
+  int  FlatNodeMightBeCloser(
+    const vct3 &v,
+    const PDTreeFlat &tree,
+    int node,
+    double ErrorBound,
+    PDTreeSearchContext &ctx);
 
   virtual double FindClosestPointOnDatum(
     const vct3 &v,
     vct3 &closest,
-    int datum) = 0;
+    int datum,
+    PDTreeSearchContext &ctx) = 0;
 
   virtual int  DatumMightBeCloser(
     const vct3 &v,
     int datum,
-    double ErrorBound) = 0;
+    double ErrorBound,
+    PDTreeSearchContext &ctx) = 0;
 
 };
 #endif
@@ -40,7 +40,8 @@
 double algICP_IMLP_MahalDist_Mesh::FindClosestPointOnDatum(
   const vct3 &point,
   vct3 &closest,
-  int datum )
+  int datum,
+  PDTreeSearchContext &ctx)
 {
   // first iteration variables that don't change
   static const vct3x3 I_7071(vct3x3::Eye()*0.7071); // sqrt(1/2)*I
@@ -48,8 +49,8 @@ double algICP_IMLP_MahalDist_Mesh::FindClosestPointOnDatum(
   static const vct3x3 I2(vct3x3::Eye()*2.0); // 2*I
   static const vct3x3 I_5(vct3x3::Eye()*0.5); // 0.5*I
 
-  static vct3 d;
-  static vct3x3 M,Minv,N,Ninv;
+  vct3 d;
+  vct3x3 M,Minv,N,Ninv;
   double det_M;
   
   if (bFirstIter_Matches)
@@ -67,7 +68,8 @@ double algICP_IMLP_MahalDist_Mesh::FindClosestPointOnDatum(
 
     // compute noise model for this datum
     //  M = R*Mxi*R' + Myi
-    M = sample_RMxRt_sigma2 + pMesh->TriangleCov[datum];
+    M = ctx.sampleXfm_M;
+    pMesh->AddTriangleCovariance(datum, M);
     ComputeCovDecomposition_NonIter(M,Minv,N,Ninv,det_M);
   }
 
@@ -92,7 +94,8 @@ double algICP_IMLP_MahalDist_Mesh::FindClosestPointOnDatum(
 int algICP_IMLP_MahalDist_Mesh::DatumMightBeCloser( 
   const vct3 &point,
   int datum,
-  double ErrorBound)
+  double ErrorBound,
+  PDTreeSearchContext &ctx)
 { 
   return true;
 }
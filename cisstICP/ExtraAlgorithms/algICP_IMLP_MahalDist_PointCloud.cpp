@@ -40,14 +40,15 @@
 double algICP_IMLP_MahalDist_PointCloud::FindClosestPointOnDatum(
   const vct3 &v,
   vct3 &closest,
-  int datum)
+  int datum,
+  PDTreeSearchContext &ctx)
 {
   // first iteration variables that don't change
   static const vct3x3 I_5(vct3x3::Eye()*0.5); // 0.5*I
 
   // Datum is only a single point
-  static vct3 d;
-  static vct3x3 M, Minv;
+  vct3 d;
+  vct3x3 M, Minv;
   double det_M;
 
   if (bFirstIter_Matches)
@@ -63,7 +64,8 @@ double algICP_IMLP_MahalDist_PointCloud::FindClosestPointOnDatum(
 
     // compute noise model for this datum
     //  M = R*Mxi*R' + Myi
-    M = sample_RMxRt_sigma2 + pTree->DatumCov(datum);
+    M = ctx.sampleXfm_M;
+    pTree->AddDatumCov(datum, M);
     ComputeCovDecomposition_NonIter(M, Minv, det_M);
   }
 
@@ -81,7 +83,8 @@ double algICP_IMLP_MahalDist_PointCloud::FindClosestPointOnDatum(
 int algICP_IMLP_MahalDist_PointCloud::DatumMightBeCloser(
   const vct3 &v,
   int datum,
-  double ErrorBound)
+  double ErrorBound,
+  PDTreeSearchContext &ctx)
 {
   return true;
 }
@@ -0,0 +1,250 @@
+// ****************************************************************************
+//
+//    Copyright (c) 2014, Seth Billings, Russell Taylor, Johns Hopkins University
+//    All rights reserved.
+//
+//    Redistribution and use in source and binary forms, with or without
+//    modification, are permitted provided that the following conditions are
+//    met:
+//
+//    1. Redistributions of source code must retain the above copyright
+//    notice, this list of conditions and the following disclaimer.
+//
+//    2. Redistributions in binary form must reproduce the above copyright
+//    notice, this list of conditions and the following disclaimer in the
+//    documentation and/or other materials provided with the distribution.
+//
+//    3. Neither the name of the copyright holder nor the names of its
+//    contributors may be used to endorse or promote products derived from
+//    this software without specific prior written permission.
+//
+//    THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+//    "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+//    LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+//    A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+//    HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+//    SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+//    LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+//    DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+//    THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+//    (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+//    OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//  
+// ****************************************************************************
+
+#include <fstream>
+#include <iostream>
+#include <iomanip>
+
+#include "ICPProfile.h"
+
+namespace
+{
+  // writes a string as a JSON string literal
+  void WriteJSONString(std::ostream &os, const std::string &str)
+  {
+    os << '"';
+    for (size_t i = 0; i < str.size(); i++)
+    {
+      char c = str[i];
+      switch (c)
+      {
+      case '"':   os << "\\\""; break;
+      case '\\':  os << "\\\\"; break;
+      case '\n':  os << "\\n"; break;
+      case '\r':  os << "\\r"; break;
+      case '\t':  os << "\\t"; break;
+      default:
+        if ((unsigned char)c < 0x20)
+        {
+          os << "\\u" << std::hex << std::setw(4) << std::setfill('0') << (int)c
+            << std::dec << std::setfill(' ');
+        }
+        else
+        {
+          os << c;
+        }
+      }
+    }
+    os << '"';
+  }
+
+  void WriteJSONIteration(std::ostream &os, const ICPProfile::Iteration &it)
+  {
+    os << "{\"iter\":" << it.iter
+      << ",\"time_Match\":" << it.time_Match
+      << ",\"time_UpdateParams_PostMatch\":" << it.time_UpdateParams_PostMatch
+      << ",\"time_FilterMatches\":" << it.time_FilterMatches
+      << ",\"time_EvalErrorFunc\":" << it.time_EvalErrorFunc
+      << ",\"time_Register\":" << it.time_Register
+      << ",\"time_UpdateParams_PostRegister\":" << it.time_UpdateParams_PostRegister
+      << ",\"time_Callbacks\":" << it.time_Callbacks
+      << ",\"time_Terminate\":" << it.time_Terminate
+      << ",\"time_Total\":" << it.TotalTime()
+      << ",\"numSearches\":" << it.numSearches
+      << ",\"numNodesVisited\":" << it.numNodesVisited
+      << ",\"numNodesSearched\":" << it.numNodesSearched
+      << ",\"numDatumsTested\":" << it.numDatumsTested
+      << ",\"minNodesSearched\":" << it.minNodesSearched
+      << ",\"maxNodesSearched\":" << it.maxNodesSearched
+      << "}";
+  }
+}
+
+
+ICPProfile::Iteration::Iteration(unsigned int iter)
+  : iter(iter),
+  time_Match(0.0),
+  time_UpdateParams_PostMatch(0.0),
+  time_FilterMatches(0.0),
+  time_EvalErrorFunc(0.0),
+  time_Register(0.0),
+  time_UpdateParams_PostRegister(0.0),
+  time_Callbacks(0.0),
+  time_Terminate(0.0),
+  numSearches(0),
+  numNodesVisited(0),
+  numNodesSearched(0),
+  numDatumsTested(0),
+  minNodesSearched(0),
+  maxNodesSearched(0)
+{}
+
+void ICPProfile::Iteration::SetSearchStats(const PDTreeSearchStats &stats)
+{
+  numSearches = stats.numSearches;
+  numNodesVisited = (unsigned long long)stats.sumNodesVisited;
+  numNodesSearched = (unsigned long long)stats.sumNodesSearched;
+  numDatumsTested = (unsigned long long)stats.sumDatumsTested;
+  minNodesSearched = stats.minNodesSearched;
+  maxNodesSearched = stats.maxNodesSearched;
+}
+
+double ICPProfile::Iteration::TotalTime() const
+{
+  return time_Match + time_UpdateParams_PostMatch + time_FilterMatches
+    + time_EvalErrorFunc + time_Register + time_UpdateParams_PostRegister
+    + time_Callbacks + time_Terminate;
+}
+
+
+ICPProfile::ICPProfile()
+{
+  Reset();
+}
+
+void ICPProfile::Reset()
+{
+  tag = "";
+  time_Initialize = 0.0;
+  iterations.clear();
+}
+
+ICPProfile::Iteration ICPProfile::Totals() const
+{
+  Iteration sum((unsigned int)iterations.size());
+  for (size_t i = 0; i < iterations.size(); i++)
+  {
+    const Iteration &it = iterations[i];
+    sum.time_Match += it.time_Match;
+    sum.time_UpdateParams_PostMatch += it.time_UpdateParams_PostMatch;
+    sum.time_FilterMatches += it.time_FilterMatches;
+    sum.time_EvalErrorFunc += it.time_EvalErrorFunc;
+    sum.time_Register += it.time_Register;
+    sum.time_UpdateParams_PostRegister += it.time_UpdateParams_PostRegister;
+    sum.time_Callbacks += it.time_Callbacks;
+    sum.time_Terminate += it.time_Terminate;
+    if (it.numSearches == 0)
+      continue;
+    if (sum.numSearches == 0 || it.minNodesSearched < sum.minNodesSearched)
+      sum.minNodesSearched = it.minNodesSearched;
+    if (sum.numSearches == 0 || it.maxNodesSearched > sum.maxNodesSearched)
+      sum.maxNodesSearched = it.maxNodesSearched;
+    sum.numSearches += it.numSearches;
+    sum.numNodesVisited += it.numNodesVisited;
+    sum.numNodesSearched += it.numNodesSearched;
+    sum.numDatumsTested += it.numDatumsTested;
+  }
+  return sum;
+}
+
+void ICPProfile::WriteJSON(std::ostream &os) const
+{
+  std::streamsize prec = os.precision(9);
+  os << "{\"tag\":";
+  WriteJSONString(os, tag);
+  os << ",\"time_Initialize\":" << time_Initialize;
+  os << ",\"totals\":";
+  WriteJSONIteration(os, Totals());
+  os << ",\"iterations\":[";
+  for (size_t i = 0; i < iterations.size(); i++)
+  {
+    if (i > 0) os << ",";
+    os << std::endl << " ";
+    WriteJSONIteration(os, iterations[i]);
+  }
+  os << "]}" << std::endl;
+  os.precision(prec);
+}
+
+void ICPProfile::WriteCSV(std::ostream &os, bool bHeader) const
+{
+  if (bHeader)
+  {
+    os << "tag,iter,"
+      << "time_Match,time_UpdateParams_PostMatch,time_FilterMatches,"
+      << "time_EvalErrorFunc,time_Register,time_UpdateParams_PostRegister,"
+      << "time_Callbacks,time_Terminate,time_Total,"
+      << "numSearches,numNodesVisited,numNodesSearched,numDatumsTested,"
+      << "minNodesSearched,maxNodesSearched" << std::endl;
+  }
+
+  // the tag is quoted, so that it may hold commas
+  std::string csvTag = "\"";
+  for (size_t i = 0; i < tag.size(); i++)
+  {
+    if (tag[i] == '"') csvTag += '"';
+    csvTag += tag[i];
+  }
+  csvTag += '"';
+
+  std::streamsize prec = os.precision(9);
+  for (size_t i = 0; i < iterations.size(); i++)
+  {
+    const Iteration &it = iterations[i];
+    os << csvTag << "," << it.iter << ","
+      << it.time_Match << "," << it.time_UpdateParams_PostMatch << ","
+      << it.time_FilterMatches << "," << it.time_EvalErrorFunc << ","
+      << it.time_Register << "," << it.time_UpdateParams_PostRegister << ","
+      << it.time_Callbacks << "," << it.time_Terminate << ","
+      << it.TotalTime() << ","
+      << it.numSearches << "," << it.numNodesVisited << ","
+      << it.numNodesSearched << "," << it.numDatumsTested << ","
+      << it.minNodesSearched << "," << it.maxNodesSearched << std::endl;
+  }
+  os.precision(prec);
+}
+
+int ICPProfile::SaveJSON(const std::string &filePath) const
+{
+  std::ofstream fs(filePath.c_str());
+  if (!fs.is_open())
+  {
+    std::cout << "ERROR: failed to open file for writing: " << filePath << std::endl;
+    return -1;
+  }
+  WriteJSON(fs);
+  return fs.good() ? 0 : -1;
+}
+
+int ICPProfile::SaveCSV(const std::string &filePath) const
+{
+  std::ofstream fs(filePath.c_str());
+  if (!fs.is_open())
+  {
+    std::cout << "ERROR: failed to open file for writing: " << filePath << std::endl;
+    return -1;
+  }
+  WriteCSV(fs);
+  return fs.good() ? 0 : -1;
+}
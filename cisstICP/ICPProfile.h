@@ -0,0 +1,120 @@
+// ****************************************************************************
+//
+//    Copyright (c) 2014, Seth Billings, Russell Taylor, Johns Hopkins University
+//    All rights reserved.
+//
+//    Redistribution and use in source and binary forms, with or without
+//    modification, are permitted provided that the following conditions are
+//    met:
+//
+//    1. Redistributions of source code must retain the above copyright
+//    notice, this list of conditions and the following disclaimer.
+//
+//    2. Redistributions in binary form must reproduce the above copyright
+//    notice, this list of conditions and the following disclaimer in the
+//    documentation and/or other materials provided with the distribution.
+//
+//    3. Neither the name of the copyright holder nor the names of its
+//    contributors may be used to endorse or promote products derived from
+//    this software without specific prior written permission.
+//
+//    THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+//    "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+//    LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+//    A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+//    HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+//    SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+//    LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+//    DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+//    THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+//    (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+//    OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//  
+// ****************************************************************************
+#ifndef _ICPProfile_h
+#define _ICPProfile_h
+
+#include <string>
+#include <vector>
+#include <ostream>
+
+#include "PDTreeSearchContext.h"
+
+class ICPProfile
+{
+  //
+  // Run-time profile of an ICP registration (see cisstICP::Options::profile)
+  //  Holds the time spent in each phase of each iteration, together with
+  //  the tree search counts of the iteration's match phase, and writes
+  //  them as JSON or CSV for comparison across algorithms and targets.
+  //
+
+  //--- Types ---//
+
+public:
+
+  struct Iteration
+  {
+    unsigned int iter;
+
+    // phase times (sec)
+    //  (the first iteration also includes the initial error evaluation
+    //   and callbacks)
+    double time_Match;
+    double time_UpdateParams_PostMatch;
+    double time_FilterMatches;
+    double time_EvalErrorFunc;
+    double time_Register;
+    double time_UpdateParams_PostRegister;
+    double time_Callbacks;
+    double time_Terminate;
+
+    // search counts of the match phase
+    unsigned int numSearches;
+    unsigned long long numNodesVisited;
+    unsigned long long numNodesSearched;
+    unsigned long long numDatumsTested;
+    unsigned int minNodesSearched;
+    unsigned int maxNodesSearched;
+
+    Iteration(unsigned int iter = 0);
+
+    // set the search counts from the statistics of the match phase
+    void SetSearchStats(const PDTreeSearchStats &stats);
+
+    double TotalTime() const;
+  };
+
+
+  //--- Variables ---//
+
+public:
+
+  std::string tag;          // user label of the run (see cisstICP::Options::profileTag)
+  double time_Initialize;   // time to initialize the algorithm parameters
+  std::vector<Iteration> iterations;
+
+
+  //--- Methods ---//
+
+public:
+
+  ICPProfile();
+
+  void Reset();
+
+  // sum of all iterations (min / max taken over the iterations)
+  Iteration Totals() const;
+
+  // JSON object holding the totals and the per-iteration records
+  void WriteJSON(std::ostream &os) const;
+
+  // one row per iteration, preceded by a header row
+  void WriteCSV(std::ostream &os, bool bHeader = true) const;
+
+  // save to file (returns 0 on success)
+  int SaveJSON(const std::string &filePath) const;
+  int SaveCSV(const std::string &filePath) const;
+};
+
+#endif
@@ -0,0 +1,205 @@
+// ****************************************************************************
+//
+//    Copyright (c) 2014, Seth Billings, Russell Taylor, Johns Hopkins University
+//    All rights reserved.
+//
+//    Redistribution and use in source and binary forms, with or without
+//    modification, are permitted provided that the following conditions are
+//    met:
+//
+//    1. Redistributions of source code must retain the above copyright
+//    notice, this list of conditions and the following disclaimer.
+//
+//    2. Redistributions in binary form must reproduce the above copyright
+//    notice, this list of conditions and the following disclaimer in the
+//    documentation and/or other materials provided with the distribution.
+//
+//    3. Neither the name of the copyright holder nor the names of its
+//    contributors may be used to endorse or promote products derived from
+//    this software without specific prior written permission.
+//
+//    THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+//    "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+//    LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+//    A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+//    HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+//    SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+//    LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+//    DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+//    THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+//    (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+//    OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//  
+// ****************************************************************************
+
+#include <chrono>
+#include <mutex>
+#include <fstream>
+#include <iostream>
+#include <iomanip>
+
+#include "ICPTrace.h"
+
+// thread local storage
+//  (thread_local is not supported prior to Visual Studio 2015)
+#if defined(_MSC_VER) && _MSC_VER < 1900
+#define ICPTRACE_THREAD_LOCAL __declspec(thread)
+#else
+#define ICPTRACE_THREAD_LOCAL thread_local
+#endif
+
+namespace
+{
+  struct TraceEvent
+  {
+    const char *name;
+    const char *argName;
+    long long argValue;
+    double beginTime;
+    double endTime;
+  };
+
+  struct TraceBuffer
+  {
+    TraceEvent events[ICPTRACE_BUFFER_EVENTS];
+    std::atomic<unsigned long long> numRecorded;  // written only by the owning thread
+    unsigned long long numWritten;                // accessed only by ICPTrace::Write()
+    int tid;
+    TraceBuffer *pNext;
+  };
+
+  // buffers of all threads that have recorded an event
+  //  (a buffer is kept once created, so that the events of a thread
+  //   remain available after the thread exits)
+  std::atomic<TraceBuffer*> traceBuffers(NULL);
+  std::atomic<int> numTraceThreads(0);
+  ICPTRACE_THREAD_LOCAL TraceBuffer *pThreadBuffer = NULL;
+
+  std::mutex traceWriteMutex;
+
+  const std::chrono::steady_clock::time_point traceEpoch = std::chrono::steady_clock::now();
+
+  TraceBuffer *ThreadBuffer()
+  {
+    if (!pThreadBuffer)
+    {
+      TraceBuffer *pBuf = new TraceBuffer;
+      pBuf->numRecorded.store(0, std::memory_order_relaxed);
+      pBuf->numWritten = 0;
+      pBuf->tid = numTraceThreads.fetch_add(1) + 1;
+
+      // add to the buffer list
+      pBuf->pNext = traceBuffers.load(std::memory_order_relaxed);
+      while (!traceBuffers.compare_exchange_weak(pBuf->pNext, pBuf,
+        std::memory_order_release, std::memory_order_relaxed));
+      pThreadBuffer = pBuf;
+    }
+    return pThreadBuffer;
+  }
+
+  void WriteJSONName(std::ostream &os, const char *name)
+  {
+    os << '"';
+    for (const char *c = name; *c; c++)
+    {
+      if (*c == '"' || *c == '\\') os << '\\';
+      os << *c;
+    }
+    os << '"';
+  }
+}
+
+std::atomic<int> ICPTrace::enableCount(0);
+
+void ICPTrace::Enable()
+{
+  enableCount.fetch_add(1);
+}
+
+void ICPTrace::Disable()
+{
+  enableCount.fetch_sub(1);
+}
+
+double ICPTrace::Now()
+{
+  return std::chrono::duration<double, std::micro>(
+    std::chrono::steady_clock::now() - traceEpoch).count();
+}
+
+void ICPTrace::Record(const char *name, double beginTime, double endTime,
+  const char *argName, long long argValue)
+{
+  TraceBuffer *pBuf = ThreadBuffer();
+  unsigned long long n = pBuf->numRecorded.load(std::memory_order_relaxed);
+  TraceEvent &e = pBuf->events[n % ICPTRACE_BUFFER_EVENTS];
+  e.name = name;
+  e.argName = argName;
+  e.argValue = argValue;
+  e.beginTime = beginTime;
+  e.endTime = endTime;
+  pBuf->numRecorded.store(n + 1, std::memory_order_release);
+}
+
+int ICPTrace::Write(const std::string &filePath)
+{
+  std::lock_guard<std::mutex> lock(traceWriteMutex);
+
+  std::ofstream fs(filePath.c_str());
+  if (!fs.is_open())
+  {
+    std::cout << "ERROR: failed to open file for writing: " << filePath << std::endl;
+    return -1;
+  }
+  fs << std::fixed << std::setprecision(3);
+
+  unsigned long long numDropped = 0;
+  bool bFirst = true;
+  fs << "{\"traceEvents\":[";
+  for (TraceBuffer *pBuf = traceBuffers.load(std::memory_order_acquire); pBuf; pBuf = pBuf->pNext)
+  {
+    unsigned long long n = pBuf->numRecorded.load(std::memory_order_acquire);
+    if (n == pBuf->numWritten)
+      continue;
+
+    // events overwritten since the last write are lost
+    unsigned long long first = pBuf->numWritten;
+    if (n - first > ICPTRACE_BUFFER_EVENTS)
+    {
+      numDropped += n - ICPTRACE_BUFFER_EVENTS - first;
+      first = n - ICPTRACE_BUFFER_EVENTS;
+    }
+
+    fs << (bFirst ? "" : ",") << std::endl
+      << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << pBuf->tid
+      << ",\"args\":{\"name\":\"thread " << pBuf->tid << "\"}}";
+    bFirst = false;
+
+    for (unsigned long long i = first; i < n; i++)
+    {
+      const TraceEvent &e = pBuf->events[i % ICPTRACE_BUFFER_EVENTS];
+      fs << "," << std::endl << "{\"name\":";
+      WriteJSONName(fs, e.name);
+      fs << ",\"ph\":\"X\",\"pid\":1,\"tid\":" << pBuf->tid
+        << ",\"ts\":" << e.beginTime << ",\"dur\":" << e.endTime - e.beginTime;
+      if (e.argName)
+      {
+        fs << ",\"args\":{";
+        WriteJSONName(fs, e.argName);
+        fs << ":" << e.argValue << "}";
+      }
+      fs << "}";
+    }
+    pBuf->numWritten = n;
+  }
+  fs << "]," << std::endl
+    << "\"displayTimeUnit\":\"ms\","
+    << "\"otherData\":{\"droppedEvents\":" << numDropped << "}}" << std::endl;
+
+  if (numDropped > 0)
+  {
+    std::cout << "WARNING: " << numDropped << " trace events were overwritten prior to writing "
+      << filePath << std::endl;
+  }
+  return fs.good() ? 0 : -1;
+}
@@ -0,0 +1,134 @@
+// ****************************************************************************
+//
+//    Copyright (c) 2014, Seth Billings, Russell Taylor, Johns Hopkins University
+//    All rights reserved.
+//
+//    Redistribution and use in source and binary forms, with or without
+//    modification, are permitted provided that the following conditions are
+//    met:
+//
+//    1. Redistributions of source code must retain the above copyright
+//    notice, this list of conditions and the following disclaimer.
+//
+//    2. Redistributions in binary form must reproduce the above copyright
+//    notice, this list of conditions and the following disclaimer in the
+//    documentation and/or other materials provided with the distribution.
+//
+//    3. Neither the name of the copyright holder nor the names of its
+//    contributors may be used to endorse or promote products derived from
+//    this software without specific prior written permission.
+//
+//    THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+//    "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+//    LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+//    A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+//    HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+//    SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+//    LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+//    DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+//    THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+//    (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+//    OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//  
+// ****************************************************************************
+#ifndef _ICPTrace_h
+#define _ICPTrace_h
+
+#include <string>
+#include <atomic>
+
+// Timeline tracing
+//
+//  Records the begin and end times of scoped code regions of every thread
+//  and writes them as a Chrome Trace Event file (open with chrome://tracing
+//  or ui.perfetto.dev), which shows the load balance of the threads of a
+//  batch search and the time spent in the optimizer calls.
+//
+//  Recording is off until enabled, either by the application (which also
+//  captures the tree construction) or by a registration run given a trace
+//  file (see cisstICP::Options::traceFile). A trace point that is not
+//  recording costs a single relaxed atomic load, so the trace points
+//  remain compiled in.
+//
+//  Each thread records into its own ring buffer without locking; once the
+//  buffer is full the oldest events are overwritten. The buffers are read
+//  by Write(), which must be called while no traced code is running
+//  (as at the end of cisstICP::RunICP()).
+//
+//  Usage: ICPTRACE_SCOPE("name") or ICPTRACE_SCOPE("name", "argName", value)
+//         records the enclosing scope; names must be string literals
+//         (only the pointer is stored)
+//
+
+// events held by each thread's ring buffer
+#define ICPTRACE_BUFFER_EVENTS 65536
+
+class ICPTrace
+{
+public:
+
+  // enable / disable recording
+  //  (the calls nest: recording is on while there are more calls to
+  //   Enable() than to Disable())
+  static void Enable();
+  static void Disable();
+  static bool IsEnabled()
+  {
+    return enableCount.load(std::memory_order_relaxed) > 0;
+  }
+
+  // time since program start (microseconds)
+  static double Now();
+
+  // record a completed region of the calling thread
+  static void Record(const char *name, double beginTime, double endTime,
+    const char *argName = NULL, long long argValue = 0);
+
+  // write the events recorded since the previous write (returns 0 on success)
+  static int Write(const std::string &filePath);
+
+private:
+
+  static std::atomic<int> enableCount;
+};
+
+
+class ICPTraceScope
+{
+  //
+  // Records the lifetime of this object as a trace event
+  //  (see ICPTRACE_SCOPE)
+  //
+
+public:
+
+  ICPTraceScope(const char *name, const char *argName = NULL, long long argValue = 0)
+    : name(ICPTrace::IsEnabled() ? name : NULL),
+    argName(argName),
+    argValue(argValue),
+    beginTime(0.0)
+  {
+    if (this->name) beginTime = ICPTrace::Now();
+  }
+
+  ~ICPTraceScope()
+  {
+    if (name) ICPTrace::Record(name, beginTime, ICPTrace::Now(), argName, argValue);
+  }
+
+private:
+
+  const char *name;   // NULL if not recording
+  const char *argName;
+  long long argValue;
+  double beginTime;
+};
+
+#define ICPTRACE_CONCAT_(a, b) a##b
+#define ICPTRACE_CONCAT(a, b) ICPTRACE_CONCAT_(a, b)
+
+// record the enclosing scope
+#define ICPTRACE_SCOPE(...) \
+  ICPTraceScope ICPTRACE_CONCAT(icpTraceScope_, __LINE__)(__VA_ARGS__)
+
+#endif
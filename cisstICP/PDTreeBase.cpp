@@ -36,6 +36,9 @@
 
 #include <stdio.h>
 #include <limits>
+#include <vector>
+#include <algorithm>
+#include <string.h>
 
 #include <cisstVector.h>
 #include <cisstCommon.h>
@@ -43,11 +46,664 @@
 
 #include "algPDTree.h"
 //#include "PDTreeNode.h"
+#include "PDTreeFlat.h"
+#include "PDTreeFile.h"
 
 // needed for debug routines
 #include "PDTree_Mesh.h"
 #include "PDTree_PointCloud.h"
 #include "TriangleClosestPointSolver.h"
+#include "ICPTrace.h"
+
+#define ENABLE_PARALLELIZATION
+
+// nodes having fewer datums than this have their subtree constructed
+//  as a single task
+#define PDTREE_SUBTREE_THRESH 4096
+
+// number of points assigned to a thread at a time in a batch search
+#define PDTREE_BATCH_CHUNK_SIZE 16
+
+
+void PDTreeBase::ConstructTree(int countThresh, double diagThresh)
+{
+  ICPTRACE_SCOPE("ConstructTree", "datums", NData);
+  int i;
+
+  constructCountThresh = countThresh;
+  constructDiagThresh = diagThresh;
+
+  // precompute the datum sort points and bounding points
+  nConstructBoundPoints = NumDatumBoundPoints();
+  ConstructSortPoints.SetSize(NData);
+  ConstructBoundPoints.SetSize(NData*nConstructBoundPoints);
+#ifdef ENABLE_PARALLELIZATION
+#pragma omp parallel for
+#endif
+  for (i = 0; i < NData; i++)
+  {
+    ConstructSortPoints[i] = DatumSortPoint(i);
+    if (nConstructBoundPoints > 0)
+    {
+      DatumBoundPoints(i, ConstructBoundPoints.Pointer(i*nConstructBoundPoints));
+    }
+  }
+
+  Top = new PDTreeNode(DataIndices, NData, this, NULL);
+  NNodes = 1;
+
+  // split the upper levels of the tree one level at a time
+  std::vector<PDTreeNode*> level(1, Top);
+  std::vector<char> isSplit;
+  while (!level.empty())
+  {
+    int nLevel = (int)level.size();
+    isSplit.assign(nLevel, 0);
+#ifdef ENABLE_PARALLELIZATION
+#pragma omp parallel for schedule(dynamic)
+#endif
+    for (i = 0; i < nLevel; i++)
+    {
+      if (level[i]->NumData() < PDTREE_SUBTREE_THRESH)
+      {
+        level[i]->ConstructSubtree(countThresh, diagThresh);
+      }
+      else
+      {
+        isSplit[i] = level[i]->SplitNode(countThresh, diagThresh);
+      }
+    }
+
+    std::vector<PDTreeNode*> nextLevel;
+    for (i = 0; i < nLevel; i++)
+    {
+      if (isSplit[i])
+      {
+        nextLevel.push_back(level[i]->pLEq);
+        nextLevel.push_back(level[i]->pMore);
+      }
+    }
+    level.swap(nextLevel);
+  }
+  treeDepth = Top->CompleteUpperSubtree(PDTREE_SUBTREE_THRESH);
+
+  ConstructSortPoints.SetSize(0);
+  ConstructBoundPoints.SetSize(0);
+
+  BuildDatumLeaves();
+  buildQuality = TreeQuality();
+}
+
+int PDTreeBase::RefitBounds(const vctDynamicVector<char> *pMoved, double margin)
+{
+  if (!Top)
+  { // only the flattened nodes are held
+    return pFlatTree->RefitBounds(pMoved, margin);
+  }
+
+  int i;
+
+  // nodes of the tree in breadth-first order
+  //  (the children of a node follow it in the list)
+  std::vector<PDTreeNode*> nodes;
+  std::vector<int> firstChild;
+  nodes.reserve(NNodes);
+  nodes.push_back(Top);
+  for (size_t k = 0; k < nodes.size(); k++)
+  {
+    if (nodes[k]->IsTerminalNode())
+    {
+      firstChild.push_back(-1);
+    }
+    else
+    {
+      firstChild.push_back((int)nodes.size());
+      nodes.push_back(nodes[k]->pLEq);
+      nodes.push_back(nodes[k]->pMore);
+    }
+  }
+  int nNodes = (int)nodes.size();
+
+  // flag the nodes holding a moved datum, from the leaves up
+  std::vector<char> refit(nNodes, pMoved ? 0 : 1);
+  if (pMoved)
+  {
+#ifdef ENABLE_PARALLELIZATION
+#pragma omp parallel for schedule(dynamic, 64)
+#endif
+    for (i = 0; i < nNodes; i++)
+    {
+      if (firstChild[i] < 0)
+      {
+        for (int d = 0; d < nodes[i]->NData; d++)
+        {
+          if ((*pMoved)[nodes[i]->Datum(d)])
+          {
+            refit[i] = 1;
+            break;
+          }
+        }
+      }
+    }
+    for (i = nNodes - 1; i >= 0; i--)
+    {
+      if (firstChild[i] >= 0)
+      {
+        refit[i] = refit[firstChild[i]] | refit[firstChild[i] + 1];
+      }
+    }
+  }
+  int nRefit = 0;
+  for (i = 0; i < nNodes; i++)
+  {
+    nRefit += refit[i];
+  }
+  if (nRefit == 0)
+  {
+    return 0;
+  }
+
+  // precompute the datum bounding points (as for construction)
+  ComputeConstructBoundPoints();
+
+  // Bounds are recomputed from the datums rather than merged from the child
+  //  bounds, since the child bounds are in the frames of the child nodes
+#ifdef ENABLE_PARALLELIZATION
+#pragma omp parallel for schedule(dynamic)
+#endif
+  for (i = 0; i < nNodes; i++)
+  {
+    if (refit[i])
+    {
+      PDTreeNode *pNode = nodes[i];
+      BoundingBox BB;
+      for (int d = 0; d < pNode->NData; d++)
+      {
+        ConstructEnlargeBounds(pNode->F, pNode->Datum(d), BB);
+      }
+      BB.EnlargeBy(margin);
+      pNode->Bounds = BB;
+    }
+  }
+  ConstructBoundPoints.SetSize(0);
+
+  // the flattened tree holds a copy of the node bounds
+  if (pFlatTree)
+  {
+    BuildFlatTree(bFlatTreeOnly);
+  }
+  return nRefit;
+}
+
+void PDTreeBase::ComputeConstructBoundPoints()
+{
+  nConstructBoundPoints = NumDatumBoundPoints();
+  ConstructBoundPoints.SetSize(NData*nConstructBoundPoints);
+  if (nConstructBoundPoints > 0)
+  {
+    int i;
+#ifdef ENABLE_PARALLELIZATION
+#pragma omp parallel for
+#endif
+    for (i = 0; i < NData; i++)
+    {
+      DatumBoundPoints(i, ConstructBoundPoints.Pointer(i*nConstructBoundPoints));
+    }
+  }
+}
+
+namespace {
+
+  double BoundsArea(const BoundingBox &BB)
+  {
+    vct3 d = BB.Diagonal();
+    return 2.0*(d[0] * d[1] + d[1] * d[2] + d[2] * d[0]);
+  }
+
+  double SumBoundsArea(const PDTreeNode *pNode)
+  {
+    double area = BoundsArea(pNode->Bounds);
+    if (!pNode->IsTerminalNode())
+    {
+      area += SumBoundsArea(pNode->pLEq) + SumBoundsArea(pNode->pMore);
+    }
+    return area;
+  }
+
+}
+
+double PDTreeBase::TreeQuality() const
+{
+  if (!Top && pFlatTree)
+  { // only the flattened nodes are held
+    double rootArea = BoundsArea(pFlatTree->GetNode(0).Bounds);
+    if (rootArea <= 0.0) return 1.0;
+    double area = 0.0;
+    for (int i = 0; i < pFlatTree->NumNodes(); i++)
+    {
+      area += BoundsArea(pFlatTree->GetNode(i).Bounds);
+    }
+    return area / rootArea;
+  }
+  if (!Top) return 1.0;
+  double rootArea = BoundsArea(Top->Bounds);
+  if (rootArea <= 0.0) return 1.0;
+  return SumBoundsArea(Top) / rootArea;
+}
+
+void PDTreeBase::RebuildTree()
+{
+  bool bFlatTree = (pFlatTree != NULL);
+  bool bFlatOnly = bFlatTreeOnly;
+  DeleteFlatTree();   // (the old nodes are not needed)
+  if (Top)
+  {
+    delete Top;
+    Top = NULL;
+  }
+  ConstructTree(constructCountThresh, constructDiagThresh);
+#ifdef ENABLE_PDTREE_NOISE_MODEL
+  // the new nodes hold no noise model bounds
+  if (bNodeNoiseModels)
+  {
+    ComputeNodeNoiseModels();
+  }
+#endif
+  DatumOrderChanged();
+  if (bFlatTree)
+  {
+    BuildFlatTree(bFlatOnly);
+  }
+}
+
+void PDTreeBase::BuildDatumLeaves()
+{
+  DatumLeaves.SetSize(NData);
+  DatumLeaves.SetAll(NULL);
+  MapDatumLeaves(Top);
+}
+
+void PDTreeBase::MapDatumLeaves(PDTreeNode *pNode)
+{
+  if (pNode->IsTerminalNode())
+  {
+    for (int i = 0; i < pNode->NData; i++)
+    {
+      DatumLeaves[pNode->Datum(i)] = pNode;
+    }
+    return;
+  }
+  MapDatumLeaves(pNode->pLEq);
+  MapDatumLeaves(pNode->pMore);
+}
+
+namespace {
+
+  // file sections
+  const unsigned int PDTreeFileTag_Info = PDTREE_FILE_TAG('I','N','F','O');
+  const unsigned int PDTreeFileTag_Nodes = PDTREE_FILE_TAG('N','O','D','E');
+  const unsigned int PDTreeFileTag_DataIndices = PDTREE_FILE_TAG('D','I','D','X');
+
+  struct PDTreeFileInfo
+  {
+    int NData;
+    int NNodes;
+    int treeDepth;
+    int reserved;
+    unsigned long long datumFingerprint;  // see DatumFingerprint()
+  };
+
+  // node record; nodes are stored in depth-first order such that
+  //  the LEq child of a node immediately follows its parent
+  struct PDTreeFileNode
+  {
+    double R[9];          // rotation of node frame (row-major)
+    double t[3];          // translation of node frame
+    double MinCorner[3];  // node bounds
+    double MaxCorner[3];
+    double EigMax;        // node noise model bounds
+    double EigRankMin[3];
+    int More;             // index of More child (-1 for a leaf node)
+    int DataBegin;        // offset of node datums in the data index array
+    int NData;
+    int myDepth;
+    int bUseParentEigMaxBound;
+    int bUseParentEigRankMinBounds;
+  };
+
+  void SaveSubtree(const PDTreeNode *pNode, const int *pDataIndices,
+                   std::vector<PDTreeFileNode> &nodes)
+  {
+    int index = (int)nodes.size();
+    nodes.push_back(PDTreeFileNode());
+    PDTreeFileNode &rec = nodes.back();
+    memset(&rec, 0, sizeof(PDTreeFileNode));
+    for (int r = 0; r < 3; r++)
+    {
+      for (int c = 0; c < 3; c++)
+      {
+        rec.R[3 * r + c] = pNode->F.Rotation().Element(r, c);
+      }
+      rec.t[r] = pNode->F.Translation().Element(r);
+      rec.MinCorner[r] = pNode->Bounds.MinCorner.Element(r);
+      rec.MaxCorner[r] = pNode->Bounds.MaxCorner.Element(r);
+    }
+#ifdef ENABLE_PDTREE_NOISE_MODEL
+    rec.EigMax = pNode->EigMax;
+    for (int r = 0; r < 3; r++)
+    {
+      rec.EigRankMin[r] = pNode->EigRankMin.Element(r);
+    }
+    rec.bUseParentEigMaxBound = pNode->bUseParentEigMaxBound;
+    rec.bUseParentEigRankMinBounds = pNode->bUseParentEigRankMinBounds;
+#endif
+    rec.More = -1;
+    rec.DataBegin = (int)(pNode->pDataIndices - pDataIndices);
+    rec.NData = pNode->NData;
+    rec.myDepth = pNode->myDepth;
+
+    if (!pNode->IsTerminalNode())
+    {
+      SaveSubtree(pNode->pLEq, pDataIndices, nodes);
+      int more = (int)nodes.size();
+      SaveSubtree(pNode->pMore, pDataIndices, nodes);
+      nodes[index].More = more;   // (node array may have been resized)
+    }
+  }
+
+  // node records from a flattened tree (same depth-first order)
+  void SaveFlatNodes(const PDTreeFlat &tree, std::vector<PDTreeFileNode> &nodes)
+  {
+    int nNodes = tree.NumNodes();
+    nodes.resize(nNodes);
+    for (int i = nNodes - 1; i >= 0; i--)
+    {
+      const PDTreeFlat::Node &n = tree.GetNode(i);
+      PDTreeFileNode &rec = nodes[i];
+      memset(&rec, 0, sizeof(PDTreeFileNode));
+      for (int r = 0; r < 3; r++)
+      {
+        for (int c = 0; c < 3; c++)
+        {
+          rec.R[3 * r + c] = n.F.Rotation().Element(r, c);
+        }
+        rec.t[r] = n.F.Translation().Element(r);
+        rec.MinCorner[r] = n.Bounds.MinCorner.Element(r);
+        rec.MaxCorner[r] = n.Bounds.MaxCorner.Element(r);
+      }
+#ifdef ENABLE_PDTREE_NOISE_MODEL
+      const PDTreeFlat::NodeNoise &noise = tree.GetNodeNoise(i);
+      rec.EigMax = noise.EigMax;
+      for (int r = 0; r < 3; r++)
+      {
+        rec.EigRankMin[r] = noise.EigRankMin.Element(r);
+      }
+      rec.bUseParentEigMaxBound = noise.bUseParentEigMaxBound;
+      rec.bUseParentEigRankMinBounds = noise.bUseParentEigRankMinBounds;
+#endif
+      rec.More = n.More;
+      rec.DataBegin = n.DataBegin;
+      rec.NData = n.NData;
+      // (the children follow the node => their depths are already set)
+      rec.myDepth = (n.More < 0) ? 0 :
+        std::max(nodes[i + 1].myDepth, nodes[n.More].myDepth) + 1;
+    }
+  }
+
+  // checks that the node records form a depth-first tree over the datums
+  //  and that the data indices are datum indices, so that the tree may be
+  //  built from them without further checks
+  bool ValidFileNodes(const PDTreeFileNode *nodes, int NNodes,
+                      const int *pDataIndices, int NData)
+  {
+    if (nodes[0].DataBegin != 0 || nodes[0].NData != NData)
+    {
+      return false;
+    }
+    if (nodes[0].bUseParentEigMaxBound || nodes[0].bUseParentEigRankMinBounds)
+    {
+      return false;  // the root has no parent
+    }
+    for (int i = 0; i < NNodes; i++)
+    {
+      const PDTreeFileNode &rec = nodes[i];
+      if (rec.DataBegin < 0 || rec.NData <= 0 || rec.DataBegin > NData - rec.NData)
+      {
+        return false;
+      }
+      // child indices follow the parent (so that loading terminates)
+      if (rec.More >= 0 && (rec.More <= i + 1 || rec.More >= NNodes))
+      {
+        return false;
+      }
+    }
+    for (int i = 0; i < NData; i++)
+    {
+      if (pDataIndices[i] < 0 || pDataIndices[i] >= NData)
+      {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  PDTreeNode* LoadSubtree(const PDTreeFileNode *nodes, int index,
+                          PDTreeBase *pTree, int *pDataIndices, PDTreeNode *pParent)
+  {
+    const PDTreeFileNode &rec = nodes[index];
+    PDTreeNode *pNode = new PDTreeNode(0.0);
+    pNode->pMyTree = pTree;
+    pNode->pParent = pParent;
+    pNode->pDataIndices = pDataIndices + rec.DataBegin;
+    pNode->NData = rec.NData;
+    pNode->myDepth = rec.myDepth;
+    for (int r = 0; r < 3; r++)
+    {
+      for (int c = 0; c < 3; c++)
+      {
+        pNode->F.Rotation().Element(r, c) = rec.R[3 * r + c];
+      }
+      pNode->F.Translation().Element(r) = rec.t[r];
+      pNode->Bounds.MinCorner.Element(r) = rec.MinCorner[r];
+      pNode->Bounds.MaxCorner.Element(r) = rec.MaxCorner[r];
+    }
+#ifdef ENABLE_PDTREE_NOISE_MODEL
+    pNode->EigMax = rec.EigMax;
+    for (int r = 0; r < 3; r++)
+    {
+      pNode->EigRankMin.Element(r) = rec.EigRankMin[r];
+    }
+    pNode->bUseParentEigMaxBound = (rec.bUseParentEigMaxBound != 0);
+    pNode->bUseParentEigRankMinBounds = (rec.bUseParentEigRankMinBounds != 0);
+    pNode->pEigMax = pNode->bUseParentEigMaxBound ? pParent->pEigMax : &pNode->EigMax;
+    pNode->pEigRankMin = pNode->bUseParentEigRankMinBounds ? pParent->pEigRankMin : &pNode->EigRankMin;
+#endif
+
+    if (rec.More >= 0)
+    {
+      pNode->pLEq = LoadSubtree(nodes, index + 1, pTree, pDataIndices, pNode);
+      pNode->pMore = LoadSubtree(nodes, rec.More, pTree, pDataIndices, pNode);
+    }
+    return pNode;
+  }
+
+}
+
+int PDTreeBase::Save(const std::string &filePath) const
+{
+  PDTreeFileInfo info;
+  info.NData = NData;
+  info.NNodes = NNodes;
+  info.treeDepth = treeDepth;
+  info.reserved = 0;
+  info.datumFingerprint = DatumFingerprint();
+
+  std::vector<PDTreeFileNode> nodes;
+  nodes.reserve(NNodes);
+  if (Top)
+  {
+    SaveSubtree(Top, DataIndices, nodes);
+  }
+  else
+  { // only the flattened nodes are held
+    SaveFlatNodes(*pFlatTree, nodes);
+  }
+
+  PDTreeFileWriter file(PDTREE_FILE_PDTREE);
+  file.AddSection(PDTreeFileTag_Info, &info, sizeof(PDTreeFileInfo));
+  file.AddSection(PDTreeFileTag_Nodes, &nodes[0], nodes.size()*sizeof(PDTreeFileNode));
+  file.AddSection(PDTreeFileTag_DataIndices, DataIndices, NData*sizeof(int));
+  SaveDatumData(file);
+
+  return file.Write(filePath);
+}
+
+int PDTreeBase::Load(const std::string &filePath)
+{
+  PDTreeFileReader file;
+  if (file.Open(filePath, PDTREE_FILE_PDTREE))
+  {
+    return -1;
+  }
+
+  const PDTreeFileInfo *pInfo = (const PDTreeFileInfo*)
+    file.FindSection(PDTreeFileTag_Info, sizeof(PDTreeFileInfo), "INFO");
+  if (!pInfo) return -1;
+  if (pInfo->NData != NData || pInfo->NNodes <= 0)
+  {
+    std::cout << "ERROR: PD tree file was saved for " << pInfo->NData
+      << " datums, but this tree has " << NData << " datums: " << filePath << std::endl;
+    return -1;
+  }
+  if (pInfo->datumFingerprint != DatumFingerprint())
+  {
+    std::cout << "ERROR: PD tree file was saved for different datums: " << filePath << std::endl;
+    return -1;
+  }
+  const PDTreeFileNode *pNodes = (const PDTreeFileNode*)
+    file.FindSection(PDTreeFileTag_Nodes, pInfo->NNodes*sizeof(PDTreeFileNode), "NODE");
+  const int *pDataIndices = (const int*)
+    file.FindSection(PDTreeFileTag_DataIndices, NData*sizeof(int), "DIDX");
+  if (!pNodes || !pDataIndices) return -1;
+  if (!ValidFileNodes(pNodes, pInfo->NNodes, pDataIndices, NData))
+  {
+    std::cout << "ERROR: PD tree file holds an invalid tree: " << filePath << std::endl;
+    return -1;
+  }
+
+  // load the new tree and the datum data before replacing the current tree,
+  //  so that the current tree is unchanged if the load fails
+  //  (the new nodes point into DataIndices, which is overwritten below)
+  PDTreeNode *pLoaded = LoadSubtree(pNodes, 0, this, DataIndices, NULL);
+  if (LoadDatumData(file))
+  {
+    delete pLoaded;
+    return -1;
+  }
+
+  // replace the current tree
+  bool rebuildFlatTree = UsingFlatTree();
+  bool flatOnly = bFlatTreeOnly;
+  DeleteFlatTree();
+  if (Top) delete Top;
+  memcpy(DataIndices, pDataIndices, NData*sizeof(int));
+  Top = pLoaded;
+  NNodes = pInfo->NNodes;
+  treeDepth = pInfo->treeDepth;
+  BuildDatumLeaves();
+  buildQuality = TreeQuality();
+#ifdef ENABLE_PDTREE_NOISE_MODEL
+  // the file holds noise model bounds if they were set when saved
+  bNodeNoiseModels = (Top->EigMax > 0.0);
+#endif
+  if (rebuildFlatTree)
+  {
+    BuildFlatTree(flatOnly);
+  }
+  DatumOrderChanged();
+
+  return 0;
+}
+
+PDTreeBase::~PDTreeBase()
+{
+  // (the derived tree has deleted the standard nodes)
+  DeleteFlatTree();
+}
+
+void PDTreeBase::BuildFlatTree(bool flatOnly)
+{
+  ICPTRACE_SCOPE("BuildFlatTree", "datums", NData);
+  // the flattened tree is compiled from the standard nodes
+  RestoreNodes();
+  if (pFlatTree)
+  {
+    pFlatTree->Build();
+  }
+  else
+  {
+    pFlatTree = new PDTreeFlat(this);
+  }
+  bFlatTreeOnly = flatOnly;
+  if (bFlatTreeOnly)
+  {
+    FreeNodes();
+  }
+}
+
+void PDTreeBase::ClearFlatTree()
+{
+  RestoreNodes();
+  DeleteFlatTree();
+}
+
+void PDTreeBase::DeleteFlatTree()
+{
+  if (pFlatTree)
+  {
+    delete pFlatTree;
+    pFlatTree = NULL;
+  }
+  bFlatTreeOnly = false;
+}
+
+bool PDTreeBase::RestoreNodes()
+{
+  if (Top || !pFlatTree)
+  {
+    return false;
+  }
+  Top = pFlatTree->ExpandTree();
+  BuildDatumLeaves();
+  return true;
+}
+
+void PDTreeBase::FreeNodes()
+{
+  if (Top)
+  {
+    delete Top;
+    Top = NULL;
+  }
+  DatumLeaves.SetSize(0);
+}
+
+size_t PDTreeBase::NodeMemory() const
+{
+  return (Top ? NNodes*sizeof(PDTreeNode) : 0) + NData*sizeof(int)
+    + DatumLeaves.size()*sizeof(PDTreeNode*);
+}
+
+double PDTreeBase::MaxDatumCovEig() const
+{
+#ifdef ENABLE_PDTREE_NOISE_MODEL
+  if (!Top)
+  {
+    return pFlatTree->GetNodeNoise(0).EigMax;
+  }
+#endif
+  return Top->EigMax;
+}
 
 
 // quickly find an approximate initial match by dropping straight down the
@@ -55,6 +711,13 @@
 int PDTreeBase::FastInitializeProximalDatum(
   const vct3 &v, vct3 &proxPoint)
 {
+  if (!Top)
+  { // only the flattened nodes are held
+    int proxDatum = pFlatTree->Datum(pFlatTree->ProximalLeaf(v), 0);
+    proxPoint = DatumSortPoint(proxDatum);
+    return proxDatum;
+  }
+
   // find proximal leaf node
   PDTreeNode *pNode;
   pNode = Top;
@@ -78,47 +741,209 @@ int PDTreeBase::FindClosestDatum(
   vct3 &closestPoint,
   int prevDatum,
   double &matchError,
-  unsigned int &numNodesSearched)
+  PDTreeSearchContext &ctx)
 {
   // NOTE: by specifying a good starting datum (such as previous closest datum)
   //       the search for new closest datum is more efficient because
   //       the bounds value will be a good initial guess => fewer datums are
   //       closely searched.
 
-  unsigned int numNodesVisited = 0;
-  numNodesSearched = 0;
-  matchError = pAlgorithm->FindClosestPointOnDatum(v, closestPoint, prevDatum);
+  if (!ctx.pAlgorithm) ctx.pAlgorithm = pAlgorithm;
+
+  if (pFlatTree)
+  {
+    return pFlatTree->FindClosestDatum(v, closestPoint, prevDatum, matchError, ctx);
+  }
+
+  ctx.ResetStats();
+  ctx.numDatumsTested++;
+  double prevError = ctx.pAlgorithm->FindClosestPointOnDatum(v, closestPoint, prevDatum, ctx);
+  ctx.SeedErrorBound(prevDatum, prevError);
 
-  int datum;
-  if (treeDepth > 0)
+  int datum = -2;
+  if (bSearchFromPrevLeaf && treeDepth > 0 && DatumLeaves.size() == (size_t)NData)
+  {
+    datum = FindClosestDatumFromLeaf(v, closestPoint, DatumLeaves[prevDatum], ctx);
+  }
+
+  if (datum > -2)
+  {
+    // already searched from the leaf of the previous datum
+  }
+  else if (treeDepth > 0)
   {
     // since all datums must lie within the root node, we don't need to do a node bounds
     // check on the root => it is more efficient to start the search from each child node
     // of the root rather than starting the search from the root node itself.
-    //int datum = Top->FindClosestDatum( v, closestPoint, matchError, numNodesVisited, numNodesSearched );
+    //int datum = Top->FindClosestDatum( v, closestPoint, ctx );
     int ClosestLEq = -1;
     int ClosestMore = -1;
-    ClosestLEq = Top->pLEq->FindClosestDatum(v, closestPoint, matchError, numNodesVisited, numNodesSearched);
-    ClosestMore = Top->pMore->FindClosestDatum(v, closestPoint, matchError, numNodesVisited, numNodesSearched);
+    ClosestLEq = Top->pLEq->FindClosestDatum(v, closestPoint, ctx);
+    ClosestMore = Top->pMore->FindClosestDatum(v, closestPoint, ctx);
 	datum = (ClosestMore < 0) ? ClosestLEq : ClosestMore;
   }
   else
   {
-	  datum = Top->FindClosestDatum(v, closestPoint, matchError, numNodesVisited, numNodesSearched);
+	  datum = Top->FindClosestDatum(v, closestPoint, ctx);
   }
   if (datum < 0)
   {
     datum = prevDatum;  // no datum found closer than previous
+    matchError = prevError;
   }
-  //std::cout << "numNodesVisited: " << numNodesVisited << "\tnumNodesSearched: " << numNodesSearched << std::endl;
+  else
+  {
+    matchError = ctx.ErrorBound;
+  }
+  //std::cout << "numNodesVisited: " << ctx.numNodesVisited << "\tnumNodesSearched: " << ctx.numNodesSearched << std::endl;
   return datum;
 
 }
 
+// Search the leaf node of the previous match, then the sibling subtree of
+//  each node on the path from this leaf up to the root
+//  Since the node bounds of sibling nodes may overlap, a node containing the
+//  error bound does not guarantee that no better match lies outside that node;
+//  hence, all siblings up to the root are checked, though most are rejected
+//  by their node bounds test once the leaf has been searched.
+int PDTreeBase::FindClosestDatumFromLeaf(
+  const vct3 &v,
+  vct3 &closestPoint,
+  PDTreeNode *pLeaf,
+  PDTreeSearchContext &ctx)
+{
+  // path from root (path[0]) to leaf
+  PDTreeNode *path[PDTREE_MAX_RESUME_DEPTH];
+  int n = 0;
+  for (PDTreeNode *pNode = pLeaf; pNode; pNode = pNode->pParent)
+  {
+    if (n == PDTREE_MAX_RESUME_DEPTH)
+    {
+      return -2;
+    }
+    path[n++] = pNode;
+  }
+  std::reverse(path, path + n);
+
+  // descend the path to the leaf, applying the node tests in the same order
+  //  as a search from the root, so that any node noise model computed for
+  //  a node on the path is available to its descendants; the noise model
+  //  computed at each level is saved for the sibling searches
+  //  (no bounds check on the root; see FindClosestDatum())
+  PDTreeSearchContext::NodeModel models[PDTREE_MAX_RESUME_DEPTH];
+  int ClosestDatum = -1;
+  int level;
+  for (level = 1; level < n; level++)
+  {
+    ctx.numNodesVisited++;
+    if (ctx.pAlgorithm->NodeMightBeCloser(v, path[level], ctx.PruneBound(), ctx) == 0)
+    {
+      break;
+    }
+    ctx.numNodesSearched++;
+    ctx.SaveNodeModel(models[level]);
+  }
+  if (level == n)
+  { // the leaf passed its node test
+    ClosestDatum = pLeaf->FindClosestLeafDatum(v, closestPoint, ctx);
+    level = n - 1;
+  }
+
+  // search the sibling subtrees from the deepest level that was reached
+  for (; level >= 1; level--)
+  {
+    PDTreeNode *pParent = path[level - 1];
+    PDTreeNode *pSibling = (path[level] == pParent->pLEq) ? pParent->pMore : pParent->pLEq;
+    if (level > 1)
+    {
+      ctx.RestoreNodeModel(models[level - 1]);
+    }
+    int datum = pSibling->FindClosestDatum(v, closestPoint, ctx);
+    if (datum >= 0)
+    {
+      ClosestDatum = datum;
+    }
+  }
+
+  return ClosestDatum;
+}
+
+void PDTreeBase::FindClosestDatums(
+  const vctDynamicVector<vct3> &points,
+  const vctDynamicVector<int> &prevDatums,
+  vctDynamicVector<int> &outDatums,
+  vctDynamicVector<vct3> &outPoints,
+  vctDoubleVec &outErrors,
+  PDTreeSearchStats &stats,
+  PDTreeMatchCallback *pCallback,
+  const vctDynamicVector<unsigned int> *pSearchOrder,
+  algPDTree *pSearchAlgorithm)
+{
+  int nPts = (int)points.size();
+  int nSearch = pSearchOrder ? (int)pSearchOrder->size() : nPts;
+  assert(prevDatums.size() == points.size());
+  assert(!pSearchOrder || pSearchOrder->size() <= points.size());
+
+  // Note: outDatums may be the same vector as prevDatums, which
+  //       always has the correct size
+  if (outDatums.size() != points.size()) outDatums.SetSize(nPts);
+  if (outPoints.size() != points.size()) outPoints.SetSize(nPts);
+  if (outErrors.size() != points.size()) outErrors.SetSize(nPts);
+
+  stats.Reset();
+
+#ifdef ENABLE_PARALLELIZATION
+#pragma omp parallel
+#endif
+  {
+    ICPTRACE_SCOPE("FindClosestDatums thread");
+
+    // statistics of this thread's searches
+    PDTreeSearchStats threadStats;
+
+    int k;
+#ifdef ENABLE_PARALLELIZATION
+#pragma omp for schedule(dynamic, PDTREE_BATCH_CHUNK_SIZE)
+#endif
+    for (k = 0; k < nSearch; k++)
+    {
+      // consecutive points of a spatially coherent search order share
+      //  most of their tree path, which then remains in cache
+      int s = pSearchOrder ? (int)pSearchOrder->Element(k) : k;
+
+      // search context for this point
+      PDTreeSearchContext ctx;
+      ctx.sampleIndex = s;
+      ctx.pAlgorithm = pSearchAlgorithm;
+
+      if (pCallback) pCallback->SamplePreMatch(s, ctx);
+
+      // read the previous datum before writing the match, since these
+      //  may share storage
+      int datum = FindClosestDatum(
+        points.Element(s), outPoints.Element(s),
+        prevDatums.Element(s), outErrors.Element(s), ctx);
+      outDatums.Element(s) = datum;
+
+      threadStats.Add(ctx);
+
+      if (pCallback) pCallback->SamplePostMatch(s, ctx);
+    }
+
+#ifdef ENABLE_PARALLELIZATION
+#pragma omp critical (PDTreeBase_FindClosestDatums)
+#endif
+    stats.Merge(threadStats);
+  }
+}
+
 // must be manually called by user after defining the noise
 //  model on the points (unless using the mesh constructor)
 void PDTreeBase::ComputeNodeNoiseModels()
 {
+  // the noise models are computed on the standard nodes
+  RestoreNodes();
+
   // root pointers should always point to its own variables
   Top->bUseParentEigMaxBound = false;
   Top->bUseParentEigRankMinBounds = false;
@@ -149,6 +974,14 @@ void PDTreeBase::ComputeNodeNoiseModels()
     ComputeSubNodeNoiseModel(Top->pLEq, 1);
   if (Top->pMore)
     ComputeSubNodeNoiseModel(Top->pMore, 1);
+
+  bNodeNoiseModels = true;
+
+  // the flattened tree holds a copy of the node noise models
+  if (pFlatTree)
+  {
+    BuildFlatTree(bFlatTreeOnly);
+  }
 }
 
 void PDTreeBase::ComputeSubNodeNoiseModel(PDTreeNode *node, bool useLocalVarsOverride)
@@ -230,15 +1063,16 @@ void PDTreeBase::ComputeSubNodeNoiseModel(PDTreeNode *node, bool useLocalVarsOve
 // Exhaustive linear search of all datums in the tree to find datum
 //  point with best match (used to validate efficient search routines)
 int PDTreeBase::ValidateClosestDatum(const vct3 &v,
-  vct3 &closestPoint)
+  vct3 &closestPoint, PDTreeSearchContext &ctx)
 {
   double bestError = std::numeric_limits<double>::max();
   int    bestDatum = -1;
   double error;
   vct3 datumPoint;
+  if (!ctx.pAlgorithm) ctx.pAlgorithm = pAlgorithm;
   for (int datum = 0; datum < NData; datum++)
   {
-    error = pAlgorithm->FindClosestPointOnDatum(v, datumPoint, datum);
+    error = ctx.pAlgorithm->FindClosestPointOnDatum(v, datumPoint, datum, ctx);
     if (error < bestError)
     {
       bestError = error;
@@ -307,12 +1141,16 @@ int PDTreeBase::ValidateClosestDatum_ByEuclideanDist(const vct3 &v,
 
 int PDTreeBase::FindTerminalNode(int datum, PDTreeNode **termNode)
 {
+  // (the node returned must remain valid => leave the flat-only mode)
+  if (RestoreNodes()) bFlatTreeOnly = false;
   return Top->FindTerminalNode(datum, termNode);
 }
 
 void PDTreeBase::PrintTerminalNodes(std::ofstream &fs)
 {
+  bool bRestored = RestoreNodes();
   Top->PrintTerminalNodes(fs);
+  if (bRestored) FreeNodes();
 }
 
 //void PDTreeBase::PrintDatum(FILE* chan,int level,int datum)
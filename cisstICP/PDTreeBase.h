@@ -43,6 +43,11 @@
 #include "BoundingBox.h"
 #include "PDTreeNode.h"
 #include "algPDTree.h"
+#include "PDTreeSearchContext.h"
+
+class PDTreeFlat;     // forward declerations for mutual dependency
+class PDTreeFileWriter;
+class PDTreeFileReader;
 
 //#define DEBUG_PD_TREE
 
@@ -60,6 +65,7 @@ class PDTreeBase
   //
 
   friend class PDTreeNode;
+  friend class PDTreeFlat;
 
 
   //--- Variables ---//
@@ -81,6 +87,36 @@ protected:
   int* DataIndices;
   PDTreeNode *Top;
 
+  // flattened copy of the tree used for searching (if built)
+  PDTreeFlat *pFlatTree;
+  // the standard nodes are freed while the flattened tree is built
+  //  (Top is NULL; see BuildFlatTree())
+  bool bFlatTreeOnly;
+
+  // leaf node holding each datum
+  //  (used to resume a search from the leaf of the previous match)
+  vctDynamicVector<PDTreeNode*> DatumLeaves;
+  bool bSearchFromPrevLeaf;
+
+  // Tree construction data
+  //  the sort point and bounding points (e.g. triangle vertices) of each
+  //  datum are computed once prior to construction rather than at every
+  //  node; these are released once the tree is built
+  vctDynamicVector<vct3> ConstructSortPoints;
+  vctDynamicVector<vct3> ConstructBoundPoints;
+  int nConstructBoundPoints;  // bounding points per datum
+
+  // construction parameters (used by RebuildTree())
+  int    constructCountThresh;
+  double constructDiagThresh;
+  double buildQuality;        // TreeQuality() of the tree when built or loaded
+
+#ifdef ENABLE_PDTREE_NOISE_MODEL
+  // node noise models are set (by ComputeNodeNoiseModels() or loaded with
+  //  the tree) and so are recomputed by RebuildTree()
+  bool bNodeNoiseModels;
+#endif
+
 
   //--- Methods ---//
 
@@ -89,8 +125,15 @@ public:
   // constructors
   PDTreeBase() :
     NData(0), NNodes(0), treeDepth(0),
-    DataIndices(NULL), Top(NULL), pAlgorithm(NULL)
+    DataIndices(NULL), Top(NULL), pFlatTree(NULL), bFlatTreeOnly(false),
+    bSearchFromPrevLeaf(true),
+    nConstructBoundPoints(0),
+    constructCountThresh(5), constructDiagThresh(5.0), buildQuality(1.0),
+    pAlgorithm(NULL)
   {
+#ifdef ENABLE_PDTREE_NOISE_MODEL
+    bNodeNoiseModels = false;
+#endif
 #ifdef DEBUG_PD_TREE
     debugFile = fopen("debugPDTree.txt","w");
     debugFile2 = fopen("debugPDTree2.txt","w");
@@ -98,7 +141,7 @@ public:
   };
 
   // destructor
-  virtual ~PDTreeBase() {}
+  virtual ~PDTreeBase();
 
   int FastInitializeProximalDatum(const vct3 &v, vct3 &proxPoint);
 
@@ -109,19 +152,117 @@ public:
 
   // Returns the index for the datum in the tree that has lowest match error for
   //  the given point and set the closest point values
+  //  (the search context holds all state for this query, including any
+  //   sample-specific values set by the algorithm prior to the search;
+  //   the node statistics of the search are returned in the context)
   int FindClosestDatum(
     const vct3 &v,
     vct3 &closestPoint,
     int prevDatum,
     double &matchError,
-    unsigned int &numNodesSearched);
+    PDTreeSearchContext &ctx);
+
+  // Start each search from the leaf node holding the previous datum rather
+  //  than from the root (default: on)
+  //  Between ICP iterations the match of a sample rarely moves far, so the
+  //  leaf of the previous match is searched first, followed by the sibling
+  //  subtrees of each node on the path back to the root. The tighter error
+  //  bound found in the leaf rejects most siblings at their top node.
+  //  The result is the same as a search from the root.
+  void SetSearchFromPreviousLeaf(bool enable) { bSearchFromPrevLeaf = enable; };
+
+  // Finds the datum having lowest match error for each of a set of points
+  //  The points are searched in parallel; since the cost of a search varies
+  //  greatly between points near to and far from the surface, the points are
+  //  assigned to threads dynamically in small chunks.
+  //  prevDatums may be the same vector as outDatums. The optional callback
+  //  is called for each point before and after its search (from the thread
+  //  searching that point) and sets any sample-specific search values.
+  //  The node statistics of the searches are returned in stats.
+  //  If a search order is given (e.g. see ComputeMortonOrder()), the points
+  //  are searched in that order; the outputs are always stored in the order
+  //  of the input points. The order may list a subset of the points, in which
+  //  case the outputs of the points not listed are unchanged.
+  //  The searches are evaluated by the given search algorithm, or by the
+  //  algorithm registered with the tree if none is given.
+  void FindClosestDatums(
+    const vctDynamicVector<vct3> &points,
+    const vctDynamicVector<int> &prevDatums,
+    vctDynamicVector<int> &outDatums,
+    vctDynamicVector<vct3> &outPoints,
+    vctDoubleVec &outErrors,
+    PDTreeSearchStats &stats,
+    PDTreeMatchCallback *pCallback = NULL,
+    const vctDynamicVector<unsigned int> *pSearchOrder = NULL,
+    algPDTree *pSearchAlgorithm = NULL);
+
+  // Build a flattened copy of the tree, which is used for all subsequent
+  //  searches; this stores the nodes contiguously in depth-first order and
+  //  reduces the memory of the nodes touched during a search.
+  //  It is kept up to date when the tree is modified through this class
+  //  (rebuild, refit, node noise models, load).
+  //  flatOnly - free the standard nodes, so that only the flattened nodes
+  //             are held; refits and searches then work on the flattened
+  //             nodes, while the operations that need the standard nodes
+  //             (e.g. node noise models, debug routines) rebuild them from
+  //             the flattened tree
+  //  Searches call the algorithm's node check for the flattened tree
+  //  (see algPDTree::FlatNodeMightBeCloser()).
+  void BuildFlatTree(bool flatOnly = false);
+  // removes the flattened tree (restoring the standard nodes if freed)
+  void ClearFlatTree();
+  bool UsingFlatTree() const { return pFlatTree != NULL; };
+  bool FlatTreeOnly() const { return bFlatTreeOnly; };
+  const PDTreeFlat* FlatTree() const { return pFlatTree; };
+
+  // memory used by the standard nodes and their datum arrays (in bytes)
+  //  (the flattened tree is reported by PDTreeFlat::NodeMemory())
+  size_t NodeMemory() const;
+
+  // Refit the node bounds to the current datum positions (e.g. of a deformed
+  //  mesh), keeping the tree structure and the node frames
+  //  The bounds of each node are recomputed in its own frame from the datums
+  //  it holds (the nodes are refit in parallel); a flattened tree is rebuilt.
+  //  pMoved - flag for each datum that moved since the last refit; only the
+  //           nodes holding a moved datum are refit (NULL = refit all nodes)
+  //  margin - distance added to each side of the refit bounds, e.g. for
+  //           datums allowed to move by a tolerance without being refit
+  //  returns the number of nodes refit
+  int RefitBounds(const vctDynamicVector<char> *pMoved = NULL, double margin = 0.0);
+
+  // sum of the surface areas of the node bounds relative to that of the root
+  //  (grows as refit bounds become loose relative to the node frames)
+  double TreeQuality() const;
+  // TreeQuality() relative to that of the tree when built or loaded
+  double RelativeTreeQuality() const { return TreeQuality() / buildQuality; }
+
+  // Rebuild the tree for the current datum positions using the thresholds
+  //  of the original construction (e.g. once RelativeTreeQuality() shows that
+  //  refit bounds have degraded the tree)
+  //  The node noise models are recomputed if they were set, and the derived
+  //  tree updates its datum order data (see DatumOrderChanged()).
+  //  Note: this changes the datum order of the tree (see DatumOrder())
+  void RebuildTree();
 
   int NumData() const { return NData; };
+  // datum indices in tree order (the datums of each leaf are contiguous)
+  const int* DatumOrder() const { return DataIndices; };
   int NumNodes() const { return NNodes; };
   int TreeDepth() const { return treeDepth; };
 
+  // Save the constructed tree to a binary file, or load a tree previously
+  //  saved for the same datums (see PDTreeFile.h); returns 0 on success
+  //  The file holds the nodes (frames, bounds and noise model bounds) and
+  //  the datum index permutation, together with any datum-specific search
+  //  data of the derived tree type.
+  //  Note: the datums themselves are not saved; the tree must be loaded
+  //        into a tree object defined on the same datums (a file saved
+  //        for other datums is rejected by DatumFingerprint())
+  int   Save(const std::string &filePath) const;
+  int   Load(const std::string &filePath);
+
   // debug routines
-  int   ValidateClosestDatum(const vct3 &v, vct3 &closestPoint);
+  int   ValidateClosestDatum(const vct3 &v, vct3 &closestPoint, PDTreeSearchContext &ctx);
   int   ValidateClosestDatum_ByEuclideanDist(const vct3 &v, vct3 &closestPoint);
   int   FindTerminalNode(int datum, PDTreeNode **termNode);
   void  PrintTerminalNodes(std::ofstream &fs);
@@ -134,15 +275,98 @@ public:
   virtual vct3  DatumSortPoint(int datum) const = 0;
   virtual void  EnlargeBounds(const vctFrm3& F, int datum, BoundingBox& BB) const = 0;
 
+  // points whose bounding box in any frame equals the bounds set by
+  //  EnlargeBounds() for this datum (e.g. the triangle vertices)
+  //  (if not defined, EnlargeBounds() is used during construction)
+  virtual int   NumDatumBoundPoints() const { return 0; }
+  virtual void  DatumBoundPoints(int datum, vct3 *pts) const {}
+
+protected:
+
+  // set the leaf node of each datum (called once the tree is built)
+  void  BuildDatumLeaves();
+  void  MapDatumLeaves(PDTreeNode *pNode);
+
+  // rebuild the standard nodes from the flattened tree if they were freed
+  //  (returns true if the nodes were rebuilt)
+  bool  RestoreNodes();
+  // free the standard nodes (once the flattened tree is built)
+  void  FreeNodes();
+  // delete the flattened tree without restoring the standard nodes
+  void  DeleteFlatTree();
+
+  // precompute the bounding points of the datums (see ConstructEnlargeBounds())
+  void  ComputeConstructBoundPoints();
+
+  // search from the leaf node of the previous datum
+  //  (returns -2 if the leaf is too deep to resume from)
+  int   FindClosestDatumFromLeaf(
+    const vct3 &v,
+    vct3 &closestPoint,
+    PDTreeNode *pLeaf,
+    PDTreeSearchContext &ctx);
+
+  // save / load datum-specific search data with the tree (returns 0 on success)
+  //  Load() calls LoadDatumData() before it replaces the current tree; on
+  //  failure the datum data must be left unchanged
+  virtual void  SaveDatumData(PDTreeFileWriter &file) const {}
+  virtual int   LoadDatumData(const PDTreeFileReader &file) { return 0; }
+
+  // hash of the datum geometry saved with the tree, so that a file saved
+  //  for other datums of the same count is rejected on load
+  //  (0 if the derived tree type does not define one)
+  virtual unsigned long long DatumFingerprint() const { return 0; }
+
+  // update any datum-specific data held in the datum order of the tree
+  //  (called by RebuildTree() and Load() once the new tree is set)
+  virtual void  DatumOrderChanged() {}
+
+  // Builds the tree from the datum index array
+  //  (called by the derived class constructor once NData and DataIndices
+  //   are set)
+  //  The upper levels of the tree are split one level at a time with the
+  //  nodes of each level split in parallel; nodes below a size threshold
+  //  have their entire subtree constructed as a single parallel task.
+  //  The resulting tree is identical to that of a serial construction.
+  void ConstructTree(int countThresh, double diagThresh);
+
+  // datum routines used during tree construction
+  const vct3& ConstructSortPoint(int datum) const
+  {
+    return ConstructSortPoints.Element(datum);
+  }
+  void ConstructEnlargeBounds(const vctFrm3& F, int datum, BoundingBox& BB) const
+  {
+    if (nConstructBoundPoints > 0)
+    {
+      const vct3 *pts = ConstructBoundPoints.Pointer(datum*nConstructBoundPoints);
+      for (int k = 0; k < nConstructBoundPoints; k++)
+      {
+        BB.Include(F*pts[k]);
+      }
+    }
+    else
+    {
+      EnlargeBounds(F, datum, BB);
+    }
+  }
+
+public:
+
 
 #ifdef ENABLE_PDTREE_NOISE_MODEL
 
   //--- Noise Model Methods ---//
 
-  virtual vct3x3& DatumCov(int datum) = 0;    // return measurement noise model for this datum
-  virtual vct3x3* DatumCovPtr(int datum) = 0; // return measurement noise model for this datum
-  virtual vct3& DatumCovEig(int datum) = 0;         
-  virtual vct3* DatumCovEigPtr(int datum) = 0;
+  //  (the noise models may be held in a compact storage by the target shape,
+  //   see CovStorageMode, so they are returned by value)
+  virtual void DatumCov(int datum, vct3x3 &M) = 0;      // measurement noise model for this datum
+  virtual void AddDatumCov(int datum, vct3x3 &M) = 0;   // M += measurement noise model for this datum
+  virtual vct3 DatumCovEig(int datum) = 0;              // noise model eigenvalues (in decreasing size)
+
+  // largest eigenvalue among the noise models of all datums
+  //  (set by ComputeNodeNoiseModels())
+  double MaxDatumCovEig() const;
 
   // may have to be manually called by user after defining the noise
   //  model of the datums
@@ -0,0 +1,239 @@
+// ****************************************************************************
+//
+//    Copyright (c) 2014, Seth Billings, Russell Taylor, Johns Hopkins University
+//    All rights reserved.
+//
+//    Redistribution and use in source and binary forms, with or without
+//    modification, are permitted provided that the following conditions are
+//    met:
+//
+//    1. Redistributions of source code must retain the above copyright
+//    notice, this list of conditions and the following disclaimer.
+//
+//    2. Redistributions in binary form must reproduce the above copyright
+//    notice, this list of conditions and the following disclaimer in the
+//    documentation and/or other materials provided with the distribution.
+//
+//    3. Neither the name of the copyright holder nor the names of its
+//    contributors may be used to endorse or promote products derived from
+//    this software without specific prior written permission.
+//
+//    THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+//    "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+//    LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+//    A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+//    HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+//    SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+//    LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+//    DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+//    THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+//    (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+//    OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//  
+// ****************************************************************************
+
+#include "PDTreeFile.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <iostream>
+
+namespace {
+
+  const char PDTreeFileMagic[8] = { 'c', 'i', 's', 's', 't', 'P', 'D', 'T' };
+
+  struct FileHeader
+  {
+    char magic[8];
+    unsigned int version;
+    unsigned int fileType;
+    unsigned long long payloadSize;
+    unsigned long long checksum;
+  };
+
+  struct SectionHeader
+  {
+    unsigned int tag;
+    unsigned int reserved;
+    unsigned long long nBytes;
+  };
+
+  size_t PaddedSize(size_t nBytes)
+  {
+    return (nBytes + 7) & ~((size_t)7);
+  }
+
+}
+
+
+unsigned long long PDTreeFileChecksum(const char *data, size_t nBytes,
+                                      unsigned long long seed)
+{
+  // 64-bit FNV-1a
+  unsigned long long hash = seed;
+  for (size_t i = 0; i < nBytes; i++)
+  {
+    hash ^= (unsigned char)data[i];
+    hash *= 1099511628211ULL;
+  }
+  return hash;
+}
+
+
+void PDTreeFileWriter::AddSection(unsigned int tag, const void *data, size_t nBytes)
+{
+  SectionHeader section;
+  section.tag = tag;
+  section.reserved = 0;
+  section.nBytes = nBytes;
+
+  size_t offset = payload.size();
+  payload.resize(offset + sizeof(SectionHeader) + PaddedSize(nBytes), 0);
+  memcpy(&payload[offset], &section, sizeof(SectionHeader));
+  if (nBytes > 0)
+  {
+    memcpy(&payload[offset + sizeof(SectionHeader)], data, nBytes);
+  }
+}
+
+int PDTreeFileWriter::Write(const std::string &filePath) const
+{
+  FileHeader header;
+  memcpy(header.magic, PDTreeFileMagic, sizeof(header.magic));
+  header.version = PDTREE_FILE_VERSION;
+  header.fileType = fileType;
+  header.payloadSize = payload.size();
+  header.checksum = payload.empty() ? PDTreeFileChecksum(NULL, 0) :
+    PDTreeFileChecksum(&payload[0], payload.size());
+
+  FILE *f = fopen(filePath.c_str(), "wb");
+  if (!f)
+  {
+    std::cout << "ERROR: failed to open file for writing: " << filePath << std::endl;
+    return -1;
+  }
+  bool ok = (fwrite(&header, sizeof(FileHeader), 1, f) == 1);
+  if (ok && !payload.empty())
+  {
+    ok = (fwrite(&payload[0], 1, payload.size(), f) == payload.size());
+  }
+  if (fclose(f) != 0) ok = false;
+  if (!ok)
+  {
+    std::cout << "ERROR: failed to write file: " << filePath << std::endl;
+    return -1;
+  }
+  return 0;
+}
+
+
+PDTreeFileReader::PDTreeFileReader()
+  : fileSize(0)
+{}
+
+void PDTreeFileReader::Close()
+{
+  std::vector<unsigned long long>().swap(buffer);
+  fileSize = 0;
+}
+
+int PDTreeFileReader::Open(const std::string &filePath, unsigned int fileType)
+{
+  Close();
+
+  // read the file
+  FILE *f = fopen(filePath.c_str(), "rb");
+  if (!f)
+  {
+    std::cout << "ERROR: failed to open file: " << filePath << std::endl;
+    return -1;
+  }
+  bool ok = (fseek(f, 0, SEEK_END) == 0);
+  long nBytes = ok ? ftell(f) : -1;
+  ok = ok && nBytes >= (long)sizeof(FileHeader) && fseek(f, 0, SEEK_SET) == 0;
+  if (ok)
+  {
+    fileSize = (size_t)nBytes;
+    buffer.resize((fileSize + 7) / 8);
+    ok = (fread(&buffer[0], 1, fileSize, f) == fileSize);
+  }
+  fclose(f);
+  if (!ok)
+  {
+    std::cout << "ERROR: failed to read file: " << filePath << std::endl;
+    Close();
+    return -1;
+  }
+
+  // validate the header
+  const FileHeader *pHeader = (const FileHeader*)Data();
+  if (memcmp(pHeader->magic, PDTreeFileMagic, sizeof(PDTreeFileMagic)) != 0)
+  {
+    std::cout << "ERROR: not a PD tree file: " << filePath << std::endl;
+    Close();
+    return -1;
+  }
+  if (pHeader->version != PDTREE_FILE_VERSION)
+  {
+    std::cout << "ERROR: PD tree file version " << pHeader->version
+      << " does not match the supported version " << PDTREE_FILE_VERSION
+      << ": " << filePath << std::endl;
+    Close();
+    return -1;
+  }
+  if (pHeader->fileType != fileType)
+  {
+    std::cout << "ERROR: PD tree file holds a different tree type: " << filePath << std::endl;
+    Close();
+    return -1;
+  }
+  if (pHeader->payloadSize != fileSize - sizeof(FileHeader)
+    || pHeader->checksum != PDTreeFileChecksum(Data() + sizeof(FileHeader), fileSize - sizeof(FileHeader)))
+  {
+    std::cout << "ERROR: PD tree file is truncated or corrupt: " << filePath << std::endl;
+    Close();
+    return -1;
+  }
+
+  return 0;
+}
+
+const void* PDTreeFileReader::FindSection(unsigned int tag, size_t &nBytes) const
+{
+  if (buffer.empty()) return NULL;
+
+  size_t offset = sizeof(FileHeader);
+  while (offset + sizeof(SectionHeader) <= fileSize)
+  {
+    const SectionHeader *pSection = (const SectionHeader*)(Data() + offset);
+    offset += sizeof(SectionHeader);
+    if (offset + PaddedSize((size_t)pSection->nBytes) > fileSize)
+    {
+      break;
+    }
+    if (pSection->tag == tag)
+    {
+      nBytes = (size_t)pSection->nBytes;
+      return Data() + offset;
+    }
+    offset += PaddedSize((size_t)pSection->nBytes);
+  }
+  return NULL;
+}
+
+const void* PDTreeFileReader::FindSection(unsigned int tag, size_t nBytesExpected, const char *name) const
+{
+  size_t nBytes = 0;
+  const void *pData = FindSection(tag, nBytes);
+  if (!pData)
+  {
+    std::cout << "ERROR: PD tree file is missing section: " << name << std::endl;
+    return NULL;
+  }
+  if (nBytesExpected > 0 && nBytes != nBytesExpected)
+  {
+    std::cout << "ERROR: PD tree file section has unexpected size: " << name << std::endl;
+    return NULL;
+  }
+  return pData;
+}
@@ -0,0 +1,134 @@
+// ****************************************************************************
+//
+//    Copyright (c) 2014, Seth Billings, Russell Taylor, Johns Hopkins University
+//    All rights reserved.
+//
+//    Redistribution and use in source and binary forms, with or without
+//    modification, are permitted provided that the following conditions are
+//    met:
+//
+//    1. Redistributions of source code must retain the above copyright
+//    notice, this list of conditions and the following disclaimer.
+//
+//    2. Redistributions in binary form must reproduce the above copyright
+//    notice, this list of conditions and the following disclaimer in the
+//    documentation and/or other materials provided with the distribution.
+//
+//    3. Neither the name of the copyright holder nor the names of its
+//    contributors may be used to endorse or promote products derived from
+//    this software without specific prior written permission.
+//
+//    THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+//    "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+//    LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+//    A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+//    HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+//    SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+//    LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+//    DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+//    THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+//    (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+//    OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//  
+// ****************************************************************************
+#ifndef _PDTreeFile_h
+#define _PDTreeFile_h
+
+#include <string>
+#include <vector>
+
+//
+// Binary file format for saving a constructed PD tree and the related
+//  search precomputations, so that these may be loaded rather than
+//  recomputed for a fixed target shape.
+//
+// File layout (native byte order):
+//   header   - magic, format version, file type, payload size and checksum
+//   payload  - a sequence of sections, each having a tag, a size
+//              and data padded to a multiple of 8 bytes
+//
+// The checksum is a 64-bit FNV-1a hash of the payload.
+// Files are read into memory with a plain file read and the whole payload
+//  is checked; the loaded tree copies its data out of this buffer, which
+//  is released once loading is done. Loading saves the construction of
+//  the tree, not the reading of the file.
+//
+
+// file format version; increment whenever the layout of any section changes
+#define PDTREE_FILE_VERSION 2
+
+// file types
+enum PDTreeFileType
+{
+  PDTREE_FILE_PDTREE = 1,   // PDTreeBase
+  PDTREE_FILE_DIRPDTREE = 2 // DirPDTreeBase
+};
+
+// section tag from four characters
+#define PDTREE_FILE_TAG(a,b,c,d) \
+  ((unsigned int)(a) | ((unsigned int)(b) << 8) | ((unsigned int)(c) << 16) | ((unsigned int)(d) << 24))
+
+
+class PDTreeFileWriter
+{
+  //
+  // Accumulates the sections of a file in memory and
+  //  writes the file with its header
+  //
+
+protected:
+
+  unsigned int fileType;
+  std::vector<char> payload;
+
+public:
+
+  PDTreeFileWriter(unsigned int fileType) : fileType(fileType) {}
+
+  // append a section to the file
+  void AddSection(unsigned int tag, const void *data, size_t nBytes);
+
+  // write the file; returns 0 on success
+  int Write(const std::string &filePath) const;
+};
+
+
+class PDTreeFileReader
+{
+  //
+  // Reads a file into memory and provides access
+  //  to its sections
+  //
+
+protected:
+
+  // file contents (held as 8-byte words, so that the sections are aligned)
+  std::vector<unsigned long long> buffer;
+  size_t fileSize;
+
+  const char* Data() const { return (const char*)&buffer[0]; }
+
+public:
+
+  PDTreeFileReader();
+
+  // reads the file and validates the header and checksum
+  //  returns 0 on success
+  int Open(const std::string &filePath, unsigned int fileType);
+  void Close();
+
+  // returns a pointer to the data of the section having the given tag
+  //  (aligned to 8 bytes) or NULL if the section is not present
+  //  (if nBytesExpected is non-zero, the section size must match)
+  const void* FindSection(unsigned int tag, size_t &nBytes) const;
+  const void* FindSection(unsigned int tag, size_t nBytesExpected, const char *name) const;
+};
+
+
+// hash used for the file checksum
+//  (a hash may be continued over further data by passing it as the seed,
+//   e.g. for the fingerprint of the datums of a tree)
+unsigned long long PDTreeFileChecksum(const char *data, size_t nBytes,
+                                      unsigned long long seed = 14695981039346656037ULL);
+
+#endif
@@ -0,0 +1,395 @@
+// ****************************************************************************
+//
+//    Copyright (c) 2014, Seth Billings, Russell Taylor, Johns Hopkins University
+//    All rights reserved.
+//
+//    Redistribution and use in source and binary forms, with or without
+//    modification, are permitted provided that the following conditions are
+//    met:
+//
+//    1. Redistributions of source code must retain the above copyright
+//    notice, this list of conditions and the following disclaimer.
+//
+//    2. Redistributions in binary form must reproduce the above copyright
+//    notice, this list of conditions and the following disclaimer in the
+//    documentation and/or other materials provided with the distribution.
+//
+//    3. Neither the name of the copyright holder nor the names of its
+//    contributors may be used to endorse or promote products derived from
+//    this software without specific prior written permission.
+//
+//    THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+//    "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+//    LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+//    A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+//    HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+//    SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+//    LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+//    DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+//    THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+//    (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+//    OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//  
+// ****************************************************************************
+
+#include "PDTreeFlat.h"
+#include "PDTreeBase.h"
+#include "algPDTree.h"
+
+#include <algorithm>
+
+#define ENABLE_PARALLELIZATION
+
+
+PDTreeFlat::PDTreeFlat(PDTreeBase *pTree)
+  : pTree(pTree)
+{
+  Build();
+}
+
+void PDTreeFlat::Build()
+{
+  Nodes.clear();
+  Nodes.reserve(pTree->NNodes);
+  Parents.clear();
+  Parents.reserve(pTree->NNodes);
+#ifdef ENABLE_PDTREE_NOISE_MODEL
+  NodeNoiseModels.clear();
+  NodeNoiseModels.reserve(pTree->NNodes);
+#endif
+
+  // datum indices are copied in the order set by the tree construction,
+  //  so that the datum range of every node is contiguous
+  DataIndices.assign(pTree->DataIndices, pTree->DataIndices + pTree->NData);
+
+  FlattenSubtree(pTree->Top, -1);
+
+  DatumLeaves.assign(pTree->NData, -1);
+  for (int i = 0; i < (int)Nodes.size(); i++)
+  {
+    if (Nodes[i].More < 0)
+    {
+      for (int k = 0; k < Nodes[i].NData; k++)
+      {
+        DatumLeaves[Datum(i, k)] = i;
+      }
+    }
+  }
+}
+
+// add a node and its subtree to the node arrays in depth-first order
+//  and return the index of the node
+int PDTreeFlat::FlattenSubtree(PDTreeNode *pNode, int parent)
+{
+  int index = (int)Nodes.size();
+  Parents.push_back(parent);
+
+  Node node;
+  node.F = pNode->F;
+  node.Bounds = pNode->Bounds;
+  node.More = -1;
+  node.DataBegin = (int)(pNode->pDataIndices - pTree->DataIndices);
+  node.NData = pNode->NData;
+  Nodes.push_back(node);
+
+#ifdef ENABLE_PDTREE_NOISE_MODEL
+  NodeNoise noise;
+  noise.EigMax = pNode->EigMax;
+  noise.EigRankMin = pNode->EigRankMin;
+  noise.bUseParentEigMaxBound = pNode->bUseParentEigMaxBound;
+  noise.bUseParentEigRankMinBounds = pNode->bUseParentEigRankMinBounds;
+  NodeNoiseModels.push_back(noise);
+#endif
+
+  if (!pNode->IsTerminalNode())
+  {
+    // LEq child must immediately follow its parent
+    FlattenSubtree(pNode->pLEq, index);
+    // (can't hold a reference to the node across the recursion
+    //  since the node array may be resized)
+    int more = FlattenSubtree(pNode->pMore, index);
+    Nodes[index].More = more;
+  }
+
+  return index;
+}
+
+PDTreeNode* PDTreeFlat::ExpandTree() const
+{
+  return ExpandSubtree(0, NULL);
+}
+
+PDTreeNode* PDTreeFlat::ExpandSubtree(int node, PDTreeNode *pParent) const
+{
+  const Node &n = Nodes[node];
+  PDTreeNode *pNode = new PDTreeNode(0.0);
+  pNode->pMyTree = pTree;
+  pNode->pParent = pParent;
+  pNode->pDataIndices = pTree->DataIndices + n.DataBegin;
+  pNode->NData = n.NData;
+  pNode->F = n.F;
+  pNode->Bounds = n.Bounds;
+
+#ifdef ENABLE_PDTREE_NOISE_MODEL
+  const NodeNoise &noise = NodeNoiseModels[node];
+  pNode->EigMax = noise.EigMax;
+  pNode->EigRankMin = noise.EigRankMin;
+  pNode->bUseParentEigMaxBound = noise.bUseParentEigMaxBound;
+  pNode->bUseParentEigRankMinBounds = noise.bUseParentEigRankMinBounds;
+  pNode->pEigMax = pNode->bUseParentEigMaxBound ? pParent->pEigMax : &pNode->EigMax;
+  pNode->pEigRankMin = pNode->bUseParentEigRankMinBounds ? pParent->pEigRankMin : &pNode->EigRankMin;
+#endif
+
+  pNode->myDepth = 0;
+  if (n.More >= 0)
+  {
+    pNode->pLEq = ExpandSubtree(node + 1, pNode);
+    pNode->pMore = ExpandSubtree(n.More, pNode);
+    pNode->myDepth = std::max(pNode->pLEq->myDepth, pNode->pMore->myDepth) + 1;
+  }
+  return pNode;
+}
+
+int PDTreeFlat::ProximalLeaf(const vct3 &v) const
+{
+  int node = 0;
+  while (Nodes[node].More >= 0)
+  {
+    // node split occurs along the local x-axis (see PDTreeNode::GetChildSplitNode())
+    const vctFrm3 &F = Nodes[node].F;
+    double x_node = F.Rotation().Row(0)*v + F.Translation()[0];
+    node = (x_node > 0) ? Nodes[node].More : node + 1;
+  }
+  return node;
+}
+
+int PDTreeFlat::RefitBounds(const vctDynamicVector<char> *pMoved, double margin)
+{
+  int nNodes = (int)Nodes.size();
+  int i;
+
+  // flag the nodes holding a moved datum, from the leaves up
+  //  (the children of a node follow it in the node array)
+  std::vector<char> refit(nNodes, pMoved ? 0 : 1);
+  if (pMoved)
+  {
+#ifdef ENABLE_PARALLELIZATION
+#pragma omp parallel for schedule(dynamic, 64)
+#endif
+    for (i = 0; i < nNodes; i++)
+    {
+      if (Nodes[i].More < 0)
+      {
+        for (int d = 0; d < Nodes[i].NData; d++)
+        {
+          if ((*pMoved)[Datum(i, d)])
+          {
+            refit[i] = 1;
+            break;
+          }
+        }
+      }
+    }
+    for (i = nNodes - 1; i >= 0; i--)
+    {
+      if (Nodes[i].More >= 0)
+      {
+        refit[i] = refit[i + 1] | refit[Nodes[i].More];
+      }
+    }
+  }
+  int nRefit = 0;
+  for (i = 0; i < nNodes; i++)
+  {
+    nRefit += refit[i];
+  }
+  if (nRefit == 0)
+  {
+    return 0;
+  }
+
+  // bounds are recomputed from the datums (as for the standard nodes)
+  pTree->ComputeConstructBoundPoints();
+#ifdef ENABLE_PARALLELIZATION
+#pragma omp parallel for schedule(dynamic)
+#endif
+  for (i = 0; i < nNodes; i++)
+  {
+    if (refit[i])
+    {
+      Node &n = Nodes[i];
+      BoundingBox BB;
+      for (int d = 0; d < n.NData; d++)
+      {
+        pTree->ConstructEnlargeBounds(n.F, Datum(i, d), BB);
+      }
+      BB.EnlargeBy(margin);
+      n.Bounds = BB;
+    }
+  }
+  pTree->ConstructBoundPoints.SetSize(0);
+  return nRefit;
+}
+
+size_t PDTreeFlat::NodeMemory() const
+{
+  size_t bytes = Nodes.capacity()*sizeof(Node) + DataIndices.capacity()*sizeof(int)
+    + (Parents.capacity() + DatumLeaves.capacity())*sizeof(int);
+#ifdef ENABLE_PDTREE_NOISE_MODEL
+  bytes += NodeNoiseModels.capacity()*sizeof(NodeNoise);
+#endif
+  return bytes;
+}
+
+
+// Return the index for the datum in the tree that is closest to the given point
+//  in terms of the complete error and set the closest point
+int PDTreeFlat::FindClosestDatum(
+  const vct3 &v,
+  vct3 &closestPoint,
+  int prevDatum,
+  double &matchError,
+  PDTreeSearchContext &ctx) const
+{
+  if (!ctx.pAlgorithm) ctx.pAlgorithm = pTree->pAlgorithm;
+  ctx.ResetStats();
+  ctx.numDatumsTested++;
+  double prevError = ctx.pAlgorithm->FindClosestPointOnDatum(v, closestPoint, prevDatum, ctx);
+  ctx.SeedErrorBound(prevDatum, prevError);
+
+  int datum = -2;
+  if (pTree->bSearchFromPrevLeaf && Nodes[0].More >= 0)
+  {
+    datum = FindClosestDatumFromLeaf(DatumLeaves[prevDatum], v, closestPoint, ctx);
+  }
+
+  if (datum > -2)
+  {
+    // already searched from the leaf of the previous datum
+  }
+  else if (Nodes[0].More >= 0)
+  {
+    // no bounds check on the root (see PDTreeBase::FindClosestDatum())
+    int ClosestLEq = FindClosestDatum(1, v, closestPoint, ctx);
+    int ClosestMore = FindClosestDatum(Nodes[0].More, v, closestPoint, ctx);
+    datum = (ClosestMore < 0) ? ClosestLEq : ClosestMore;
+  }
+  else
+  {
+    datum = FindClosestDatum(0, v, closestPoint, ctx);
+  }
+  if (datum < 0)
+  {
+    datum = prevDatum;  // no datum found closer than previous
+    matchError = prevError;
+  }
+  else
+  {
+    matchError = ctx.ErrorBound;
+  }
+  return datum;
+}
+
+// Check if a datum in this node has a lower match error than the error bound
+//  (same behavior as PDTreeNode::FindClosestDatum())
+int PDTreeFlat::FindClosestDatum(
+  int node,
+  const vct3 &v,
+  vct3 &closestPoint,
+  PDTreeSearchContext &ctx) const
+{
+  ctx.numNodesVisited++;
+
+  // fast check if this node may contain a datum with better match error
+  if (ctx.pAlgorithm->FlatNodeMightBeCloser(v, *this, node, ctx.PruneBound(), ctx) == 0)
+  {
+    return -1;
+  }
+
+  ctx.numNodesSearched++;
+
+  const Node &n = Nodes[node];
+  if (n.More < 0)
+  { // a leaf node => look at each datum in the node
+    return FindClosestLeafDatum(node, v, closestPoint, ctx);
+  }
+
+  // not a terminal node => extend search to both child nodes
+  int ClosestLEq = FindClosestDatum(node + 1, v, closestPoint, ctx);
+  int ClosestMore = FindClosestDatum(n.More, v, closestPoint, ctx);
+  return (ClosestMore < 0) ? ClosestLEq : ClosestMore;
+}
+
+int PDTreeFlat::FindClosestLeafDatum(
+  int node,
+  const vct3 &v,
+  vct3 &closestPoint,
+  PDTreeSearchContext &ctx) const
+{
+  const Node &n = Nodes[node];
+  ctx.numDatumsTested += n.NData;
+  return ctx.pAlgorithm->FindClosestLeafDatum(
+    v, &DataIndices[n.DataBegin], n.DataBegin, n.NData, closestPoint, ctx);
+}
+
+// Search the leaf node of the previous match, then the sibling subtree of
+//  each node on the path up to the root
+//  (same search order as PDTreeBase::FindClosestDatumFromLeaf())
+int PDTreeFlat::FindClosestDatumFromLeaf(
+  int leaf,
+  const vct3 &v,
+  vct3 &closestPoint,
+  PDTreeSearchContext &ctx) const
+{
+  // path from root (path[0]) to leaf
+  int path[PDTREE_MAX_RESUME_DEPTH];
+  int n = 0;
+  for (int node = leaf; node >= 0; node = Parents[node])
+  {
+    if (n == PDTREE_MAX_RESUME_DEPTH)
+    {
+      return -2;
+    }
+    path[n++] = node;
+  }
+  std::reverse(path, path + n);
+
+  // descend the path to the leaf (no bounds check on the root)
+  PDTreeSearchContext::NodeModel models[PDTREE_MAX_RESUME_DEPTH];
+  int ClosestDatum = -1;
+  int level;
+  for (level = 1; level < n; level++)
+  {
+    ctx.numNodesVisited++;
+    if (ctx.pAlgorithm->FlatNodeMightBeCloser(v, *this, path[level], ctx.PruneBound(), ctx) == 0)
+    {
+      break;
+    }
+    ctx.numNodesSearched++;
+    ctx.SaveNodeModel(models[level]);
+  }
+  if (level == n)
+  { // the leaf passed its node test
+    ClosestDatum = FindClosestLeafDatum(leaf, v, closestPoint, ctx);
+    level = n - 1;
+  }
+
+  // search the sibling subtrees from the deepest level that was reached
+  //  (the LEq child of a node immediately follows it)
+  for (; level >= 1; level--)
+  {
+    int parent = path[level - 1];
+    int sibling = (path[level] == parent + 1) ? Nodes[parent].More : parent + 1;
+    if (level > 1)
+    {
+      ctx.RestoreNodeModel(models[level - 1]);
+    }
+    int datum = FindClosestDatum(sibling, v, closestPoint, ctx);
+    if (datum >= 0)
+    {
+      ClosestDatum = datum;
+    }
+  }
+
+  return ClosestDatum;
+}
@@ -0,0 +1,180 @@
+// ****************************************************************************
+//
+//    Copyright (c) 2014, Seth Billings, Russell Taylor, Johns Hopkins University
+//    All rights reserved.
+//
+//    Redistribution and use in source and binary forms, with or without
+//    modification, are permitted provided that the following conditions are
+//    met:
+//
+//    1. Redistributions of source code must retain the above copyright
+//    notice, this list of conditions and the following disclaimer.
+//
+//    2. Redistributions in binary form must reproduce the above copyright
+//    notice, this list of conditions and the following disclaimer in the
+//    documentation and/or other materials provided with the distribution.
+//
+//    3. Neither the name of the copyright holder nor the names of its
+//    contributors may be used to endorse or promote products derived from
+//    this software without specific prior written permission.
+//
+//    THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+//    "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+//    LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+//    A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+//    HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+//    SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+//    LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+//    DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+//    THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+//    (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+//    OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//  
+// ****************************************************************************
+#ifndef _PDTreeFlat_h
+#define _PDTreeFlat_h
+
+#include <vector>
+#include <cisstVector.h>
+
+#include "BoundingBox.h"
+#include "PDTreeNode.h"
+#include "PDTreeSearchContext.h"
+
+class PDTreeBase;     // forward decleration for mutual dependency
+
+
+class PDTreeFlat
+{
+  //
+  // This class implements a flattened (compiled) representation of
+  //  a constructed PD tree.
+  //  The nodes of the source tree are copied into a single array in
+  //  depth-first order, such that the LEq child of a node immediately
+  //  follows its parent and only the index of the More child must be
+  //  stored. The data needed to traverse the tree and test the node
+  //  bounds is kept in one array, while the node noise model bounds,
+  //  which are only referenced by some algorithms, are kept in a separate
+  //  array of the same order.
+  // The search routines of the source tree's algorithm are used to
+  //  search this tree, with a node check that reads the flattened nodes
+  //  (see algPDTree::FlatNodeMightBeCloser()).
+  // The source tree may free its standard nodes once this tree is built
+  //  (see PDTreeBase::BuildFlatTree()); they are rebuilt from this tree if
+  //  needed (see ExpandTree()).
+  //
+
+  //--- Types ---//
+
+public:
+
+  // traversal and bounds data of a node
+  struct Node
+  {
+    vctFrm3 F;            // transforms world -> local node coords
+    BoundingBox Bounds;   // bounding box for this node
+    int More;             // index of the More child (-1 if a leaf node)
+                          //  (the LEq child is always the next node)
+    int DataBegin;        // index of the first datum of this node in DataIndices
+    int NData;            // number of datums in this node
+  };
+
+#ifdef ENABLE_PDTREE_NOISE_MODEL
+  // noise model bounds of a node
+  struct NodeNoise
+  {
+    double EigMax;                    // largest eigenvector of covariances in the node
+    vct3   EigRankMin;                // min eigenvalues by rank w/in node
+    bool   bUseParentEigMaxBound;
+    bool   bUseParentEigRankMinBounds;
+  };
+#endif
+
+
+  //--- Variables ---//
+
+protected:
+
+  PDTreeBase *pTree;    // the source tree
+
+  std::vector<Node>       Nodes;
+#ifdef ENABLE_PDTREE_NOISE_MODEL
+  std::vector<NodeNoise>  NodeNoiseModels;
+#endif
+  std::vector<int>        DataIndices;  // datum indices in node order
+  std::vector<int>        Parents;      // parent of each node (-1 for the root)
+  std::vector<int>        DatumLeaves;  // leaf node holding each datum
+
+
+  //--- Methods ---//
+
+public:
+
+  // constructor
+  //  compiles the current state of the source tree
+  PDTreeFlat(PDTreeBase *pTree);
+
+  // destructor
+  ~PDTreeFlat() {}
+
+  // re-compiles the source tree
+  //  (must be called if the source tree is modified)
+  void Build();
+
+  // Returns the index for the datum in the tree that has lowest match error for
+  //  the given point and set the closest point values
+  //  (same behavior as PDTreeBase::FindClosestDatum())
+  int FindClosestDatum(
+    const vct3 &v,
+    vct3 &closestPoint,
+    int prevDatum,
+    double &matchError,
+    PDTreeSearchContext &ctx) const;
+
+  int NumNodes() const { return (int)Nodes.size(); }
+
+  const Node& GetNode(int node) const { return Nodes[node]; }
+#ifdef ENABLE_PDTREE_NOISE_MODEL
+  const NodeNoise& GetNodeNoise(int node) const { return NodeNoiseModels[node]; }
+#endif
+
+  // Return the global datum index of the ith datum in this node
+  int Datum(int node, int i) const
+  {
+    assert(i >= 0 && i < Nodes[node].NData);
+    return DataIndices[Nodes[node].DataBegin + i];
+  }
+
+  // parent of a node (-1 for the root)
+  int Parent(int node) const { return Parents[node]; }
+
+  // leaf node reached by dropping down the tree from the root to the
+  //  given point (see PDTreeBase::FastInitializeProximalDatum())
+  int ProximalLeaf(const vct3 &v) const;
+
+  // refits the node bounds to the current datum positions
+  //  (see PDTreeBase::RefitBounds(); used when the source tree holds
+  //   only the flattened nodes)
+  int RefitBounds(const vctDynamicVector<char> *pMoved, double margin);
+
+  // rebuilds the standard nodes of the source tree from this tree
+  //  (the nodes point into the data index array of the source tree)
+  PDTreeNode* ExpandTree() const;
+
+  // memory used by the node arrays (in bytes)
+  size_t NodeMemory() const;
+
+protected:
+
+  int   FlattenSubtree(PDTreeNode *pNode, int parent);
+  PDTreeNode* ExpandSubtree(int node, PDTreeNode *pParent) const;
+  int   FindClosestDatum(int node, const vct3 &v, vct3 &closestPoint,
+                         PDTreeSearchContext &ctx) const;
+  int   FindClosestLeafDatum(int node, const vct3 &v, vct3 &closestPoint,
+                             PDTreeSearchContext &ctx) const;
+  // (see PDTreeBase::FindClosestDatumFromLeaf())
+  int   FindClosestDatumFromLeaf(int leaf, const vct3 &v, vct3 &closestPoint,
+                                 PDTreeSearchContext &ctx) const;
+};
+
+#endif
@@ -41,8 +41,11 @@
 #include "PDTreeNode.h"
 #include "PDTreeBase.h"
 #include "algPDTree.h"
+#include "PDTreeSearchContext.h"
 #include "utilities.h"
 
+#define ENABLE_PARALLELIZATION
+
 PDTreeNode::PDTreeNode(
   int* pDataIndexArray,
   int numIndexes,
@@ -90,7 +93,7 @@ PDTreeNode::PDTreeNode(
   {
     // We must call the enlarge bounds function from the tree where
     //  the datum type is known.
-    pMyTree->EnlargeBounds(F, Datum(i), Bounds);
+    pMyTree->ConstructEnlargeBounds(F, Datum(i), Bounds);
   }
 }
 
@@ -171,7 +174,7 @@ vctFrm3 PDTreeNode::ComputeCovFrame(int i0, int i1)
 
 void PDTreeNode::AccumulateCentroid(int datum, vct3 &sum) const
 {
-  sum += pMyTree->DatumSortPoint(datum);
+  sum += pMyTree->ConstructSortPoint(datum);
 }
 
 // NOTE: providing the M argument is not important for the calling function,
@@ -179,8 +182,8 @@ void PDTreeNode::AccumulateCentroid(int datum, vct3 &sum) const
 //       have to be re-allocated N times
 void PDTreeNode::AccumulateVariances(int datum, const vct3 &mean, vctDouble3x3 &C) const
 {
-  static vctDouble3x3 M;
-  vct3 d = pMyTree->DatumSortPoint(datum) - mean;
+  vctDouble3x3 M;
+  vct3 d = pMyTree->ConstructSortPoint(datum) - mean;
   M.OuterProductOf(d, d);
   C += M;
 }
@@ -189,17 +192,15 @@ void PDTreeNode::AccumulateVariances(int datum, const vct3 &mean, vctDouble3x3 &
 int PDTreeNode::SortNodeForSplit()
 {
   int top = NData;
-  static int callNumber = 0;
-  callNumber++;
   vct3 Ck; vct3 Ct;
   vct3 r = F.Rotation().Row(0);
   double px = F.Translation()[0];
   for (int k = 0; k < top; k++) {
-    Ck = pMyTree->DatumSortPoint(Datum(k)); // 3D coordinate of datum in global coord system
+    Ck = pMyTree->ConstructSortPoint(Datum(k)); // 3D coordinate of datum in global coord system
     double kx = r*Ck + px;  // compute the x coordinate in local coord system
     if (kx > 0) { // this one needs to go to the end of the line
       while ((--top) > k) {
-        Ct = pMyTree->DatumSortPoint(Datum(top));
+        Ct = pMyTree->ConstructSortPoint(Datum(top));
         double tx = r*Ct + px;
         if (tx <= 0) {
           int Temp = Datum(k);
@@ -226,13 +227,33 @@ PDTreeNode* PDTreeNode::GetChildSplitNode(const vct3 &datumPos)
 // returns tree depth
 int PDTreeNode::ConstructSubtree(int CountThresh, double DiagThresh) {
 
+  if (!SplitNode(CountThresh, DiagThresh))
+  { // leaf node
+    return myDepth;
+  }
+
+  int depthL, depthR;
+  depthL = pLEq->ConstructSubtree(CountThresh, DiagThresh);
+  depthR = pMore->ConstructSubtree(CountThresh, DiagThresh);
+
+  this->myDepth = (depthL > depthR ? depthL : depthR) + 1;
+  return myDepth;
+}
+
+// creates the two child nodes of this node, leaving the subtrees of the
+//  children unconstructed; returns false if this is a leaf node
+//  (in which case the node depth is set to zero)
+// NOTE: the children use disjoint ranges of the data index array, so their
+//       subtrees may be constructed concurrently
+bool PDTreeNode::SplitNode(int CountThresh, double DiagThresh) {
+
   if (NumData() < CountThresh || Bounds.DiagonalLength() < DiagThresh)
   { // leaf node
 #ifdef DEBUG_PD_TREE
     fprintf(MyTree->debugFile, "Leaf Node: Ndata=%d\tDiagLen=%f\n", NumData(), Bounds.DiagonalLength());
 #endif
     myDepth = 0;
-    return myDepth;
+    return false;
   }
 
   int topLEq = SortNodeForSplit();
@@ -251,7 +272,7 @@ int PDTreeNode::ConstructSubtree(int CountThresh, double DiagThresh) {
 #endif
 
     myDepth = 0;  // stop here and do not split any further
-    return 0;
+    return false;
   }
 
 #ifdef DEBUG_PD_TREE
@@ -260,14 +281,28 @@ int PDTreeNode::ConstructSubtree(int CountThresh, double DiagThresh) {
 
   assert(topLEq > 0 && topLEq < NumData());
 
-  int depthL, depthR;
   pLEq = new PDTreeNode(pDataIndices, topLEq, pMyTree, this);
-  pMyTree->NNodes++;
-  depthL = pLEq->ConstructSubtree(CountThresh, DiagThresh);
-
   pMore = new PDTreeNode(&pDataIndices[topLEq], NumData() - topLEq, pMyTree, this);
-  pMyTree->NNodes++;
-  depthR = pMore->ConstructSubtree(CountThresh, DiagThresh);
+#ifdef ENABLE_PARALLELIZATION
+#pragma omp atomic
+#endif
+  pMyTree->NNodes += 2;
+
+  return true;
+}
+
+// sets the depth of the nodes above the subtrees that were constructed
+//  separately (see PDTreeBase::ConstructTree()); returns tree depth
+int PDTreeNode::CompleteUpperSubtree(int SubtreeThresh) {
+
+  if (NumData() < SubtreeThresh || IsTerminalNode())
+  { // depth already set by the subtree construction
+    return myDepth;
+  }
+
+  int depthL, depthR;
+  depthL = pLEq->CompleteUpperSubtree(SubtreeThresh);
+  depthR = pMore->CompleteUpperSubtree(SubtreeThresh);
 
   this->myDepth = (depthL > depthR ? depthL : depthR) + 1;
   return myDepth;
@@ -280,44 +315,23 @@ int PDTreeNode::ConstructSubtree(int CountThresh, double DiagThresh) {
 int PDTreeNode::FindClosestDatum(
   const vct3 &v,
   vct3 &closestPoint,
-  double &ErrorBound,
-  unsigned int &numNodesVisited,
-  unsigned int &numNodesSearched)
+  PDTreeSearchContext &ctx)
 {
-  numNodesVisited++;
+  ctx.numNodesVisited++;
 
   // fast check if this node may contain a datum with better match error
-  if (pMyTree->pAlgorithm->NodeMightBeCloser(v, this, ErrorBound) == 0)
+  if (ctx.pAlgorithm->NodeMightBeCloser(v, this, ctx.PruneBound(), ctx) == 0)
   {
     return -1;
   }
 
   // Search points w/in this node
   int ClosestDatum = -1;
-  numNodesSearched++;
+  ctx.numNodesSearched++;
 
   if (IsTerminalNode())
   { // a leaf node => look at each datum in the node
-    for (int i = 0; i < NData; i++)
-    {
-      int datum = Datum(i);
-
-      // fast check if this datum might have a lower match error than error bound
-      if (pMyTree->pAlgorithm->DatumMightBeCloser(v, datum, ErrorBound))
-      { // a candidate
-        vct3 candidate;
-        // close check if this datum has a lower match error than error bound
-        double err = pMyTree->pAlgorithm->FindClosestPointOnDatum(v, candidate, datum);
-        if (err < ErrorBound)
-        {
-          closestPoint = candidate;
-          ErrorBound = err;
-          ClosestDatum = datum;
-        }
-      }
-    }
-
-    return ClosestDatum;
+    return FindClosestLeafDatum(v, closestPoint, ctx);
   }
 
   // here if not a terminal node =>
@@ -329,12 +343,22 @@ int PDTreeNode::FindClosestDatum(
   //  before 2nd call to More. If More returns (-1), then More had
   //  nothing better than LEq and the resulting datum should be
   //  the return value of LEq (whether that is -1 or a closer datum index)
-  ClosestLEq = pLEq->FindClosestDatum(v, closestPoint, ErrorBound, numNodesVisited, numNodesSearched);
-  ClosestMore = pMore->FindClosestDatum(v, closestPoint, ErrorBound, numNodesVisited, numNodesSearched);
+  ClosestLEq = pLEq->FindClosestDatum(v, closestPoint, ctx);
+  ClosestMore = pMore->FindClosestDatum(v, closestPoint, ctx);
   ClosestDatum = (ClosestMore < 0) ? ClosestLEq : ClosestMore;
   return ClosestDatum;
 }
 
+int PDTreeNode::FindClosestLeafDatum(
+  const vct3 &v,
+  vct3 &closestPoint,
+  PDTreeSearchContext &ctx)
+{
+  ctx.numDatumsTested += NData;
+  return ctx.pAlgorithm->FindClosestLeafDatum(
+    v, pDataIndices, (int)(pDataIndices - pMyTree->DataIndices), NData, closestPoint, ctx);
+}
+
 // find terminal node holding the specified datum
 int PDTreeNode::FindTerminalNode(int datum, PDTreeNode **termNode)
 {
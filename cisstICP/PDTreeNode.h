@@ -43,6 +43,7 @@
 
 class PDTreeBase;       // forward declerations for mutual dependency
 class algPDTree;        //  ''
+class PDTreeSearchContext;
 
 // if the PDTree noise model is not needed then PDTree construction
 // time may be reduced by disabling it
@@ -124,12 +125,18 @@ public:
   //  If a lower match error is found, set the new closest point, update error
   //  bound, and return the global datum index of the closest datum.
   //  Otherwise, return -1.
+  //  (the error bound and node counts are held in the search context)
   int FindClosestDatum(
     const vct3 &v,
     vct3 &closestPoint,
-    double &ErrorBound,
-    unsigned int &numNodesVisited,
-    unsigned int &numNodesSearched);
+    PDTreeSearchContext &ctx);
+
+  // Check each datum of this leaf node against the error bound
+  //  (no node bounds check; same return as FindClosestDatum())
+  int FindClosestLeafDatum(
+    const vct3 &v,
+    vct3 &closestPoint,
+    PDTreeSearchContext &ctx);
 
   int   NumData() const { return NData; };
   int   IsTerminalNode() const { return pLEq == NULL; };
@@ -137,6 +144,8 @@ public:
   int     SortNodeForSplit();
   vctFrm3 ComputeCovFrame(int i0, int i1);
   int     ConstructSubtree(int CountThresh, double DiagThresh);
+  bool    SplitNode(int CountThresh, double DiagThresh);
+  int     CompleteUpperSubtree(int SubtreeThresh);
 
   void  AccumulateCentroid(int datum, vct3 &sum) const;
   void  AccumulateVariances(int datum, const vct3 &mean, vctDouble3x3 &C) const;
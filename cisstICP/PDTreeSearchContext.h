@@ -0,0 +1,344 @@
+// ****************************************************************************
+//
+//    Copyright (c) 2014, Seth Billings, Russell Taylor, Johns Hopkins University
+//    All rights reserved.
+//
+//    Redistribution and use in source and binary forms, with or without
+//    modification, are permitted provided that the following conditions are
+//    met:
+//
+//    1. Redistributions of source code must retain the above copyright
+//    notice, this list of conditions and the following disclaimer.
+//
+//    2. Redistributions in binary form must reproduce the above copyright
+//    notice, this list of conditions and the following disclaimer in the
+//    documentation and/or other materials provided with the distribution.
+//
+//    3. Neither the name of the copyright holder nor the names of its
+//    contributors may be used to endorse or promote products derived from
+//    this software without specific prior written permission.
+//
+//    THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+//    "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+//    LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+//    A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+//    HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+//    SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+//    LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+//    DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+//    THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+//    (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+//    OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//  
+// ****************************************************************************
+#ifndef _PDTreeSearchContext_h
+#define _PDTreeSearchContext_h
+
+#include <limits>
+#include <cisstVector.h>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+// max depth of the tree path stored by a search resumed from the leaf
+//  node of a previous match (deeper trees are searched from the root)
+#define PDTREE_MAX_RESUME_DEPTH 64
+
+class algPDTree;  // forward decleration
+
+class PDTreeSearchContext
+{
+  //
+  // This class holds the state of a single PD tree query.
+  //  An instance is created by the caller for each search and passed
+  //  down through the tree and into the search algorithm, so that the
+  //  tree and the algorithm objects remain read-only during a search.
+  //  This allows multiple threads to search the same tree concurrently,
+  //  each with their own context.
+  //
+
+  //--- Variables ---//
+
+public:
+
+  // search bound and statistics
+  double ErrorBound;              // match error of the best datum found so far
+  unsigned int numNodesVisited;   // nodes tested against the error bound
+  unsigned int numNodesSearched;  // nodes whose bounds passed the test
+  unsigned int numDatumsTested;   // datums tested against the error bound
+
+  // index of the sample point being searched (-1 if not a sample search)
+  int sampleIndex;
+
+  // algorithm evaluating the node and datum tests of this query
+  //  (NULL for the search algorithm registered with the tree; several
+  //   algorithm instances may thus search the same tree concurrently)
+  algPDTree *pAlgorithm;
+
+  // Runner-up bound
+  //  nodes and datums are pruned against ErrorBound + SearchMargin, such
+  //  that once the search ends, every datum other than the match has an error
+  //  of at least min(RunnerUpError, ErrorBound + SearchMargin)
+  //  (SearchMargin is 0 for a standard search)
+  double SearchMargin;
+  double RunnerUpError; // lowest error found among the datums not matched
+  int SeedDatum;        // datum whose error set the initial error bound
+
+  // cap on the initial error bound
+  //  datums having a match error above this are not searched for; if no
+  //  datum has a lower error, the previous datum is returned as the match
+  //  together with its match error (>= ErrorCap)
+  double ErrorCap;
+
+  // Sample noise model
+  //  these are set once for each sample point prior to searching the tree
+  //  (by the pre-match function of the algorithm) and used for every node
+  //  and datum test thereafter
+  vct3x3 sampleXfm_M;   // covariance of transformed sample point (including any match uncertainty)
+  vct3   sample_M_Eig;  // eigenvalues of sampleXfm_M in order of decreasing magnitude
+
+  // Node noise model
+  //  these are recomputed by the algorithm as the search descends the tree;
+  //  nodes that share the bound of their parent reuse the values computed
+  //  for the parent
+  vct3x3 M;       // effective measurement error covariance for a node & sample pair
+  vct3x3 N;       // decomposition of inv(M) = N'N
+  double Dmin;    // inverse sqrt of largest eigenvalue of M
+                  //  (or the sqrt of the smallest eigenvalue of inv(M))
+  double MinLogM; // lower bound on the log component of error for this node
+
+  // copy of the node noise model, used to restore the values computed for
+  //  a node when a search returns to that node's children
+  struct NodeModel
+  {
+    vct3x3 M, N;
+    double Dmin, MinLogM;
+  };
+
+
+  //--- Methods ---//
+
+public:
+
+  // constructor
+  PDTreeSearchContext()
+    : ErrorBound(0.0),
+    numNodesVisited(0),
+    numNodesSearched(0),
+    numDatumsTested(0),
+    sampleIndex(-1),
+    pAlgorithm(NULL),
+    SearchMargin(0.0),
+    RunnerUpError(0.0),
+    SeedDatum(-1),
+    ErrorCap(std::numeric_limits<double>::max()),
+    Dmin(0.0),
+    MinLogM(0.0)
+  {}
+
+  // reset the search statistics prior to a new query
+  void ResetStats()
+  {
+    numNodesVisited = 0;
+    numNodesSearched = 0;
+    numDatumsTested = 0;
+  }
+
+  // bound against which nodes and datums are pruned
+  double PruneBound() const { return ErrorBound + SearchMargin; }
+
+  // set the initial error bound from the error of a datum
+  void SeedErrorBound(int datum, double error)
+  {
+    ErrorBound = error < ErrorCap ? error : ErrorCap;
+    SeedDatum = datum;
+    RunnerUpError = std::numeric_limits<double>::max();
+  }
+
+  // update the bounds for the error of a datum that is closely searched
+  //  (returns true if this datum is the new best match)
+  bool UpdateErrorBound(int datum, double error)
+  {
+    if (error < ErrorBound)
+    {
+      RunnerUpError = ErrorBound;
+      ErrorBound = error;
+      return true;
+    }
+    // the seed datum is searched again in its leaf
+    if (error < RunnerUpError && datum != SeedDatum)
+    {
+      RunnerUpError = error;
+    }
+    return false;
+  }
+
+  void SaveNodeModel(NodeModel &model) const
+  {
+    model.M = M;
+    model.N = N;
+    model.Dmin = Dmin;
+    model.MinLogM = MinLogM;
+  }
+  void RestoreNodeModel(const NodeModel &model)
+  {
+    M = model.M;
+    N = model.N;
+    Dmin = model.Dmin;
+    MinLogM = model.MinLogM;
+  }
+};
+
+
+class PDTreeSearchStats
+{
+  //
+  // This class holds the node statistics of a batch of PD tree queries.
+  //  Each thread of a batch search accumulates its own statistics, which
+  //  are then merged once the thread has completed its share of the batch.
+  //
+
+  //--- Variables ---//
+
+public:
+
+  unsigned int numSearches;
+  unsigned int minNodesSearched;
+  unsigned int maxNodesSearched;
+  double avgNodesSearched;
+  double sumNodesSearched;
+  double sumNodesVisited;
+  double sumDatumsTested;
+
+
+  //--- Methods ---//
+
+public:
+
+  // constructor
+  PDTreeSearchStats()
+  {
+    Reset();
+  }
+
+  void Reset()
+  {
+    numSearches = 0;
+    minNodesSearched = 0;
+    maxNodesSearched = 0;
+    avgNodesSearched = 0.0;
+    sumNodesSearched = 0.0;
+    sumNodesVisited = 0.0;
+    sumDatumsTested = 0.0;
+  }
+
+  // add the statistics of a single query
+  void Add(const PDTreeSearchContext &ctx)
+  {
+    Add(ctx.numNodesSearched, ctx.numNodesVisited, ctx.numDatumsTested);
+  }
+  void Add(unsigned int nodesSearched,
+    unsigned int nodesVisited = 0, unsigned int datumsTested = 0)
+  {
+    if (numSearches == 0 || nodesSearched < minNodesSearched)
+      minNodesSearched = nodesSearched;
+    if (numSearches == 0 || nodesSearched > maxNodesSearched)
+      maxNodesSearched = nodesSearched;
+    sumNodesSearched += nodesSearched;
+    sumNodesVisited += nodesVisited;
+    sumDatumsTested += datumsTested;
+    numSearches++;
+    avgNodesSearched = sumNodesSearched / numSearches;
+  }
+
+  // merge the statistics of another batch into this one
+  void Merge(const PDTreeSearchStats &stats)
+  {
+    if (stats.numSearches == 0)
+      return;
+    if (numSearches == 0 || stats.minNodesSearched < minNodesSearched)
+      minNodesSearched = stats.minNodesSearched;
+    if (numSearches == 0 || stats.maxNodesSearched > maxNodesSearched)
+      maxNodesSearched = stats.maxNodesSearched;
+    sumNodesSearched += stats.sumNodesSearched;
+    sumNodesVisited += stats.sumNodesVisited;
+    sumDatumsTested += stats.sumDatumsTested;
+    numSearches += stats.numSearches;
+    avgNodesSearched = sumNodesSearched / numSearches;
+  }
+};
+
+
+class PDTreeMatchCallback
+{
+  //
+  // Per-sample hooks of a batch PD tree search
+  //  (see PDTreeBase::FindClosestDatums())
+  //  These are called for each sample from whichever thread searches
+  //  that sample and must only modify state belonging to that sample
+  //  or to the search context.
+  //
+
+public:
+
+  virtual ~PDTreeMatchCallback() {}
+
+  // called prior to searching for a sample; sets any sample-specific
+  //  values of the search context
+  virtual void  SamplePreMatch(unsigned int sampleIndex, PDTreeSearchContext &ctx) {};
+
+  // called once the match for a sample is found
+  virtual void  SamplePostMatch(unsigned int sampleIndex, PDTreeSearchContext &ctx) {};
+};
+
+
+// index of the calling thread within a batch search
+//  (used to address per-thread search state; 0 for a serial search)
+inline int PDTreeThreadIndex()
+{
+#ifdef _OPENMP
+  return omp_get_thread_num();
+#else
+  return 0;
+#endif
+}
+
+
+class DirPDTreeMatchCallback
+{
+  //
+  // Per-sample hooks of a batch oriented PD tree search
+  //  (see DirPDTreeBase::FindClosestDatums() and
+  //   DirPDTree2DBase::FindClosestDatums())
+  //  The oriented search algorithms keep the state of the sample
+  //  being searched in the algorithm object, so these hooks take no
+  //  search context. An algorithm that keeps this state per search
+  //  thread (indexed by PDTreeThreadIndex()) may have the batch searched
+  //  in parallel; otherwise the batch is searched serially.
+  //
+
+public:
+
+  virtual ~DirPDTreeMatchCallback() {}
+
+  // true if the hooks and the search algorithm of the tree write only
+  //  per-sample or per-thread state, such that the samples of a batch
+  //  may be searched concurrently
+  virtual bool  ParallelMatchSafe() const { return false; }
+
+  // called before the batch is searched with the number of threads
+  //  that may search it (1 for a serial search)
+  virtual void  ReserveSearchThreads(int numThreads) {};
+
+  virtual void  SamplePreMatch(unsigned int sampleIndex) {};
+  virtual void  SamplePostMatch(unsigned int sampleIndex) {};
+
+  // cap on the initial error bound for this sample
+  //  (see PDTreeSearchContext::ErrorCap; called after the pre-match hook)
+  virtual double SampleMatchErrorCap(unsigned int sampleIndex)
+  {
+    return std::numeric_limits<double>::max();
+  }
+};
+
+#endif
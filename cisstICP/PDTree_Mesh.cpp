@@ -34,10 +34,11 @@
 // ****************************************************************************
 
 #include "PDTree_Mesh.h"
+#include "PDTreeFile.h"
 
 
 PDTree_Mesh::PDTree_Mesh(cisstMesh &mesh, int countThresh, double diagThresh)
-	: MeshP(&mesh), Bounds()
+	: MeshP(&mesh), Bounds(), pTCPS(NULL)
 {
   NData = MeshP->NumTriangles();
   DataIndices = new int[NData];
@@ -45,21 +46,72 @@ PDTree_Mesh::PDTree_Mesh(cisstMesh &mesh, int countThresh, double diagThresh)
   {
     DataIndices[i] = i;
   }
-  Top = new PDTreeNode(DataIndices, NData, this, NULL);
-  NNodes = 0; NNodes++;
-  treeDepth = Top->ConstructSubtree(countThresh, diagThresh);
+  ConstructTree(countThresh, diagThresh);
 
 #ifdef DEBUG_PD_TREE
   fprintf(debugFile, "Mesh Cov Tree built: NNodes=%d  NData=%d  TreeDepth=%d\n", NumNodes(), NumData(), TreeDepth());
 #endif
 }
 
+PDTree_Mesh::PDTree_Mesh(cisstMesh &mesh, const std::string &treeFile,
+                         int countThresh, double diagThresh)
+  : MeshP(&mesh), Bounds(), pTCPS(NULL)
+{
+  NData = MeshP->NumTriangles();
+  DataIndices = new int[NData];
+  constructCountThresh = countThresh;   // for RebuildTree()
+  constructDiagThresh = diagThresh;
+
+  if (Load(treeFile))
+  {
+    std::cout << "WARNING: failed to load PD tree file; constructing the tree instead" << std::endl;
+    if (Top) { delete Top; Top = NULL; }
+    for (int i = 0; i < NData; i++)
+    {
+      DataIndices[i] = i;
+    }
+    ConstructTree(countThresh, diagThresh);
+  }
+}
+
 PDTree_Mesh::~PDTree_Mesh()
 {
+  if (pTCPS) delete pTCPS;
   if (Top) delete Top;
   if (DataIndices) delete DataIndices;
 }
 
+void PDTree_Mesh::SetCompactTCPS(bool bLazy)
+{
+  if (!pTCPS)
+  {
+    pTCPS = new TriangleClosestPointSolver();
+  }
+  pTCPS->initCompact(MeshP->vertices, MeshP->faces, bLazy);
+}
+
+TriangleClosestPointSolver* PDTree_Mesh::SearchTCPS()
+{
+  if (!pTCPS)
+  {
+    pTCPS = new TriangleClosestPointSolver(*MeshP);
+  }
+  return pTCPS;
+}
+
+void PDTree_Mesh::ComputeLeafCoords()
+{
+  SearchTCPS()->SetLeafOrder(DataIndices, NData);
+}
+
+void PDTree_Mesh::DatumOrderChanged()
+{
+  if (pTCPS && pTCPS->LeafOrderSize() > 0)
+  {
+    ComputeLeafCoords();
+  }
+}
+
 vct3 PDTree_Mesh::DatumSortPoint(int datum) const
 { 
   //// use vertex 0 as the sort point
@@ -80,6 +132,44 @@ void PDTree_Mesh::EnlargeBounds(const vctFrm3& F, int datum, BoundingBox& BB) co
   BB.Include(F*v3);
 }
 
+void PDTree_Mesh::DatumBoundPoints(int datum, vct3 *pts) const
+{
+  MeshP->FaceCoords(datum, pts[0], pts[1], pts[2]);
+}
+
+void PDTree_Mesh::SaveDatumData(PDTreeFileWriter &file) const
+{
+  if (pTCPS)
+  {
+    pTCPS->Save(file);
+  }
+  else
+  {
+    TriangleClosestPointSolver TCPS(*MeshP);
+    TCPS.Save(file);
+  }
+}
+
+int PDTree_Mesh::LoadDatumData(const PDTreeFileReader &file)
+{
+  // load into the current solver if any, since it may be shared by
+  //  search algorithms (the solver is unchanged if the load fails)
+  TriangleClosestPointSolver *pLoaded = pTCPS ? pTCPS : new TriangleClosestPointSolver();
+  int rv = pLoaded->Load(file, *MeshP);
+  if (rv != 0)
+  { // no solver data in file, or not valid for this mesh
+    if (pLoaded != pTCPS) delete pLoaded;
+    return rv < 0 ? -1 : 0;
+  }
+  pTCPS = pLoaded;
+  return 0;
+}
+
+unsigned long long PDTree_Mesh::DatumFingerprint() const
+{
+  return TriangleClosestPointSolver::MeshFingerprint(*MeshP);
+}
+
 void PDTree_Mesh::EnlargeBounds(const vctFrm3& F, PDTreeNode *pNode) const
 {
 	if (!pNode->IsTerminalNode())
@@ -36,6 +36,7 @@
 
 #include "PDTreeBase.h"
 #include "cisstMesh.h"
+#include "TriangleClosestPointSolver.h"
 #include <limits>
 
 class PDTree_Mesh : public PDTreeBase
@@ -52,6 +53,14 @@ public:
   cisstMesh *MeshP;
   BoundingBox Bounds;
 
+protected:
+
+  // triangle solver precomputations loaded with the tree, set by
+  //  SetCompactTCPS() or computed by SearchTCPS() (NULL if none of these)
+  //  The solver is shared by the search algorithms of the tree and also
+  //  holds the triangle coordinates in leaf order (see ComputeLeafCoords()).
+  TriangleClosestPointSolver *pTCPS;
+
   //--- Methods ---//
 
 public:
@@ -63,9 +72,41 @@ public:
   //  diagThresh - min physical size to subdivide a node
 	PDTree_Mesh(cisstMesh &mesh, int nThresh, double diagThresh);
 
+  // constructor
+  //  loads the tree from a file previously saved for this mesh; the tree
+  //  is constructed instead if the file cannot be loaded
+  //  treeFile   - PD tree file (see PDTreeBase::Save())
+  PDTree_Mesh(cisstMesh &mesh, const std::string &treeFile, int nThresh, double diagThresh);
+
   // destructor
   virtual ~PDTree_Mesh();
 
+  // triangle solver precomputations loaded with the tree, for use
+  //  by the search algorithms (NULL if not available)
+  const TriangleClosestPointSolver* PrecomputedTCPS() const { return pTCPS; }
+
+  // triangle solver shared by the search algorithms of a rigid target, so
+  //  that instances searching the tree concurrently (e.g. the starts of a
+  //  multi-start registration) hold no copy of the mesh precomputations
+  //  The solver is computed from the mesh on the first call if not loaded
+  //  or set by SetCompactTCPS(); this first call is not thread safe and is
+  //  made by the algorithm constructors. The searches only read the solver
+  //  (a lazy compact solver computes its blocks safely on first use).
+  TriangleClosestPointSolver* SearchTCPS();
+
+  // use compact triangle solver precomputations for the search algorithms,
+  //  which reference the mesh rather than copying it
+  //  (see TriangleClosestPointSolver::initCompact())
+  //  The triangle coordinates in leaf order are then only computed if
+  //  ComputeLeafCoords() is called explicitly.
+  void SetCompactTCPS(bool bLazy);
+
+  // compute the triangle coordinates in the datum order of the tree for the
+  //  batched leaf search (see TriangleClosestPointSolver::SetLeafOrder());
+  //  these are then recomputed by RebuildTree()
+  void ComputeLeafCoords();
+  bool HasLeafCoords() const { return pTCPS && pTCPS->LeafOrderSize() == NData; }
+
 
   //--- Base Class Virtual Methods ---//
 
@@ -74,27 +115,35 @@ public:
   virtual void EnlargeBounds(const vctFrm3& F) const;
   virtual void EnlargeBounds(const vctFrm3& F, PDTreeNode *pNode) const;
   virtual void EnlargeBounds(const vctFrm3& F, int datum, BoundingBox& BB) const;
+  virtual int  NumDatumBoundPoints() const { return 3; }
+  virtual void DatumBoundPoints(int datum, vct3 *pts) const;
+
+protected:
+
+  virtual void SaveDatumData(PDTreeFileWriter &file) const;
+  virtual int  LoadDatumData(const PDTreeFileReader &file);
+  virtual unsigned long long DatumFingerprint() const;
+  virtual unsigned long long DatumFingerprint() const;
+  virtual void DatumOrderChanged();
+
+public:
 
 
 
   //--- Noise Model Methods ---//
 
-  vct3x3& DatumCov(int datum)       // return measurement noise model for this datum
+  void DatumCov(int datum, vct3x3 &M)       // return measurement noise model for this datum
   {
-    return MeshP->TriangleCov[datum];
+    MeshP->TriangleCovariance(datum, M);
   }
-  vct3x3* DatumCovPtr(int datum)    // return measurement noise model for this datum
+  void AddDatumCov(int datum, vct3x3 &M)    // add measurement noise model for this datum
   {
-    return &(MeshP->TriangleCov[datum]);
+    MeshP->AddTriangleCovariance(datum, M);
   }
 
-  vct3& DatumCovEig(int datum)         // return measurement noise model for this datum
-  {
-    return MeshP->TriangleCovEig[datum];
-  }
-  vct3* DatumCovEigPtr(int datum)      // return measurement noise model for this datum
+  vct3 DatumCovEig(int datum)         // return measurement noise model eigenvalues for this datum
   {
-    return &(MeshP->TriangleCovEig[datum]);
+    return MeshP->TriangleCovarianceEig(datum);
   }
 
 };
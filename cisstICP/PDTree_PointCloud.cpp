@@ -53,9 +53,7 @@ pointCloud(pointCloud)
   {
     DataIndices[i] = i;
   }
-  Top = new PDTreeNode(DataIndices, NData, this, NULL);
-  NNodes = 0; NNodes++;
-  treeDepth = Top->ConstructSubtree(nThresh, diagThresh);
+  ConstructTree(nThresh, diagThresh);
 
 #ifdef DEBUG_PD_TREE
   fprintf(debugFile, "Point Cloud Cov Tree built: NNodes=%d  NData=%d  TreeDepth=%d\n", NumNodes(), NumData(), TreeDepth());
@@ -83,3 +81,8 @@ void PDTree_PointCloud::EnlargeBounds(const vctFrm3& F, int datum, BoundingBox&
 {
   BB.Include(F*pointCloud.points.Element(datum));
 }
+
+void PDTree_PointCloud::DatumBoundPoints(int datum, vct3 *pts) const
+{
+  pts[0] = pointCloud.points.Element(datum);
+}
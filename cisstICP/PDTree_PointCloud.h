@@ -78,28 +78,26 @@ public:
 
   virtual vct3 DatumSortPoint(int datum) const;  // return sort point of this datum
   virtual void EnlargeBounds(const vctFrm3& F, int datum, BoundingBox& BB) const;
+  virtual int  NumDatumBoundPoints() const { return 1; }
+  virtual void DatumBoundPoints(int datum, vct3 *pts) const;
 
 
 #ifdef ENABLE_PDTREE_NOISE_MODEL
 
   //--- Noise Model Methods ---//
 
-  vct3x3& DatumCov(int datum)         // return measurement noise model for this datum
+  void DatumCov(int datum, vct3x3 &M)       // return measurement noise model for this datum
   {
-    return pointCloud.pointCov.Element(datum);
+    pointCloud.PointCovariance(datum, M);
   }
-  vct3x3* DatumCovPtr(int datum)      // return measurement noise model for this datum
+  void AddDatumCov(int datum, vct3x3 &M)    // add measurement noise model for this datum
   {
-    return &(pointCloud.pointCov.Element(datum));
+    pointCloud.AddPointCovariance(datum, M);
   }
 
-  vct3& DatumCovEig(int datum)         // return measurement noise model for this datum
+  vct3 DatumCovEig(int datum)         // return measurement noise model eigenvalues for this datum
   {
-    return pointCloud.pointCovEig.Element(datum);
-  }
-  vct3* DatumCovEigPtr(int datum)      // return measurement noise model for this datum
-  {
-    return &(pointCloud.pointCovEig.Element(datum));
+    return pointCloud.PointCovarianceEig(datum);
   }
 
 #endif // ENABLE_PDTREE_NOISE_MODEL
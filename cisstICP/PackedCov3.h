@@ -0,0 +1,128 @@
+// ****************************************************************************
+//
+//    Copyright (c) 2014, Seth Billings, Russell Taylor, Johns Hopkins University
+//    All rights reserved.
+//
+//    Redistribution and use in source and binary forms, with or without
+//    modification, are permitted provided that the following conditions are
+//    met:
+//
+//    1. Redistributions of source code must retain the above copyright
+//    notice, this list of conditions and the following disclaimer.
+//
+//    2. Redistributions in binary form must reproduce the above copyright
+//    notice, this list of conditions and the following disclaimer in the
+//    documentation and/or other materials provided with the distribution.
+//
+//    3. Neither the name of the copyright holder nor the names of its
+//    contributors may be used to endorse or promote products derived from
+//    this software without specific prior written permission.
+//
+//    THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+//    "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+//    LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+//    A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+//    HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+//    SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+//    LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+//    DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+//    THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+//    (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+//    OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//  
+// ****************************************************************************
+#ifndef _PackedCov3_h
+#define _PackedCov3_h
+
+#include <cisstVector.h>
+
+// Compact storage of symmetric 3x3 noise covariances
+//
+//  COV_STORAGE_FULL        vct3x3 per datum (9 doubles)
+//  COV_STORAGE_PACKED      upper triangle per datum (6 doubles, see PackedCov3)
+//  COV_STORAGE_PARAMETRIC  noise model having one variance along the datum
+//                          normal and another in the plane orthogonal to it;
+//                          only the variances are stored, the normal is that
+//                          already held for the datum (e.g. the face normal)
+//
+enum CovStorageMode
+{
+  COV_STORAGE_FULL,
+  COV_STORAGE_PACKED,
+  COV_STORAGE_PARAMETRIC
+};
+
+// symmetric 3x3 matrix stored as its upper triangle
+class PackedCov3
+{
+public:
+
+  double xx, xy, xz, yy, yz, zz;
+
+  PackedCov3() {}
+  explicit PackedCov3(const vct3x3 &M) { Pack(M); }
+
+  // store the upper triangle of M
+  inline void Pack(const vct3x3 &M)
+  {
+    xx = M.Element(0, 0); xy = M.Element(0, 1); xz = M.Element(0, 2);
+    yy = M.Element(1, 1); yz = M.Element(1, 2);
+    zz = M.Element(2, 2);
+  }
+
+  // M = this
+  inline void Unpack(vct3x3 &M) const
+  {
+    M.Element(0, 0) = xx; M.Element(0, 1) = xy; M.Element(0, 2) = xz;
+    M.Element(1, 0) = xy; M.Element(1, 1) = yy; M.Element(1, 2) = yz;
+    M.Element(2, 0) = xz; M.Element(2, 1) = yz; M.Element(2, 2) = zz;
+  }
+
+  // M += this
+  inline void AddTo(vct3x3 &M) const
+  {
+    M.Element(0, 0) += xx; M.Element(0, 1) += xy; M.Element(0, 2) += xz;
+    M.Element(1, 0) += xy; M.Element(1, 1) += yy; M.Element(1, 2) += yz;
+    M.Element(2, 0) += xz; M.Element(2, 1) += yz; M.Element(2, 2) += zz;
+  }
+};
+
+
+// parametric noise model for the (unit) normal n
+//    M = normPerpVar*I + (normPrllVar - normPerpVar)*n*n'
+//  (same form and round-off as ComputePointCovariance_Batch())
+inline void UnpackParametricCov(
+  const vct3 &n, double normPrllVar, double normPerpVar, vct3x3 &M)
+{
+  double d = normPrllVar - normPerpVar;
+  M.Element(0, 0) = normPerpVar + d*(n[0] * n[0]);
+  M.Element(1, 1) = normPerpVar + d*(n[1] * n[1]);
+  M.Element(2, 2) = normPerpVar + d*(n[2] * n[2]);
+  M.Element(0, 1) = M.Element(1, 0) = d*(n[0] * n[1]);
+  M.Element(0, 2) = M.Element(2, 0) = d*(n[0] * n[2]);
+  M.Element(1, 2) = M.Element(2, 1) = d*(n[1] * n[2]);
+}
+
+// M += parametric noise model for the (unit) normal n
+inline void AddParametricCov(
+  const vct3 &n, double normPrllVar, double normPerpVar, vct3x3 &M)
+{
+  vct3x3 C;
+  UnpackParametricCov(n, normPrllVar, normPerpVar, C);
+  M.Add(C);
+}
+
+// eigenvalues of the parametric noise model (in decreasing size)
+inline vct3 ParametricCovEig(double normPrllVar, double normPerpVar)
+{
+  if (normPerpVar >= normPrllVar)
+  {
+    return vct3(normPerpVar, normPerpVar, normPrllVar);
+  }
+  else
+  {
+    return vct3(normPrllVar, normPerpVar, normPerpVar);
+  }
+}
+
+#endif
@@ -36,6 +36,57 @@
 #include "RegisterP2P.h"
 #include "utilities.h"
 
+#include <omp.h>
+
+#define ENABLE_PARALLELIZATION
+
+
+namespace {
+
+  // covariance matrix of point sets recentered about their centroids
+  //  H = Sum( Wi*(Xi - Xmean)*(Yi - Ymean)' )
+  //  accumulated without storing the recentered points, so that the
+  //  registrations below do not allocate (pW = NULL for unit weights)
+  vct3x3 RecenteredCovariance(
+    const vctDynamicVector<vct3> &X, const vctDynamicVector<vct3> &Y,
+    const vct3 &Xmean, const vct3 &Ymean,
+    const vctDoubleVec *pW)
+  {
+    unsigned int N = X.size();
+    vct3x3 H(0.0);
+    vct3x3 Htemp;
+    for (unsigned int i = 0; i < N; i++)
+    {
+      if (pW)
+        Htemp.OuterProductOf((*pW)[i] * (X[i] - Xmean), Y[i] - Ymean);
+      else
+        Htemp.OuterProductOf(X[i] - Xmean, Y[i] - Ymean);
+      H.Add(Htemp);
+    }
+    return H;
+  }
+
+  // covariance matrix of the normals  H = Sum( Wi*(Nxi*Nyi') )
+  vct3x3 NormalsCovariance(
+    const vctDynamicVector<vct3> &Nx, const vctDynamicVector<vct3> &Ny,
+    const vctDoubleVec *pW)
+  {
+    unsigned int N = Nx.size();
+    vct3x3 H(0.0);
+    vct3x3 Htemp;
+    for (unsigned int i = 0; i < N; i++)
+    {
+      if (pW)
+        Htemp.OuterProductOf((*pW)[i] * Nx[i], Ny[i]);
+      else
+        Htemp.OuterProductOf(Nx[i], Ny[i]);
+      H.Add(Htemp);
+    }
+    return H;
+  }
+
+}
+
 
 // Compute the least squares rigid body transform to minimize P2P distances:
 //  minimize:  Sum( ||Yi - T*Xi||^2 )
@@ -51,18 +102,11 @@ void RegisterP2P_LSQ(
   vct3 Xmean = vctCentroid(X);
   vct3 Ymean = vctCentroid(Y);
 
-  // recenter point sets about the centroids
-  vctDynamicVector<vct3> Xp(numPts);
-  vctDynamicVector<vct3> Yp(numPts);
-  for (unsigned int i = 0; i < numPts; i++)
-  {
-    Xp[i] = X[i] - Xmean;
-    Yp[i] = Y[i] - Ymean;
-  }
-
   // Rotation
-  RotateP2P_LSQ_SVD( Xp, Yp, F.Rotation() );  
-  //RotateP2P_LSQ_Quaternion(Xp, Yp, F.Rotation());
+  //  (as RotateP2P_LSQ_SVD() for the point sets recentered about the centroids)
+  vct3x3 H = RecenteredCovariance(X, Y, Xmean, Ymean, NULL);
+  F.Rotation() = SolveRotation_ArunsMethod(H);
+  //F.Rotation() = SolveRotation_HornsMethod(H);
 
   // Translation
   //  optimal translation always aligns the centroid locations:  Ymean = R*Xmean + t
@@ -93,18 +137,13 @@ void RegisterP2P_WLSQ(
   vct3 Xmean = vctWeightedMean(X, W);
   vct3 Ymean = vctWeightedMean(Y, W);
 
-  // recenter point sets about the centroids
-  vctDynamicVector<vct3> Xp(N);
-  vctDynamicVector<vct3> Yp(N);
-  for (unsigned int i = 0; i < N; i++)
-  {
-    Xp[i] = X[i] - Xmean;
-    Yp[i] = Y[i] - Ymean;
-  }
-
   // Rotation
-  //RotateP2P_WLSQ_SVD( Xp,Yp,W,F.Rotation() );
-  RotateP2P_WLSQ_Quaternion(Xp, Yp, W, F.Rotation());
+  //  (as RotateP2P_WLSQ_Quaternion() for the point sets recentered about
+  //   the centroids)
+  vct3x3 H = RecenteredCovariance(X, Y, Xmean, Ymean, &W);
+  //F.Rotation() = SolveRotation_ArunsMethod(H);
+  H.Divide(N);
+  F.Rotation() = SolveRotation_HornsMethod(H);
 
   // Translation
   //  optimal translation always aligns the centroid locations:  Ymean = R*Xmean + t
@@ -139,17 +178,12 @@ void RegisterP2P_Normals_vMFG(const vctDynamicVector<vct3> &X,
   vct3 Xmean = vctWeightedMean(X, W);
   vct3 Ymean = vctWeightedMean(Y, W);
 
-  // recenter point sets about the centroids
-  vctDynamicVector<vct3> Xp(N);
-  vctDynamicVector<vct3> Yp(N);
-  for (unsigned int i = 0; i < N; i++)
-  {
-    Xp[i] = X[i] - Xmean;
-    Yp[i] = Y[i] - Ymean;
-  }
-
   // Rotation
-  RotateP2P_Normals_vMFG_Quaternion(Xp, Yp, Nx, Ny, W, B, k, F.Rotation());
+  //  (as RotateP2P_Normals_vMFG_Quaternion() for the point sets recentered
+  //   about the centroids)
+  vct3x3 H = RecenteredCovariance(X, Y, Xmean, Ymean, &W).Multiply(2.0*B)
+    + NormalsCovariance(Nx, Ny, &W).Multiply(k);
+  F.Rotation() = SolveRotation_HornsMethod(H);
 
   // Translation
   //  optimal translation always aligns the centroid locations:  Ymean = R*Xmean + t
@@ -174,17 +208,12 @@ void RegisterP2P_Normals_vMFG(const vctDynamicVector<vct3> &X,
   vct3 Xmean = vctCentroid(X);
   vct3 Ymean = vctCentroid(Y);
 
-  // recenter point sets about the centroids
-  vctDynamicVector<vct3> Xp(N);
-  vctDynamicVector<vct3> Yp(N);
-  for (unsigned int i = 0; i < N; i++)
-  {
-    Xp[i] = X[i] - Xmean;
-    Yp[i] = Y[i] - Ymean;
-  }
-
   // Rotation
-  RotateP2P_Normals_vMFG_Quaternion(Xp, Yp, Nx, Ny, B, k, F.Rotation());
+  //  (as RotateP2P_Normals_vMFG_Quaternion() for the point sets recentered
+  //   about the centroids)
+  vct3x3 H = RecenteredCovariance(X, Y, Xmean, Ymean, NULL).Multiply(2.0*B)
+    + NormalsCovariance(Nx, Ny, NULL).Multiply(k);
+  F.Rotation() = SolveRotation_HornsMethod(H);
 
   // Translation
   //  optimal translation always aligns the centroid locations:  Ymean = R*Xmean + t
@@ -214,17 +243,12 @@ void RegisterP2P_Normals_VarEst(const vctDynamicVector<vct3> &X,
   vct3 Xmean = vctWeightedMean(X, W);
   vct3 Ymean = vctWeightedMean(Y, W);
 
-  // recenter point sets about the centroids
-  vctDynamicVector<vct3> Xp(N);
-  vctDynamicVector<vct3> Yp(N);
-  for (unsigned int i = 0; i < N; i++)
-  {
-    Xp[i] = X[i] - Xmean;
-    Yp[i] = Y[i] - Ymean;
-  }
-
   // Rotation
-  RotateP2P_Normals_VarEst_Quaternion(Xp, Yp, Nx, Ny, W, posWeight, normWeight, F.Rotation());
+  //  (as RotateP2P_Normals_VarEst_Quaternion() for the point sets recentered
+  //   about the centroids)
+  vct3x3 H = RecenteredCovariance(X, Y, Xmean, Ymean, &W).Multiply(posWeight)
+    + NormalsCovariance(Nx, Ny, &W).Multiply(normWeight);
+  F.Rotation() = SolveRotation_HornsMethod(H);
 
   // Translation
   //  optimal translation always aligns the centroid locations:  Ymean = R*Xmean + t
@@ -295,11 +319,12 @@ void RegisterP2P_LSQ_CovEst(
   double dTheta = 100.0;
   double dt_norm = 100.0;
 
+  vctDynamicVector<vct3> x_rot(nSamps);   // rotated samples
+
   while (((dTheta > dTheta_term) || (dt_norm > dt_term)) && (numIter++ < maxIter))
   {
     // Step 2: F0
     vct3 res;
-    vctDynamicVector<vct3> x_rot(nSamps);
     for (unsigned int i = 0; i < nSamps; i++)
     {
       x_rot.Element(i) = R*x.Element(i);
@@ -454,11 +479,12 @@ void RegisterP2P_TLS(
   double dTheta = 1.0;
   double dt_norm = 1.0;
 
+  vctDynamicVector<vct3> x_rot(nSamps);   // rotated samples
+
   while (((dTheta > dTheta_term) || (dt_norm > dt_term)) && (numIter++ < maxIter))
   {
     // Step 2: F0
     vct3 res;
-    vctDynamicVector<vct3> x_rot(nSamps);
     for (unsigned int i = 0; i < nSamps; i++)
     {
       x_rot.Element(i) = R*x.Element(i);
@@ -627,11 +653,12 @@ void RegisterP2P_TLS(
   double dTheta = 1.0;
   double dt_norm = 1.0;
 
+  vctDynamicVector<vct3> x_rot(nSamps);   // rotated samples
+
   while (((dTheta > dTheta_term) || (dt_norm > dt_term)) && (numIter++ < maxIter))
   {
     // Step 2: F0
     vct3 res;
-    vctDynamicVector<vct3> x_rot(nSamps);
     for (unsigned int i = 0; i < nSamps; i++)
     {
       x_rot.Element(i) = R*x.Element(i);
@@ -815,11 +842,12 @@ void RegisterP2P_WTLS(
   double dTheta = 1.0;
   double dt_norm = 1.0;
 
+  vctDynamicVector<vct3> x_rot(nSamps);   // rotated samples
+
   while (((dTheta > dTheta_term) || (dt_norm > dt_term)) && (numIter++ < maxIter))
   {
     // Step 2: F0
     vct3 res;
-    vctDynamicVector<vct3> x_rot(nSamps);
     for (unsigned int i = 0; i < nSamps; i++)
     {
       x_rot.Element(i) = R*x.Element(i);
@@ -920,6 +948,226 @@ void RegisterP2P_WTLS(
   Fact.Translation() = t;
 }
 
+namespace {
+
+  // Iterative TLS registration with block-accumulated normal equations
+  //  (see RegisterP2P_TLS for the linearized scheme)
+  //  For point pair i with x_rot = R*xi and residual F0i = yi - (x_rot + t):
+  //    Ji  = [skew(x_rot)  -I]
+  //    Mi  = R*Mxi*R' + Myi   (divided by Wi if weighted)
+  //  so that with P = skew(x_rot), Ni = inv(Mi):
+  //    Ji'*Ni*Ji   = [ P'*Ni*P  -P'*Ni ]     -Ji'*Ni*F0i = [ -P'*Ni*F0i ]
+  //                  [ -Ni*P     Ni    ]                   [  Ni*F0i    ]
+  void RegisterP2P_TLS_Blocks(
+    const vctDynamicVector<vct3> &x, const vctDynamicVector<vct3> &y,
+    const vctDynamicVector<vct3x3> &Mxi, const vctDynamicVector<vct3x3> &Myi,
+    const vctDynamicVector<double> *pWi,
+    const vctDynamicVector<int> *pExclude,
+    const vctDynamicVector<vct3x3> *pInvM0,
+    double dTheta_term,
+    vctFrm3 &Fact)
+  {
+    // termination conditions
+    double dt_term = 0.001;       // delta translation (mm)
+    int    maxIter = 10;          // max iterations
+
+    // Workspace for SVD computations
+    //  (fixed size => no heap allocation per call)
+    vctFixedSizeMatrix<double, 6, 6, VCT_COL_MAJOR> A;
+    vctFixedSizeMatrix<double, 6, 6, VCT_COL_MAJOR> U;
+    vctFixedSizeVector<double, 6> S;
+    vctFixedSizeMatrix<double, 6, 6, VCT_COL_MAJOR> Vt;
+    nmrSVDFixedSizeData<6, 6, VCT_COL_MAJOR>::VectorTypeWorkspace workspaceSVD6x6;
+
+    int nSamps = (int)x.size();
+
+    vctFixedSizeMatrix<double, 6, 6> Jt_Minv_J;
+    vctFixedSizeVector<double, 6> neg_Jt_Minv_F0;
+    vctRot3 dR;
+    vctRodRot3 dAlpha;
+    vct3 dt;
+
+    // sums of the blocks of each thread
+    //  (added in thread order, so that the result does not depend on the
+    //   order in which the threads finish)
+    int nThreads = 1;
+#ifdef ENABLE_PARALLELIZATION
+    nThreads = omp_get_max_threads();
+#endif
+    vctDynamicVector< vctFixedSizeMatrix<double, 6, 6> > threadA(nThreads);
+    vctDynamicVector< vctFixedSizeVector<double, 6> > threadB(nThreads);
+
+    // Step 1: Initialize transform params
+    vct3x3 R = vct3x3::Eye();
+    vct3 t(0.0);
+
+    int numIter = 0;
+    double dTheta = 1.0;
+    double dt_norm = 1.0;
+
+    while (((dTheta > dTheta_term) || (dt_norm > dt_term)) && (numIter++ < maxIter))
+    {
+      for (int k = 0; k < nThreads; k++)
+      {
+        threadA[k].SetAll(0.0);
+        threadB[k].SetAll(0.0);
+      }
+
+      // Steps 2 - 4: accumulate the normal equations
+      //  (each thread sums its own blocks over a static partition of the
+      //   point pairs, so the sums are reproducible for a thread count)
+#ifdef ENABLE_PARALLELIZATION
+#pragma omp parallel
+#endif
+      {
+        int thread = 0;
+#ifdef ENABLE_PARALLELIZATION
+        thread = omp_get_thread_num();
+#endif
+        vctFixedSizeMatrix<double, 6, 6> &A_t = threadA[thread];
+        vctFixedSizeVector<double, 6> &b_t = threadB[thread];
+        vct3x3 Mi, Ni, P, Pt_Ni, Pt_Ni_P;
+        vct3 x_rot, F0i, Ni_F0i;
+
+        int i;
+#ifdef ENABLE_PARALLELIZATION
+#pragma omp for schedule(static)
+#endif
+        for (i = 0; i < nSamps; i++)
+        {
+          if (pExclude && (*pExclude)[i]) continue;
+
+          x_rot = R*x.Element(i);
+          F0i = y.Element(i) - (x_rot + t);
+          skew(x_rot, P);
+
+          if (pInvM0 && numIter == 1)
+          { // R = I
+            Ni = (*pInvM0)[i];
+          }
+          else if (pWi)
+          {
+            Mi = R*Mxi[i] * R.TransposeRef() + Myi[i];
+            Mi /= (*pWi)[i];
+            Ni = Mi;
+            nmrInverse(Ni); // computes inverse in-place
+          }
+          else
+          {
+            Mi = R*Mxi[i] * R.TransposeRef() + Myi[i];
+            ComputeCovInverse_NonIter(Mi, Ni);
+          }
+
+          Pt_Ni = P.TransposeRef() * Ni;
+          Pt_Ni_P = Pt_Ni * P;
+          Ni_F0i = Ni * F0i;
+          for (unsigned int r = 0; r < 3; r++)
+          {
+            for (unsigned int c = 0; c < 3; c++)
+            {
+              A_t.Element(r, c) += Pt_Ni_P.Element(r, c);
+              A_t.Element(r, c + 3) -= Pt_Ni.Element(r, c);
+              A_t.Element(r + 3, c + 3) += Ni.Element(r, c);
+            }
+            b_t.Element(r + 3) += Ni_F0i.Element(r);
+          }
+          vct3 Pt_Ni_F0i = Pt_Ni * F0i;
+          b_t.Element(0) -= Pt_Ni_F0i.Element(0);
+          b_t.Element(1) -= Pt_Ni_F0i.Element(1);
+          b_t.Element(2) -= Pt_Ni_F0i.Element(2);
+        }
+      }
+      Jt_Minv_J.SetAll(0.0);
+      neg_Jt_Minv_F0.SetAll(0.0);
+      for (int k = 0; k < nThreads; k++)
+      {
+        Jt_Minv_J += threadA[k];
+        neg_Jt_Minv_F0 += threadB[k];
+      }
+      // lower left block is the transpose of the upper right block
+      for (unsigned int r = 0; r < 3; r++)
+      {
+        for (unsigned int c = 0; c < 3; c++)
+        {
+          Jt_Minv_J.Element(r + 3, c) = Jt_Minv_J.Element(c, r + 3);
+        }
+      }
+
+      // solve Ax = b
+      try
+      {
+        A.Assign(Jt_Minv_J);
+        nmrSVD(A, U, S, Vt, workspaceSVD6x6);
+      }
+      catch (...)
+      {
+        std::cout << "ERROR: Compute SVD failed" << std::endl;
+        assert(0);
+      }
+
+      // dP = V * Sinv * U' * neg_Jt_Minv_F0
+      vctFixedSizeVector<double, 6> Sinv_Ut_F0;
+      vctFixedSizeVector<double, 6> dP(0.0);
+      for (unsigned int i = 0; i < 6; i++)
+      {
+        double Ut_F0 = 0.0;
+        for (unsigned int k = 0; k < 6; k++)
+        {
+          Ut_F0 += U.Element(k, i) * neg_Jt_Minv_F0.Element(k);
+        }
+        Sinv_Ut_F0.Element(i) = Ut_F0 / S.Element(i);
+      }
+      for (unsigned int i = 0; i < 6; i++)
+      {
+        for (unsigned int k = 0; k < 6; k++)
+        {
+          dP.Element(i) += Vt.Element(k, i) * Sinv_Ut_F0.Element(k);
+        }
+      }
+      dAlpha.X() = dP.Element(0);
+      dAlpha.Y() = dP.Element(1);
+      dAlpha.Z() = dP.Element(2);
+      dt.X() = dP.Element(3);
+      dt.Y() = dP.Element(4);
+      dt.Z() = dP.Element(5);
+
+      // Step 5: [R,t]
+      dR = vctRot3(dAlpha);
+      R = dR*R;
+      t = t + dt;
+
+      dt_norm = dt.Norm();
+      dTheta = dAlpha.Norm();
+    }
+
+    Fact.Rotation() = R;
+    Fact.Translation() = t;
+  }
+
+}
+
+void RegisterP2P_TLS_Block(
+  const vctDynamicVector<vct3> &x, const vctDynamicVector<vct3> &y,
+  const vctDynamicVector<vct3x3> &Mxi, const vctDynamicVector<vct3x3> &Myi,
+  vctFrm3 &Fact,
+  const vctDynamicVector<int> *pExclude,
+  const vctDynamicVector<vct3x3> *pInvM0)
+{
+  // same termination as RegisterP2P_TLS
+  RegisterP2P_TLS_Blocks(x, y, Mxi, Myi, NULL, pExclude, pInvM0, 0.001*cmnPI / 180.0, Fact);
+}
+
+void RegisterP2P_WTLS_Block(
+  const vctDynamicVector<vct3> &x, const vctDynamicVector<vct3> &y,
+  const vctDynamicVector<vct3x3> &Mxi, const vctDynamicVector<vct3x3> &Myi,
+  const vctDynamicVector<double> &Wi,
+  vctFrm3 &Fact,
+  const vctDynamicVector<int> *pExclude)
+{
+  // same termination as RegisterP2P_WTLS
+  RegisterP2P_TLS_Blocks(x, y, Mxi, Myi, &Wi, pExclude, NULL, 0.001, Fact);
+}
+
 // Total Least Squares registration of point pair positions & orientations
 //  (assumes error in both sample and model values)
 //  solved via an iterative linear scheme based on Jacobian
@@ -1543,7 +1791,13 @@ void RotateP2P_Normals_vMFG_Quaternion(
   double B, double k,
   vctRot3 &R)
 {
-  RotateP2P_Normals_vMFG_Quaternion(X, Y, Nx, Ny, vctDoubleVec(X.size(), 1.0), B, k, R);
+  unsigned int numPts = X.size();
+  assert(numPts == Y.size() && numPts == Nx.size() && numPts == Ny.size());
+
+  vct3x3 H = RecenteredCovariance(X, Y, vct3(0.0), vct3(0.0), NULL).Multiply(2.0*B)
+    + NormalsCovariance(Nx, Ny, NULL).Multiply(k);
+
+  R = SolveRotation_HornsMethod(H);
 }
 
 
@@ -1592,5 +1846,5 @@ void RotateP2P_Normals_VarEst_Quaternion(const vctDynamicVector<vct3> &X,
   }
   H = H1.Multiply(posWeight) + H2.Multiply(normWeight);
 
-  SolveRotation_ArunsMethod(H);
+  R = SolveRotation_HornsMethod(H);
 }
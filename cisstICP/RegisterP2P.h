@@ -141,6 +141,33 @@ void RegisterP2P_WTLS(
   const vctDynamicVector<vct3x3> &Mxi, const vctDynamicVector<vct3x3> &Myi,
   const vctDynamicVector<double> &Wi,
   vctFrm3 &Fact);
+
+// Block-accumulated versions of the above TLS and WTLS registrations
+//  The normal equations J'*inv(M)*J and J'*inv(M)*F0 are sums of 6x6 and
+//  6x1 blocks per point pair, which are accumulated in parallel without
+//  forming the 3Nx6 Jacobian; no memory of order N is allocated.
+//  The result agrees with RegisterP2P_TLS / RegisterP2P_WTLS up to
+//  round-off (the sums are accumulated in a different order); the sums of
+//  the threads are added in thread order, so that the result is the same
+//  on every run with the same number of threads.
+//
+//   pExclude - optional flags of point pairs to leave out (e.g. outliers)
+//   pInvM0   - optional inverses of Mxi + Myi, already computed by the
+//              caller; used by the first step, which solves at R = I
+//
+void RegisterP2P_TLS_Block(
+  const vctDynamicVector<vct3> &x, const vctDynamicVector<vct3> &y,
+  const vctDynamicVector<vct3x3> &Mxi, const vctDynamicVector<vct3x3> &Myi,
+  vctFrm3 &Fact,
+  const vctDynamicVector<int> *pExclude = NULL,
+  const vctDynamicVector<vct3x3> *pInvM0 = NULL);
+void RegisterP2P_WTLS_Block(
+  const vctDynamicVector<vct3> &x, const vctDynamicVector<vct3> &y,
+  const vctDynamicVector<vct3x3> &Mxi, const vctDynamicVector<vct3x3> &Myi,
+  const vctDynamicVector<double> &Wi,
+  vctFrm3 &Fact,
+  const vctDynamicVector<int> *pExclude = NULL);
+
 void RegisterP2P_Normals_TLS();
 
 
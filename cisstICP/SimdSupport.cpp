@@ -0,0 +1,104 @@
+// ****************************************************************************
+//
+//    Copyright (c) 2014, Seth Billings, Russell Taylor, Johns Hopkins University
+//    All rights reserved.
+//
+//    Redistribution and use in source and binary forms, with or without
+//    modification, are permitted provided that the following conditions are
+//    met:
+//
+//    1. Redistributions of source code must retain the above copyright
+//    notice, this list of conditions and the following disclaimer.
+//
+//    2. Redistributions in binary form must reproduce the above copyright
+//    notice, this list of conditions and the following disclaimer in the
+//    documentation and/or other materials provided with the distribution.
+//
+//    3. Neither the name of the copyright holder nor the names of its
+//    contributors may be used to endorse or promote products derived from
+//    this software without specific prior written permission.
+//
+//    THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+//    "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+//    LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+//    A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+//    HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+//    SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+//    LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+//    DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+//    THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+//    (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+//    OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//  
+// ****************************************************************************
+
+#include "SimdSupport.h"
+
+#include <iostream>
+#if defined(_MSC_VER) && (defined(CISSTICP_SIMD_AVX2) || defined(CISSTICP_SIMD_AVX512))
+#include <intrin.h>
+#include <immintrin.h>
+#endif
+
+// NOTE: this file must not be compiled with the SIMD instruction set flags
+
+namespace {
+
+#if defined(CISSTICP_SIMD_AVX512)
+  const char *SimdInstructionSet = "AVX-512";
+#elif defined(CISSTICP_SIMD_AVX2)
+  const char *SimdInstructionSet = "AVX2";
+#endif
+
+  bool CpuSupportsSimdKernels()
+  {
+#if defined(CISSTICP_SIMD_AVX2) || defined(CISSTICP_SIMD_AVX512)
+#if defined(_MSC_VER)
+    int info[4];
+    __cpuid(info, 0);
+    if (info[0] < 7) return false;
+    __cpuid(info, 1);
+    bool bOSXSave = (info[2] & (1 << 27)) != 0;
+    bool bFMA = (info[2] & (1 << 12)) != 0;
+    if (!bOSXSave || !bFMA) return false;
+    // the operating system must save the extended register state
+    unsigned long long xcr0 = _xgetbv(0);
+    __cpuidex(info, 7, 0);
+#if defined(CISSTICP_SIMD_AVX512)
+    return (xcr0 & 0xe6) == 0xe6 && (info[1] & (1 << 16)) != 0;   // AVX-512F
+#else
+    return (xcr0 & 0x06) == 0x06 && (info[1] & (1 << 5)) != 0;    // AVX2
+#endif
+#else
+    __builtin_cpu_init();
+#if defined(CISSTICP_SIMD_AVX512)
+    return __builtin_cpu_supports("avx512f") && __builtin_cpu_supports("fma");
+#else
+    return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+#endif
+#endif
+#else
+    return false;
+#endif
+  }
+
+  bool CheckSimdKernels()
+  {
+    bool bSupported = CpuSupportsSimdKernels();
+#if defined(CISSTICP_SIMD_AVX2) || defined(CISSTICP_SIMD_AVX512)
+    if (!bSupported)
+    {
+      std::cout << "WARNING: the batched kernels were compiled for " << SimdInstructionSet
+        << ", which this processor does not support; using the scalar kernels" << std::endl;
+    }
+#endif
+    return bSupported;
+  }
+
+}
+
+bool SimdKernelsSupported()
+{
+  static const bool bSupported = CheckSimdKernels();
+  return bSupported;
+}
@@ -34,20 +34,178 @@
 #include "TriangleClosestPointSolver.h"
 
 #include <cisstCommon.h>
+#include <string.h>
+#include <vector>
+#include <limits>
+#include <algorithm>
+#include <omp.h>
+
+#include "PDTreeFile.h"
+#include "SimdSupport.h"
+
+#define ENABLE_PARALLELIZATION
+
+// scalar square distance kernel
+#define TCPS_KERNEL(name) name##_Scalar
+#include "TriangleDistanceKernels.inl"
+#undef TCPS_KERNEL
+
+// SIMD square distance kernel (see TriangleClosestPointSolver_SIMD.cpp)
+#if defined(CISSTICP_SIMD_AVX2) || defined(CISSTICP_SIMD_AVX512)
+void ComputeTriangleSquareDistances_SIMD(
+  const double point[3], const double * const coords[9], int count, double *sqrDist);
+#endif
+
+namespace {
+
+  const unsigned int PDTreeFileTag_TCPS = PDTREE_FILE_TAG('T','C','P','S');
+
+  // per-triangle record of the file section
+  struct TriangleFileRecord
+  {
+    double triXfm[12];      // rotation (row-major) and translation
+    double triXfmInv[12];
+    double P2[2], P3[2], P1P3[2], P2P3[2], E13[2], E23[2];
+  };
+
+  void SaveFrame(const vctFrm3 &F, double *data)
+  {
+    for (int r = 0; r < 3; r++)
+    {
+      for (int c = 0; c < 3; c++)
+      {
+        data[3 * r + c] = F.Rotation().Element(r, c);
+      }
+      data[9 + r] = F.Translation().Element(r);
+    }
+  }
+
+  void LoadFrame(const double *data, vctFrm3 &F)
+  {
+    for (int r = 0; r < 3; r++)
+    {
+      for (int c = 0; c < 3; c++)
+      {
+        F.Rotation().Element(r, c) = data[3 * r + c];
+      }
+      F.Translation().Element(r) = data[9 + r];
+    }
+  }
+
+  // single precision unit quaternion (w, x, y, z) of a rotation
+  //  (compact mode)
+  void RotationToQuaternion(const vctRot3 &R, float *q)
+  {
+    double w, x, y, z, s;
+    double tr = R.Element(0, 0) + R.Element(1, 1) + R.Element(2, 2);
+    if (tr > 0.0)
+    {
+      s = 0.5 / sqrt(tr + 1.0);
+      w = 0.25 / s;
+      x = (R.Element(2, 1) - R.Element(1, 2))*s;
+      y = (R.Element(0, 2) - R.Element(2, 0))*s;
+      z = (R.Element(1, 0) - R.Element(0, 1))*s;
+    }
+    else if (R.Element(0, 0) > R.Element(1, 1) && R.Element(0, 0) > R.Element(2, 2))
+    {
+      s = 2.0*sqrt(1.0 + R.Element(0, 0) - R.Element(1, 1) - R.Element(2, 2));
+      w = (R.Element(2, 1) - R.Element(1, 2)) / s;
+      x = 0.25*s;
+      y = (R.Element(0, 1) + R.Element(1, 0)) / s;
+      z = (R.Element(0, 2) + R.Element(2, 0)) / s;
+    }
+    else if (R.Element(1, 1) > R.Element(2, 2))
+    {
+      s = 2.0*sqrt(1.0 + R.Element(1, 1) - R.Element(0, 0) - R.Element(2, 2));
+      w = (R.Element(0, 2) - R.Element(2, 0)) / s;
+      x = (R.Element(0, 1) + R.Element(1, 0)) / s;
+      y = 0.25*s;
+      z = (R.Element(1, 2) + R.Element(2, 1)) / s;
+    }
+    else
+    {
+      s = 2.0*sqrt(1.0 + R.Element(2, 2) - R.Element(0, 0) - R.Element(1, 1));
+      w = (R.Element(1, 0) - R.Element(0, 1)) / s;
+      x = (R.Element(0, 2) + R.Element(2, 0)) / s;
+      y = (R.Element(1, 2) + R.Element(2, 1)) / s;
+      z = 0.25*s;
+    }
+    q[0] = (float)w;
+    q[1] = (float)x;
+    q[2] = (float)y;
+    q[3] = (float)z;
+  }
+
+  // rotation of a single precision quaternion
+  //  (the quaternion is renormalized so that the rotation is orthonormal
+  //   to double precision)
+  void QuaternionToRotation(const float *q, vctRot3 &R)
+  {
+    double w = q[0], x = q[1], y = q[2], z = q[3];
+    double s = 2.0 / (w*w + x*x + y*y + z*z);
+    R.Element(0, 0) = 1.0 - s*(y*y + z*z);
+    R.Element(0, 1) = s*(x*y - w*z);
+    R.Element(0, 2) = s*(x*z + w*y);
+    R.Element(1, 0) = s*(x*y + w*z);
+    R.Element(1, 1) = 1.0 - s*(x*x + z*z);
+    R.Element(1, 2) = s*(y*z - w*x);
+    R.Element(2, 0) = s*(x*z - w*y);
+    R.Element(2, 1) = s*(y*z + w*x);
+    R.Element(2, 2) = 1.0 - s*(x*x + y*y);
+  }
+
+}
 
 
 TriangleClosestPointSolver::TriangleClosestPointSolver( const cisstMesh &mesh ) :
   P1(0.0,0.0),
-  E12(-1.0, 0.0)
+  E12(-1.0, 0.0),
+  pVertices(NULL), pTriangles(NULL), bLazy(false)
 {
   init(mesh.vertices, mesh.faces);
 }
 
 
+TriangleClosestPointSolver::TriangleClosestPointSolver( const cisstMesh &mesh,
+                                                        const TriangleClosestPointSolver *pPrecomputed ) :
+  P1(0.0,0.0),
+  E12(-1.0, 0.0),
+  pVertices(NULL), pTriangles(NULL), bLazy(false)
+{
+  if (pPrecomputed && pPrecomputed->IsCompact())
+  { // compact mode referencing this mesh
+    //  (the quaternions of a lazy solver are computed again as needed)
+    initCompact(mesh.vertices, mesh.faces, pPrecomputed->bLazy);
+    if (!bLazy)
+    {
+      triQuat = pPrecomputed->triQuat;
+    }
+  }
+  else if (pPrecomputed)
+  {
+    vertices = pPrecomputed->vertices;
+    triangles = pPrecomputed->triangles;
+    triXfm = pPrecomputed->triXfm;
+    triXfmInv = pPrecomputed->triXfmInv;
+    P2 = pPrecomputed->P2;
+    P3 = pPrecomputed->P3;
+    P1P3 = pPrecomputed->P1P3;
+    P2P3 = pPrecomputed->P2P3;
+    E13 = pPrecomputed->E13;
+    E23 = pPrecomputed->E23;
+  }
+  else
+  {
+    init(mesh.vertices, mesh.faces);
+  }
+}
+
+
 TriangleClosestPointSolver::TriangleClosestPointSolver( const vctDynamicVector<vct3> &vertices_,
                                                         const vctDynamicVector<vctInt3> &triangles_ ) :
   P1(0.0, 0.0),
-  E12(-1.0, 0.0)
+  E12(-1.0, 0.0),
+  pVertices(NULL), pTriangles(NULL), bLazy(false)
 {
   init(vertices_, triangles_);
 }
@@ -57,6 +215,11 @@ void TriangleClosestPointSolver::init( const vctDynamicVector<vct3> &vertices_,
 {
   vertices = vertices_;
   triangles = triangles_;
+  pVertices = NULL;
+  pTriangles = NULL;
+  triQuat.SetSize(0);
+  quatBlockReady.clear();
+  bLazy = false;
 
   // precompute properties for each triangle
   int numTriangles = triangles.size();
@@ -68,49 +231,321 @@ void TriangleClosestPointSolver::init( const vctDynamicVector<vct3> &vertices_,
   E23.SetSize(numTriangles);
   P1P3.SetSize(numTriangles);
   P2P3.SetSize(numTriangles);
-  for (int triIdx = 0; triIdx < (int)triangles.size(); triIdx++)
+  for (int triIdx = 0; triIdx < numTriangles; triIdx++)
+  {
+    ComputeTriangleProperties(triIdx);
+  }
+}
+
+void TriangleClosestPointSolver::ComputeTriangleProperties( int triIdx )
+{
+  triXfm[triIdx] = computeTriangleXfm(triIdx);
+  triXfmInv[triIdx] = triXfm[triIdx].Inverse();
+
+  // compute the y coordinate of P2 which lies on the y-axis
+  vct3 tmp = triXfm[triIdx] * vertices[triangles[triIdx][1]];
+  P2[triIdx].Assign(tmp[0],tmp[1]);
+  if (tmp[0] > 1e-10 || tmp[2] > 1e-10)
   {
-    triXfm[triIdx] = computeTriangleXfm(triIdx);
-    triXfmInv[triIdx] = triXfm[triIdx].Inverse();
+    std::cout << "WARNING: P2.x or P2.z for xfmd triangle index " << triIdx <<
+        " is greater than zero with 3D coord: " << tmp << std::endl;
+  }
+
+  // compute the xy coordinates of P3 which lies on the xy-axis
+  tmp = triXfm[triIdx] * vertices[triangles[triIdx][2]];
+  P3[triIdx].Assign(tmp[0],tmp[1]);
+  if (tmp[2] > 1e-10)
+  {
+    std::cout << "WARNING: P3.z for xfmd triangle index " << triIdx <<
+        " is greater than zero with 3D coord: " << tmp << std::endl;
+  }
+
+  P1P3[triIdx].Assign(P3[triIdx]-P1);
+  P2P3[triIdx].Assign(P3[triIdx]-P2[triIdx]);
+  P1P3[triIdx].NormalizedSelf();
+  P2P3[triIdx].NormalizedSelf();
+
+  // compute the in-plane xfmd edge normal directions pointing
+  //  outward from the triangle
+  //  do this by rotating each directed edge outwards by 90 degrees
+  // Note: E12 is always (-1,0)
+  E13[triIdx].Assign(P3[triIdx][1],-P3[triIdx][0]);
+  E23[triIdx].Assign(-P2P3[triIdx][1],P2P3[triIdx][0]);
+}
 
-    // compute the y coordinate of P2 which lies on the y-axis
-    vct3 tmp = triXfm[triIdx] * vertices[triangles[triIdx][1]];
-    P2[triIdx].Assign(tmp[0],tmp[1]);
-    if (tmp[0] > 1e-10 || tmp[2] > 1e-10)
+int TriangleClosestPointSolver::Refit( const vctDynamicVector<vct3> &vertices_,
+                                       double tol,
+                                       vctDynamicVector<char> &triMoved )
+{
+  int numTriangles = NumTriangles();
+  triMoved.SetSize(numTriangles);
+
+  if (IsCompact())
+  {
+    // the vertices are referenced => no copy to compare with
+    //  (recompute the rotations of all triangles)
+    if (bLazy)
+    {
+      for (size_t block = 0; block < quatBlockReady.size(); block++)
+      {
+        quatBlockReady[block].store(0, std::memory_order_relaxed);
+      }
+    }
+    else
+    {
+#ifdef ENABLE_PARALLELIZATION
+#pragma omp parallel for
+#endif
+      for (int triIdx = 0; triIdx < numTriangles; triIdx++)
+      {
+        RotationToQuaternion(computeTriangleXfm(triIdx).Rotation(), triQuat.Pointer(4 * triIdx));
+      }
+    }
+    triMoved.SetAll(1);
+  }
+  else if (vertices_.size() != vertices.size())
+  {
+    // mesh vertices changed
+    vctDynamicVector<vctInt3> triangles_(triangles);
+    init(vertices_, triangles_);
+    triMoved.SetAll(1);
+  }
+  else
+  {
+    // update the vertices moved by more than the tolerance
+    //  and recompute the triangles using them
+    int numVertices = vertices.size();
+    vctDynamicVector<char> vxMoved(numVertices, (char)0);
+    double sqrTol = tol*tol;
+    for (int vx = 0; vx < numVertices; vx++)
+    {
+      if ((vertices_[vx] - vertices[vx]).NormSquare() > sqrTol)
+      {
+        vertices[vx] = vertices_[vx];
+        vxMoved[vx] = 1;
+      }
+    }
+    for (int triIdx = 0; triIdx < numTriangles; triIdx++)
     {
-      std::cout << "WARNING: P2.x or P2.z for xfmd triangle index " << triIdx <<
-          " is greater than zero with 3D coord: " << tmp << std::endl;
+      triMoved[triIdx] = vxMoved[triangles[triIdx][0]] |
+        vxMoved[triangles[triIdx][1]] | vxMoved[triangles[triIdx][2]];
     }
+#ifdef ENABLE_PARALLELIZATION
+#pragma omp parallel for schedule(dynamic, 256)
+#endif
+    for (int triIdx = 0; triIdx < numTriangles; triIdx++)
+    {
+      if (triMoved[triIdx])
+      {
+        ComputeTriangleProperties(triIdx);
+      }
+    }
+  }
+
+  // leaf order coordinates
+  if (leafOrder.size() > 0)
+  {
+    SetLeafOrder(leafOrder.Pointer(), leafOrder.size());
+  }
 
-    // compute the xy coordinates of P3 which lies on the xy-axis
-    tmp = triXfm[triIdx] * vertices[triangles[triIdx][2]];
-    P3[triIdx].Assign(tmp[0],tmp[1]);
-    if (tmp[2] > 1e-10)
+  int nMoved = 0;
+  for (int triIdx = 0; triIdx < numTriangles; triIdx++)
+  {
+    nMoved += triMoved[triIdx];
+  }
+  return nMoved;
+}
+
+
+void TriangleClosestPointSolver::initCompact( const vctDynamicVector<vct3> &vertices_,
+                                              const vctDynamicVector<vctInt3> &triangles_,
+                                              bool bLazy_ )
+{
+  // release any full precomputations
+  vertices.SetSize(0);
+  triangles.SetSize(0);
+  triXfm.SetSize(0);
+  triXfmInv.SetSize(0);
+  P2.SetSize(0);
+  P3.SetSize(0);
+  E13.SetSize(0);
+  E23.SetSize(0);
+  P1P3.SetSize(0);
+  P2P3.SetSize(0);
+  // (the leaf-order coordinates would copy the mesh as well)
+  for (int k = 0; k < 9; k++)
+  {
+    leafCoords[k].SetSize(0);
+  }
+  leafOrder.SetSize(0);
+
+  pVertices = &vertices_;
+  pTriangles = &triangles_;
+  bLazy = bLazy_;
+
+  int numTriangles = NumTriangles();
+  triQuat.SetSize(4 * numTriangles);
+  if (bLazy)
+  {
+    // (a new vector since the flags cannot be copied by a resize; the
+    //  flags of the new vector are zero-initialized)
+    quatBlockReady = std::vector< std::atomic<char> >(
+      (numTriangles + TCPS_LAZY_BLOCK_SIZE - 1) / TCPS_LAZY_BLOCK_SIZE);
+  }
+  else
+  {
+    quatBlockReady.clear();
+    for (int triIdx = 0; triIdx < numTriangles; triIdx++)
+    {
+      RotationToQuaternion(computeTriangleXfm(triIdx).Rotation(), triQuat.Pointer(4 * triIdx));
+    }
+  }
+}
+
+
+size_t TriangleClosestPointSolver::MemoryUsage() const
+{
+  size_t bytes =
+    vertices.size()*sizeof(vct3) + triangles.size()*sizeof(vctInt3) +
+    (triXfm.size() + triXfmInv.size())*sizeof(vctFrm3) +
+    (P2.size() + P3.size() + P1P3.size() + P2P3.size() + E13.size() + E23.size())*sizeof(vct2) +
+    9 * leafCoords[0].size()*sizeof(double) + leafOrder.size()*sizeof(int) +
+    triQuat.size()*sizeof(float) + quatBlockReady.size()*sizeof(std::atomic<char>);
+  return bytes;
+}
+
+
+// rotation of the local triangle frame in compact mode
+void TriangleClosestPointSolver::CompactRotation( int triangleIndex, vctRot3 &R )
+{
+  if (bLazy)
+  {
+    // another thread may set the flag once it has stored the quaternions
+    //  of the block; the acquire load orders the quaternion reads after it
+    //  (a plain load on x86, so searching a computed block costs no more)
+    int block = triangleIndex / TCPS_LAZY_BLOCK_SIZE;
+    if (!quatBlockReady[block].load(std::memory_order_acquire))
+    {
+      ComputeCompactBlock(block);
+    }
+  }
+  QuaternionToRotation(triQuat.Pointer(4 * triangleIndex), R);
+}
+
+
+// compute the quaternions of a block of triangles on first use (lazy mode)
+void TriangleClosestPointSolver::ComputeCompactBlock( int block )
+{
+#ifdef ENABLE_PARALLELIZATION
+#pragma omp critical (TriangleClosestPointSolver_ComputeCompactBlock)
+#endif
+  {
+    if (!quatBlockReady[block].load(std::memory_order_relaxed))
+    {
+      int end = std::min((block + 1)*TCPS_LAZY_BLOCK_SIZE, NumTriangles());
+      for (int triIdx = block*TCPS_LAZY_BLOCK_SIZE; triIdx < end; triIdx++)
+      {
+        RotationToQuaternion(computeTriangleXfm(triIdx).Rotation(), triQuat.Pointer(4 * triIdx));
+      }
+      // quaternions must be visible before the flag
+      quatBlockReady[block].store(1, std::memory_order_release);
+    }
+  }
+}
+
+
+void TriangleClosestPointSolver::Save( PDTreeFileWriter &file ) const
+{
+  if (IsCompact())
+  { // the file holds the full precomputations
+    TriangleClosestPointSolver full(*pVertices, *pTriangles);
+    full.Save(file);
+    return;
+  }
+
+  int numTriangles = triangles.size();
+  std::vector<TriangleFileRecord> records(numTriangles);
+  for (int triIdx = 0; triIdx < numTriangles; triIdx++)
+  {
+    TriangleFileRecord &rec = records[triIdx];
+    SaveFrame(triXfm[triIdx], rec.triXfm);
+    SaveFrame(triXfmInv[triIdx], rec.triXfmInv);
+    for (int k = 0; k < 2; k++)
     {
-      std::cout << "WARNING: P3.z for xfmd triangle index " << triIdx <<
-          " is greater than zero with 3D coord: " << tmp << std::endl;
+      rec.P2[k] = P2[triIdx][k];
+      rec.P3[k] = P3[triIdx][k];
+      rec.P1P3[k] = P1P3[triIdx][k];
+      rec.P2P3[k] = P2P3[triIdx][k];
+      rec.E13[k] = E13[triIdx][k];
+      rec.E23[k] = E23[triIdx][k];
     }
+  }
+  file.AddSection(PDTreeFileTag_TCPS, numTriangles > 0 ? &records[0] : NULL,
+    numTriangles*sizeof(TriangleFileRecord));
+}
+
 
-    P1P3[triIdx].Assign(P3[triIdx]-P1);
-    P2P3[triIdx].Assign(P3[triIdx]-P2[triIdx]);
-    P1P3[triIdx].NormalizedSelf();
-    P2P3[triIdx].NormalizedSelf();
+int TriangleClosestPointSolver::Load( const PDTreeFileReader &file, const cisstMesh &mesh )
+{
+  size_t nBytes = 0;
+  const TriangleFileRecord *records = (const TriangleFileRecord*)
+    file.FindSection(PDTreeFileTag_TCPS, nBytes);
+  if (!records)
+  {
+    return 1;
+  }
+  int numTriangles = mesh.faces.size();
+  if (nBytes != numTriangles*sizeof(TriangleFileRecord))
+  {
+    std::cout << "ERROR: triangle solver data of PD tree file does not match the mesh" << std::endl;
+    return -1;
+  }
 
-    // compute the in-plane xfmd edge normal directions pointing
-    //  outward from the triangle
-    //  do this by rotating each directed edge outwards by 90 degrees
-    // Note: E12 is always (-1,0)
-    E13[triIdx].Assign(P3[triIdx][1],-P3[triIdx][0]);
-    E23[triIdx].Assign(-P2P3[triIdx][1],P2P3[triIdx][0]);
+  vertices = mesh.vertices;
+  triangles = mesh.faces;
+  pVertices = NULL;
+  pTriangles = NULL;
+  triQuat.SetSize(0);
+  quatBlockReady.clear();
+  bLazy = false;
+  triXfm.SetSize(numTriangles);
+  triXfmInv.SetSize(numTriangles);
+  P2.SetSize(numTriangles);
+  P3.SetSize(numTriangles);
+  E13.SetSize(numTriangles);
+  E23.SetSize(numTriangles);
+  P1P3.SetSize(numTriangles);
+  P2P3.SetSize(numTriangles);
+  for (int triIdx = 0; triIdx < numTriangles; triIdx++)
+  {
+    const TriangleFileRecord &rec = records[triIdx];
+    LoadFrame(rec.triXfm, triXfm[triIdx]);
+    LoadFrame(rec.triXfmInv, triXfmInv[triIdx]);
+    P2[triIdx].Assign(rec.P2[0], rec.P2[1]);
+    P3[triIdx].Assign(rec.P3[0], rec.P3[1]);
+    P1P3[triIdx].Assign(rec.P1P3[0], rec.P1P3[1]);
+    P2P3[triIdx].Assign(rec.P2P3[0], rec.P2P3[1]);
+    E13[triIdx].Assign(rec.E13[0], rec.E13[1]);
+    E23[triIdx].Assign(rec.E23[0], rec.E23[1]);
   }
+  return 0;
+}
+
+
+unsigned long long TriangleClosestPointSolver::MeshFingerprint( const cisstMesh &mesh )
+{
+  unsigned long long hash = PDTreeFileChecksum(
+    (const char*)mesh.vertices.Pointer(), mesh.vertices.size()*sizeof(vct3));
+  return PDTreeFileChecksum(
+    (const char*)mesh.faces.Pointer(), mesh.faces.size()*sizeof(vctInt3), hash);
 }
 
 
 vctFrm3 TriangleClosestPointSolver::computeTriangleXfm( int triangleIndex )
 {
-  vct3 v1 = vertices[triangles[triangleIndex][0]];
-  vct3 v2 = vertices[triangles[triangleIndex][1]];
-  vct3 v3 = vertices[triangles[triangleIndex][2]];
+  vct3 v1 = Vertex(triangleIndex, 0);
+  vct3 v2 = Vertex(triangleIndex, 1);
+  vct3 v3 = Vertex(triangleIndex, 2);
 
   return computeTriangleXfm(v1, v2, v3);
 }
@@ -151,6 +586,18 @@ void TriangleClosestPointSolver::FindClosestPointOnTriangle(
   int triangleIndex,
   vct3 &closestPoint )
 {
+  if (IsCompact())
+  { // local triangle frame from the stored rotation
+    vctFrm3 xfm;
+    CompactRotation(triangleIndex, xfm.Rotation());
+    xfm.Translation() = -(xfm.Rotation() * Vertex(triangleIndex, 0));
+    FindClosestPointOnTriangle(
+      point,
+      Vertex(triangleIndex, 1), Vertex(triangleIndex, 2),
+      xfm, closestPoint);
+    return;
+  }
+
   FindClosestPointOnTriangle(
     point,
     closestPoint,
@@ -171,9 +618,20 @@ void TriangleClosestPointSolver::FindClosestPointOnTriangle(
   const vct3 &v3,
   vct3 &closestPoint)
 {
-  //--- precomputations ---//
+  FindClosestPointOnTriangle(
+    point, v2, v3,
+    computeTriangleXfm(v1,v2,v3),
+    closestPoint);
+}
 
-  vctFrm3 triXfm = computeTriangleXfm(v1,v2,v3);
+void TriangleClosestPointSolver::FindClosestPointOnTriangle(
+  const vct3 &point,
+  const vct3 &v2,
+  const vct3 &v3,
+  const vctFrm3 &triXfm,
+  vct3 &closestPoint)
+{
+  //--- precomputations ---//
 
   // compute the y coordinate of P2 which lies on the y-axis
   vct3 tmp = triXfm * v2;
@@ -392,7 +850,7 @@ void TriangleClosestPointSolver::FindMostLikelyPointOnTriangle(
   //   2) Find closest point (c') on triangle' to the origin
   //      (using standard Euclidean means)
   //   3) Affine transform c' back to normal coordinates
-  static vct3 p0, p1, p2, c;
+  vct3 p0, p1, p2, c;
 
   // 1: transform triangle to spherical coords
   p0 = N*(v0 - point);
@@ -413,13 +871,87 @@ void TriangleClosestPointSolver::FindMostLikelyPointOnTriangle(
   const vct3x3 &N, const vct3x3 &Ninv,
   vct3 &closestPoint)
 {
-  vct3 v1 = vertices[triangles[triangleIndex][0]];
-  vct3 v2 = vertices[triangles[triangleIndex][1]];
-  vct3 v3 = vertices[triangles[triangleIndex][2]];
+  vct3 v1 = Vertex(triangleIndex, 0);
+  vct3 v2 = Vertex(triangleIndex, 1);
+  vct3 v3 = Vertex(triangleIndex, 2);
 
   FindMostLikelyPointOnTriangle(
     point,
     v1, v2, v3,
     N, Ninv,
 	closestPoint);
-}
\ No newline at end of file
+}
+
+
+void TriangleClosestPointSolver::ComputeSquareDistances(
+  const vct3 &point,
+  const double * const coords[9],
+  int count,
+  double *sqrDist)
+{
+#if defined(CISSTICP_SIMD_AVX2) || defined(CISSTICP_SIMD_AVX512)
+  if (SimdKernelsSupported())
+  {
+    ComputeTriangleSquareDistances_SIMD(point.Pointer(), coords, count, sqrDist);
+    return;
+  }
+#endif
+  ComputeTriangleSquareDistances_Scalar(point.Pointer(), coords, count, sqrDist);
+}
+
+
+void TriangleClosestPointSolver::SetLeafOrder(const int *order, int numTriangles)
+{
+  if (order != leafOrder.Pointer())
+  {
+    leafOrder.SetSize(numTriangles);
+    for (int i = 0; i < numTriangles; i++)
+    {
+      leafOrder[i] = order[i];
+    }
+  }
+  for (int k = 0; k < 9; k++)
+  {
+    leafCoords[k].SetSize(numTriangles);
+  }
+  for (int i = 0; i < numTriangles; i++)
+  {
+    for (int vx = 0; vx < 3; vx++)
+    {
+      const vct3 &v = Vertex(order[i], vx);
+      leafCoords[3 * vx][i] = v[0];
+      leafCoords[3 * vx + 1][i] = v[1];
+      leafCoords[3 * vx + 2][i] = v[2];
+    }
+  }
+}
+
+
+void TriangleClosestPointSolver::ComputeLeafSquareDistances(
+  const vct3 &point,
+  int first, int count,
+  double *sqrDist) const
+{
+  assert(first >= 0 && first + count <= LeafOrderSize());
+  const double *coords[9];
+  for (int k = 0; k < 9; k++)
+  {
+    coords[k] = leafCoords[k].Pointer(first);
+  }
+  ComputeSquareDistances(point, coords, count, sqrDist);
+}
+
+
+void TriangleClosestPointSolver::TransformedTriangleCoords(
+  int triangleIndex,
+  const vct3 &point, const vct3x3 &N,
+  double * const coords[9], int i) const
+{
+  for (int vx = 0; vx < 3; vx++)
+  {
+    vct3 v = N*(Vertex(triangleIndex, vx) - point);
+    coords[3 * vx][i] = v[0];
+    coords[3 * vx + 1][i] = v[1];
+    coords[3 * vx + 2][i] = v[2];
+  }
+}
@@ -35,9 +35,23 @@
 #define H_TriangleClosestPointSolver
 
 #include <cisstVector.h>
+#include <vector>
+#include <atomic>
 
 #include "cisstMesh.h"
 
+class PDTreeFileWriter;   // forward declerations
+class PDTreeFileReader;   //  ''
+
+// max number of triangles evaluated by one call of the batched kernels
+//  from a search (e.g. the datums of a PD tree leaf are evaluated in
+//  batches of this size)
+#define TCPS_BATCH_SIZE 16
+
+// number of triangles whose compact precomputations are computed together
+//  on first use (see initCompact())
+#define TCPS_LAZY_BLOCK_SIZE 64
+
 class TriangleClosestPointSolver
 {
 protected:
@@ -60,14 +74,44 @@ protected:
   vctDynamicVector<vct2>      E13;  // edge normal direction for edge P1P3
   vctDynamicVector<vct2>      E23;  // edge normal direction for edge P2P3
 
+  // vertex coordinates of the triangles in leaf order (see SetLeafOrder())
+  //  stored as 9 arrays (x, y, z of the first vertices, then of the second
+  //  and third vertices) for the batched kernels
+  vctDynamicVector<double>    leafCoords[9];
+  vctDynamicVector<int>       leafOrder;
+
+  // compact mode (see initCompact())
+  //  the vertices and triangles of the mesh are referenced rather than copied
+  //  and the rotation of each local triangle frame is stored as a single
+  //  precision unit quaternion (w, x, y, z); the other triangle properties
+  //  are recomputed from the vertices for each query
+  const vctDynamicVector<vct3>     *pVertices;
+  const vctDynamicVector<vctInt3>  *pTriangles;
+  vctDynamicVector<float>     triQuat;
+  bool                        bLazy;
+  // lazy mode: block of quaternions is computed
+  //  (set with release order once the quaternions are stored and read with
+  //   acquire order, so a thread seeing the flag set also sees them)
+  std::vector< std::atomic<char> > quatBlockReady;
+
 public:
 
   // constructor without precomputations
-  TriangleClosestPointSolver() {};
+  TriangleClosestPointSolver() :
+    P1(0.0, 0.0),
+    E12(-1.0, 0.0),
+    pVertices(NULL), pTriangles(NULL), bLazy(false)
+  {};
 
   // constructor with mesh-based precomputations
   TriangleClosestPointSolver(const cisstMesh &mesh);
 
+  // constructor that copies the precomputations from another solver
+  //  for the same mesh if one is given (e.g. a solver loaded with a
+  //  PD tree file) or otherwise computes them from the mesh
+  TriangleClosestPointSolver(const cisstMesh &mesh,
+                             const TriangleClosestPointSolver *pPrecomputed);
+
   // constructor with mesh-based precomputations
   TriangleClosestPointSolver( 
     const vctDynamicVector<vct3> &vertices,
@@ -80,6 +124,49 @@ public:
     const vctDynamicVector<vct3> &vertices, 
     const vctDynamicVector<vctInt3> &triangles );
 
+  // updates the precomputations for a deformed mesh having the same
+  //  triangles, returning the number of triangles updated
+  //  Only vertices moved by more than tol from the vertex positions last
+  //  used are updated, so the precomputed triangles are within tol of the
+  //  given mesh. In compact mode the vertices are referenced and so all
+  //  triangles are updated. The leaf order coordinates are also updated.
+  //  triMoved - flags for each triangle that was updated
+  int Refit(
+    const vctDynamicVector<vct3> &vertices,
+    double tol,
+    vctDynamicVector<char> &triMoved );
+
+  // initializes the triangle object in compact mode
+  //  The vertices and triangles are referenced, and so must outlive the
+  //  solver and remain unchanged. Only a single precision quaternion is
+  //  stored per triangle (16 bytes rather than about 300 bytes), which places
+  //  closest points within about 1e-7 times the distance from the first
+  //  triangle vertex of the exact closest point.
+  //  bLazy - compute the quaternions of a block of triangles when one of
+  //          them is first searched rather than for all triangles here,
+  //          which avoids the precomputation time for triangles never
+  //          searched (safe for concurrent searches)
+  void initCompact(
+    const vctDynamicVector<vct3> &vertices,
+    const vctDynamicVector<vctInt3> &triangles,
+    bool bLazy = false );
+  bool IsCompact() const { return pVertices != NULL; }
+
+  // memory (in bytes) held by the solver for the mesh precomputations
+  //  (including the leaf order coordinates)
+  size_t MemoryUsage() const;
+
+  // save / load the per-triangle precomputations as a section of
+  //  a PD tree file (see PDTreeFile.h)
+  //  load returns 0 on success, or 1 if the file holds no solver data
+  void Save( PDTreeFileWriter &file ) const;
+  int  Load( const PDTreeFileReader &file, const cisstMesh &mesh );
+
+  // hash of the vertices and triangles of a mesh, saved with a PD tree
+  //  built on the mesh to reject a file saved for a different mesh
+  //  (see PDTreeBase::DatumFingerprint())
+  static unsigned long long MeshFingerprint( const cisstMesh &mesh );
+
   // most efficient routine, which uses triangle properties pre-computed from a mesh
   void FindClosestPointOnTriangle( 
     const vct3 &point, 
@@ -113,6 +200,48 @@ public:
     const vct3x3 &N, const vct3x3 &Ninv,
     vct3 &closestPoint);
 
+  //--- Batched Kernels ---//
+  //
+  // These compute the square distance from a point to each of a batch of
+  //  triangles, whose vertex coordinates are given as 9 arrays in the order
+  //  of leafCoords (structure of arrays). When the library is built with
+  //  AVX-512 or AVX2 kernels (USE_AVX512 / USE_AVX2) and the processor
+  //  supports them, 8 or 4 triangles are evaluated at once; otherwise the
+  //  triangles are evaluated one at a time (see TriangleDistanceKernels.inl).
+  // The distances are used to rank the triangles; the closest point on a
+  //  selected triangle is then found by FindClosestPointOnTriangle(), which
+  //  agrees with these distances up to round-off.
+  //
+
+  static void ComputeSquareDistances(
+    const vct3 &point,
+    const double * const coords[9],
+    int count,
+    double *sqrDist);
+
+  // store the vertex coordinates of the triangles in the given order,
+  //  e.g. the datum order of a PD tree, in which the datums of each leaf
+  //  node are contiguous (see PDTreeBase::DatumOrder())
+  void SetLeafOrder(const int *order, int numTriangles);
+  int  LeafOrderSize() const { return (int)leafCoords[0].size(); }
+
+  // square distances to the triangles at positions [first, first + count)
+  //  of the leaf order
+  void ComputeLeafSquareDistances(
+    const vct3 &point,
+    int first, int count,
+    double *sqrDist) const;
+
+  // store the vertices of a triangle transformed by N relative to a point,
+  //  i.e. N*(vertex - point), at position i of a batch of coordinates
+  //  The square distance of the transformed triangle from the origin is the
+  //  square Mahalanobis distance of the point from the triangle for the
+  //  covariance inv(N'*N) (see FindMostLikelyPointOnTriangle()).
+  void TransformedTriangleCoords(
+    int triangleIndex,
+    const vct3 &point, const vct3x3 &N,
+    double * const coords[9], int i) const;
+
 protected:
 
   void FindClosestPointOnTriangle(
@@ -127,6 +256,29 @@ protected:
     const vct2 &E13,
     const vct2 &E23 );
 
+  // computes the in-plane triangle properties from the xfm to local triangle
+  //  coordinates (as for the one-off triangles and for compact mode)
+  void FindClosestPointOnTriangle(
+    const vct3 &point,
+    const vct3 &v2,
+    const vct3 &v3,
+    const vctFrm3 &triXfm,
+    vct3 &closestPoint );
+
+  // computes the precomputed properties of a triangle from its vertices
+  void ComputeTriangleProperties( int triIdx );
+
+  // compact mode accessors
+  int NumTriangles() const { return pTriangles ? (int)pTriangles->size() : (int)triangles.size(); }
+  const vct3& Vertex( int triangleIndex, int vx ) const
+  {
+    return pVertices ?
+      (*pVertices)[(*pTriangles)[triangleIndex][vx]] :
+      vertices[triangles[triangleIndex][vx]];
+  }
+  void CompactRotation( int triangleIndex, vctRot3 &R );
+  void ComputeCompactBlock( int block );
+
   // computes xfm to local triangle coordinates such that
   //   P1   at origin
   //   P2   on z-axis
@@ -0,0 +1,222 @@
+// ****************************************************************************
+//
+//    Copyright (c) 2014, Seth Billings, Russell Taylor, Johns Hopkins University
+//    All rights reserved.
+//
+//    Redistribution and use in source and binary forms, with or without
+//    modification, are permitted provided that the following conditions are
+//    met:
+//
+//    1. Redistributions of source code must retain the above copyright
+//    notice, this list of conditions and the following disclaimer.
+//
+//    2. Redistributions in binary form must reproduce the above copyright
+//    notice, this list of conditions and the following disclaimer in the
+//    documentation and/or other materials provided with the distribution.
+//
+//    3. Neither the name of the copyright holder nor the names of its
+//    contributors may be used to endorse or promote products derived from
+//    this software without specific prior written permission.
+//
+//    THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+//    "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+//    LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+//    A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+//    HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+//    SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+//    LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+//    DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+//    THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+//    (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+//    OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//  
+// ****************************************************************************
+
+// Batched square distance kernel of TriangleClosestPointSolver
+//
+//  This file is compiled twice: by TriangleClosestPointSolver.cpp for the
+//  scalar kernel, and by TriangleClosestPointSolver_SIMD.cpp, with the SIMD
+//  instruction set enabled, for the SIMD kernel. The including file defines
+//  TCPS_KERNEL(name) to give the entry point of each a distinct name.
+//
+//  The SIMD build must not instantiate inline or template code of other
+//  headers (e.g. cisstVector): the linker may keep that SIMD copy for the
+//  whole program, which then fails on processors without the instruction
+//  set. The kernel therefore takes plain arrays and includes only the
+//  intrinsics and C headers.
+//
+
+#include <float.h>
+
+// SIMD width of the batched kernels
+//  (set by the instruction sets enabled for the compiler, e.g. by
+//   the USE_AVX2 / USE_AVX512 build options for TriangleClosestPointSolver_SIMD.cpp)
+#if defined(__AVX512F__)
+#include <immintrin.h>
+#define TCPS_SIMD_WIDTH 8
+#elif defined(__AVX2__)
+#include <immintrin.h>
+#define TCPS_SIMD_WIDTH 4
+#else
+#define TCPS_SIMD_WIDTH 1
+#endif
+
+namespace {
+
+  //--- Batched Kernel Operations ---//
+  //
+  // The square distance of a triangle is written once in terms of these
+  //  operations and instantiated for a single triangle (double) and for
+  //  the SIMD vector type.
+  //
+
+  inline double Load(const double *p, double) { return *p; }
+  inline void   Store(double *p, double a) { *p = a; }
+  inline double Add(double a, double b) { return a + b; }
+  inline double Sub(double a, double b) { return a - b; }
+  inline double Mul(double a, double b) { return a * b; }
+  inline double Div(double a, double b) { return a / b; }
+  inline double Min(double a, double b) { return a < b ? a : b; }
+  inline double Max(double a, double b) { return a > b ? a : b; }
+  inline bool   GreaterEq(double a, double b) { return a >= b; }
+  inline bool   And(bool a, bool b) { return a && b; }
+  inline double Select(bool mask, double a, double b) { return mask ? a : b; }
+
+#if TCPS_SIMD_WIDTH == 8
+  typedef __m512d SimdVec;
+  typedef __mmask8 SimdMask;
+  inline SimdVec Load(const double *p, SimdVec) { return _mm512_loadu_pd(p); }
+  inline void    Store(double *p, SimdVec a) { _mm512_storeu_pd(p, a); }
+  inline SimdVec Splat(double a) { return _mm512_set1_pd(a); }
+  inline SimdVec Add(SimdVec a, SimdVec b) { return _mm512_add_pd(a, b); }
+  inline SimdVec Sub(SimdVec a, SimdVec b) { return _mm512_sub_pd(a, b); }
+  inline SimdVec Mul(SimdVec a, SimdVec b) { return _mm512_mul_pd(a, b); }
+  inline SimdVec Div(SimdVec a, SimdVec b) { return _mm512_div_pd(a, b); }
+  inline SimdVec Min(SimdVec a, SimdVec b) { return _mm512_min_pd(a, b); }
+  inline SimdVec Max(SimdVec a, SimdVec b) { return _mm512_max_pd(a, b); }
+  inline SimdMask GreaterEq(SimdVec a, SimdVec b) { return _mm512_cmp_pd_mask(a, b, _CMP_GE_OQ); }
+  inline SimdMask And(SimdMask a, SimdMask b) { return (SimdMask)(a & b); }
+  inline SimdVec Select(SimdMask mask, SimdVec a, SimdVec b) { return _mm512_mask_blend_pd(mask, b, a); }
+#elif TCPS_SIMD_WIDTH == 4
+  typedef __m256d SimdVec;
+  typedef __m256d SimdMask;
+  inline SimdVec Load(const double *p, SimdVec) { return _mm256_loadu_pd(p); }
+  inline void    Store(double *p, SimdVec a) { _mm256_storeu_pd(p, a); }
+  inline SimdVec Splat(double a) { return _mm256_set1_pd(a); }
+  inline SimdVec Add(SimdVec a, SimdVec b) { return _mm256_add_pd(a, b); }
+  inline SimdVec Sub(SimdVec a, SimdVec b) { return _mm256_sub_pd(a, b); }
+  inline SimdVec Mul(SimdVec a, SimdVec b) { return _mm256_mul_pd(a, b); }
+  inline SimdVec Div(SimdVec a, SimdVec b) { return _mm256_div_pd(a, b); }
+  inline SimdVec Min(SimdVec a, SimdVec b) { return _mm256_min_pd(a, b); }
+  inline SimdVec Max(SimdVec a, SimdVec b) { return _mm256_max_pd(a, b); }
+  inline SimdMask GreaterEq(SimdVec a, SimdVec b) { return _mm256_cmp_pd(a, b, _CMP_GE_OQ); }
+  inline SimdMask And(SimdMask a, SimdMask b) { return _mm256_and_pd(a, b); }
+  inline SimdVec Select(SimdMask mask, SimdVec a, SimdVec b) { return _mm256_blendv_pd(b, a, mask); }
+#endif
+
+  // square distance from the origin to the segment o + t*e, t in [0,1]
+  template <class V>
+  inline V SquareDistanceToSegment(
+    V ox, V oy, V oz, V ex, V ey, V ez, V zero, V one, V tiny)
+  {
+    V ee = Add(Add(Mul(ex, ex), Mul(ey, ey)), Mul(ez, ez));
+    V oe = Add(Add(Mul(ox, ex), Mul(oy, ey)), Mul(oz, ez));
+    V t = Div(Sub(zero, oe), Max(ee, tiny));
+    t = Min(Max(t, zero), one);
+    V qx = Add(ox, Mul(t, ex));
+    V qy = Add(oy, Mul(t, ey));
+    V qz = Add(oz, Mul(t, ez));
+    return Add(Add(Mul(qx, qx), Mul(qy, qy)), Mul(qz, qz));
+  }
+
+  // square distance from point p to the triangles starting at element i
+  //  of the coordinate arrays
+  //  The point is closest to the triangle interior if its projection onto
+  //  the triangle plane has non-negative area coordinates; otherwise it is
+  //  closest to one of the edges. Degenerate triangles (sine of the angle
+  //  between two edges below sqrt(eps)) are handled as their edges.
+  template <class V>
+  inline V SquareDistanceToTriangle(
+    V px, V py, V pz, const double * const coords[9], int i,
+    V zero, V one, V tiny, V eps)
+  {
+    // triangle vertices relative to the point
+    V ax = Sub(Load(coords[0] + i, px), px);
+    V ay = Sub(Load(coords[1] + i, px), py);
+    V az = Sub(Load(coords[2] + i, px), pz);
+    V bx = Sub(Load(coords[3] + i, px), px);
+    V by = Sub(Load(coords[4] + i, px), py);
+    V bz = Sub(Load(coords[5] + i, px), pz);
+    V cx = Sub(Load(coords[6] + i, px), px);
+    V cy = Sub(Load(coords[7] + i, px), py);
+    V cz = Sub(Load(coords[8] + i, px), pz);
+
+    // edges and normal
+    V abx = Sub(bx, ax), aby = Sub(by, ay), abz = Sub(bz, az);
+    V bcx = Sub(cx, bx), bcy = Sub(cy, by), bcz = Sub(cz, bz);
+    V cax = Sub(ax, cx), cay = Sub(ay, cy), caz = Sub(az, cz);
+    V nx = Sub(Mul(cay, abz), Mul(caz, aby));   // n = ca x ab
+    V ny = Sub(Mul(caz, abx), Mul(cax, abz));
+    V nz = Sub(Mul(cax, aby), Mul(cay, abx));
+    V nn = Add(Add(Mul(nx, nx), Mul(ny, ny)), Mul(nz, nz));
+    V minNN = Mul(eps, Mul(
+      Add(Add(Mul(abx, abx), Mul(aby, aby)), Mul(abz, abz)),
+      Add(Add(Mul(cax, cax), Mul(cay, cay)), Mul(caz, caz))));
+
+    // area coordinates of the projected point (scaled by nn)
+    //  u = (b x c).n   v = (c x a).n   w = (a x b).n
+    V u = Add(Add(
+      Mul(Sub(Mul(by, cz), Mul(bz, cy)), nx),
+      Mul(Sub(Mul(bz, cx), Mul(bx, cz)), ny)),
+      Mul(Sub(Mul(bx, cy), Mul(by, cx)), nz));
+    V v = Add(Add(
+      Mul(Sub(Mul(cy, az), Mul(cz, ay)), nx),
+      Mul(Sub(Mul(cz, ax), Mul(cx, az)), ny)),
+      Mul(Sub(Mul(cx, ay), Mul(cy, ax)), nz));
+    V w = Sub(nn, Add(u, v));
+
+    // distance to the plane
+    V s = Add(Add(Mul(ax, nx), Mul(ay, ny)), Mul(az, nz));
+    V planeDist = Div(Mul(s, s), Max(nn, tiny));
+
+    // distance to the edges
+    V edgeDist = Min(
+      SquareDistanceToSegment(ax, ay, az, abx, aby, abz, zero, one, tiny),
+      Min(SquareDistanceToSegment(bx, by, bz, bcx, bcy, bcz, zero, one, tiny),
+          SquareDistanceToSegment(cx, cy, cz, cax, cay, caz, zero, one, tiny)));
+
+    return Select(
+      And(And(GreaterEq(u, zero), GreaterEq(v, zero)), And(GreaterEq(w, zero), GreaterEq(nn, Max(minNN, tiny)))),
+      planeDist, edgeDist);
+  }
+
+}
+
+
+// square distances from point to the triangles of the coordinate arrays
+//  (see TriangleClosestPointSolver::ComputeSquareDistances)
+void TCPS_KERNEL(ComputeTriangleSquareDistances)(
+  const double point[3],
+  const double * const coords[9],
+  int count,
+  double *sqrDist)
+{
+  const double tiny = DBL_MIN;
+  const double eps = 1e-14;
+  int i = 0;
+#if TCPS_SIMD_WIDTH > 1
+  SimdVec px = Splat(point[0]);
+  SimdVec py = Splat(point[1]);
+  SimdVec pz = Splat(point[2]);
+  SimdVec zero = Splat(0.0), one = Splat(1.0), tinyV = Splat(tiny), epsV = Splat(eps);
+  for (; i + TCPS_SIMD_WIDTH <= count; i += TCPS_SIMD_WIDTH)
+  {
+    Store(sqrDist + i, SquareDistanceToTriangle(px, py, pz, coords, i, zero, one, tinyV, epsV));
+  }
+#endif
+  // remaining triangles
+  for (; i < count; i++)
+  {
+    sqrDist[i] = SquareDistanceToTriangle(point[0], point[1], point[2], coords, i, 0.0, 1.0, tiny, eps);
+  }
+}
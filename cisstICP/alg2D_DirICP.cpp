@@ -134,34 +134,22 @@ void alg2D_DirICP::ICP_ComputeMatches()
   // Find the point on the model having lowest match error
   //  for each sample point
 
-#ifdef ValidatePDTreeSearch  
-  numInvalidDatums = 0;
-  numValidDatums = 0;
-#endif
+  PDTreeSearchStats stats;
+  pDirTree->FindClosestDatums(
+    samplePtsXfmd, sampleNormsXfmd,
+    matchDatums,
+    matchDatums, matchPts, matchNorms, matchErrors,
+    stats, this);
 
-  unsigned int nodesSearched = 0;
-  minNodesSearched = std::numeric_limits<unsigned int>::max();
-  maxNodesSearched = std::numeric_limits<unsigned int>::min();
-  avgNodesSearched = 0;
+  minNodesSearched = stats.minNodesSearched;
+  maxNodesSearched = stats.maxNodesSearched;
+  avgNodesSearched = (int)stats.avgNodesSearched;
 
+#ifdef ValidatePDTreeSearch
+  numInvalidDatums = 0;
+  numValidDatums = 0;
   for (unsigned int s = 0; s < nSamples; s++)
   {
-    // inform algorithm beginning new match
-    SamplePreMatch(s);
-
-    // Find best match for this sample
-    matchDatums.Element(s) = pDirTree->FindClosestDatum(
-      samplePtsXfmd.Element(s), sampleNormsXfmd.Element(s),
-      matchPts.Element(s), matchNorms.Element(s),
-      matchDatums.Element(s),
-      matchErrors.Element(s),
-      nodesSearched);
-
-    avgNodesSearched += nodesSearched;
-    minNodesSearched = (nodesSearched < minNodesSearched) ? nodesSearched : minNodesSearched;
-    maxNodesSearched = (nodesSearched > maxNodesSearched) ? nodesSearched : maxNodesSearched;
-
-#ifdef ValidatePDTreeSearch        
     validDatum = pDirTree->ValidateClosestDatum( 
       samplePtsXfmd.Element(s), sampleNormsXfmd.Element(s),
       validPoint, validNorm );
@@ -224,15 +212,10 @@ void alg2D_DirICP::ICP_ComputeMatches()
     else
     {
       numValidDatums++;
+    }
   }
 #endif
 
-    // inform algorithm that match completed
-    SamplePostMatch(s);
-}
-
-  avgNodesSearched /= nSamples;
-
 #ifdef ValidatePDTreeSearch  
   validPercent = (double)numValidDatums / (double)nSamples;
   validFS << "iter " << validIter << ":  NumMatches(valid/invalid): "
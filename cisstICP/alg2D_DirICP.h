@@ -43,7 +43,7 @@
 //#define ValidatePDTreeSearch
 
 
-class alg2D_DirICP
+class alg2D_DirICP : public DirPDTreeMatchCallback
 {
   //
   // This is the base class for a family of ICP algorithms
@@ -107,6 +107,7 @@ protected:
 
   virtual void  UpdateSampleXfmPositions(const vctFrm2 &F);
 
+  // called by the tree's batch search for each sample (see DirPDTreeMatchCallback)
   virtual void  SamplePreMatch(unsigned int sampleIndex) {};
   virtual void  SamplePostMatch(unsigned int sampleIndex) {};
 
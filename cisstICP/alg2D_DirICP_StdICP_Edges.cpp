@@ -38,7 +38,11 @@
 void alg2D_DirICP_StdICP_Edges::SamplePostMatch(unsigned int sampleIndex)
 {
   // keep lambda of final match
-  matchLambdas.Element(sampleIndex) = searchLambdas.Element(matchDatums(sampleIndex));
+  //  (the sample is projected onto the matched edge again rather than
+  //   recording the lambda of every edge searched, which would be shared
+  //   by the threads of a parallel search)
+  alg2D_DirPDTree_CP_Edges::pDirTree->GetEdge(matchDatums(sampleIndex)).ProjectOnEdge(
+    samplePtsXfmd(sampleIndex), &matchLambdas.Element(sampleIndex));
 }
 
 
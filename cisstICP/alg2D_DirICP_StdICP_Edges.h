@@ -90,6 +90,9 @@ public:
     matchLambdas.SetSize(samplePts.size());
   }
 
+  // the edge search algorithm and the hooks write only per-sample state
+  bool  ParallelMatchSafe() const { return true; }
+
   void  SamplePreMatch(unsigned int sampleIndex) {}
   void  SamplePostMatch(unsigned int sampleIndex);
 
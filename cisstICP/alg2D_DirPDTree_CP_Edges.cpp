@@ -39,8 +39,7 @@ double alg2D_DirPDTree_CP_Edges::FindClosestPointOnDatum(
   int datum)
 {
   // Project point onto the edge
-  //  (storing lambda value in temp buffer)
-  closest = pDirTree->GetEdge(datum).ProjectOnEdge(v, &searchLambdas.Element(datum));
+  closest = pDirTree->GetEdge(datum).ProjectOnEdge(v);
   closestNorm = pDirTree->GetEdge(datum).Norm;
 
   // return distance as match error
@@ -50,15 +50,6 @@ protected:
 
   DirPDTree2D_Edges *pDirTree;
 
-public:
-
-  // temporary buffer storage used to help determine matchLambdas
-  //  (since current architecture cannot store the matchLambdas directly)
-  //  matchPt = (edgeV2-edgeV1)*matchLambda + edgeV1
-  //
-  //  (stores matchLambda for each datum searched)
-  vctDoubleVec    searchLambdas;
-
 
   //--- Algorithm Methods ---//
 
@@ -68,9 +59,7 @@ public:
   alg2D_DirPDTree_CP_Edges(DirPDTree2D_Edges *pDirTree) :
     alg2D_DirPDTree_CP(pDirTree),
     pDirTree(pDirTree)
-  {
-    searchLambdas.SetSize(pDirTree->EdgeList.numEdges);
-  }
+  {}
 
   // destructor
   virtual ~alg2D_DirPDTree_CP_Edges() {}
@@ -32,6 +32,7 @@
 //  
 // ****************************************************************************
 #include "algDirICP.h"
+#include "ICPTrace.h"
 
 
 #ifdef ValidatePDTreeSearch
@@ -213,37 +214,27 @@ void  algDirICP::ICP_UpdateParameters_PostRegister(vctFrm3 &Freg)
 
 void algDirICP::ICP_ComputeMatches()
 {
+  ICPTRACE_SCOPE("ComputeMatches", "samples", nSamples);
+
   // Find the point on the model having lowest match error
   //  for each sample point
 
-#ifdef ValidatePDTreeSearch  
-  numInvalidDatums = 0;
-  numValidDatums = 0;
-#endif
+  pDirTree->FindClosestDatums(
+    samplePtsXfmd, sampleNormsXfmd,
+    matchDatums,
+    matchDatums, matchPts, matchNorms, matchErrors,
+    matchStats, this,
+    sampleSearchOrder.size() == nSamples ? &sampleSearchOrder : NULL);
 
-  unsigned int nodesSearched = 0;
-  minNodesSearched = std::numeric_limits<unsigned int>::max();
-  maxNodesSearched = std::numeric_limits<unsigned int>::min();
-  avgNodesSearched = 0;
+  minNodesSearched = matchStats.minNodesSearched;
+  maxNodesSearched = matchStats.maxNodesSearched;
+  avgNodesSearched = (int)matchStats.avgNodesSearched;
 
+#ifdef ValidatePDTreeSearch
+  numInvalidDatums = 0;
+  numValidDatums = 0;
   for (unsigned int s = 0; s < nSamples; s++)
   {
-    // inform algorithm beginning new match
-    SamplePreMatch(s);
-
-    // Find best match for this sample
-    matchDatums.Element(s) = pDirTree->FindClosestDatum(
-      samplePtsXfmd.Element(s), sampleNormsXfmd.Element(s),
-      matchPts.Element(s), matchNorms.Element(s),
-      matchDatums.Element(s),
-      matchErrors.Element(s),
-      nodesSearched);
-
-    avgNodesSearched += nodesSearched;
-    minNodesSearched = (nodesSearched < minNodesSearched) ? nodesSearched : minNodesSearched;
-    maxNodesSearched = (nodesSearched > maxNodesSearched) ? nodesSearched : maxNodesSearched;
-
-#ifdef ValidatePDTreeSearch        
     validDatum = pDirTree->ValidateClosestDatum(
       samplePtsXfmd.Element(s), sampleNormsXfmd.Element(s),
       validPoint, validNorm);
@@ -308,10 +299,8 @@ void algDirICP::ICP_ComputeMatches()
     {
       numValidDatums++;
     }
-#endif
   }
-
-  avgNodesSearched /= nSamples;
+#endif
 
 #ifdef ValidatePDTreeSearch  
   validPercent = (double)numValidDatums / (double)nSamples;
@@ -43,7 +43,7 @@
 //#define ValidatePDTreeSearch
 
 
-class algDirICP : public algICP
+class algDirICP : public algICP, public DirPDTreeMatchCallback
 {
   //
   // This is the base class for a family of ICP algorithms
@@ -109,6 +109,7 @@ protected:
 
   virtual void  UpdateSampleXfmPositions(const vctFrm3 &F);
 
+  // called by the tree's batch search for each sample (see DirPDTreeMatchCallback)
   virtual void  SamplePreMatch(unsigned int sampleIndex) {};
   virtual void  SamplePostMatch(unsigned int sampleIndex) {};
 
@@ -36,6 +36,10 @@
 #include "DirPDTreeNode.h"
 #include "RegisterP2P.h"
 #include "utilities.h"
+#include "CovBatchKernels.h"
+
+#include <cisstOSAbstraction.h>
+#include <omp.h>
 
 #define EPS  1e-12
 
@@ -56,8 +60,14 @@ algDirICP_DIMLOP::algDirICP_DIMLOP(
 	dlib(this),
 	pDirTree(pDirTree),
 	pMesh(&pDirTree->mesh),
-	TCPS(pDirTree->mesh)
+	TCPS(pDirTree->mesh, pDirTree->PrecomputedTCPS())
 {
+   refitTol = 0.0;
+   rebuildRatio = 1.5;
+   nRefitTriangles = 0;
+   nRebuilds = 0;
+   refitTime = 0.0;
+
    // Ensure SetSamples function of this derived class gets called
    SetSamples(samplePts, sampleNorms, sampleCov, sampleMsmtCov, meanShape, scale, bScale);
 }
@@ -89,16 +99,17 @@ void algDirICP_DIMLOP::ComputeMatchStatistics(double &Avg, double &StdDev)
 
 	nGoodSamples = 0;
 
-	vct3x3 M, Minv;
 	vct3 residual;
 
+	// M = R*Mxi*Rt  (+*Myi[i] is not included)
+	MxiCache.Update(Freg.Rotation(), 0.0);
+
 	// NOTE: if using a method with outlier rejection, it may be desirable to
 	//       compute statistics on only the inliers
 	for (unsigned int i = 0; i < nSamples; i++)
 	{
 		residual = Tssm_Y[i] - (Freg * samplePts[i]) * sc;
-		M = Freg.Rotation() * Mxi[i] * Freg.Rotation().Transpose();// +*Myi[i];
-		ComputeCovInverse_NonIter(M, Minv);
+		const vct3x3 &Minv = MxiCache.Inverse(i);
 
 		sqrMahalDist = residual*Minv*residual;
 		totalSumSqrMahalDist += sqrMahalDist;
@@ -139,6 +150,8 @@ void algDirICP_DIMLOP::PrintMatchStatistics(std::stringstream &tMsg)
 	tMsg << "\nSum square match angle = " << totalSumSqrMatchAngle << " over " << nSamples << " samples";
 	tMsg << "\nSum square mahalanobis distance = " << sumSqrMahalDist << " over " << nGoodSamples << " inliers";
 	tMsg << "\nSum square match angle = " << sumSqrMatchAngle << " over " << nGoodSamples << " inliers\n";
+	tMsg << "Shape refit: " << nRefitTriangles << " triangles updated, " << nRebuilds << " tree rebuilds, "
+		<< refitTime << " sec total\n";
 }
 
 //void algDirICP_DIMLOP::ComputeMatchStatistics(
@@ -192,10 +205,8 @@ void algDirICP_DIMLOP::SetSamples(
   meanShape = argMeanShape;
 
   eigMxi.SetSize(nSamples);
-  for (unsigned int i = 0; i < nSamples; i++)
-  {
-	  ComputeCovEigenValues_SVD(argMxi[i], eigMxi[i]);
-  }
+  ComputeCovEigenValues_Batch(argMxi.Pointer(), nSamples, eigMxi.Pointer());
+  MxiCache.SetCovariances(argMxi);
 
   R_Mxi_Rt.SetSize(nSamples);
   R_MsmtMxi_Rt.SetSize(nSamples);
@@ -222,10 +233,9 @@ void algDirICP_DIMLOP::SetSamples(
 
   Si = pDirTree->mesh.Si; 
   wi = pDirTree->mesh.wi;
+  if (!pMesh->HasModeMatrix())
+	  pMesh->BuildModeMatrix();
 
-  Tssm_wi.resize(nModes);
-  for (int i = 0; i < Tssm_wi.size(); i++)
-	  Tssm_wi[i].resize(nSamples);
   Tssm_matchPts.resize(nSamples);
 
   Tssm_Y.resize(nSamples);
@@ -243,23 +253,27 @@ void algDirICP_DIMLOP::SetSamples(
 void algDirICP_DIMLOP::UpdateShape(vctDynamicVector<double>	&S)
 {
 	// deformably transform each mesh vertex
-	pDirTree->mesh.vertices = meanShape;
-	int s;
-#ifdef ENABLE_PARALLELIZATION
-#pragma omp parallel for
-#endif
-	for (s = 0; s < pMesh->NumVertices(); s++)
-		for (unsigned int i = 0; i < nModes; i++)
-			pDirTree->mesh.vertices(s) += (S[i] * wi[i].Element(s));
-
+	//  (one matrix-vector product with the mode matrix of the mesh)
+	pMesh->SynthesizeShape(meanShape, S, pMesh->vertices);
 }
 
 void algDirICP_DIMLOP::UpdateTree()
 {
-	vctFrm3 FId;
-	FId.Assign(vctFrm3::Identity());
+	osaStopwatch refitTimer;
+	refitTimer.Reset();
+	refitTimer.Start();
+
+	// update the triangles and the tree bounds holding them
+	//  (rather than re-initializing the solver and enlarging all node bounds)
+	nRefitTriangles += TCPS.Refit(pDirTree->mesh.vertices, refitTol, triMoved);
+	pDirTree->RefitBounds(&triMoved, 2.0*refitTol);
+	if (pDirTree->RelativeTreeQuality() > rebuildRatio)
+	{
+		pDirTree->RebuildTree();
+		nRebuilds++;
+	}
 
-	pDirTree->EnlargeBounds(FId);
+	refitTime += refitTimer.GetElapsedTime();
 }
 
 void algDirICP_DIMLOP::ICP_ComputeMatches()
@@ -291,10 +305,10 @@ double algDirICP_DIMLOP::ICP_EvaluateErrorFunction()
   //double logC;
   //static const double log2PI = log(2 * cmnPI); // compute this once for efficiency
 
-  vctDynamicVector<vct3x3>  Mi(nSamples);           // noise covariances of match (R*Mxi*Rt + Myi)
-  vctDynamicVector<vct3x3>  inv_Mi(nSamples);       // inverse noise covariances of match (R*Mxi*Rt + Myi)^-1
-  vctDynamicVector<double>  det_Mi(nSamples);       // determinant of noise covariances of match |R*Mxi*Rt + Myi|
-  vctDynamicVector<double>  SqrMahalDist(nSamples); // square Mahalanobis distance of matches = (yi-Rxi-t)'*inv(Mi)*(yi-Rxi-t)
+  vct3x3  Mi;            // noise covariances of match (R*Mxi*Rt + Myi)
+  vct3x3  inv_Mi;        // inverse noise covariances of match (R*Mxi*Rt + Myi)^-1
+  double  det_Mi;        // determinant of noise covariances of match |R*Mxi*Rt + Myi|
+  double  SqrMahalDist;  // square Mahalanobis distance of matches = (yi-Rxi-t)'*inv(Mi)*(yi-Rxi-t)
 
   vct3 residual;
   double sumSqrDist = 0.0;
@@ -314,20 +328,20 @@ double algDirICP_DIMLOP::ICP_EvaluateErrorFunction()
 	// deformed shape after computing updating Si
     residual = samplePtsXfmd.Element(s) - Tssm_Y.Element(s);	// matchPts.Element(s);
 	// match covariance
-	Mi[s] = R_Mxi_Rt[s] + Myi_sigma2[s];
+	Mi = R_Mxi_Rt[s] + Myi_sigma2[s];
 	// match covariance decomposition
-	ComputeCovDecomposition_NonIter(Mi[s], inv_Mi[s], det_Mi[s]);
+	ComputeCovDecomposition_NonIter(Mi, inv_Mi, det_Mi);
 	// match square distance
 	sumSqrDist += residual.NormSquare();
 	// match square Mahalanobis distance
-	SqrMahalDist[s] = residual * inv_Mi[s] * residual;
+	SqrMahalDist = residual * inv_Mi * residual;
 
 	// -- Here We Compute the Full Negative Log-Likelihood -- //
 	// Compute error contribution for this sample
 	nlogkappa += log(k);
 	nklog2PI += 5.0*log(2.0*cmnPI); // 1/2
-	expCost += SqrMahalDist[s];		// 1/2
-	logCost += log(det_Mi[s]);		// 1/2
+	expCost += SqrMahalDist;		// 1/2
+	logCost += log(det_Mi);		// 1/2
 	logExp += log(exp(k) - exp(-k));
     sumNormProducts += vctDotProduct(sampleNormsXfmd.Element(s), matchNorms.Element(s));
   }
@@ -405,6 +419,44 @@ void algDirICP_DIMLOP::ComputeMu()
 	}
 }
 
+// Barycentric mode contributions of the matches
+//  The match point of sample j on the shape with parameters s is
+//    Tssm_Y[j] = Tssm_Y_mean[j] + sum_i s[i]*Tssm_wi[i][j]
+//  where Tssm_wi[i][j] = sum_v mu[j][v]*wi[i][f[j][v]]; these are computed
+//  once per registration, so the optimizer evaluations do not access the mesh
+void algDirICP_DIMLOP::ComputeModeBasis()
+{
+	modeBasis.SetSize(nSamples * nModes * 3);
+#ifdef ENABLE_PARALLELIZATION
+	gsThreadBuf.SetSize(omp_get_max_threads() * nModes);
+#else
+	gsThreadBuf.SetSize(nModes);
+#endif
+	Tssm_Y_mean.SetSize(nSamples);
+
+	int j;
+#ifdef ENABLE_PARALLELIZATION
+#pragma omp parallel for
+#endif
+	for (j = 0; j < (int)nSamples; j++)
+	{
+		Tssm_Y_mean[j] = mu[j][0] * meanShape[f[j][0]]
+			+ mu[j][1] * meanShape[f[j][1]]
+			+ mu[j][2] * meanShape[f[j][2]];
+
+		double *b = modeBasis.Pointer(j * nModes * 3);
+		for (unsigned int i = 0; i < nModes; i++)
+		{
+			vct3 w = mu[j][0] * wi[i][f[j][0]]
+				+ mu[j][1] * wi[i][f[j][1]]
+				+ mu[j][2] * wi[i][f[j][2]];
+			b[3 * i] = w[0];
+			b[3 * i + 1] = w[1];
+			b[3 * i + 2] = w[2];
+		}
+	}
+}
+
 void algDirICP_DIMLOP::ReturnScale(double &scale)
 {
 	scale = sc;
@@ -412,7 +464,7 @@ void algDirICP_DIMLOP::ReturnScale(double &scale)
 
 void algDirICP_DIMLOP::ReturnShapeParam(vctDynamicVector<double> &shapeParam)
 {
-	shapeParam = Si;
+	shapeParam.ForceAssign(Si);  // reallocates only if the size changes
 }
 
 void algDirICP_DIMLOP::ReturnMatchPts(vctDynamicVector<vct3> &rMatchPts, vctDynamicVector<vct3> &rMatchNorms)
@@ -439,13 +491,7 @@ vctFrm3 algDirICP_DIMLOP::ICP_RegisterMatches()
 	// x_prev must be at a different value than x0
 	x_prev.SetAll(std::numeric_limits<double>::max());
 
-	for (unsigned int j = 0; j < nSamples; j++)
-	{
-		for (unsigned int i = 0; i < nModes; i++)
-			Tssm_wi[i][j]	= mu[j][0] * wi[i][f[j][0]]
-							+ mu[j][1] * wi[i][f[j][1]]
-							+ mu[j][2] * wi[i][f[j][2]];
-	}
+	ComputeModeBasis();
 	x = dlib.ComputeRegistration(x0);
 
 	// update transform
@@ -480,30 +526,33 @@ void algDirICP_DIMLOP::UpdateOptimizerCalculations(const vctDynamicVector<double
 	// Rodrigues formulation
 	Ra = vctRot3(vctRodRot3(a));
 
-	X = samplePts;
+	X.ForceAssign(samplePts);  // reallocates only if the sample count changes
 	vctDynamicVectorRef<vct3>   X(samplePts);
-	vctDynamicVectorRef<vct3>   Mu(mu);
 
-	vctDynamicVector<vct3x3>  inv_Mxi(nSamples);       // inverse noise covariances of match Mxi^-1
-	vctDynamicVector<double>  det_Mxi(nSamples);       // determinant of noise covariances of match |Mxi|
 
-	// Update shape based on current s (and wi and meanshape)
 	// Compute Tssm_Y based on current Mu and shape
-	UpdateShape(s);
+	//  from the mode contributions of the matches (the full shape
+	//  is synthesized after the registration)
 	unsigned int j;
 #ifdef ENABLE_PARALLELIZATION
 #pragma omp parallel for
 #endif
 	for (j = 0; j < nSamples; j++)
 	{
-		Tssm_Y.Element(j) = Mu[j][0] * pMesh->vertices[f[j][0]]
-			+ Mu[j][1] * pMesh->vertices[f[j][1]]
-			+ Mu[j][2] * pMesh->vertices[f[j][2]];
+		const double *b = modeBasis.Pointer(j * nModes * 3);
+		vct3 y = Tssm_Y_mean[j];
+		for (unsigned int i = 0; i < nModes; i++)
+		{
+			y[0] += s[i] * b[3 * i];
+			y[1] += s[i] * b[3 * i + 1];
+			y[2] += s[i] * b[3 * i + 2];
+		}
+		Tssm_Y.Element(j) = y;
 
 		Tssm_Y_t.Element(j) = Tssm_Y.Element(j) - t;
 		Rat_Tssm_Y_t_x.Element(j) = Ra.Transpose() * Tssm_Y_t.Element(j) - sc * X.Element(j);
-		ComputeCovDecomposition_NonIter(Mxi.Element(j), inv_Mxi.Element(j), det_Mxi.Element(j));
-		Rat_Tssm_Y_t_x_invMx.Element(j) = Rat_Tssm_Y_t_x.Element(j) * inv_Mxi.Element(j); 
+		// inverse noise covariance of match Mxi^-1 (decomposed once per sample set)
+		Rat_Tssm_Y_t_x_invMx.Element(j) = Rat_Tssm_Y_t_x.Element(j) * MxiCache.SampleInverse(j); 
 		Yn_Rat_Xn.Element(j) = vctDotProduct(Ra * sampleNorms.Element(j), matchNorms.Element(j));
 	}
 	x_prev = x;
@@ -520,7 +569,7 @@ double algDirICP_DIMLOP::CostFunctionValue(const vctDynamicVector<double> &x)
 	double f = 0.0;
 	unsigned int i;
 #ifdef ENABLE_PARALLELIZATION
-#pragma omp parallel for
+#pragma omp parallel for reduction(+:f)
 #endif
 	for (i = 0; i < nSamples; i++)
 	{
@@ -559,30 +608,61 @@ void algDirICP_DIMLOP::CostFunctionGradient(const vctDynamicVector<double> &x, v
 		gsc.SetRef(g, 6);
 	vctDynamicVectorRef<double> gs(g, nTrans, nModes);
 
-	vct3x3 Jz_a;
-	vct3 k_Yn_dRa_Xn;
-
-	unsigned int j;
+	// each thread accumulates its own gradient, which are summed at the end
 #ifdef ENABLE_PARALLELIZATION
-#pragma omp parallel for
+#pragma omp parallel
 #endif
-	for (j = 0; j < nSamples; j++)
 	{
-		if (outlierFlags[j])	continue;
+		vct3 ga_j(0.0), gt_j(0.0);
+		double gsc_j = 0.0;
+		// shape gradient sums of this thread (preallocated in ComputeModeBasis())
+#ifdef ENABLE_PARALLELIZATION
+		double *gs_j = gsThreadBuf.Pointer(omp_get_thread_num() * nModes);
+#else
+		double *gs_j = gsThreadBuf.Pointer();
+#endif
+		for (unsigned int i = 0; i < nModes; i++)
+			gs_j[i] = 0.0;
+		vct3x3 Jz_a;
+		vct3 k_Yn_dRa_Xn;
 
-		for (unsigned int c = 0; c < 3; c++)
+		unsigned int j;
+#ifdef ENABLE_PARALLELIZATION
+#pragma omp for
+#endif
+		for (j = 0; j < nSamples; j++)
 		{
-			Jz_a.Column(c) = dRa[c].TransposeRef() * Tssm_Y_t[j]; 
-			k_Yn_dRa_Xn.Element(c) = -k*sampleNorms[j] * dRa[c].TransposeRef() * matchNorms[j];
+			if (outlierFlags[j])	continue;
+
+			for (unsigned int c = 0; c < 3; c++)
+			{
+				Jz_a.Column(c) = dRa[c].TransposeRef() * Tssm_Y_t[j]; 
+				k_Yn_dRa_Xn.Element(c) = -k*sampleNorms[j] * dRa[c].TransposeRef() * matchNorms[j];
+			}
+
+			ga_j += Rat_Tssm_Y_t_x_invMx[j] * Jz_a + k_Yn_dRa_Xn;
+			gt_j += Rat_Tssm_Y_t_x_invMx[j] * (-Ra.Transpose());
+			if (bScale)
+				gsc_j += Rat_Tssm_Y_t_x_invMx[j]* (-X.Element(j));
+
+			// Cmatch component:  r'*Ra'*Tssm_wi[i][j] = (Ra*r)'*Tssm_wi[i][j]
+			vct3 q = Ra * Rat_Tssm_Y_t_x_invMx[j];
+			const double *b = modeBasis.Pointer(j * nModes * 3);
+			for (unsigned int i = 0; i < nModes; i++)
+				gs_j[i] += q[0] * b[3 * i] + q[1] * b[3 * i + 1] + q[2] * b[3 * i + 2];
 		}
 
-		ga += Rat_Tssm_Y_t_x_invMx[j] * Jz_a + k_Yn_dRa_Xn;
-		gt += Rat_Tssm_Y_t_x_invMx[j] * (-Ra.Transpose());
-		if (bScale)
-			gsc += Rat_Tssm_Y_t_x_invMx[j]* (-X.Element(j));
-
-		for (unsigned int i = 0; i < nModes; i++)
-			gs[i] += Rat_Tssm_Y_t_x_invMx[j] * (Ra.Transpose() * Tssm_wi[i][j]);	// Cmatch component	
+#ifdef ENABLE_PARALLELIZATION
+#pragma omp critical (algDirICP_DIMLOP_CostFunctionGradient)
+#endif
+		{
+			ga += ga_j;
+			gt += gt_j;
+			if (bScale)
+				gsc[0] += gsc_j;
+			for (unsigned int i = 0; i < nModes; i++)
+				gs[i] += gs_j[i];
+		}
 	}
 
 #ifdef NOREGULARIZER
@@ -614,7 +694,7 @@ void algDirICP_DIMLOP::ICP_InitializeParameters(vctFrm3 &FGuess)
   R_MsmtMxi_Rt.SetAll(vct3x3(0.0));
 
   Myi_sigma2.SetAll(vct3x3::Eye());
-  Myi.SetAll(NULL);
+  Myi.SetAll(vct3x3(0.0));
 
   outlierFlags.SetAll(0);
 
@@ -678,7 +758,7 @@ void algDirICP_DIMLOP::ICP_UpdateParameters_PostMatch() // CHECK IF YOU NEED NOR
   for (unsigned int s = 0; s < nSamples; s++)
   {
 	  // update target covariances
-	  Myi[s] = pDirTree->DatumCovPtr(matchDatums[s]);	// use pointer here for efficiency
+	  pDirTree->DatumCov(matchDatums[s], Myi[s]);
 
 	  // target covariance with match uncertainty	// TODO
 	  //Myi_sigma2[s] = *Myi[s];
@@ -696,10 +776,7 @@ void algDirICP_DIMLOP::ICP_UpdateParameters_PostMatch() // CHECK IF YOU NEED NOR
   }
 
   vctRot3 R(FGuess.Rotation());
-  for (unsigned int s = 0; s < nSamples; s++)
-  {
-	  R_MsmtMxi_Rt[s] = R*MsmtMxi[s] * R.Transpose();
-  }
+  Calc_RMRt_Batch(R, MsmtMxi.Pointer(), nSamples, R_MsmtMxi_Rt.Pointer());
 
   bFirstIter_Matches = false;
 }
@@ -718,9 +795,6 @@ void algDirICP_DIMLOP::ICP_UpdateParameters_PostRegister(vctFrm3 &Freg)
   UpdateShape(Si);
   UpdateTree();
 
-  // Re-initialize to compute matches on updated mesh
-  TCPS.init(pDirTree->mesh.vertices, pDirTree->mesh.faces);
-
 #if 0
   static int count = 1; 
   cisstMesh currentSamples;
@@ -744,10 +818,7 @@ void algDirICP_DIMLOP::UpdateNoiseModel_SamplesXfmd(vctFrm3 &Freg)
 	// update noise models of the transformed sample points
 	static vctRot3 R;
 	R = Freg.Rotation();
-	for (unsigned int s = 0; s < nSamples; s++)
-	{
-		R_Mxi_Rt[s] = R * Mxi[s] * R.Transpose();
-	}
+	Calc_RMRt_Batch(R, Mxi.Pointer(), nSamples, R_Mxi_Rt.Pointer());
 }
 
 unsigned int algDirICP_DIMLOP::ICP_FilterMatches()
@@ -779,10 +850,13 @@ unsigned int algDirICP_DIMLOP::ICP_FilterMatches()
 	double NormProductThresh = cos(ThetaThresh);
 
 	nOutliers = 0;
-	vct3x3 Mo, inv_Mo;
 	double sqrMahalDist = 0.0;
 	double normProduct = 0.0;
 
+	// outlier noise model:  Mo = R*Mxi*Rt + sigma2*I
+	//  (the inverses are formed from the cached decompositions of Mxi)
+	MxiCache.Update(Freg.Rotation(), sigma2);
+
 	for (unsigned int s = 0; s < nSamples; s++)
 	{
 		// compute outlier noise model based on mearurment noise and sigma2 only
@@ -793,17 +867,13 @@ unsigned int algDirICP_DIMLOP::ICP_FilterMatches()
 		//       measurement noise; if this is not true, then the target measurement
 		//       noise should be added to the outlier covariance test below as well
 		//   
-		Mo = R_Mxi_Rt.Element(s);
-		Mo.Element(0, 0) += sigma2;
-		Mo.Element(1, 1) += sigma2;
-		Mo.Element(2, 2) += sigma2;
 		//Mo = R_Mxi_Rt.Element(s) + Myi_sigma2.Element(s);
 		//Mo.Element(0, 0) += outlier_alpha;
 		//Mo.Element(1, 1) += outlier_alpha;
 		//Mo.Element(2, 2) += outlier_alpha;
 
 		// compute Mahalanobis distance
-		ComputeCovInverse_NonIter(Mo, inv_Mo);
+		const vct3x3 &inv_Mo = MxiCache.Inverse(s);
 		sqrMahalDist = residuals_PostMatch.Element(s)*inv_Mo*residuals_PostMatch.Element(s); 
 		normProduct = vctDotProduct(sampleNormsXfmd.Element(s), matchNorms.Element(s));
 
@@ -37,6 +37,7 @@
 #include "algDirICP_IMLOP.h"
 #include "DirPDTree_Mesh.h"
 #include "TriangleClosestPointSolver.h"
+#include "CovDecompositionCache.h"
 #include "algDirICP_DIMLOP_dlibWrapper.h"
 
 
@@ -60,7 +61,9 @@ public:
 	vctDynamicVector<vct3>		Tssm_matchPts;
 	vctDynamicVector<vct3>		mu;
 	vctDynamicVector<vctInt3>	f;
-	vctDynamicVector<vctDynamicVector<vct3>>	Tssm_wi;
+	vctDynamicVector<vct3>		Tssm_Y_mean;	// match points on the mean shape
+	vctDynamicVector<double>	modeBasis;	// Tssm_wi[i][j] at (j*nModes + i)*3 (see ComputeModeBasis())
+	vctDynamicVector<double>	gsThreadBuf;	// per-thread shape gradient sums (nModes per thread)
 
 	double rb, tb, sb, spb;		// rotation, translation, scale, and shape parameter bounds
 	bool bScale;
@@ -85,6 +88,15 @@ protected:
 	cisstMesh *pMesh;
 	DirPDTree_Mesh *pDirTree;
 
+	// incremental update of the solver and tree for the deformed shape
+	//  (see SetRefitTolerance())
+	double refitTol;
+	double rebuildRatio;
+	vctDynamicVector<char> triMoved;	// triangles updated by the last refit
+	int nRefitTriangles;			// total over all refits
+	int nRebuilds;
+	double refitTime;
+
 	vctFrm3 FGuess; // intiial guess for registration
 
 	bool bFirstIter_Matches;  // flag that the first iteration is being run
@@ -100,8 +112,9 @@ protected:
 	// Note: Myi values are obtained from the mesh object
 	vctDynamicVector<vct3x3>  Mxi;        // noise covariances of sample points
 	vctDynamicVector<vct3>    eigMxi;     // eigenvalues of sample covariances
+	CovDecompositionCache     MxiCache;   // decompositions of Mxi and of R*Mxi*Rt + sigma2*I
 	vctDynamicVector<vct3x3>  R_Mxi_Rt;   // noise covariances of transformed sample points
-	vctDynamicVector<vct3x3*> Myi;        // noise covariances of target correspondence points
+	vctDynamicVector<vct3x3>  Myi;        // noise covariances of target correspondence points
 	vctDynamicVector<vct3x3>  Myi_sigma2; // noise covariances of target correspondence points with match uncertainty added
 
 	// measurement noise component of the sample noise model
@@ -199,6 +212,16 @@ public:
   void	UpdateShape(vctDynamicVector<double> &si);
   void	UpdateTree();
 
+  // The solver and the tree are refit to the shape updated after each
+  //  registration rather than re-initialized: only the triangles having a
+  //  vertex moved by more than the refit tolerance (default 0) since it was
+  //  last updated are recomputed, and only the tree nodes holding them are
+  //  refit, with bounds enlarged by twice the tolerance. The tree is rebuilt
+  //  when its total node bounds area grows beyond the rebuild threshold
+  //  times that of the built tree (default 1.5).
+  void	SetRefitTolerance(double tol) { refitTol = tol; }
+  void	SetRebuildThreshold(double ratio) { rebuildRatio = ratio; }
+
   void    UpdateOptimizerCalculations(const vctDynamicVector<double> &x);
   void    CostFunctionGradient(const vctDynamicVector<double> &x, vctDynamicVector<double> &g);
   double  CostFunctionValue(const vctDynamicVector<double> &x);
@@ -237,6 +260,7 @@ public:
 protected:
 	// -- Deformable Methods -- //
 	void ComputeMu();
+	void ComputeModeBasis();
 
 	void algDirICP_DIMLOP::UpdateNoiseModel_SamplesXfmd(vctFrm3 &Freg);
 };
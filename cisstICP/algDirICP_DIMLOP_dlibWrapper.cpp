@@ -33,6 +33,7 @@
 // ****************************************************************************
 #include "algDirICP_DIMLOP_dlibWrapper.h"
 #include "algDirICP_DIMLOP.h"
+#include "ICPTrace.h"
 
 #include <assert.h>
 #undef NDEBUG       // enable debug in release mode
@@ -99,6 +100,8 @@ algDirICP_DIMLOP_dlibWrapper::algDirICP_DIMLOP_dlibWrapper(algDirICP_DIMLOP *arg
 //vct7 algICP_DIMLP_dlibWrapper::ComputeRegistration(const vct7 &x0)
 vctDynamicVector<double> algDirICP_DIMLOP_dlibWrapper::ComputeRegistration(const vctDynamicVector<double> &x0)
 {
+	ICPTRACE_SCOPE("DIMLOP dlib ComputeRegistration");
+
 	int nComponents = x0.size();
 
 	dlib_vector x_dlib(nComponents); // n_trans+n_modes-element vector
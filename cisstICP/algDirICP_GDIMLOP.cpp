@@ -38,6 +38,10 @@
 #include "algDirICP_GDIMLOP.h"
 #include "DirPDTreeNode.h"
 #include "utilities.h"
+#include "CovBatchKernels.h"
+
+#include <cisstOSAbstraction.h>
+#include <omp.h>
 
 #include "mins.h"   // Numerical Recipes
 
@@ -66,10 +70,16 @@ algDirICP_GDIMLOP::algDirICP_GDIMLOP(
   : algDirICP_GIMLOP(pDirTree, samplePts, sampleNorms, argK, argE, argL, argM, scale, bScale),
   pDirTree(pDirTree),
   pMesh(&pDirTree->mesh),
-  TCPS(pDirTree->mesh),
+  TCPS(pDirTree->mesh, pDirTree->PrecomputedTCPS()),
   dlib(this),
   paramEstMethod(paramEst)
 {
+  refitTol = 0.0;
+  rebuildRatio = 1.5;
+  nRefitTriangles = 0;
+  nRebuilds = 0;
+  refitTime = 0.0;
+
   //SetNoiseModel(argK, argE, argL, argM, paramEst);
   SetSamples(samplePts, sampleNorms, argK, argE, argL, argM, argMsmtM, argMeanShape, scale, bScale, paramEst);
 
@@ -152,6 +162,8 @@ void algDirICP_GDIMLOP::PrintMatchStatistics(std::stringstream &tMsg)
 	tMsg << "\nSum square match angle = " << totalSumSqrMatchAngle << " over " << nSamples << " samples";
 	tMsg << "\nSum square mahalanobis distance = " << sumSqrMahalDist << " over " << nGoodSamples << " inliers";
 	tMsg << "\nSum square match angle = " << sumSqrMatchAngle << " over " << nGoodSamples << " inliers\n";
+	tMsg << "Shape refit: " << nRefitTriangles << " triangles updated, " << nRebuilds << " tree rebuilds, "
+		<< refitTime << " sec total\n";
 }
 
 double algDirICP_GDIMLOP::ICP_EvaluateErrorFunction()
@@ -162,9 +174,9 @@ double algDirICP_GDIMLOP::ICP_EvaluateErrorFunction()
   //
   //   Negative Log-Likelihood:
   //    -log[ C * exp( ... ) ]
-  vctDynamicVector<vct3x3>  Mi(nSamples);           // noise covariances of match (R*Mxi*Rt + Myi)
-  vctDynamicVector<vct3x3>  inv_Mi(nSamples);       // inverse noise covariances of match (R*Mxi*Rt + Myi)^-1
-  vctDynamicVector<double>  det_Mi(nSamples);       // determinant of noise covariances of match |R*Mxi*Rt + Myi|
+  vct3x3  Mi;            // noise covariances of match (R*Mxi*Rt + Myi)
+  vct3x3  inv_Mi;        // inverse noise covariances of match (R*Mxi*Rt + Myi)^-1
+  double  det_Mi;        // determinant of noise covariances of match |R*Mxi*Rt + Myi|
 
   // Just return match error for now, shifted to be lower bounded at 0
   double Error		= 0.0;
@@ -176,21 +188,21 @@ double algDirICP_GDIMLOP::ICP_EvaluateErrorFunction()
   double normCost1	= 0.0;	// for debugging only
   for (unsigned int i = 0; i < nSamples; i++)
   {
-	Mi[i] = R_M_Rt[i] + Myi_sigma2[i];
-	ComputeCovDecomposition_NonIter(Mi[i], inv_Mi[i], det_Mi[i]);
+	Mi = R_M_Rt[i] + Myi_sigma2[i];
+	ComputeCovDecomposition_NonIter(Mi, inv_Mi, det_Mi);
 
 	if (outlierFlags[i])	continue;	// skip outliers
 
 	vct3 residual = samplePtsXfmd.Element(i) - Tssm_Y.Element(i);	// matchPts.Element(s);
-	expCost += residual * inv_Mi[i] * residual;
+	expCost += residual * inv_Mi * residual;
 
     Error += MatchError(samplePtsXfmd[i], sampleNormsXfmd[i],
       Tssm_Y[i], matchNorms[i],
-	  k[i], B[i], R_L[i], inv_Mi[i]);
+	  k[i], B[i], R_L[i], inv_Mi);
 
 	// match covariance
 	nklog2PI += 5.0*log(2.0*cmnPI);			// 1/2
-	logCost += log(det_Mi[i]);				// 1/2
+	logCost += log(det_Mi);				// 1/2
 	normCost += L[i].Norm();
   }
   vctRot3 R(Freg.Rotation());
@@ -265,6 +277,44 @@ void algDirICP_GDIMLOP::ComputeMu()
 	}
 }
 
+// Barycentric mode contributions of the matches
+//  The match point of sample j on the shape with parameters s is
+//    Tssm_Y[j] = Tssm_Y_mean[j] + sum_i s[i]*Tssm_wi[i][j]
+//  where Tssm_wi[i][j] = sum_v mu[j][v]*wi[i][f[j][v]]; these are computed
+//  once per registration, so the optimizer evaluations do not access the mesh
+void algDirICP_GDIMLOP::ComputeModeBasis()
+{
+	modeBasis.SetSize(nSamples * nModes * 3);
+#ifdef ENABLE_PARALLELIZATION
+	gsThreadBuf.SetSize(omp_get_max_threads() * nModes);
+#else
+	gsThreadBuf.SetSize(nModes);
+#endif
+	Tssm_Y_mean.SetSize(nSamples);
+
+	int j;
+#ifdef ENABLE_PARALLELIZATION
+#pragma omp parallel for
+#endif
+	for (j = 0; j < (int)nSamples; j++)
+	{
+		Tssm_Y_mean[j] = mu[j][0] * meanShape[f[j][0]]
+			+ mu[j][1] * meanShape[f[j][1]]
+			+ mu[j][2] * meanShape[f[j][2]];
+
+		double *b = modeBasis.Pointer(j * nModes * 3);
+		for (unsigned int i = 0; i < nModes; i++)
+		{
+			vct3 w = mu[j][0] * wi[i][f[j][0]]
+				+ mu[j][1] * wi[i][f[j][1]]
+				+ mu[j][2] * wi[i][f[j][2]];
+			b[3 * i] = w[0];
+			b[3 * i + 1] = w[1];
+			b[3 * i + 2] = w[2];
+		}
+	}
+}
+
 vctFrm3 algDirICP_GDIMLOP::ICP_RegisterMatches()
 {
   vctFrm3 F;
@@ -281,13 +331,7 @@ vctFrm3 algDirICP_GDIMLOP::ICP_RegisterMatches()
   // x_prev must begin at a different value than x0
   x_prev.SetAll(std::numeric_limits<double>::max());
 
-  for (unsigned int j = 0; j < nSamples; j++)
-  {
-	  for (unsigned int i = 0; i < nModes; i++)
-		  Tssm_wi[i][j] = mu[j][0] * wi[i][f[j][0]]
-		  + mu[j][1] * wi[i][f[j][1]]
-		  + mu[j][2] * wi[i][f[j][2]];
-  }
+  ComputeModeBasis();
   //x = gsl.ComputeRegistration( x0 );
   x = dlib.ComputeRegistration(x0, this);
 
@@ -334,7 +378,7 @@ void algDirICP_GDIMLOP::ICP_InitializeParameters(vctFrm3 &FGuess)
   R_MsmtM_Rt.SetAll(vct3x3(0.0));
 
   Myi_sigma2.SetAll(vct3x3::Eye());
-  Myi.SetAll(NULL);
+  Myi.SetAll(vct3x3(0.0));
 
   outlierFlags.SetAll(0);
 
@@ -461,23 +505,27 @@ void algDirICP_GDIMLOP::ICP_InitializeParameters(vctFrm3 &FGuess)
 void algDirICP_GDIMLOP::UpdateShape(vctDynamicVector<double> &S)
 {
 	// deformably transform each mesh vertex
-	pDirTree->mesh.vertices = meanShape;
-	int s;
-#ifdef ENABLE_PARALLELIZATION
-#pragma omp parallel for
-#endif
-	for (s = 0; s < pMesh->NumVertices(); s++)
-		for (unsigned int i = 0; i < nModes; i++)
-			pDirTree->mesh.vertices(s) += (S[i] * wi[i].Element(s));
-
+	//  (one matrix-vector product with the mode matrix of the mesh)
+	pMesh->SynthesizeShape(meanShape, S, pMesh->vertices);
 }
 
 void algDirICP_GDIMLOP::UpdateTree()
 {
-	vctFrm3 FId;
-	FId.Assign(vctFrm3::Identity());
+	osaStopwatch refitTimer;
+	refitTimer.Reset();
+	refitTimer.Start();
+
+	// update the triangles and the tree bounds holding them
+	//  (rather than re-initializing the solver and enlarging all node bounds)
+	nRefitTriangles += TCPS.Refit(pDirTree->mesh.vertices, refitTol, triMoved);
+	pDirTree->RefitBounds(&triMoved, 2.0*refitTol);
+	if (pDirTree->RelativeTreeQuality() > rebuildRatio)
+	{
+		pDirTree->RebuildTree();
+		nRebuilds++;
+	}
 
-	pDirTree->EnlargeBounds(FId);
+	refitTime += refitTimer.GetElapsedTime();
 }
 
 void algDirICP_GDIMLOP::ICP_ComputeMatches()
@@ -526,7 +574,7 @@ void algDirICP_GDIMLOP::ICP_UpdateParameters_PostMatch()
 	for (unsigned int s = 0; s < nSamples; s++)
 	{
 		// update target covariances
-		Myi[s] = pDirTree->DatumCovPtr(matchDatums[s]);	// use pointer here for efficiency
+		pDirTree->DatumCov(matchDatums[s], Myi[s]);
 
 		// target covariance with match uncertainty		// TODO
 		//Myi_sigma2[s] = *Myi[s];
@@ -544,10 +592,7 @@ void algDirICP_GDIMLOP::ICP_UpdateParameters_PostMatch()
 	}
 
 	vctRot3 R(FGuess.Rotation());
-	for (unsigned int s = 0; s < nSamples; s++)
-	{
-		R_MsmtM_Rt[s] = R*M_msmt[s] * R.Transpose();
-	}
+	Calc_RMRt_Batch(R, M_msmt.Pointer(), nSamples, R_MsmtM_Rt.Pointer());
 
 	bFirstIter_Matches = false;
 }
@@ -567,9 +612,6 @@ void algDirICP_GDIMLOP::ICP_UpdateParameters_PostRegister(vctFrm3 &Freg)
   UpdateShape(Si);
   UpdateTree();
 
-  // Re-initialize to compute matches on updated mesh
-  TCPS.init(pDirTree->mesh.vertices, pDirTree->mesh.faces);
-
 #if 0
   static int count = 1;
   cisstMesh currentSamples;
@@ -700,11 +742,11 @@ void algDirICP_GDIMLOP::UpdateNoiseModel_DynamicEstimates()
       isoVar.Element(2, 2) = sigma2_diff;
       for (unsigned int i = 0; i < nSamples; i++)
       {
-        // TODO: can speed this up by only recomputing diagonal matrix D
-        //       and re-multiplying to get invM, N, etc.
+        // M shares the eigen vectors of M_msmt => only the eigen values
+        //  are shifted when forming invM, N, etc.
         M[i] = M_msmt[i] + isoVar;
+        MsmtMCache.Decompose(i, sigma2_diff, invM[i], N[i], invN[i], Dmin[i], Emin[i]);
       }
-      ComputeCovDecompositions( M, invM, N, invN, Dmin, Emin);      
     }
     meanSigma2 = traceM_est > meanTraceM_msmt ? traceM_est : meanTraceM_msmt;
     meanSigma2 /= 3.0;
@@ -738,7 +780,11 @@ void algDirICP_GDIMLOP::UpdateNoiseModel_DynamicEstimates()
     {
       B[i] = E_msmt[i] * k_msmt[i] / 2.0;
     }
-    ComputeCovDecompositions(M, invM, N, invN, Dmin, Emin);
+    invM = invM_msmt;
+    N = N_msmt;
+    invN = invN_msmt;
+    Dmin = Dmin_msmt;
+    Emin = Emin_msmt;
     break;
   }
   default:
@@ -754,10 +800,12 @@ void algDirICP_GDIMLOP::UpdateNoiseModel_SamplesXfmd(vctFrm3 &Freg)
 {
   // update noise models of the transformed sample points
   vctRot3 R(Freg.Rotation());
+  Calc_RMRt_Batch(R, M.Pointer(), nSamples, R_M_Rt.Pointer());
+  Calc_RMRt_Batch(R, invM.Pointer(), nSamples, R_invM_Rt.Pointer());
+  // N, invN and L are not symmetric, so their products with R are not
+  //  batched (the batched kernels are for symmetric matrices)
   for (unsigned int s = 0; s < nSamples; s++)
   {
-	R_M_Rt[s] = R * M[s] * R.Transpose();
-    R_invM_Rt[s] = R*invM[s] * R.Transpose();
     N_Rt[s] = N[s] * R.Transpose();
     inv_N_Rt[s] = R*invN[s];
     R_L[s] = R*L[s];
@@ -885,19 +933,20 @@ double algDirICP_GDIMLOP::ComputeRpos()
 
 void algDirICP_GDIMLOP::SamplePreMatch(unsigned int sampleIndex)
 {
-  sampleK = k[sampleIndex];
-  sampleB = B[sampleIndex];
-  sampleR_L = R_L[sampleIndex];
-  sampleDmin = Dmin[sampleIndex];
-  sampleEmin = Emin[sampleIndex];
-  sampleR_InvM_Rt = R_invM_Rt[sampleIndex];
-  sampleN_Rt = N_Rt[sampleIndex];
-  sample_inv_N_Rt = inv_N_Rt[sampleIndex];
+  SampleSearchModel &sm = SearchModel();
+  sm.K = k[sampleIndex];
+  sm.B = B[sampleIndex];
+  sm.R_L = R_L[sampleIndex];
+  sm.Dmin = Dmin[sampleIndex];
+  sm.Emin = Emin[sampleIndex];
+  sm.R_InvM_Rt = R_invM_Rt[sampleIndex];
+  sm.N_Rt = N_Rt[sampleIndex];
+  sm.inv_N_Rt = inv_N_Rt[sampleIndex];
 
 #ifdef SAVE_MATCHES
   if (MatchIsotropic)
   {
-    sampleB = 0.0;
+    sm.B = 0.0;
   }
 #endif
 }
@@ -909,6 +958,8 @@ int algDirICP_GDIMLOP::NodeMightBeCloser(
   DirPDTreeNode const *node,
   double ErrorBound)
 {
+  // noise model of the sample set by the pre-match routine
+  SampleSearchModel &sm = SearchModel();
 
   // Check if point lies w/in search range of the bounding box for this node
   //
@@ -972,9 +1023,9 @@ int algDirICP_GDIMLOP::NodeMightBeCloser(
     // Brent Method
     // bracket the global min
     Brent brent;
-    brent.bracket(x1, x2, Xn, yNewton, node->Navg, sampleK, sampleB, sampleR_L);
+    brent.bracket(x1, x2, Xn, yNewton, node->Navg, sm.K, sm.B, sm.R_L);
     // find the global min
-    MinKentError = brent.minimize(Xn, yNewton, node->Navg, sampleK, sampleB, sampleR_L);
+    MinKentError = brent.minimize(Xn, yNewton, node->Navg, sm.K, sm.B, sm.R_L);
   }
 
 
@@ -988,7 +1039,7 @@ int algDirICP_GDIMLOP::NodeMightBeCloser(
   // Assume ErrorBound = MinKentError + (1/2)*(v-closest)'*inv(M)*(v-closest) 
   //                   = MinKentError + (1/2)*(v-closest)'*diag(Emin)*(v-closest)
   //  => MaxDist = sqrt[ (ErrorBound - MinKentError)*2.0/Emin ]
-  double searchDist2 = (ErrorBound - MinKentError)*2.0/sampleEmin;
+  double searchDist2 = (ErrorBound - MinKentError)*2.0/sm.Emin;
   if (searchDist2 < 0.0)
   { // orientation error alone dismisses this node
     return 0;
@@ -1012,7 +1063,7 @@ int algDirICP_GDIMLOP::NodeMightBeCloser(
   return IntersectionSolver.Test_Ellipsoid_OBB_Intersection(
     Xp, node->Bounds, node->F,
     MaxSqrMahalError,
-    sampleN_Rt, sampleDmin);
+    sm.N_Rt, sm.Dmin);
 #endif
 }
 
@@ -1065,10 +1116,9 @@ void algDirICP_GDIMLOP::SetSamples(
   nModes = (unsigned int)pDirTree->mesh.modeWeight.size(); 
   Si = pDirTree->mesh.Si;
   wi = pDirTree->mesh.wi;
+  if (!pMesh->HasModeMatrix())
+	  pMesh->BuildModeMatrix();
 
-  Tssm_wi.resize(nModes);
-  for (int i = 0; i < Tssm_wi.size(); i++)
-	  Tssm_wi[i].resize(nSamples);
   Tssm_matchPts.resize(nSamples);
 
   Tssm_Y.resize(nSamples);
@@ -1114,9 +1164,14 @@ void algDirICP_GDIMLOP::SetNoiseModel(
   Dmin_msmt.SetSize(nSamples);
   Emin_msmt.SetSize(nSamples);
 
-  ComputeCovDecompositions(
-    M_msmt, invM_msmt, N_msmt, invN_msmt,
-    Dmin_msmt, Emin_msmt);
+  // decompose the measurement covariances once; the effective noise model
+  //  M_msmt + sigma2*I is formed from these decompositions on each iteration
+  MsmtMCache.SetCovariances(M_msmt);
+  for (unsigned int i = 0; i < nSamples; i++)
+  {
+    MsmtMCache.Decompose(i, 0.0,
+      invM_msmt[i], N_msmt[i], invN_msmt[i], Dmin_msmt[i], Emin_msmt[i]);
+  }
 
   // TODO: only include non-zero values in the means
   //       (since some data may leave out orientation or position for some samples)
@@ -1172,19 +1227,25 @@ void algDirICP_GDIMLOP::ComputeCovDecompositions(
   }
 
   // compute decomposition of noise covariances for each sample
+  //  (the eigen decompositions are computed for all samples at once,
+  //   see CovBatchKernels.h)
   //static vctFixedSizeMatrix<double, 3, 3, VCT_COL_MAJOR> A;
   //static vctFixedSizeMatrix<double, 3, 3, VCT_COL_MAJOR> U;
   //static vctFixedSizeMatrix<double, 3, 3, VCT_COL_MAJOR> Vt;
   //static vct3 S;
   //static vct3 D;
   //static nmrSVDFixedSizeData<3, 3, VCT_COL_MAJOR>::VectorTypeWorkspace workspace;
+  covEigenValues.SetSize(nSamples);
+  covEigenVectors.SetSize(nSamples);
+  ComputeCovEigenDecomposition_Batch(
+    M.Pointer(), nSamples, covEigenValues.Pointer(), covEigenVectors.Pointer());
   for (unsigned int i = 0; i < nSamples; i++)
   {
     // Compute Decomposition of Minv = N'*N
     //   Minv = N'*N = R*D^2*R' = U*S*V'   =>   R'=V', D=sqrt(S), R=U
     //   N = D*R'   invN = R*inv(D)
-    ComputeCovDecomposition_NonIter(
-      M[i], invM[i], N[i], invN[i], Dmin[i], Emin[i]);
+    ComputeCovDecomposition_Eigen(
+      covEigenValues[i], covEigenVectors[i], invM[i], N[i], invN[i], Dmin[i], Emin[i]);
   }
 }
 
@@ -1225,6 +1286,16 @@ void algDirICP_GDIMLOP::ComputeCovDecomposition_NonIter(
   vct3x3  eigenVectors;
   ComputeCovEigenDecomposition_NonIter(M, eigenValues, eigenVectors);
 
+  ComputeCovDecomposition_Eigen(eigenValues, eigenVectors, Minv, N, Ninv, Dmin, Emin);
+}
+
+// decomposition of M from its eigen decomposition M = V*diag(S)*V'
+//  (eigen values in descending order)
+void algDirICP_GDIMLOP::ComputeCovDecomposition_Eigen(
+  const vct3 &eigenValues, const vct3x3 &eigenVectors,
+  vct3x3 &Minv, vct3x3 &N, vct3x3 &Ninv,
+  double &Dmin, double &Emin)
+{
   // Compute Minv
   //   Minv = V*diag(1/S)*V'
   static vctFixedSizeMatrix<double, 3, 3, VCT_COL_MAJOR> V_Sinv;
@@ -1275,9 +1346,8 @@ void algDirICP_GDIMLOP::UpdateOptimizerCalculations(const vctDynamicVector<doubl
   // matrix for rotation increment
   Ra = vctRot3(vctRodRot3(a));
 
-  X = samplePts;
+  X.ForceAssign(samplePts);  // reallocates only if the sample count changes
   vctDynamicVectorRef<vct3>   X(samplePts);
-  vctDynamicVectorRef<vct3>   Mu(mu);
 
   vctDynamicVectorRef<vct3>   Xp_xfm(samplePtsXfmd);
   vctDynamicVectorRef<vct3>   Xn(sampleNorms);
@@ -1285,9 +1355,9 @@ void algDirICP_GDIMLOP::UpdateOptimizerCalculations(const vctDynamicVector<doubl
   vctDynamicVectorRef<vct3>   Yp(matchPts);
   vctDynamicVectorRef<vct3>   Yn(matchNorms);
 
-  // Update shape based on current s (and wi and meanshape)
   // Compute Tssm_Y based on current Mu and shape
-  UpdateShape(s);
+  //  from the mode contributions of the matches (the full shape
+  //  is synthesized after the registration)
   unsigned int i;
 #ifdef ENABLE_PARALLELIZATION
 #pragma omp parallel for
@@ -1299,9 +1369,15 @@ void algDirICP_GDIMLOP::UpdateOptimizerCalculations(const vctDynamicVector<doubl
     RaRL[i] = Ra * L[i];
 
     //--- position---//
-	Tssm_Y.Element(i) = Mu[i][0] * pMesh->vertices[f[i][0]]
-		+ Mu[i][1] * pMesh->vertices[f[i][1]]
-		+ Mu[i][2] * pMesh->vertices[f[i][2]];
+	const double *b = modeBasis.Pointer(i * nModes * 3);
+	vct3 y = Tssm_Y_mean[i];
+	for (unsigned int m = 0; m < nModes; m++)
+	{
+		y[0] += s[m] * b[3 * m];
+		y[1] += s[m] * b[3 * m + 1];
+		y[2] += s[m] * b[3 * m + 2];
+	}
+	Tssm_Y.Element(i) = y;
 
 	Tssm_Y_t[i] = Tssm_Y[i] - t;
 	Rat_Tssm_Y_t_x[i] = Ra.TransposeRef() * Tssm_Y_t[i] - sc * X[i];
@@ -1328,7 +1404,7 @@ double algDirICP_GDIMLOP::CostFunctionValue(const vctDynamicVector<double> &x)
   double f = 0.0;
   unsigned int i;
 #ifdef ENABLE_PARALLELIZATION
-#pragma omp parallel for
+#pragma omp parallel for reduction(+:f)
 #endif
   for (i = 0; i < nSamples; i++)
   {
@@ -1383,43 +1459,74 @@ void algDirICP_GDIMLOP::CostFunctionGradient(const vctDynamicVector<double> &x,
   vctDynamicVectorRef<vct3>   Yp(matchPts);
   vctDynamicVectorRef<vct3>   Yn(matchNorms);
 
-  vct3x3 Jz_a;
-
-  unsigned int j;
+  // each thread accumulates its own gradient, which are summed at the end
 #ifdef ENABLE_PARALLELIZATION
-#pragma omp parallel for
+#pragma omp parallel
 #endif
-  for (j = 0; j < nSamples; j++)
   {
-    // TODO: vectorize Kent term better
-	if (outlierFlags[j])	continue;
+    vct3 ga_j(0.0), gt_j(0.0);
+    double gsc_j = 0.0;
+    // shape gradient sums of this thread (preallocated in ComputeModeBasis())
+#ifdef ENABLE_PARALLELIZATION
+    double *gs_j = gsThreadBuf.Pointer(omp_get_thread_num() * nModes);
+#else
+    double *gs_j = gsThreadBuf.Pointer();
+#endif
+    for (unsigned int i = 0; i < nModes; i++)
+      gs_j[i] = 0.0;
+    vct3x3 Jz_a;
 
-    //--- Kent term ---//   (orientations)        
-    for (unsigned int i = 0; i < 3; i++)
+    unsigned int j;
+#ifdef ENABLE_PARALLELIZATION
+#pragma omp for
+#endif
+    for (j = 0; j < nSamples; j++)
     {
+      // TODO: vectorize Kent term better
+      if (outlierFlags[j])	continue;
+
+      //--- Kent term ---//   (orientations)        
+      for (unsigned int i = 0; i < 3; i++)
+      {
+        //  rotational effect
+        ga_j[i] += 
+          -k[j] * (Xn[j] * dRa[i].TransposeRef() * Yn[j])
+            - 2.0 * B[j] * ((dRa[i] * L[j].Column(0) * Xn[j]) * (Yn[j] * RaRL[j].Column(0))
+            - (dRa[i] * L[j].Column(1) * Xn[j]) * (Yn[j] * RaRL[j].Column(1)));
+
+        //--- Gaussian term ---//   (positions)
+        //  rotational effect
+        Jz_a.Column(i) = dRa[i].TransposeRef() * Tssm_Y_t[j];
+      }
+
+      //--- Gaussian term ---//   (positions)
       //  rotational effect
-		ga[i] += 
-			-k[j] * (Xn[j] * dRa[i].TransposeRef() * Yn[j])
-				- 2.0 * B[j] * ((dRa[i] * L[j].Column(0) * Xn[j]) * (Yn[j] * RaRL[j].Column(0))
-				- (dRa[i] * L[j].Column(1) * Xn[j]) * (Yn[j] * RaRL[j].Column(1)));
-
-		//--- Gaussian term ---//   (positions)
-		//  rotational effect
-		Jz_a.Column(i) = dRa[i].TransposeRef() * Tssm_Y_t[j];
-    }
+      ga_j += Rat_Tssm_Y_t_x_invMx[j] * Jz_a;
 
-    //--- Gaussian term ---//   (positions)
-    //  rotational effect
-	ga += Rat_Tssm_Y_t_x_invMx[j] * Jz_a;
+      // translational effect
+      vct3 q = Ra * Rat_Tssm_Y_t_x_invMx[j];
+      gt_j -= q;
 
-    // translational effect
-	gt -= Ra * Rat_Tssm_Y_t_x_invMx[j] ;
+      if (bScale)
+        gsc_j += Rat_Tssm_Y_t_x_invMx[j] * (-X.Element(j));
 
-	if (bScale)
-		gsc += Rat_Tssm_Y_t_x_invMx[j] * (-X.Element(j));
+      // Cmatch component:  r'*Ra'*Tssm_wi[i][j] = (Ra*r)'*Tssm_wi[i][j]
+      const double *b = modeBasis.Pointer(j * nModes * 3);
+      for (unsigned int i = 0; i < nModes; i++)
+        gs_j[i] += q[0] * b[3 * i] + q[1] * b[3 * i + 1] + q[2] * b[3 * i + 2];
+    }
 
-	for (unsigned int i = 0; i < nModes; i++)
-		gs[i] += Rat_Tssm_Y_t_x_invMx[j] * (Ra.Transpose() * Tssm_wi[i][j]);	// Cmatch component	
+#ifdef ENABLE_PARALLELIZATION
+#pragma omp critical (algDirICP_GDIMLOP_CostFunctionGradient)
+#endif
+    {
+      ga += ga_j;
+      gt += gt_j;
+      if (bScale)
+        gsc[0] += gsc_j;
+      for (unsigned int i = 0; i < nModes; i++)
+        gs[i] += gs_j[i];
+    }
   }
 #ifdef NOREGULARIZER
   gs += 0;
@@ -1436,6 +1543,7 @@ double algDirICP_GDIMLOP::FindClosestPointOnDatum(
 	int datum)
 {
 	// NOTE: noise model parameters are those set by the pre-match routine within the base class
+	const SampleSearchModel &sm = SearchModel();
 
 #ifdef KENT_POS_ISOTROPIC
 	// This finds closest point to this triangle in a Euclidean distance sense
@@ -1450,25 +1558,25 @@ double algDirICP_GDIMLOP::FindClosestPointOnDatum(
 	//
 	//   Mahalanobis Distance:  sqrt((x-v)'*Minv*(x-v))
 	//
-	TCPS.FindMostLikelyPointOnTriangle(Xp, datum, sampleN_Rt, sample_inv_N_Rt, closest);
+	TCPS.FindMostLikelyPointOnTriangle(Xp, datum, sm.N_Rt, sm.inv_N_Rt, closest);
 #endif
 
 	// norm has same value everywhere on this datum
 	closestNorm = pDirTree->mesh.faceNormals[datum];
 
 	// noise parameters set by the pre-match routine of the base class
-	double major = vctDotProduct(sampleR_L.Column(0), closestNorm);
-	double minor = vctDotProduct(sampleR_L.Column(1), closestNorm);
+	double major = vctDotProduct(sm.R_L.Column(0), closestNorm);
+	double minor = vctDotProduct(sm.R_L.Column(1), closestNorm);
 
 
 	// return the match error
 	//  Note: add "extra" k so that match error is always >= 0
 #ifdef KENT_POS_ISOTROPIC
-	return sampleK * (1 - vctDotProduct(Xn, closestNorm)) - sampleB*(major*major - minor*minor)
-		+ (Xp - closest).NormSquare()*sampleEmin / 2.0;
+	return sm.K * (1 - vctDotProduct(Xn, closestNorm)) - sm.B*(major*major - minor*minor)
+		+ (Xp - closest).NormSquare()*sm.Emin / 2.0;
 #else
-	return sampleK * (1 - vctDotProduct(Xn, closestNorm)) - sampleB*(major*major - minor*minor)
-		+ ((Xp - closest)*sampleR_InvM_Rt*(Xp - closest)) / 2.0;
+	return sm.K * (1 - vctDotProduct(Xn, closestNorm)) - sm.B*(major*major - minor*minor)
+		+ ((Xp - closest)*sm.R_InvM_Rt*(Xp - closest)) / 2.0;
 #endif
 
 }
@@ -1508,7 +1616,7 @@ void algDirICP_GDIMLOP::ReturnScale(double &scale)
 
 void algDirICP_GDIMLOP::ReturnShapeParam(vctDynamicVector<double> &shapeParam)
 {
-	shapeParam = Si;
+	shapeParam.ForceAssign(Si);  // reallocates only if the size changes
 }
 
 void algDirICP_GDIMLOP::ReturnMatchPts(vctDynamicVector<vct3> &rMatchPts, vctDynamicVector<vct3> &rMatchNorms)
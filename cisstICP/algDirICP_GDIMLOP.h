@@ -37,6 +37,7 @@
 #include "algDirICP_GIMLOP.h"
 #include "DirPDTree_Mesh.h"
 #include "TriangleClosestPointSolver.h"
+#include "CovDecompositionCache.h"
 
 #include "Ellipsoid_OBB_Intersection_Solver.h"
 #include "algDirICP_GDIMLOP_dlibWrapper.h"
@@ -66,6 +67,15 @@ protected:
 	cisstMesh *pMesh;
 	DirPDTree_Mesh *pDirTree;
 
+	// incremental update of the solver and tree for the deformed shape
+	//  (see SetRefitTolerance())
+	double refitTol;
+	double rebuildRatio;
+	vctDynamicVector<char> triMoved;	// triangles updated by the last refit
+	int nRefitTriangles;			// total over all refits
+	int nRebuilds;
+	double refitTime;
+
 	vctFrm3 FGuess; // intiial guess for registration
 
 	bool bFirstIter_Matches;  // flag that the first iteration is being run
@@ -129,6 +139,9 @@ protected:
   vctDynamicVector<vct3x3>	invN_msmt;
   vctDoubleVec				Dmin_msmt;		// sqrt of smallest eigenvalue of inv(M)
   vctDoubleVec				Emin_msmt;		// smallest eigenvalue of inv(M)
+  CovDecompositionCache		MsmtMCache;		// decompositions of M_msmt (shared by M_msmt + sigma2*I)
+  vctDynamicVector<vct3>		covEigenValues;		// eigen decompositions computed by ComputeCovDecompositions()
+  vctDynamicVector<vct3x3>	covEigenVectors;
   //  match uncertainty model (dynamic)
   double traceM_est;
   double meanTraceM_msmt;
@@ -141,22 +154,12 @@ protected:
   vctDynamicVector<vct3x3> N_Rt;
   vctDynamicVector<vct3x3> inv_N_Rt;		// inv(N*Rt) = R*invN
 
-  vctDynamicVector<vct3x3*> Myi;			// noise covariances of target correspondence points
+  vctDynamicVector<vct3x3>  Myi;			// noise covariances of target correspondence points
   vctDynamicVector<vct3x3>  Myi_sigma2;		// noise covariances of target correspondence points with match uncertainty added
 
   // Variables for current sample point undergoing a match search
-  //  these are set once for each sample point by the pre-match function
-  //  and used whenever a tree search routine is called for that sample thereafter.
-  //  These do not change relative to the node being searched => storing them here
-  //  allows using the same PD tree search structure without adding new
-  //  function arguments.
-  vctFixedSizeMatrix<double, 3, 2> sampleR_L;
-  double sampleK, sampleB;
-  vct3x3 sampleR_InvM_Rt;
-  vct3x3 sampleN_Rt;
-  vct3x3 sample_inv_N_Rt;
-  double sampleDmin;
-  double sampleEmin;
+  //  the pre-match function sets these in the per-thread search variables
+  //  of the base class (see algDirICP_GIMLOP::SearchModel())
 
   // registration statistics
   double totalSumSqrMahalDist;
@@ -198,7 +201,9 @@ protected:
   vctDynamicVector<vct3>		Tssm_matchPts;
   vctDynamicVector<vct3>		mu;
   vctDynamicVector<vctInt3>		f;
-  vctDynamicVector<vctDynamicVector<vct3>>	Tssm_wi;
+  vctDynamicVector<vct3>		Tssm_Y_mean;	// match points on the mean shape
+  vctDynamicVector<double>	modeBasis;	// Tssm_wi[i][j] at (j*nModes + i)*3 (see ComputeModeBasis())
+  vctDynamicVector<double>	gsThreadBuf;	// per-thread shape gradient sums (nModes per thread)
 
   // Optimizer calculations common to both cost function and gradient
   //vct6 x_prev;
@@ -219,6 +224,7 @@ protected:
 
   // -- Deformable Methods -- //
   void ComputeMu();
+  void ComputeModeBasis();
 
   //--- Algorithm Methods ---//
 
@@ -253,6 +259,16 @@ public:
   void	UpdateShape(vctDynamicVector<double> &si);
   void	UpdateTree();
 
+  // The solver and the tree are refit to the shape updated after each
+  //  registration rather than re-initialized: only the triangles having a
+  //  vertex moved by more than the refit tolerance (default 0) since it was
+  //  last updated are recomputed, and only the tree nodes holding them are
+  //  refit, with bounds enlarged by twice the tolerance. The tree is rebuilt
+  //  when its total node bounds area grows beyond the rebuild threshold
+  //  times that of the built tree (default 1.5).
+  void	SetRefitTolerance(double tol) { refitTol = tol; }
+  void	SetRebuildThreshold(double ratio) { rebuildRatio = ratio; }
+
   // dlib routines
   void    UpdateOptimizerCalculations(const vctDynamicVector<double> &x);
   void    CostFunctionGradient(const vctDynamicVector<double> &x, vctDynamicVector<double> &g);
@@ -309,6 +325,10 @@ public:
   void ComputeCovDecomposition_NonIter(
     const vct3x3 &M, vct3x3 &Minv, vct3x3 &N, vct3x3 &Ninv,
     double &Dmin, double &Emin);
+  void ComputeCovDecomposition_Eigen(
+    const vct3 &eigenValues, const vct3x3 &eigenVectors,
+    vct3x3 &Minv, vct3x3 &N, vct3x3 &Ninv,
+    double &Dmin, double &Emin);
   void ComputeCovDecomposition_SVD(
     const vct3x3 &M, vct3x3 &Minv, vct3x3 &N, vct3x3 &Ninv, 
     double &Dmin, double &Emin );
@@ -316,6 +336,15 @@ public:
   // standard virtual routines
   virtual void SamplePreMatch(unsigned int sampleIndex);
 
+  // the searches are not capped (see algDirICP_GIMLOP::SetOutlierCappedSearch()):
+  //  the outlier test of this algorithm includes the match uncertainty,
+  //  which is updated from the matches after the search
+  virtual double SampleMatchErrorCap(unsigned int sampleIndex)
+  {
+    matchErrorCap[sampleIndex] = std::numeric_limits<double>::max();
+    return matchErrorCap[sampleIndex];
+  }
+
 
   //--- ICP Interface Methods ---//
 
@@ -33,6 +33,7 @@
 // ****************************************************************************
 #include "algDirICP_GDIMLOP_dlibWrapper.h"
 #include "algDirICP_GDIMLOP.h"
+#include "ICPTrace.h"
 
 #include <assert.h>
 #undef NDEBUG       // enable debug in release mode
@@ -102,6 +103,8 @@ algDirICP_GDIMLOP_dlibWrapper::algDirICP_GDIMLOP_dlibWrapper(algDirICP_GDIMLOP *
 //  used with multiple Kent algorithms simultaneously (even if single threaded)
 vctDynamicVector<double> algDirICP_GDIMLOP_dlibWrapper::ComputeRegistration(const vctDynamicVector<double> &x0, algDirICP_GDIMLOP *kent)
 {
+  ICPTRACE_SCOPE("GDIMLOP dlib ComputeRegistration");
+
   // initialize global pointer to algorithm
   Kent_dlib = kent;
 
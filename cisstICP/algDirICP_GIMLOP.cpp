@@ -38,6 +38,7 @@
 #include "algDirICP_GIMLOP.h"
 #include "DirPDTreeNode.h"
 #include "utilities.h"
+#include "CovBatchKernels.h"
 
 #include "mins.h"   // Numerical Recipes
 
@@ -63,6 +64,10 @@ algDirICP_GIMLOP::algDirICP_GIMLOP(
   dlib(),
   paramEstMethod(paramEst)
 {
+  // search variables for a serial search
+  //  (see ReserveSearchThreads())
+  searchModels.resize(1);
+
   SetSamples(samplePts, sampleNorms, argK, argE, argL, argM, scale, bScale, paramEst);
   //SetNoiseModel(argK, argE, argL, argM, paramEst);
 
@@ -311,23 +316,28 @@ void algDirICP_GIMLOP::ICP_UpdateParameters_PostMatch() // CHECK IF YOU NEED NOR
 	algDirICP::ICP_UpdateParameters_PostMatch();
 
 	// compute sum of square distance of inliers
+	//  (leaving out the previous matches kept by capped searches)
 	sumSqrDist_Inliers = 0.0;
 	double sumNormProducts_Inliers = 0.0;
+	unsigned int nInliers = 0;
 	for (unsigned int s = 0; s < nSamples; s++)
 	{
 		residuals_PostMatch[s] = samplePtsXfmd[s] - matchPts[s];
 		sqrDist_PostMatch[s] = residuals_PostMatch[s].NormSquare();
 
 		if (outlierFlags[s])	continue;	// skip outliers
+		if (MatchCapped(s))		continue;	// skip previous matches
 
 		sumSqrDist_Inliers += sqrDist_PostMatch[s];
 
 		sumNormProducts_Inliers +=
 			vctDotProduct(sampleNormsXfmd.Element(s), matchNorms.Element(s));
+		nInliers++;
 	}
 
 	// update the match uncertainty factor
-	sigma2 = sumSqrDist_Inliers / (nSamples - nOutliers);
+	if (nInliers > 0)
+		sigma2 = sumSqrDist_Inliers / nInliers;
 
 	// apply max threshold
 	if (sigma2 > sigma2Max)
@@ -355,10 +365,7 @@ void algDirICP_GIMLOP::ICP_UpdateParameters_PostMatch() // CHECK IF YOU NEED NOR
 	}
 
 	vctRot3 R(FGuess.Rotation());
-	for (unsigned int s = 0; s < nSamples; s++)
-	{
-		R_MsmtM_Rt[s] = R*M_msmt[s] * R.Transpose();
-	}
+	Calc_RMRt_Batch(R, M_msmt.Pointer(), nSamples, R_MsmtM_Rt.Pointer());
 
 	bFirstIter_Matches = false;
 }
@@ -435,7 +442,10 @@ unsigned int algDirICP_GIMLOP::ICP_FilterMatches()
 		normProduct = vctDotProduct(sampleNormsXfmd.Element(s), matchNorms.Element(s));
 
 		// check if outlier
-		if (sqrMahalDist > ChiSquareThresh)
+		//  (a capped search that found no match below the cap has proven
+		//   the match an outlier under R_invM_Rt, which is unchanged since
+		//   the search; see SetOutlierCappedSearch())
+		if (sqrMahalDist > ChiSquareThresh || MatchCapped(s))
 		{ // an outlier
 			nOutliers++;
 			outlierFlags[s] = 1;
@@ -499,11 +509,11 @@ void algDirICP_GIMLOP::UpdateNoiseModel_DynamicEstimates()
       isoVar.Element(2, 2) = sigma2_diff;
       for (unsigned int i = 0; i < nSamples; i++)
       {
-        // TODO: can speed this up by only recomputing diagonal matrix D
-        //       and re-multiplying to get invM, N, etc.
+        // M shares the eigen vectors of M_msmt => only the eigen values
+        //  are shifted when forming invM, N, etc.
         M[i] = M_msmt[i] + isoVar;
+        MsmtMCache.Decompose(i, sigma2_diff, invM[i], N[i], invN[i], Dmin[i], Emin[i]);
       }
-      ComputeCovDecompositions( M, invM, N, invN, Dmin, Emin);      
     }
     meanSigma2 = traceM_est > meanTraceM_msmt ? traceM_est : meanTraceM_msmt;
     meanSigma2 /= 3.0;
@@ -537,7 +547,11 @@ void algDirICP_GIMLOP::UpdateNoiseModel_DynamicEstimates()
     {
       B[i] = E_msmt[i] * k_msmt[i] / 2.0;
     }
-    ComputeCovDecompositions(M, invM, N, invN, Dmin, Emin);
+    invM = invM_msmt;
+    N = N_msmt;
+    invN = invN_msmt;
+    Dmin = Dmin_msmt;
+    Emin = Emin_msmt;
     break;
   }
   default:
@@ -553,9 +567,11 @@ void algDirICP_GIMLOP::UpdateNoiseModel_SamplesXfmd(vctFrm3 &Freg)
 {
   // update noise models of the transformed sample points
   vctRot3 R(Freg.Rotation());
+  Calc_RMRt_Batch(R, invM.Pointer(), nSamples, R_invM_Rt.Pointer());
+  // N, invN and L are not symmetric, so their products with R are not
+  //  batched (the batched kernels are for symmetric matrices)
   for (unsigned int s = 0; s < nSamples; s++)
   {
-    R_invM_Rt[s] = R*invM[s] * R.Transpose();
     N_Rt[s] = N[s] * R.Transpose();
     inv_N_Rt[s] = R*invN[s];
     R_L[s] = R*L[s];
@@ -680,25 +696,50 @@ double algDirICP_GIMLOP::ComputeRpos()
 
 // PD Tree Methods
 
+void algDirICP_GIMLOP::ReserveSearchThreads(int numThreads)
+{
+  if ((int)searchModels.size() < numThreads)
+  {
+    searchModels.resize(numThreads);
+  }
+}
+
 void algDirICP_GIMLOP::SamplePreMatch(unsigned int sampleIndex)
 {
-  sampleK = k[sampleIndex];
-  sampleB = B[sampleIndex];
-  sampleR_L = R_L[sampleIndex];
-  sampleDmin = Dmin[sampleIndex];
-  sampleEmin = Emin[sampleIndex];
-  sampleR_InvM_Rt = R_invM_Rt[sampleIndex];
-  sampleN_Rt = N_Rt[sampleIndex];
-  sample_inv_N_Rt = inv_N_Rt[sampleIndex];
+  SampleSearchModel &sm = SearchModel();
+  sm.K = k[sampleIndex];
+  sm.B = B[sampleIndex];
+  sm.R_L = R_L[sampleIndex];
+  sm.Dmin = Dmin[sampleIndex];
+  sm.Emin = Emin[sampleIndex];
+  sm.R_InvM_Rt = R_invM_Rt[sampleIndex];
+  sm.N_Rt = N_Rt[sampleIndex];
+  sm.inv_N_Rt = inv_N_Rt[sampleIndex];
 
 #ifdef SAVE_MATCHES
   if (MatchIsotropic)
   {
-    sampleB = 0.0;
+    sm.B = 0.0;
   }
 #endif
 }
 
+double algDirICP_GIMLOP::SampleMatchErrorCap(unsigned int sampleIndex)
+{
+  // match error = orientation terms + (1/2)*(square Mahalanobis distance),
+  //  where the orientation terms are at most 2k + |B|
+  //  (not capped on the first iteration, since the noise model of the
+  //   search is updated from the first matches before they are filtered)
+  double errorCap = std::numeric_limits<double>::max();
+  if (bOutlierCappedSearch && !bFirstIter_Matches)
+  {
+    const SampleSearchModel &sm = SearchModel();
+    errorCap = ChiSquareThresh / 2.0 + 2.0*sm.K + fabs(sm.B);
+  }
+  matchErrorCap[sampleIndex] = errorCap;
+  return errorCap;
+}
+
 
 // fast check if a node might contain a datum having smaller match error
 //  than the error bound
@@ -707,6 +748,8 @@ int algDirICP_GIMLOP::NodeMightBeCloser(
   DirPDTreeNode const *node,
   double ErrorBound)
 {
+  // noise model of the sample set by the pre-match routine
+  SampleSearchModel &sm = SearchModel();
 
   // Check if point lies w/in search range of the bounding box for this node
   //
@@ -772,9 +815,9 @@ int algDirICP_GIMLOP::NodeMightBeCloser(
     // Brent Method
     // bracket the global min
     Brent brent;
-    brent.bracket(x1, x2, Xn, yNewton, node->Navg, sampleK, sampleB, sampleR_L);
+    brent.bracket(x1, x2, Xn, yNewton, node->Navg, sm.K, sm.B, sm.R_L);
     // find the global min
-    MinKentError = brent.minimize(Xn, yNewton, node->Navg, sampleK, sampleB, sampleR_L);
+    MinKentError = brent.minimize(Xn, yNewton, node->Navg, sm.K, sm.B, sm.R_L);
 
     //// Golden Method
     //Golden golden;
@@ -794,7 +837,7 @@ int algDirICP_GIMLOP::NodeMightBeCloser(
   // Assume ErrorBound = MinKentError + (1/2)*(v-closest)'*inv(M)*(v-closest) 
   //                   = MinKentError + (1/2)*(v-closest)'*diag(Emin)*(v-closest)
   //  => MaxDist = sqrt[ (ErrorBound - MinKentError)*2.0/Emin ]
-  double searchDist2 = (ErrorBound - MinKentError)*2.0/sampleEmin;
+  double searchDist2 = (ErrorBound - MinKentError)*2.0/sm.Emin;
   if (searchDist2 < 0.0)
   { // orientation error alone dismisses this node
     return 0;
@@ -818,7 +861,7 @@ int algDirICP_GIMLOP::NodeMightBeCloser(
   return IntersectionSolver.Test_Ellipsoid_OBB_Intersection(
     Xp, node->Bounds, node->F,
     MaxSqrMahalError,
-    sampleN_Rt, sampleDmin);
+    sm.N_Rt, sm.Dmin);
 #endif
 }
 
@@ -839,6 +882,8 @@ void algDirICP_GIMLOP::SetSamples(
 
   R_MsmtM_Rt.SetSize(nSamples);
   outlierFlags.SetSize(nSamples);
+  matchErrorCap.SetSize(nSamples);
+  matchErrorCap.SetAll(std::numeric_limits<double>::max());
   residuals_PostMatch.SetSize(nSamples);
   sqrDist_PostMatch.SetSize(nSamples);
 
@@ -890,9 +935,14 @@ void algDirICP_GIMLOP::SetNoiseModel(
   Dmin_msmt.SetSize(nSamples);
   Emin_msmt.SetSize(nSamples);
 
-  ComputeCovDecompositions(
-    M_msmt, invM_msmt, N_msmt, invN_msmt,
-    Dmin_msmt, Emin_msmt);
+  // decompose the measurement covariances once; the effective noise model
+  //  M_msmt + sigma2*I is formed from these decompositions on each iteration
+  MsmtMCache.SetCovariances(M_msmt);
+  for (unsigned int i = 0; i < nSamples; i++)
+  {
+    MsmtMCache.Decompose(i, 0.0,
+      invM_msmt[i], N_msmt[i], invN_msmt[i], Dmin_msmt[i], Emin_msmt[i]);
+  }
 
   // TODO: only include non-zero values in the means
   //       (since some data may leave out orientation or position for some samples)
@@ -947,19 +997,25 @@ void algDirICP_GIMLOP::ComputeCovDecompositions(
   }
 
   // compute decomposition of noise covariances for each sample
+  //  (the eigen decompositions are computed for all samples at once,
+  //   see CovBatchKernels.h)
   //static vctFixedSizeMatrix<double, 3, 3, VCT_COL_MAJOR> A;
   //static vctFixedSizeMatrix<double, 3, 3, VCT_COL_MAJOR> U;
   //static vctFixedSizeMatrix<double, 3, 3, VCT_COL_MAJOR> Vt;
   //static vct3 S;
   //static vct3 D;
   //static nmrSVDFixedSizeData<3, 3, VCT_COL_MAJOR>::VectorTypeWorkspace workspace;
+  covEigenValues.SetSize(nSamples);
+  covEigenVectors.SetSize(nSamples);
+  ComputeCovEigenDecomposition_Batch(
+    M.Pointer(), nSamples, covEigenValues.Pointer(), covEigenVectors.Pointer());
   for (unsigned int i = 0; i < nSamples; i++)
   {
     // Compute Decomposition of Minv = N'*N
     //   Minv = N'*N = R*D^2*R' = U*S*V'   =>   R'=V', D=sqrt(S), R=U
     //   N = D*R'   invN = R*inv(D)
-    ComputeCovDecomposition_NonIter(
-      M[i], invM[i], N[i], invN[i], Dmin[i], Emin[i]);
+    ComputeCovDecomposition_Eigen(
+      covEigenValues[i], covEigenVectors[i], invM[i], N[i], invN[i], Dmin[i], Emin[i]);
   }
 }
 
@@ -976,6 +1032,16 @@ void algDirICP_GIMLOP::ComputeCovDecomposition_NonIter(
   vct3x3  eigenVectors;
   ComputeCovEigenDecomposition_NonIter(M, eigenValues, eigenVectors);
 
+  ComputeCovDecomposition_Eigen(eigenValues, eigenVectors, Minv, N, Ninv, Dmin, Emin);
+}
+
+// decomposition of M from its eigen decomposition M = V*diag(S)*V'
+//  (eigen values in descending order)
+void algDirICP_GIMLOP::ComputeCovDecomposition_Eigen(
+  const vct3 &eigenValues, const vct3x3 &eigenVectors,
+  vct3x3 &Minv, vct3x3 &N, vct3x3 &Ninv,
+  double &Dmin, double &Emin)
+{
   // Compute Minv
   //   Minv = V*diag(1/S)*V'
   static vctFixedSizeMatrix<double, 3, 3, VCT_COL_MAJOR> V_Sinv;
@@ -1023,7 +1089,6 @@ void algDirICP_GIMLOP::UpdateOptimizerCalculations(const /*vct6*/ vctDynamicVect
   // matrix for rotation increment
   Ra = vctRot3(vctRodRot3(a));
 
-  Xp_xfm = samplePtsXfmd;
   vctDynamicVectorRef<vct3>   Xp_xfm(samplePtsXfmd);
   vctDynamicVectorRef<vct3>   Xn_xfm(sampleNormsXfmd);
   vctDynamicVectorRef<vct3>   Yp(matchPts);
@@ -34,9 +34,12 @@
 #ifndef _algDirICP_GIMLOP_h
 #define _algDirICP_GIMLOP_h
 
+#include <vector>
+
 #include "algDirICP.h"
 #include "DirPDTree_Mesh.h"
 #include "TriangleClosestPointSolver.h"
+#include "CovDecompositionCache.h"
 
 #include "Ellipsoid_OBB_Intersection_Solver.h"
 #include "wrapper_dlib.h"
@@ -124,6 +127,9 @@ protected:
   vctDynamicVector<vct3x3>	invN_msmt;
   vctDoubleVec				Dmin_msmt;		// sqrt of smallest eigenvalue of inv(M)
   vctDoubleVec				Emin_msmt;		// smallest eigenvalue of inv(M)
+  CovDecompositionCache		MsmtMCache;		// decompositions of M_msmt (shared by M_msmt + sigma2*I)
+  vctDynamicVector<vct3>		covEigenValues;		// eigen decompositions computed by ComputeCovDecompositions()
+  vctDynamicVector<vct3x3>	covEigenVectors;
   //  match uncertainty model (dynamic)
   double traceM_est;
   double meanTraceM_msmt;
@@ -140,14 +146,22 @@ protected:
   //  and used whenever a tree search routine is called for that sample thereafter.
   //  These do not change relative to the node being searched => storing them here
   //  allows using the same PD tree search structure without adding new
-  //  function arguments.
-  vctFixedSizeMatrix<double, 3, 2> sampleR_L;
-  double sampleK, sampleB;
-  vct3x3 sampleR_InvM_Rt;
-  vct3x3 sampleN_Rt;
-  vct3x3 sample_inv_N_Rt;
-  double sampleDmin;
-  double sampleEmin;
+  //  function arguments. Each thread of a batch search has its own copy
+  //  (see SearchModel()), so the samples may be searched in parallel.
+  struct SampleSearchModel
+  {
+    vctFixedSizeMatrix<double, 3, 2> R_L;
+    double K, B;
+    vct3x3 R_InvM_Rt;
+    vct3x3 N_Rt;
+    vct3x3 inv_N_Rt;
+    double Dmin;
+    double Emin;
+  };
+  std::vector<SampleSearchModel> searchModels;
+
+  // search variables of the calling thread
+  SampleSearchModel &SearchModel() { return searchModels[PDTreeThreadIndex()]; }
 
   unsigned int	nTrans;
 
@@ -158,7 +172,6 @@ protected:
   vctRot3 Ra;
   //vctDynamicVector<vct3> Yp_RaXp_t;
 
-  vctDynamicVector<vct3>	Xp_xfm;
   vctDynamicVector<vct3>	Yp_t;
   vctDynamicVector<vct3>	Rat_Yp_RaXp_t;
   vctDynamicVector<vct3>	invM_Rat_Yp_RaXp_t;
@@ -178,6 +191,15 @@ protected:
   double ChiSquareThresh = 7.81;
   double sumSqrDist_Inliers;
   vctDynamicVector<int>   outlierFlags;
+  // outlier-capped search (see SetOutlierCappedSearch())
+  bool bOutlierCappedSearch = false;
+  vctDoubleVec matchErrorCap;   // cap on the match error searched for each sample
+
+  // the capped search of a sample found no match below the cap
+  bool MatchCapped(unsigned int s) const
+  {
+    return matchErrors.Element(s) >= matchErrorCap.Element(s);
+  }
 
   // dynamic noise model
   double sigma2;											// match uncertainty (added to My covariances as sigma2*I)
@@ -212,6 +234,16 @@ public:
 
   virtual void ReturnScale(double &scale);
 
+  // Stop the match search of a sample once its match is proven an outlier
+  //  (disabled by default; see algICP_IMLP::SetOutlierCappedSearch())
+  //  The orientation terms of the match error are at most 2k + |B|, so a
+  //  sample having no datum with error below ChiSquare/2 + 2k + |B| fails
+  //  the positional outlier test. The outlier test uses the noise model of
+  //  the search (R*invM*Rt is only updated after registration), so the
+  //  proof holds when the matches are filtered. The capped samples are left
+  //  out of the match uncertainty and orientation error estimates.
+  void SetOutlierCappedSearch(bool bEnable) { bOutlierCappedSearch = bEnable; }
+
   // dlib routines
   void    UpdateOptimizerCalculations(const vctDynamicVector<double> &x);
   void    CostFunctionGradient(const vctDynamicVector<double> &x, vctDynamicVector<double> &g);
@@ -258,12 +290,19 @@ public:
   void ComputeCovDecomposition_NonIter(
     const vct3x3 &M, vct3x3 &Minv, vct3x3 &N, vct3x3 &Ninv,
     double &Dmin, double &Emin);
+  void ComputeCovDecomposition_Eigen(
+    const vct3 &eigenValues, const vct3x3 &eigenVectors,
+    vct3x3 &Minv, vct3x3 &N, vct3x3 &Ninv,
+    double &Dmin, double &Emin);
   void ComputeCovDecomposition_SVD(
     const vct3x3 &M, vct3x3 &Minv, vct3x3 &N, vct3x3 &Ninv, 
     double &Dmin, double &Emin );
 
   // standard virtual routines
+  virtual bool ParallelMatchSafe() const { return true; }
+  virtual void ReserveSearchThreads(int numThreads);
   virtual void SamplePreMatch(unsigned int sampleIndex);
+  virtual double SampleMatchErrorCap(unsigned int sampleIndex);
 
 
   //--- ICP Interface Methods ---//
@@ -43,6 +43,7 @@ double algDirICP_GIMLOP_Mesh::FindClosestPointOnDatum(
   int datum)
 {
   // NOTE: noise model parameters are those set by the pre-match routine within the base class
+  const SampleSearchModel &sm = SearchModel();
 
 #ifdef KENT_POS_ISOTROPIC
   // This finds closest point to this triangle in a Euclidean distance sense
@@ -57,15 +58,15 @@ double algDirICP_GIMLOP_Mesh::FindClosestPointOnDatum(
   //
   //   Mahalanobis Distance:  sqrt((x-v)'*Minv*(x-v))
   //
-  TCPS.FindMostLikelyPointOnTriangle(Xp, datum, sampleN_Rt, sample_inv_N_Rt, closest);
+  TCPS.FindMostLikelyPointOnTriangle(Xp, datum, sm.N_Rt, sm.inv_N_Rt, closest);
 #endif
 
   // norm has same value everywhere on this datum
   closestNorm = pDirTree->mesh.faceNormals[datum];
 
   // noise parameters set by the pre-match routine of the base class
-  double major = vctDotProduct(sampleR_L.Column(0), closestNorm);
-  double minor = vctDotProduct(sampleR_L.Column(1), closestNorm);
+  double major = vctDotProduct(sm.R_L.Column(0), closestNorm);
+  double minor = vctDotProduct(sm.R_L.Column(1), closestNorm);
 
   //debugStream << "RL1*Xn: " << sampleR_L.Column(0) * Xn << std::endl
   //  << "RL2*Xn: " << sampleR_L.Column(1) * Xn << std::endl;
@@ -74,11 +75,11 @@ double algDirICP_GIMLOP_Mesh::FindClosestPointOnDatum(
   // return the match error
   //  Note: add "extra" k so that match error is always >= 0
 #ifdef KENT_POS_ISOTROPIC
-  return sampleK * (1 - vctDotProduct(Xn, closestNorm)) - sampleB*(major*major - minor*minor) 
-    + (Xp-closest).NormSquare()*sampleEmin/2.0;
+  return sm.K * (1 - vctDotProduct(Xn, closestNorm)) - sm.B*(major*major - minor*minor) 
+    + (Xp-closest).NormSquare()*sm.Emin/2.0;
 #else
-  return sampleK * (1 - vctDotProduct(Xn, closestNorm)) - sampleB*(major*major - minor*minor)
-    + ((Xp - closest)*sampleR_InvM_Rt*(Xp - closest)) / 2.0;
+  return sm.K * (1 - vctDotProduct(Xn, closestNorm)) - sm.B*(major*major - minor*minor)
+    + ((Xp - closest)*sm.R_InvM_Rt*(Xp - closest)) / 2.0;
 #endif
 
 }
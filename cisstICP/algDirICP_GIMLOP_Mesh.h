@@ -72,7 +72,7 @@ public:
     PARAM_EST_TYPE paramEst = PARAMS_FIXED)
 	: algDirICP_GIMLOP(pDirTree, samplePts, sampleNorms, argK, argE, argL, M, scale, bScale, paramEst),
     pDirTree(pDirTree),
-	  TCPS(pDirTree->mesh)
+	  TCPS(pDirTree->mesh, pDirTree->PrecomputedTCPS())
   {};
 
   // destructor
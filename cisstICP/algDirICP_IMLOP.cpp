@@ -160,9 +160,18 @@ void algDirICP_IMLOP::ICP_InitializeParameters(vctFrm3 &FGuess)
   // initialize base class
   algDirICP::ICP_InitializeParameters(FGuess);
 
-  k = k_init;
-  sigma2 = sigma2_init;
-  B = 1.0 / (2.0*sigma2_init);
+  if (bWarmStartNoiseModel)
+  { // continue from the noise model of a previous registration
+    k = k_warmStart;
+    sigma2 = sigma2_warmStart;
+    bWarmStartNoiseModel = false;
+  }
+  else
+  {
+    k = k_init;
+    sigma2 = sigma2_init;
+  }
+  B = 1.0 / (2.0*sigma2);
 
 #ifdef TEST_STD_ICP
   k = 0.0;
@@ -173,6 +182,23 @@ void algDirICP_IMLOP::ICP_InitializeParameters(vctFrm3 &FGuess)
   errFuncPosWeight = B;
 }
 
+bool algDirICP_IMLOP::ReturnNoiseModel(double &sigma2, double &k)
+{
+  sigma2 = this->sigma2;
+  k = this->k;
+  return true;
+}
+
+void algDirICP_IMLOP::SetNoiseModelWarmStart(double sigma2, double k)
+{
+  if (sigma2 > 0.0)
+  {
+    bWarmStartNoiseModel = true;
+    k_warmStart = k;
+    sigma2_warmStart = sigma2;
+  }
+}
+
 void algDirICP_IMLOP::ICP_UpdateParameters_PostRegister(vctFrm3 &Freg)
 {
   // base class
@@ -83,6 +83,8 @@ public:
 protected:
 
   double k_init, sigma2_init;
+  bool   bWarmStartNoiseModel;          // begin the next registration from
+  double k_warmStart, sigma2_warmStart; //  these values (see SetNoiseModelWarmStart())
   double wRpos;   // weighting of positions for estimating k in each iteration
 
   bool   dynamicParamEst;  // if true, k & sigma2 are dynamically estimated from the match residuals
@@ -145,7 +147,9 @@ public:
     bool dynamicallyEstParams = true)
     : algDirICP(pDirTree, samplePts, sampleNorms),
     algDirPDTree(pDirTree),
-    k_init(kinit), sigma2_init(sigma2init), wRpos(wRpos),
+    k_init(kinit), sigma2_init(sigma2init),
+    bWarmStartNoiseModel(false), k_warmStart(0.0), sigma2_warmStart(0.0),
+    wRpos(wRpos),
     k_factor(kfactor),
     dynamicParamEst(dynamicallyEstParams),
     threshK(1.0e5), threshB(1.0e4)
@@ -166,6 +170,9 @@ public:
   void SetNoiseModel(
     double initK, double initSigma2, double wRpos, bool dynamicallyEstParams);
 
+  virtual bool ReturnNoiseModel(double &sigma2, double &k);
+  virtual void SetNoiseModelWarmStart(double sigma2, double k);
+
   void SetSamples(
     const vctDynamicVector<vct3> &argSamplePts,
     const vctDynamicVector<vct3> &argSampleNorms);
@@ -183,6 +190,10 @@ public:
 
   //--- PD Tree Interface Methods ---//
 
+  // the noise model is shared by all samples, so the search writes no state
+  //  (derived search algorithms must keep this so; see DirPDTreeMatchCallback)
+  virtual bool ParallelMatchSafe() const { return true; }
+
   int  NodeMightBeCloser(
     const vct3 &v, const vct3 &n,
     DirPDTreeNode const *node,
@@ -69,7 +69,7 @@ public:
     bool dynamicallyEstParams = true) :
       algDirICP_IMLOP(pDirTree, samplePts, sampleNorms, kinit, sigma2init, wRpos, kfactor, dynamicallyEstParams),
       pDirTree(pDirTree),
-      TCPS(pDirTree->mesh)
+      TCPS(pDirTree->mesh, pDirTree->PrecomputedTCPS())
   {}
 
   // destructor
@@ -38,6 +38,7 @@
 #include "algDirICP_PIMLOP.h"
 #include "DirPDTreeNode.h"
 #include "utilities.h"
+#include "CovBatchKernels.h"
 
 
 #include <assert.h>
@@ -161,11 +162,14 @@ void algDirICP_PIMLOP::UpdateNoiseModel_SamplesXfmd(vctFrm3 &Freg)
 {
   // update noise models of the transformed sample points
   vctRot3 R(Freg.Rotation());
+  Calc_RMRt_Batch(R, invM.Pointer(), nSamples, R_invM_Rt.Pointer());
+  // the plane orientations, N and invN are not symmetric, so their
+  //  products with R are not batched (the batched kernels are for
+  //  symmetric matrices)
   for (unsigned int s = 0; s < nSamples; s++)
   {
     Ry_pln[s] = R * Rx_pln[s];
 
-    R_invM_Rt[s] = R * invM[s] * R.Transpose();
     N_Rt[s] = N[s] * R.Transpose();
     inv_N_Rt[s] = R*invN[s];
   }
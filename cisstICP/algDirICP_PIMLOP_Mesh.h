@@ -68,6 +68,9 @@ public:
 
 
   // standard ICP algorithm virtual methods
+  //  (the sample being searched is held per thread by the search algorithm)
+  bool ParallelMatchSafe() const { return true; }
+  void ReserveSearchThreads(int numThreads) { ReserveSearchSamples(numThreads); }
   void SamplePreMatch(unsigned int sampleIndex);
 };
 
@@ -33,6 +33,7 @@
 // ****************************************************************************
 #include "algDirICP_PIMLOP_dlibWrapper.h"
 #include "algDirICP_PIMLOP.h"
+#include "ICPTrace.h"
 
 #include <assert.h>
 #undef NDEBUG       // enable debug in release mode
@@ -96,6 +97,8 @@ algDirICP_PIMLOP_dlibWrapper::algDirICP_PIMLOP_dlibWrapper(algDirICP_PIMLOP *arg
 
 vct6 algDirICP_PIMLOP_dlibWrapper::ComputeRegistration( const vct6 &x0 )
 {
+  ICPTRACE_SCOPE("PIMLOP dlib ComputeRegistration");
+
   dlib_vector x_dlib(6);  // 6-element vector
 
   try
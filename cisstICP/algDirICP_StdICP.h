@@ -137,6 +137,10 @@ public:
 
   //--- PD Tree Interface Methods ---//
 
+  // the closest point search writes no state
+  //  (derived search algorithms must keep this so; see DirPDTreeMatchCallback)
+  virtual bool ParallelMatchSafe() const { return true; }
+
   int  NodeMightBeCloser(
     const vct3 &v, const vct3 &n,
     DirPDTreeNode const *node,
@@ -64,7 +64,7 @@ public:
     vctDynamicVector<vct3> &sampleNorms) :
       algDirICP_StdICP(pDirTree, samplePts, sampleNorms),
       pDirTree(pDirTree),
-      TCPS(pDirTree->mesh)
+      TCPS(pDirTree->mesh, pDirTree->PrecomputedTCPS())
   {}
 
   // destructor
@@ -111,6 +111,16 @@ void algDirICP_VIMLOP::SetSamples(
 
 	S_R_Rat_Y3dn_2d(alg2D_DirPDTree_vonMises_Edges::nSamples);
 	k_S_R_Rat_Y3dn_2d_Xxfmd.resize(alg2D_DirPDTree_vonMises_Edges::nSamples);
+
+	// optimizer workspace
+	inv_Mxi.resize(algICP_IMLP::nSamples);
+	det_Mxi.resize(algICP_IMLP::nSamples);
+	R_Rat_Y3dp_t.resize(alg2D_DirPDTree_vonMises_Edges::nSamples);
+	R_Rat_Y3dp_t_st_2d.resize(alg2D_DirPDTree_vonMises_Edges::nSamples);
+	inv_MsmtMxi.resize(algICP_IMLP::nSamples);
+	det_MsmtMxi.resize(algICP_IMLP::nSamples);
+	R_Rat_Y3dn.resize(alg2D_DirPDTree_vonMises_Edges::nSamples);
+	R_Rat_Y3dn_2d.resize(alg2D_DirPDTree_vonMises_Edges::nSamples);
 	//outlierFlags.SetSize(alg2D_DirICP::nSamples);
 }
 
@@ -275,20 +285,12 @@ void algDirICP_VIMLOP::UpdateOptimizerCalculations(const vct7 &x)
 	
 	vctDynamicVectorRef<vct3>   Ysfm(algICP_IMLP::matchPts);
 	vctDynamicVectorRef<vct3>   Xsfm_xfmd(algICP_IMLP::samplePtsXfmd);
-	vctDynamicVector<vct3x3>  inv_Mxi(algICP_IMLP::nSamples);       // inverse noise covariances of match Mxi^-1
-	vctDynamicVector<double>  det_Mxi(algICP_IMLP::nSamples);       // determinant of noise covariances of match |Mxi|
 	
 	vctDynamicVectorRef<vct3>   Y3dp(alg2D_DirPDTree_vonMises_Edges::matchPts);
 	vctDynamicVectorRef<vct2>   X3dp_xfmd(alg2D_DirPDTree_vonMises_Edges::samplePtsXfmd);
-	vctDynamicVector<vct3>   R_Rat_Y3dp_t(alg2D_DirPDTree_vonMises_Edges::nSamples);
-	vctDynamicVector<vct2>   R_Rat_Y3dp_t_st_2d(alg2D_DirPDTree_vonMises_Edges::nSamples);
-	vctDynamicVector<vct2x2>  inv_MsmtMxi(algICP_IMLP::nSamples);       // inverse noise covariances of match Mxi^-1
-	vctDynamicVector<double>  det_MsmtMxi(algICP_IMLP::nSamples);       // determinant of noise covariances of match |Mxi|
 
 	vctDynamicVectorRef<vct3>   Y3dn(alg2D_DirPDTree_vonMises_Edges::matchNorms);
 	vctDynamicVectorRef<vct2>   X3dn_xfmd(alg2D_DirPDTree_vonMises_Edges::sampleNormsXfmd);
-	vctDynamicVector<vct3>   R_Rat_Y3dn(alg2D_DirPDTree_vonMises_Edges::nSamples);
-	vctDynamicVector<vct2>   R_Rat_Y3dn_2d(alg2D_DirPDTree_vonMises_Edges::nSamples);
 
 	// C_sfm_i
 	for (unsigned int i = 0; i < algICP_IMLP::nSamples; i++)
@@ -489,9 +491,10 @@ unsigned int algDirICP_VIMLOP::ICP_FilterMatches()
 // fast check if a datum might have smaller match error than error bound
 int algDirICP_VIMLOP::DatumMightBeCloser(const vct3 &v,
                                                 int datum,
-                                                double ErrorBound)
+                                                double ErrorBound,
+                                                PDTreeSearchContext &ctx)
 {
-	return algICP_IMLP_Mesh::DatumMightBeCloser(v, datum, ErrorBound);
+	return algICP_IMLP_Mesh::DatumMightBeCloser(v, datum, ErrorBound, ctx);
 }
 
 int algDirICP_VIMLOP::DatumMightBeCloser(const vct2 &v, const vct2 &n,
@@ -505,9 +508,10 @@ int algDirICP_VIMLOP::DatumMightBeCloser(const vct2 &v, const vct2 &n,
 //  than the error bound
 int algDirICP_VIMLOP::NodeMightBeCloser(const vct3 &v,
 	PDTreeNode *node,
-	double ErrorBound)
+	double ErrorBound,
+	PDTreeSearchContext &ctx)
 {
-	return algICP_IMLP_Mesh::NodeMightBeCloser(v, node, ErrorBound);
+	return algICP_IMLP_Mesh::NodeMightBeCloser(v, node, ErrorBound, ctx);
 }
 
 
@@ -516,9 +520,9 @@ int algDirICP_VIMLOP::NodeMightBeCloser(const vct3 &v,
 // Note: this function depends on the SamplePreMatch() function
 //       to set the noise model of the current transformed sample
 //       point before this function is called
-void algDirICP_VIMLOP::ComputeNodeMatchCov(PDTreeNode *node, DirPDTree2DNode *dirNode)
+void algDirICP_VIMLOP::ComputeNodeMatchCov(PDTreeNode *node, DirPDTree2DNode *dirNode, PDTreeSearchContext &ctx)
 {
-	algICP_IMLP_Mesh::ComputeNodeMatchCov(node);
+	algICP_IMLP_Mesh::ComputeNodeMatchCov(node, ctx);
   //// Note:  This function is called when searching a node that is using 
   ////        its own noise model rather than that of its parent node
 
@@ -595,9 +599,10 @@ void algDirICP_VIMLOP::ComputeCovDecomposition_SVD(const vct3x3 &M, vct3x3 &Minv
 double algDirICP_VIMLOP::FindClosestPointOnDatum(
 	const vct3 &point,
 	vct3 &closest,
-	int datum)
+	int datum,
+	PDTreeSearchContext &ctx)
 {
-	return algICP_IMLP_Mesh::FindClosestPointOnDatum(point, closest, datum);
+	return algICP_IMLP_Mesh::FindClosestPointOnDatum(point, closest, datum, ctx);
 }
 
 double algDirICP_VIMLOP::FindClosestPointOnDatum(
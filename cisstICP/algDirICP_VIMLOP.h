@@ -87,6 +87,16 @@ public:
 
 	vctDynamicVector<vct2>		S_R_Rat_Y3dn_2d;
 	vctDynamicVector<double>	k_S_R_Rat_Y3dn_2d_Xxfmd;
+
+	// workspace of UpdateOptimizerCalculations() (sized in SetSamples())
+	vctDynamicVector<vct3x3>	inv_Mxi;        // inverse noise covariances of match Mxi^-1
+	vctDynamicVector<double>	det_Mxi;        // determinant of noise covariances of match |Mxi|
+	vctDynamicVector<vct3>		R_Rat_Y3dp_t;
+	vctDynamicVector<vct2>		R_Rat_Y3dp_t_st_2d;
+	vctDynamicVector<vct2x2>	inv_MsmtMxi;    // inverse measurement noise covariances
+	vctDynamicVector<double>	det_MsmtMxi;    // determinant of measurement noise covariances
+	vctDynamicVector<vct3>		R_Rat_Y3dn;
+	vctDynamicVector<vct2>		R_Rat_Y3dn_2d;
   //-- Algorithm Parameters --//
 
 protected:
@@ -218,7 +228,7 @@ protected:
 
   void UpdateNoiseModel_SamplesXfmd(vctFrm3 &Freg);
 
-  void ComputeNodeMatchCov(PDTreeNode *node, DirPDTree2DNode *dirNode);
+  void ComputeNodeMatchCov(PDTreeNode *node, DirPDTree2DNode *dirNode, PDTreeSearchContext &ctx);
 
   void ComputeCovDecomposition_NonIter(const vct3x3 &M, vct3x3 &Minv, double &det_M);
   void ComputeCovDecomposition_NonIter(const vct3x3 &M, vct3x3 &Minv, vct3x3 &N, vct3x3 &Ninv, double &det_M);
@@ -275,7 +285,11 @@ public:
   int  NodeMightBeCloser(
     const vct3 &v,
     PDTreeNode *node,
-	double ErrorBound);
+	double ErrorBound,
+	PDTreeSearchContext &ctx);
+
+  // (the node check above is that of IMLP, so the flattened tree uses
+  //  algICP_IMLP::FlatNodeMightBeCloser())
 
   int  NodeMightBeCloser(
 	  const vct2 &v,
@@ -285,12 +299,14 @@ public:
   double FindClosestPointOnDatum(
     const vct3 &v,
     vct3 &closest,
-    int datum);
+    int datum,
+    PDTreeSearchContext &ctx);
 
   int  DatumMightBeCloser(
     const vct3 &v,
     int datum,
-    double ErrorBound);
+    double ErrorBound,
+    PDTreeSearchContext &ctx);
 
   int  DatumMightBeCloser(
 	  const vct2 &sample, const vct2 &sampleNorm,
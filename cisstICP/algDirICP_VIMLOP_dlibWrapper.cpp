@@ -33,6 +33,7 @@
 // ****************************************************************************
 #include "algDirICP_VIMLOP_dlibWrapper.h"
 #include "algDirICP_VIMLOP.h"
+#include "ICPTrace.h"
 
 #include <assert.h>
 #undef NDEBUG       // enable debug in release mode
@@ -99,6 +100,8 @@ algDirICP_VIMLOP_dlibWrapper::algDirICP_VIMLOP_dlibWrapper(algDirICP_VIMLOP *arg
 
 vct7 algDirICP_VIMLOP_dlibWrapper::ComputeRegistration(const vct7 &x0)
 {
+  ICPTRACE_SCOPE("VIMLOP dlib ComputeRegistration");
+
   dlib_vector x_dlib(7);  // 7-element vector
 
   //std::cout << "[1.1]" << std::endl;
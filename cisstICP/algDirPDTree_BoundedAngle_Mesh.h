@@ -62,7 +62,7 @@ public:
   algDirPDTree_BoundedAngle_Mesh(DirPDTree_Mesh *pDirTree, double maxMatchAngle_ = 2.0*cmnPI)
     : algDirPDTree_BoundedAngle(pDirTree, maxMatchAngle_),
     pDirTree(pDirTree),
-    TCPS(pDirTree->mesh)
+    TCPS(pDirTree->mesh, pDirTree->PrecomputedTCPS())
   {}
 
   // destructor
@@ -81,8 +81,9 @@ int algDirPDTree_vonMisesPrj::NodeMightBeCloser(
   // Ellipsoid / OBB Intersection Test
   //  test if the ellipsoid centered at the sample point and defined by the 
   //  level set of MaxSqrMahalError intersects the oriented bounding box of this node
+  const SearchSampleModel &sm = SearchSample();
   return IntersectionSolver.Test_Ellipsoid_OBB_Intersection(
-    Xp, node->Bounds, node->F, MaxSqrMahalError, N, Dmin);
+    Xp, node->Bounds, node->F, MaxSqrMahalError, sm.N, sm.Dmin);
 }
 
 // Xpln         ~ non-transformed in-plane (2d) sample orientation
@@ -100,16 +101,17 @@ void algDirPDTree_vonMisesPrj::InitializeSample(
   vct3x3 N, vct3x3 Ninv,
   double Dmin)
 {
-  this->Xpln = Xpln;
-  this->sample_k = sample_k;  
-  this->Minv = Minv;
-  this->N = N;
-  this->Ninv = Ninv;
-  this->Dmin = Dmin;
-  //this->M = M;
+  SearchSampleModel &sm = SearchSample();
+  sm.Xpln = Xpln;
+  sm.sample_k = sample_k;  
+  sm.Minv = Minv;
+  sm.N = N;
+  sm.Ninv = Ninv;
+  sm.Dmin = Dmin;
+  //sm.M = M;
   
-  this->Rpln_y.Row(0) = Ry_pln.Column(0);
-  this->Rpln_y.Row(1) = Ry_pln.Column(1);
+  sm.Rpln_y.Row(0) = Ry_pln.Column(0);
+  sm.Rpln_y.Row(1) = Ry_pln.Column(1);
 }
 
 // Xpln       ~ non-transformed in-plane (2d) sample orientation
@@ -124,20 +126,21 @@ void algDirPDTree_vonMisesPrj::InitializeSample(
   vct3x3 sample_M, //vct3 sample_M_Eig,
   vctRot3 Rreg )
 {
-  this->Xpln = Xpln;  
-  this->sample_k = sample_k;
-  //this->sample_M = sample_M;
-  //this->Rreg = Rreg;
+  SearchSampleModel &sm = SearchSample();
+  sm.Xpln = Xpln;  
+  sm.sample_k = sample_k;
+  //sm.sample_M = sample_M;
+  //sm.Rreg = Rreg;
 
   vctRot3 Ry_pln(Rreg * Rx_pln);
-  this->Rpln_y.Row(0) = Ry_pln.Column(0);
-  this->Rpln_y.Row(1) = Ry_pln.Column(1);
+  sm.Rpln_y.Row(0) = Ry_pln.Column(0);
+  sm.Rpln_y.Row(1) = Ry_pln.Column(1);
 
   // compute noise model of transformed sample point
   vct3x3 RMxRt = Rreg * sample_M * Rreg.TransposeRef();
 
   // compute noise model decomposition
-  ComputeCovDecomposition(RMxRt, Minv, N, Ninv, Dmin);
+  ComputeCovDecomposition(RMxRt, sm.Minv, sm.N, sm.Ninv, sm.Dmin);
 }
 
 void algDirPDTree_vonMisesPrj::ComputeCovDecomposition(
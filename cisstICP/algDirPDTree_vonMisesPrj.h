@@ -34,6 +34,8 @@
 #ifndef _algDirPDTree_vonMisesPrj_h
 #define _algDirPDTree_vonMisesPrj_h
 
+#include <vector>
+
 #include "algDirPDTree.h"
 #include "Ellipsoid_OBB_Intersection_Solver.h"
 
@@ -53,29 +55,34 @@ protected:
 
   Ellipsoid_OBB_Intersection_Solver IntersectionSolver;
 
-  vct2 Xpln;   // non-transformed in-plane orientation of sample
-                //  NOTE: 3d orientation in local sample coords = [Xpln; 0]
-
-  // sample noise model  
-  double sample_k;   // orientational concentration
-  //vct3x3 sample_M;   // positional covariance
-  //vct3   sample_M_Eig;  // eigenvalues of sample covariance in order of decreasing magnitude
-  
-  //  Current rotation of registration
-  //vctRot3 Rreg;   // position matches Yp close to Rreg * Xp + t = Xp_xfm
-
-  // Yn_2d_xfm = Rpln_y * Yn_3d
-  //  NOTE: orientation matches Yn_3d are chosen such that
-  //        Prj_xy(Rreg^-1 * Yn_3d) = Yn_2d_xfm is close to Xpln
-  vctFixedSizeMatrix<double, 2, 3> Rpln_y;
-
-  // effective noise model for node intersection test
-  //  (i.e. for transformed samples)
-  //vct3x3 M;     // effective measurement error covariance for a node & sample pair
-  vct3x3 Minv;    // M = effective measurement error covariance for a node & sample pair
-  vct3x3 N, Ninv; // decomposition of inv(M) = N'N
-  double Dmin;    // inverse sqrt of largest eigenvalue of M
-                  //  (or the sqrt of the smallest eigenvalue of inv(M))
+  // Variables for current sample point undergoing a match search
+  //  these are set once for each sample by InitializeSample() and used
+  //  by the tree search routines for that sample thereafter. Each thread
+  //  of a batch search has its own copy (see SearchSample()).
+  struct SearchSampleModel
+  {
+    vct2 Xpln;   // non-transformed in-plane orientation of sample
+                  //  NOTE: 3d orientation in local sample coords = [Xpln; 0]
+
+    // sample noise model
+    double sample_k;   // orientational concentration
+
+    // Yn_2d_xfm = Rpln_y * Yn_3d
+    //  NOTE: orientation matches Yn_3d are chosen such that
+    //        Prj_xy(Rreg^-1 * Yn_3d) = Yn_2d_xfm is close to Xpln
+    vctFixedSizeMatrix<double, 2, 3> Rpln_y;
+
+    // effective noise model for node intersection test
+    //  (i.e. for transformed samples)
+    vct3x3 Minv;    // M = effective measurement error covariance for a node & sample pair
+    vct3x3 N, Ninv; // decomposition of inv(M) = N'N
+    double Dmin;    // inverse sqrt of largest eigenvalue of M
+                    //  (or the sqrt of the smallest eigenvalue of inv(M))
+  };
+  std::vector<SearchSampleModel> searchSamples;
+
+  // search variables of the calling thread
+  SearchSampleModel &SearchSample() { return searchSamples[PDTreeThreadIndex()]; }
 
   // the log term is constant when the measurement error of the target is
   //  is assumed to be zero
@@ -88,12 +95,23 @@ public:
 
   // constructor
   algDirPDTree_vonMisesPrj(DirPDTreeBase *pDirTree)
-    : algDirPDTree(pDirTree)
+    : algDirPDTree(pDirTree),
+    searchSamples(1)
   {}
 
   // destructor
   virtual ~algDirPDTree_vonMisesPrj() {}
 
+  // Size the search variables for a batch search by the given
+  //  number of threads (see DirPDTreeMatchCallback::ReserveSearchThreads())
+  void ReserveSearchSamples(int numThreads)
+  {
+    if ((int)searchSamples.size() < numThreads)
+    {
+      searchSamples.resize(numThreads);
+    }
+  }
+
   // Set sample to be matched in the search (slower routine)
   //  Xpln       ~ non-transformed in-plane (2d) sample orientation
   //  Rx_pln     ~ transformation from plane to y coordinates:  Xn = Rx_pln * [Xpln; 0]
@@ -44,17 +44,18 @@ double algDirPDTree_vonMisesPrj_Mesh::FindClosestPointOnDatum(
 {
   // This routine ignores the 3d orientation Xn and uses the 2d orientation
   //  Xpln as stored in the base class
+  const SearchSampleModel &sm = SearchSample();
 
   // Find closest point on triangle in a Mahalanobis distance sense
   //
   //   Mahalanobis Distance:  sqrt((x-v)'*Minv*(x-v))
   //
-  TCPS.FindMostLikelyPointOnTriangle(Xp, datum, N, Ninv, closest);
+  TCPS.FindMostLikelyPointOnTriangle(Xp, datum, sm.N, sm.Ninv, closest);
 
   // norm has same value everywhere on this datum
-  static vct2 Yprj, Ypln;
+  vct2 Yprj, Ypln;
   closestNorm = pDirTree->mesh.faceNormals(datum);  
-  Yprj = Rpln_y * closestNorm;
+  Yprj = sm.Rpln_y * closestNorm;
   double Ynorm = Yprj.Norm();
   if (Ynorm < 0.001)
   {
@@ -69,8 +70,8 @@ double algDirPDTree_vonMisesPrj_Mesh::FindClosestPointOnDatum(
   // Note: orientation error was pre-computed in DatumMightBeCloser routine
   // add extra k to the negative log-likelihood value in order
   //  to make match error always >= 0  
-  return sample_k*(1 - Ypln * Xpln)
-    + ((Xp - closest)*Minv*(Xp - closest)) / 2.0;
+  return sm.sample_k*(1 - Ypln * sm.Xpln)
+    + ((Xp - closest)*sm.Minv*(Xp - closest)) / 2.0;
 
   //// set closest point
   //TCPS.FindClosestPointOnTriangle(
@@ -62,7 +62,7 @@ public:
   algDirPDTree_vonMisesPrj_Mesh(DirPDTree_Mesh *pDirTree)
     : algDirPDTree_vonMisesPrj(pDirTree),
     pDirTree(pDirTree),
-	TCPS(pDirTree->mesh)
+	TCPS(pDirTree->mesh, pDirTree->PrecomputedTCPS())
   {}
 
   // destructor
@@ -33,10 +33,17 @@
 // ****************************************************************************
 
 #include "algICP.h"
+#include "DistanceField_Mesh.h"
+#include "utilities.h"
+#include "ICPTrace.h"
 #include <omp.h>
 
 #define ENABLE_PARALLELIZATION
 
+// search margin for match reuse, as a multiple of the distance a sample
+//  moved since its previous search
+#define MATCH_REUSE_MARGIN_SCALE 4.0
+
 #ifdef ValidatePDTreeSearch
 std::ofstream validFS("../ICP_TestData/LastRun/debugPDTreeSearchValidation.txt");
 vct3 validPoint;
@@ -83,6 +90,10 @@ namespace {
       << arg.nOutliers
       //<< dR.Norm()*180/cmnPI << arg.dF.Translation().Norm()
       ;
+    if (pThis->bMatchReuse)
+    {
+      ss << cmnPrintf("  skip=%.2f") << pThis->matchReuseFraction;
+    }
 #ifdef ValidatePDTreeSearch
       fstring = "  vld=%.2f";
       ss << cmnPrintf(fstring.c_str())
@@ -104,7 +115,13 @@ std::vector<cisstICP::Callback> algICP::ICP_GetIterationCallbacks()
 
 // constructor
 algICP::algICP(PDTreeBase *pTree, const vctDynamicVector<vct3> &samplePts)
-  : pTree(pTree)
+  : pTree(pTree),
+  bSpatialSearchOrder(false),
+  bMatchReuse(false),
+  bMatchReuseActive(false),
+  matchReuseFraction(0.0),
+  pDistanceField(NULL),
+  pSearchAlgorithm(NULL)
 {
 	//std::cout << "Setting samples ICP...\n";
   SetSamples(samplePts);
@@ -122,6 +139,42 @@ void algICP::SetSamples(const vctDynamicVector<vct3> &argSamplePts)
   matchPts.SetSize(nSamples);
   matchDatums.SetSize(nSamples);
   matchErrors.SetSize(nSamples);
+
+  matchSearchPts.SetSize(nSamples);
+  matchReuseRadius.SetSize(nSamples);
+  matchReuseRadius.SetAll(0.0);
+  matchReused.SetSize(nSamples);
+  matchReused.SetAll(0);
+
+  // the sample order is computed from the untransformed samples, since the
+  //  spatial coherence of the samples is unaffected by a rigid transform
+  if (bSpatialSearchOrder)
+  {
+    ComputeMortonOrder(samplePts, sampleSearchOrder);
+  }
+  else
+  {
+    sampleSearchOrder.SetSize(0);
+  }
+}
+
+void algICP::SetSpatialSearchOrder(bool bEnable)
+{
+  bSpatialSearchOrder = bEnable;
+  if (bSpatialSearchOrder)
+  {
+    ComputeMortonOrder(samplePts, sampleSearchOrder);
+  }
+  else
+  {
+    sampleSearchOrder.SetSize(0);
+  }
+}
+
+void algICP::SetMatchReuse(bool bEnable)
+{
+  bMatchReuse = bEnable;
+  matchReuseRadius.SetAll(0.0);
 }
 
 void algICP::ICP_InitializeParameters(vctFrm3 &FGuess)
@@ -148,6 +201,10 @@ void algICP::ICP_InitializeParameters(vctFrm3 &FGuess)
   //  matchPts.Element(s) = pTree->DatumSortPoint(0);
   //}
 
+  // the initial matches are not searched => none may be reused
+  matchSearchPts = samplePtsXfmd;
+  matchReuseRadius.SetAll(0.0);
+
   nOutliers = 0;
   Freg = FGuess;
 }
@@ -166,45 +223,70 @@ void algICP::ICP_UpdateParameters_PostRegister(vctFrm3 &Freg)
 
 void algICP::ICP_ComputeMatches()
 {
+  ICPTRACE_SCOPE("ComputeMatches", "samples", nSamples);
+
   // Find the point on the model having lowest match error
   //  for each sample point
+  //  (the tree schedules the searches across threads; the algorithm sets
+  //   the sample-specific search values through the pre-match callback)
 
-#ifdef ValidatePDTreeSearch  
-  numInvalidDatums = 0;
-  numValidDatums = 0;
-#endif
-  unsigned int nodesSearched = 0;
+  const vctDynamicVector<unsigned int> *pSearchOrder =
+    sampleSearchOrder.size() == nSamples ? &sampleSearchOrder : NULL;
 
-  minNodesSearched = std::numeric_limits<unsigned int>::max();
-  maxNodesSearched = std::numeric_limits<unsigned int>::min();
-  avgNodesSearched = 0;
+  if (!pSearchAlgorithm)
+  {
+    pSearchAlgorithm = dynamic_cast<algPDTree*>(this);
+    if (!pSearchAlgorithm) pSearchAlgorithm = pTree->pAlgorithm;
+  }
 
-  unsigned int s;
-#ifdef ENABLE_PARALLELIZATION
-#pragma omp parallel for
-#endif
-  for (s = 0; s < nSamples; s++)
+  // the distance field of the target mesh only finds closest point matches
+  bool bSearchDistanceField = pDistanceField
+    && (PDTreeBase*)pDistanceField->pTree == pTree
+    && pSearchAlgorithm->MatchErrorIsDistance();
+
+  // skip the search of samples that provably keep their match
+  bMatchReuseActive = bMatchReuse && !bSearchDistanceField
+    && pSearchAlgorithm->MatchErrorIsDistance();
+  matchReuseFraction = 0.0;
+  if (bMatchReuseActive)
   {
-    // inform algorithm beginning new match
-    SamplePreMatch(s);
+    matchReuseFraction = (double)ReuseMatches() / (double)nSamples;
+    pSearchOrder = &matchSearchList;
+  }
 
-    // Find best match for this sample
-    matchDatums.Element(s) = pTree->FindClosestDatum(
-      samplePtsXfmd.Element(s),
-      matchPts.Element(s),
-      matchDatums.Element(s),
-      matchErrors.Element(s),
-      nodesSearched);
+  if (bSearchDistanceField)
+  {
+    pDistanceField->FindClosestDatums(
+      samplePtsXfmd, matchDatums,
+      matchDatums, matchPts, matchErrors,
+      matchStats, this, pSearchOrder, pSearchAlgorithm);
+  }
+  else
+  {
+    pTree->FindClosestDatums(
+      samplePtsXfmd, matchDatums,
+      matchDatums, matchPts, matchErrors,
+      matchStats, this, pSearchOrder, pSearchAlgorithm);
+  }
 
-    avgNodesSearched += nodesSearched;
-    minNodesSearched = (nodesSearched < minNodesSearched) ? nodesSearched : minNodesSearched;
-    maxNodesSearched = (nodesSearched > maxNodesSearched) ? nodesSearched : maxNodesSearched;
+  minNodesSearched = matchStats.minNodesSearched;
+  maxNodesSearched = matchStats.maxNodesSearched;
+  avgNodesSearched = (int)matchStats.avgNodesSearched;
 
 #ifdef ValidatePDTreeSearch
+  numInvalidDatums = 0;
+  numValidDatums = 0;
+  for (unsigned int s = 0; s < nSamples; s++)
+  {
+    PDTreeSearchContext ctx;
+    ctx.sampleIndex = s;
+    ctx.pAlgorithm = pSearchAlgorithm;
+    SamplePreMatch(s, ctx);
+
 #ifdef ValidateByEuclideanDist
     validDatum = pTree->ValidateClosestDatum_ByEuclideanDist(samplePtsXfmd.Element(s), validPoint);
 #else
-    validDatum = pTree->ValidateClosestDatum(samplePtsXfmd.Element(s), validPoint);
+    validDatum = pTree->ValidateClosestDatum(samplePtsXfmd.Element(s), validPoint, ctx);
 #endif
     if (validDatum != matchDatums.Element(s))
     {
@@ -222,10 +304,10 @@ void algICP::ICP_ComputeMatches()
         numInvalidDatums++;
         vct3 tmp1;
 
-        searchError = pTree->pAlgorithm->FindClosestPointOnDatum(
-          samplePtsXfmd.Element(s), tmp1, matchDatums.Element(s));
-        validError = pTree->pAlgorithm->FindClosestPointOnDatum(
-          samplePtsXfmd.Element(s), tmp1, validDatum);
+        searchError = pSearchAlgorithm->FindClosestPointOnDatum(
+          samplePtsXfmd.Element(s), tmp1, matchDatums.Element(s), ctx);
+        validError = pSearchAlgorithm->FindClosestPointOnDatum(
+          samplePtsXfmd.Element(s), tmp1, validDatum, ctx);
         validFS << "Match Errors = " << searchError << "/" << validError
           << "\t\tdPos = " << ResidualDistance << "/" << validDist << std::endl;
         validFS << " XfmSamplePoint = [" << samplePtsXfmd.Element(s) << "]" << std::endl;
@@ -276,13 +358,8 @@ void algICP::ICP_ComputeMatches()
     {
       numValidDatums++;
     }
-#endif
-
-    // inform algorithm that match completed
-    SamplePostMatch(s);
   }
-
-  avgNodesSearched /= nSamples;
+#endif
 
 #ifdef ValidatePDTreeSearch  
   validPercent = (double)numValidDatums / (double)nSamples;
@@ -315,6 +392,73 @@ void algICP::ICP_ComputeMatches()
 
 }
 
+unsigned int algICP::ReuseMatches()
+{
+  int s;
+#ifdef ENABLE_PARALLELIZATION
+#pragma omp parallel for
+#endif
+  for (s = 0; s < (int)nSamples; s++)
+  {
+    // the match error of every datum has changed by at most the distance
+    //  moved, so the match is unchanged if this is less than half the gap
+    //  between the match and the runner-up at the last search
+    double dist = (samplePtsXfmd.Element(s) - matchSearchPts.Element(s)).Norm();
+    matchReused.Element(s) = (dist < matchReuseRadius.Element(s));
+    if (matchReused.Element(s))
+    {
+      PDTreeSearchContext ctx;
+      ctx.sampleIndex = s;
+      ctx.pAlgorithm = pSearchAlgorithm;
+      matchErrors.Element(s) = pSearchAlgorithm->FindClosestPointOnDatum(
+        samplePtsXfmd.Element(s), matchPts.Element(s), matchDatums.Element(s), ctx);
+    }
+  }
+
+  // list the remaining samples in search order
+  unsigned int nReused = 0;
+  for (unsigned int k = 0; k < nSamples; k++)
+  {
+    if (matchReused.Element(k)) nReused++;
+  }
+  matchSearchList.SetSize(nSamples - nReused);
+  unsigned int n = 0;
+  for (unsigned int k = 0; k < nSamples; k++)
+  {
+    unsigned int i = sampleSearchOrder.size() == nSamples ? sampleSearchOrder.Element(k) : k;
+    if (!matchReused.Element(i))
+    {
+      matchSearchList.Element(n++) = i;
+    }
+  }
+
+  return nReused;
+}
+
+void algICP::SamplePreMatch(unsigned int sampleIndex, PDTreeSearchContext &ctx)
+{
+  if (bMatchReuseActive)
+  {
+    ctx.SearchMargin = MATCH_REUSE_MARGIN_SCALE *
+      (samplePtsXfmd.Element(sampleIndex) - matchSearchPts.Element(sampleIndex)).Norm();
+  }
+}
+
+void algICP::SamplePostMatch(unsigned int sampleIndex, PDTreeSearchContext &ctx)
+{
+  if (bMatchReuseActive)
+  {
+    // every datum other than the match has at least this error
+    double runnerUpBound = ctx.ErrorBound + ctx.SearchMargin;
+    if (ctx.RunnerUpError < runnerUpBound)
+    {
+      runnerUpBound = ctx.RunnerUpError;
+    }
+    matchReuseRadius.Element(sampleIndex) = 0.5*(runnerUpBound - ctx.ErrorBound);
+    matchSearchPts.Element(sampleIndex) = samplePtsXfmd.Element(sampleIndex);
+  }
+}
+
 unsigned int algICP::ICP_FilterMatches()
 {
   return 0;
@@ -66,8 +66,10 @@ extern std::string saveMatchesDir;
 extern int saveMatchesIter;
 #endif
 
+class DistanceField_Mesh;   // forward decleration
 
-class algICP
+
+class algICP : public PDTreeMatchCallback
 {
   //
   // This is the base class for a family of ICP algorithms
@@ -88,7 +90,35 @@ public:
   vctDynamicVector<int>   matchDatums;
   vctDoubleVec            matchErrors;
 
+  // search statistics
   int minNodesSearched, maxNodesSearched, avgNodesSearched;
+  PDTreeSearchStats matchStats;   // node and datum counts of the last match
+
+  // order in which the samples are searched
+  //  (the samples sorted along a Morton curve, so that consecutive
+  //   searches share most of their tree path; empty if not used)
+  //  Note: all sample and match arrays remain in the original sample order
+  bool bSpatialSearchOrder;
+  vctDynamicVector<unsigned int> sampleSearchOrder;
+
+  // match reuse (see SetMatchReuse())
+  bool bMatchReuse;
+  bool bMatchReuseActive;   // match reuse is enabled and valid for the search algorithm
+  vctDynamicVector<vct3>  matchSearchPts;     // sample positions at their last search
+  vctDoubleVec            matchReuseRadius;   // distance a sample may move from its last search
+                                              //  position and provably keep its match
+  vctDynamicVector<int>   matchReused;        // flags the samples whose search was skipped
+  vctDynamicVector<unsigned int> matchSearchList; // samples searched on this iteration
+  double matchReuseFraction;  // fraction of samples whose search was skipped on the last match
+
+  // distance field searched in place of the tree (see SetDistanceField())
+  DistanceField_Mesh *pDistanceField;
+
+  // tree search interface of this algorithm
+  //  (passed with each search, so that algorithm instances sharing a tree
+  //   do not depend on the algorithm registered with the tree; set on the
+  //   first match)
+  algPDTree *pSearchAlgorithm;
 
   // current registration
   vctFrm3 Freg;
@@ -106,6 +136,34 @@ public:
 
   virtual void  SetSamples(const vctDynamicVector<vct3> &argSamplePts);
 
+  // enable/disable searching the samples in spatially coherent order
+  //  (disabled by default; does not change the matches found)
+  void  SetSpatialSearchOrder(bool bEnable);
+
+  // enable/disable skipping the search of samples that provably keep
+  //  their match (disabled by default; does not change the matches found)
+  //  Each search also finds a lower bound on the match error of the
+  //  runner-up datum, by pruning with a margin added to the error bound.
+  //  Half the gap between the match and the runner-up is a distance that
+  //  the sample may move and keep the same match; while the sample stays
+  //  within this distance of where it was last searched, its match is only
+  //  re-projected onto the same datum. The margin is proportional to the
+  //  distance the sample moved since its previous search.
+  //  Only used by algorithms whose match error is the distance to the
+  //  match (see algPDTree::MatchErrorIsDistance()); the errors of the
+  //  oriented algorithms also depend on the sample orientation and these
+  //  always search every sample.
+  void  SetMatchReuse(bool bEnable);
+
+  // search the given distance field of the target mesh in place of the
+  //  tree (NULL to search the tree; default NULL)
+  //  The distance field finds the closest point matches and is only used by
+  //  algorithms whose match error is the distance to the match (see
+  //  algPDTree::MatchErrorIsDistance()); the distance field must be built
+  //  on the mesh of this algorithm's tree. Match reuse is not applied to
+  //  the searches of the distance field.
+  void  SetDistanceField(DistanceField_Mesh *pField) { pDistanceField = pField; }
+
   virtual void ComputeMatchStatistics(double &Avg, double &StdDev);
   virtual void  PrintMatchStatistics(std::stringstream &tMsg){};
 
@@ -113,12 +171,32 @@ public:
   virtual void ReturnShapeParam(vctDynamicVector<double> &shapeParam) {};
   virtual void ReturnMatchPts(vctDynamicVector<vct3> &matchPts, vctDynamicVector<vct3> &matchNorms){};
 
+  // noise model estimates of the last registration: the match uncertainty
+  //  (sigma2) and, for oriented algorithms, the orientation concentration (k)
+  //  returns false if the algorithm does not estimate a noise model
+  virtual bool ReturnNoiseModel(double &sigma2, double &k) { return false; }
+
+  // begin the next registration from the given noise model estimates
+  //  rather than from the algorithm's initial values, e.g. those of the
+  //  previous level of a coarse-to-fine registration (applies to the next
+  //  call of ICP_InitializeParameters() only)
+  virtual void SetNoiseModelWarmStart(double sigma2, double k) {}
+
 protected:
 
   virtual void  UpdateSampleXfmPositions(const vctFrm3 &F);
 
-  virtual void  SamplePreMatch(unsigned int sampleIndex) {};
-  virtual void  SamplePostMatch(unsigned int sampleIndex) {};
+  // called by the tree's batch search for each sample (see PDTreeMatchCallback);
+  //  the search context is used for all PD tree searches of this sample;
+  //  any sample-specific search variables must be stored there rather than
+  //  in the algorithm, since multiple samples may be matched concurrently
+  //  (the base routines set the search margin and reuse radius of match reuse)
+  virtual void  SamplePreMatch(unsigned int sampleIndex, PDTreeSearchContext &ctx);
+  virtual void  SamplePostMatch(unsigned int sampleIndex, PDTreeSearchContext &ctx);
+
+  // re-project the matches of samples within their reuse radius and set the
+  //  list of samples to search (returns the number of matches reused)
+  unsigned int  ReuseMatches();
 
 
 //--- ICP Interface Methods ---//
@@ -37,9 +37,12 @@
 #include "PDTreeNode.h"
 #include "RegisterP2P.h"
 #include "utilities.h"
+#include "CovBatchKernels.h"
+
+#include <cisstOSAbstraction.h>
 
 #include <limits.h>
-//#include <omp.h>
+#include <omp.h>
 
 #define COMPUTE_ERROR_FUNCTION
 #define ENABLE_PARALLELIZATION
@@ -57,8 +60,14 @@ algICP_DIMLP::algICP_DIMLP(
 	dlib(this),
 	pTree(pTree),
 	pMesh(pTree->MeshP),
-	TCPS(*(pTree->MeshP))
+	TCPS(*(pTree->MeshP), pTree->PrecomputedTCPS())
 {
+	refitTol = 0.0;
+	rebuildRatio = 1.5;
+	nRefitTriangles = 0;
+	nRebuilds = 0;
+	refitTime = 0.0;
+
 	SetSamples(samplePts, sampleCov, sampleMsmtCov, meanShape, scale, bScale);
 }
 
@@ -96,7 +105,7 @@ void algICP_DIMLP::ComputeMatchStatistics(double &Avg, double &StdDev)
 	for (unsigned int i = 0; i < nSamples; i++)
 	{
 		residual = Tssm_Y[i] - (Freg * samplePts[i]) * sc;
-		M = Freg.Rotation() * Mxi[i] * Freg.Rotation().Transpose() + *Myi[i];
+		M = Freg.Rotation() * Mxi[i] * Freg.Rotation().Transpose() + Myi[i];
 		ComputeCovInverse_NonIter(M, Minv);
 
 		sqrMahalDist = residual*Minv*residual;
@@ -126,6 +135,8 @@ void algICP_DIMLP::PrintMatchStatistics(std::stringstream &tMsg)
 	// For registration rejection purpose:
 	tMsg << "\nSum square mahalanobis distance = " << totalSumSqrMahalDist << " over " << nSamples << " samples";
 	tMsg << "\nSum square mahalanobis distance = " << sumSqrMahalDist << " over " << nGoodSamples << " inliers\n";
+	tMsg << "Shape refit: " << nRefitTriangles << " triangles updated, " << nRebuilds << " tree rebuilds, "
+		<< refitTime << " sec total\n";
 }
 
 void algICP_DIMLP::SetSamples(
@@ -151,16 +162,17 @@ void algICP_DIMLP::SetSamples(
 
 	Si = pTree->MeshP->Si;
 	wi = pTree->MeshP->wi;
+	if (!pMesh->HasModeMatrix())
+		pMesh->BuildModeMatrix();
 
-	Tssm_wi.resize(nModes);
-	for (int i = 0; i < Tssm_wi.size(); i++)
-		Tssm_wi[i].resize(nSamples);
 	Tssm_matchPts.resize(nSamples);
 
 	Tssm_Y.resize(nSamples);
 	Tssm_Y_t.resize(nSamples);
 	Rat_Tssm_Y_t_x.resize(nSamples);
 	Rat_Tssm_Y_t_x_invMx.resize(nSamples);
+	inv_Mxi.SetSize(nSamples);
+	ComputeCovInverse_Batch(argMxi.Pointer(), nSamples, inv_Mxi.Pointer());
 
 	x_prev.SetSize(nTrans + nModes);  // transformation parameters, and n modes
 	mu.SetSize(nSamples);
@@ -201,20 +213,26 @@ void algICP_DIMLP::ICP_UpdateParameters_PostMatch()
 	algICP::ICP_UpdateParameters_PostMatch();
 
 	// compute sum of square distances of inliers
+	//  (leaving out the previous matches kept by capped searches)
 	sumSqrDist_Inliers = 0.0;
+	unsigned int nInliers = 0;
 	for (unsigned int s = 0; s < nSamples; s++)
 	{
 		residuals_PostMatch.Element(s) = samplePtsXfmd.Element(s) - Tssm_Y.Element(s); 
 		sqrDist_PostMatch.Element(s) = residuals_PostMatch.Element(s).NormSquare();
 
-		if (!outlierFlags[s])
+		if (!outlierFlags[s] && !MatchCapped(s))
 		{
 			sumSqrDist_Inliers += sqrDist_PostMatch.Element(s);
+			nInliers++;
 		}
 	}
 
 	// update the match uncertainty factor
-	sigma2 = sumSqrDist_Inliers / (nSamples - nOutliers);
+	if (nInliers > 0)
+	{
+		sigma2 = sumSqrDist_Inliers / nInliers;
+	}
 
 	// apply max threshold
 	if (sigma2 > sigma2Max)
@@ -222,14 +240,24 @@ void algICP_DIMLP::ICP_UpdateParameters_PostMatch()
 		sigma2 = sigma2Max;
 	}
 
+	// matches of capped samples that are no longer proven outliers
+	unsigned int nResearched = ResearchCappedSamples();
+	for (unsigned int i = 0; i < nResearched; i++)
+	{
+		unsigned int s = cappedSamples.Element(i);
+		Tssm_Y.Element(s) = matchPts.Element(s);
+		residuals_PostMatch.Element(s) = samplePtsXfmd.Element(s) - Tssm_Y.Element(s);
+		sqrDist_PostMatch.Element(s) = residuals_PostMatch.Element(s).NormSquare();
+	}
+
 	// update noise models of the matches
 	for (unsigned int s = 0; s < nSamples; s++)
 	{
 		//update target covariances
-		Myi[s] = algICP::pTree->DatumCovPtr(matchDatums.Element(s));	// use pointer here for efficiency
+		algICP::pTree->DatumCov(matchDatums.Element(s), Myi[s]);
 
 		// target covariance with match uncertainty
-		Myi_sigma2[s] = *Myi[s];
+		Myi_sigma2[s] = Myi[s];
 		Myi_sigma2[s].Element(0, 0) += sigma2;
 		Myi_sigma2[s].Element(1, 1) += sigma2;
 		Myi_sigma2[s].Element(2, 2) += sigma2;
@@ -241,14 +269,11 @@ void algICP_DIMLP::ICP_UpdateParameters_PostMatch()
 	}
 
 	vctRot3 R(FGuess.Rotation());
-	for (unsigned int s = 0; s < nSamples; s++)
-	{
-		R_MsmtMxi_Rt[s] = R*MsmtMxi[s] * R.Transpose();
-	}
+	Calc_RMRt_Batch(R, MsmtMxi.Pointer(), nSamples, R_MsmtMxi_Rt.Pointer());
 
 #ifdef DEBUG_DIMLP
-	std::cout << "My0:" << std::endl << *Myi[0] << std::endl;
-	std::cout << "My1:" << std::endl << *Myi[1] << std::endl;
+	std::cout << "My0:" << std::endl << Myi[0] << std::endl;
+	std::cout << "My1:" << std::endl << Myi[1] << std::endl;
 #endif
 
 	bFirstIter_Matches = false;
@@ -265,9 +290,6 @@ void algICP_DIMLP::ICP_UpdateParameters_PostRegister(vctFrm3 &Freg)
 	UpdateShape(Si);
 	UpdateTree();
 
-	// Re-initialize to compute matches on updated mesh
-	TCPS.init(pTree->MeshP->vertices, pTree->MeshP->faces);
-
 #if 0
 	static int count = 1;
 	cisstMesh currentSamples;
@@ -290,22 +312,27 @@ void algICP_DIMLP::UpdateShape(vctDynamicVector<double>	&S)
 	//static int itermesh = 0;
 
 	// deformably transform each mesh vertex
-	pTree->MeshP->vertices = meanShape;
-	int s;
-#ifdef ENABLE_PARALLELIZATION
-#pragma omp parallel for
-#endif
-	for (s = 0; s < pMesh->NumVertices(); s++)
-		for (unsigned int i = 0; i < nModes; i++)
-			pTree->MeshP->vertices(s) += (S[i] * wi[i].Element(s));
+	//  (one matrix-vector product with the mode matrix of the mesh)
+	pMesh->SynthesizeShape(meanShape, S, pMesh->vertices);
 }
 
 void algICP_DIMLP::UpdateTree()
 {
-	vctFrm3 FId;
-	FId.Assign(vctFrm3::Identity());
+	osaStopwatch refitTimer;
+	refitTimer.Reset();
+	refitTimer.Start();
+
+	// update the triangles and the tree bounds holding them
+	//  (rather than re-initializing the solver and enlarging all node bounds)
+	nRefitTriangles += TCPS.Refit(pTree->MeshP->vertices, refitTol, triMoved);
+	pTree->RefitBounds(&triMoved, 2.0*refitTol);
+	if (pTree->RelativeTreeQuality() > rebuildRatio)
+	{
+		pTree->RebuildTree();
+		nRebuilds++;
+	}
 
-	pTree->EnlargeBounds(FId);
+	refitTime += refitTimer.GetElapsedTime();
 }
 
 void algICP_DIMLP::ICP_ComputeMatches()
@@ -352,10 +379,10 @@ double algICP_DIMLP::ICP_EvaluateErrorFunction()
 	//	Simplified Error = Sum_i[ -loglik_IMLP ] + 1/2 * Sum_i [ ||s||^2 ]
 	//
 
-	vctDynamicVector<vct3x3>  Mi(nSamples);           // noise covariances of match (R*Mxi*Rt + Myi)
-	vctDynamicVector<vct3x3>  inv_Mi(nSamples);       // inverse noise covariances of match (R*Mxi*Rt + Myi)^-1
-	vctDynamicVector<double>  det_Mi(nSamples);       // determinant of noise covariances of match |R*Mxi*Rt + Myi|
-	vctDynamicVector<double>  SqrMahalDist(nSamples); // square Mahalanobis distance of matches = (yi-Rxi-t)'*inv(Mi)*(yi-Rxi-t)
+	vct3x3  Mi;            // noise covariances of match (R*Mxi*Rt + Myi)
+	vct3x3  inv_Mi;        // inverse noise covariances of match (R*Mxi*Rt + Myi)^-1
+	double  det_Mi;        // determinant of noise covariances of match |R*Mxi*Rt + Myi|
+	double  SqrMahalDist;  // square Mahalanobis distance of matches = (yi-Rxi-t)'*inv(Mi)*(yi-Rxi-t)
 
 	vct3 residual;
 	double nklog2PI = 0.0;
@@ -372,17 +399,17 @@ double algICP_DIMLP::ICP_EvaluateErrorFunction()
 		// deformed shape after computing updating Si
 		residual = samplePtsXfmd.Element(s) - Tssm_Y.Element(s);  
 		// match covariance
-		Mi.Element(s) = R_Mxi_Rt.Element(s) + Myi_sigma2.Element(s);
+		Mi = R_Mxi_Rt.Element(s) + Myi_sigma2.Element(s);
 		// match covariance decomposition
-		ComputeCovDecomposition_NonIter(Mi.Element(s), inv_Mi.Element(s), det_Mi.Element(s));
+		ComputeCovDecomposition_NonIter(Mi, inv_Mi, det_Mi);
 		// match square Mahalanobis distance
-		SqrMahalDist.Element(s) = residual*inv_Mi.Element(s)*residual;
+		SqrMahalDist = residual*inv_Mi*residual;
 
 		// -- Here We Compute the Full Negative Log-Likelihood -- //
 		// Compute error contribution for this sample
 		nklog2PI += 3.0*log(2.0*cmnPI);
-		expCost += SqrMahalDist.Element(s);
-		logCost += log(det_Mi.Element(s));
+		expCost += SqrMahalDist;
+		logCost += log(det_Mi);
 	}
 	ssmCost += Si.NormSquare();
 
@@ -455,6 +482,44 @@ void algICP_DIMLP::ComputeMu()
 	}
 }
 
+// Barycentric mode contributions of the matches
+//  The match point of sample j on the shape with parameters s is
+//    Tssm_Y[j] = Tssm_Y_mean[j] + sum_i s[i]*Tssm_wi[i][j]
+//  where Tssm_wi[i][j] = sum_v mu[j][v]*wi[i][f[j][v]]; these are computed
+//  once per registration, so the optimizer evaluations do not access the mesh
+void algICP_DIMLP::ComputeModeBasis()
+{
+	modeBasis.SetSize(nSamples * nModes * 3);
+#ifdef ENABLE_PARALLELIZATION
+	gsThreadBuf.SetSize(omp_get_max_threads() * nModes);
+#else
+	gsThreadBuf.SetSize(nModes);
+#endif
+	Tssm_Y_mean.SetSize(nSamples);
+
+	int j;
+#ifdef ENABLE_PARALLELIZATION
+#pragma omp parallel for
+#endif
+	for (j = 0; j < (int)nSamples; j++)
+	{
+		Tssm_Y_mean[j] = mu[j][0] * meanShape[f[j][0]]
+			+ mu[j][1] * meanShape[f[j][1]]
+			+ mu[j][2] * meanShape[f[j][2]];
+
+		double *b = modeBasis.Pointer(j * nModes * 3);
+		for (unsigned int i = 0; i < nModes; i++)
+		{
+			vct3 w = mu[j][0] * wi[i][f[j][0]]
+				+ mu[j][1] * wi[i][f[j][1]]
+				+ mu[j][2] * wi[i][f[j][2]];
+			b[3 * i] = w[0];
+			b[3 * i + 1] = w[1];
+			b[3 * i + 2] = w[2];
+		}
+	}
+}
+
 bool algICP_DIMLP::ICP_Terminate(vctFrm3 &F)
 {
 	if (bTerminateAlgorithm)
@@ -476,7 +541,7 @@ void algICP_DIMLP::ReturnScale(double &scale)
 
 void algICP_DIMLP::ReturnShapeParam(vctDynamicVector<double> &shapeParam)
 {
-	shapeParam = Si;
+	shapeParam.ForceAssign(Si);  // reallocates only if the size changes
 }
 
 void algICP_DIMLP::ReturnMatchPts(vctDynamicVector<vct3> &rMatchPts, vctDynamicVector<vct3> &rMatchNorms)
@@ -503,13 +568,7 @@ vctFrm3 algICP_DIMLP::ICP_RegisterMatches()
 	// x_prev must be at a different value than x0
 	x_prev.SetAll(std::numeric_limits<double>::max());
 
-	for (unsigned int j = 0; j < nSamples; j++)
-	{
-		for (unsigned int i = 0; i < nModes; i++)
-			Tssm_wi[i][j]	= mu[j][0] * wi[i][f[j][0]]
-							+ mu[j][1] * wi[i][f[j][1]]
-							+ mu[j][2] * wi[i][f[j][2]];
-	}
+	ComputeModeBasis();
 
 	x = dlib.ComputeRegistration(x0);
 
@@ -545,28 +604,29 @@ void algICP_DIMLP::UpdateOptimizerCalculations(const vctDynamicVector<double> &x
 	// Rodrigues formulation
 	Ra = vctRot3(vctRodRot3(a));
 
-	X = samplePts;
-	vctDynamicVectorRef<vct3>   Mu(mu);
+	X.ForceAssign(samplePts);  // reallocates only if the sample count changes
 
-	vctDynamicVector<vct3x3>  inv_Mxi(nSamples);       // inverse noise covariances of match Mxi^-1
-	vctDynamicVector<double>  det_Mxi(nSamples);       // determinant of noise covariances of match |Mxi|
-
-	// Update shape based on current s (and wi and meanshape)
 	// Compute Tssm_Y based on current Mu and shape
-	UpdateShape(s);
+	//  from the mode contributions of the matches (the full shape
+	//  is synthesized after the registration)
 	unsigned int j;
 #ifdef ENABLE_PARALLELIZATION
 #pragma omp parallel for
 #endif
 	for (j = 0; j < nSamples; j++)
 	{
-		Tssm_Y.Element(j)	= Mu[j][0] * pMesh->vertices[f[j][0]] 
-							+ Mu[j][1] * pMesh->vertices[f[j][1]] 
-							+ Mu[j][2] * pMesh->vertices[f[j][2]];
+		const double *b = modeBasis.Pointer(j * nModes * 3);
+		vct3 y = Tssm_Y_mean[j];
+		for (unsigned int i = 0; i < nModes; i++)
+		{
+			y[0] += s[i] * b[3 * i];
+			y[1] += s[i] * b[3 * i + 1];
+			y[2] += s[i] * b[3 * i + 2];
+		}
+		Tssm_Y.Element(j) = y;
 
 		Tssm_Y_t.Element(j) = Tssm_Y.Element(j) - t;
 		Rat_Tssm_Y_t_x.Element(j) = Ra.Transpose() * Tssm_Y_t.Element(j) - sc * X.Element(j); 
-		ComputeCovDecomposition_NonIter(Mxi.Element(j), inv_Mxi.Element(j), det_Mxi.Element(j));
 		Rat_Tssm_Y_t_x_invMx.Element(j) = Rat_Tssm_Y_t_x.Element(j) * inv_Mxi.Element(j);
 	}
 	x_prev = x;
@@ -583,7 +643,7 @@ double algICP_DIMLP::CostFunctionValue(const vctDynamicVector<double> &x)
 	double f = 0.0; 
 	unsigned int i;
 #ifdef ENABLE_PARALLELIZATION
-#pragma omp parallel for
+#pragma omp parallel for reduction(+:f)
 #endif
 	for (i = 0; i < nSamples; i++)
 	{
@@ -622,26 +682,57 @@ void algICP_DIMLP::CostFunctionGradient(const vctDynamicVector<double> &x, vctDy
 		gsc.SetRef(g, 6);
 	vctDynamicVectorRef<double> gs(g, nTrans, nModes);
 
-	vct3x3 Jz_a;
-
-	unsigned int j;
+	// each thread accumulates its own gradient, which are summed at the end
 #ifdef ENABLE_PARALLELIZATION
-#pragma omp parallel for
+#pragma omp parallel
 #endif
-	for (j = 0; j < nSamples; j++)
 	{
-		if (outlierFlags[j])	continue;
+		vct3 ga_j(0.0), gt_j(0.0);
+		double gsc_j = 0.0;
+		// shape gradient sums of this thread (preallocated in ComputeModeBasis())
+#ifdef ENABLE_PARALLELIZATION
+		double *gs_j = gsThreadBuf.Pointer(omp_get_thread_num() * nModes);
+#else
+		double *gs_j = gsThreadBuf.Pointer();
+#endif
+		for (unsigned int i = 0; i < nModes; i++)
+			gs_j[i] = 0.0;
+		vct3x3 Jz_a;
 
-		for (unsigned int c = 0; c < 3; c++)
-			Jz_a.Column(c) = dRa[c].TransposeRef() * Tssm_Y_t[j]; // check this computation
+		unsigned int j;
+#ifdef ENABLE_PARALLELIZATION
+#pragma omp for
+#endif
+		for (j = 0; j < nSamples; j++)
+		{
+			if (outlierFlags[j])	continue;
 
-		ga += Rat_Tssm_Y_t_x_invMx[j] * Jz_a;
-		gt += Rat_Tssm_Y_t_x_invMx[j] * (-Ra.Transpose());
-		if (bScale)
-			gsc += Rat_Tssm_Y_t_x_invMx[j] * (-X.Element(j));
+			for (unsigned int c = 0; c < 3; c++)
+				Jz_a.Column(c) = dRa[c].TransposeRef() * Tssm_Y_t[j]; // check this computation
 
-		for (unsigned int i = 0; i < nModes; i++)
-			gs[i] += Rat_Tssm_Y_t_x_invMx[j] * (Ra.Transpose() * Tssm_wi[i][j]);	// Cmatch component	
+			ga_j += Rat_Tssm_Y_t_x_invMx[j] * Jz_a;
+			gt_j += Rat_Tssm_Y_t_x_invMx[j] * (-Ra.Transpose());
+			if (bScale)
+				gsc_j += Rat_Tssm_Y_t_x_invMx[j] * (-X.Element(j));
+
+			// Cmatch component:  r'*Ra'*Tssm_wi[i][j] = (Ra*r)'*Tssm_wi[i][j]
+			vct3 q = Ra * Rat_Tssm_Y_t_x_invMx[j];
+			const double *b = modeBasis.Pointer(j * nModes * 3);
+			for (unsigned int i = 0; i < nModes; i++)
+				gs_j[i] += q[0] * b[3 * i] + q[1] * b[3 * i + 1] + q[2] * b[3 * i + 2];
+		}
+
+#ifdef ENABLE_PARALLELIZATION
+#pragma omp critical (algICP_DIMLP_CostFunctionGradient)
+#endif
+		{
+			ga += ga_j;
+			gt += gt_j;
+			if (bScale)
+				gsc[0] += gsc_j;
+			for (unsigned int i = 0; i < nModes; i++)
+				gs[i] += gs_j[i];
+		}
 	}
 
 #ifdef NOREGULARIZER
@@ -657,12 +748,13 @@ void algICP_DIMLP::CostFunctionGradient(const vctDynamicVector<double> &x, vctDy
 // fast check if a datum might have smaller match error than error bound
 int algICP_DIMLP::DatumMightBeCloser(const vct3 &v,
 	int datum,
-	double ErrorBound)
+	double ErrorBound,
+	PDTreeSearchContext &ctx)
 {
 	return true;
 }
 
-double algICP_DIMLP::FindClosestPointOnDatum(const vct3 &v, vct3 &closest, int datum)
+double algICP_DIMLP::FindClosestPointOnDatum(const vct3 &v, vct3 &closest, int datum, PDTreeSearchContext &ctx)
 {
 	// first iteration variables that don't change
 	static const vct3x3 I_7071(vct3x3::Eye()*0.7071); // sqrt(1/2)*I
@@ -670,8 +762,8 @@ double algICP_DIMLP::FindClosestPointOnDatum(const vct3 &v, vct3 &closest, int d
 	static const vct3x3 I2(vct3x3::Eye()*2.0); // 2*I
 	static const vct3x3 I_5(vct3x3::Eye()*0.5); // 0.5*I
 
-	static vct3 d;
-	static vct3x3 M, Minv, N, Ninv;
+	vct3 d;
+	vct3x3 M, Minv, N, Ninv;
 	double det_M;
 
 	if (bFirstIter_Matches)
@@ -690,7 +782,8 @@ double algICP_DIMLP::FindClosestPointOnDatum(const vct3 &v, vct3 &closest, int d
 
 		// compute noise model for this datum
 		//  M = R*Mxi*R' + Myi
-		M = sample_RMxRt_sigma2 + pMesh->TriangleCov[datum];
+		M = ctx.sampleXfm_M;
+		pMesh->AddTriangleCovariance(datum, M);
 		ComputeCovDecomposition_NonIter(M, Minv, N, Ninv, det_M);
 	}
 
@@ -58,7 +58,9 @@ public:
 	vctDynamicVector<vct3>		Tssm_matchPts;
 	vctDynamicVector<vct3>		mu;
 	vctDynamicVector<vctInt3>	f;
-	vctDynamicVector<vctDynamicVector<vct3>>	Tssm_wi;
+	vctDynamicVector<vct3>		Tssm_Y_mean;	// match points on the mean shape
+	vctDynamicVector<double>	modeBasis;	// Tssm_wi[i][j] at (j*nModes + i)*3 (see ComputeModeBasis())
+	vctDynamicVector<double>	gsThreadBuf;	// per-thread shape gradient sums (nModes per thread)
 
 	double rb, tb, sb, spb;		// rotation, translation, scale, and shape parameter bounds
 	bool bScale;				// boolean for optional scale optimization
@@ -81,12 +83,22 @@ public:
 	vctDynamicVector<vct3> Tssm_Y_t;
 	vctDynamicVector<vct3> Rat_Tssm_Y_t_x;
 	vctDynamicVector<vct3> Rat_Tssm_Y_t_x_invMx;
+	vctDynamicVector<vct3x3> inv_Mxi;	// Mxi^-1 (decomposed once per sample set)
 
 protected:
 	TriangleClosestPointSolver TCPS;
 	PDTree_Mesh *pTree;
 	cisstMesh *pMesh;
 
+	// incremental update of the solver and tree for the deformed shape
+	//  (see SetRefitTolerance())
+	double refitTol;
+	double rebuildRatio;
+	vctDynamicVector<char> triMoved;	// triangles updated by the last refit
+	int nRefitTriangles;			// total over all refits
+	int nRebuilds;
+	double refitTime;
+
 	// Deformable Variables
 	vctDynamicVector<vct3>	meanShape;
 	unsigned int nTrans; // # transformation parameters
@@ -131,6 +143,16 @@ public:
 	virtual void  PrintMatchStatistics(std::stringstream &tMsg);
 	void	UpdateShape(vctDynamicVector<double> &si);
 	void	UpdateTree();
+
+	// The solver and the tree are refit to the shape updated after each
+	//  registration rather than re-initialized: only the triangles having a
+	//  vertex moved by more than the refit tolerance (default 0) since it was
+	//  last updated are recomputed, and only the tree nodes holding them are
+	//  refit, with bounds enlarged by twice the tolerance. The tree is rebuilt
+	//  when its total node bounds area grows beyond the rebuild threshold
+	//  times that of the built tree (default 1.5).
+	void	SetRefitTolerance(double tol) { refitTol = tol; }
+	void	SetRebuildThreshold(double ratio) { rebuildRatio = ratio; }
 	void    UpdateOptimizerCalculations(const vctDynamicVector<double> &x);
 	void    CostFunctionGradient(const vctDynamicVector<double> &x, vctDynamicVector<double> &g);
 	double	CostFunctionValue(const vctDynamicVector<double> &x);
@@ -138,6 +160,7 @@ public:
 protected:
 	// -- Deformable Methods -- //
 	void ComputeMu(); 
+	void ComputeModeBasis();
 
 	// -- ICP Interface Methods -- //
 
@@ -166,11 +189,13 @@ public:
 	virtual double FindClosestPointOnDatum(
 		const vct3 &v,
 		vct3 &closest,
-		int datum);
+		int datum,
+		PDTreeSearchContext &ctx);
 
 	virtual int  DatumMightBeCloser(
 		const vct3 &v,
 		int datum,
-		double ErrorBound);
+		double ErrorBound,
+		PDTreeSearchContext &ctx);
 };
 #endif
\ No newline at end of file
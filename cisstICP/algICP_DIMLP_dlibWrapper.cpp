@@ -33,6 +33,7 @@
 // ****************************************************************************
 #include "algICP_DIMLP_dlibWrapper.h"
 #include "algICP_DIMLP.h"
+#include "ICPTrace.h"
 
 #include <assert.h>
 #undef NDEBUG       // enable debug in release mode
@@ -99,6 +100,8 @@ algICP_DIMLP_dlibWrapper::algICP_DIMLP_dlibWrapper(algICP_DIMLP *argAlg)
 
 vctDynamicVector<double> algICP_DIMLP_dlibWrapper::ComputeRegistration(const vctDynamicVector<double> &x0)
 {
+	ICPTRACE_SCOPE("DIMLP dlib ComputeRegistration");
+
   //dlib_vector x_dlib(7);  // 7-element vector
 	int nComponents = x0.size();
 
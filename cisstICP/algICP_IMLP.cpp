@@ -35,8 +35,10 @@
 #include "algICP_IMLP.h"
 #include "cisstICP.h"
 #include "PDTreeNode.h"
+#include "PDTreeFlat.h"
 #include "RegisterP2P.h"
 #include "utilities.h"
+#include "CovBatchKernels.h"
 
 #include <limits.h>
 
@@ -53,7 +55,13 @@ algICP_IMLP::algICP_IMLP(
   double outlierChiSquareThreshold,
   double sigma2Max)
   : algICP(pTree, samplePts),
-  algPDTree(pTree)
+  algPDTree(pTree),
+  bWarmStartNoiseModel(false),
+  sigma2WarmStart(0.0),
+  bMatchCovCurrent(false),
+  bOutlierCappedSearch(false),
+  bCappedSearch(false),
+  sigma2_Search(0.0)
 {
   SetSamples(samplePts, sampleCov, sampleMsmtCov);
   SetChiSquareThreshold(outlierChiSquareThreshold);
@@ -77,7 +85,7 @@ void algICP_IMLP::ComputeMatchStatistics(double &Avg, double &StdDev)
   for (unsigned int i = 0; i < nSamples; i++)
   {
 	residual = matchPts[i] - Freg * samplePts[i];
-	M = Freg.Rotation() * Mxi[i] * Freg.Rotation().Transpose() + *Myi[i];
+	M = Freg.Rotation() * Mxi[i] * Freg.Rotation().Transpose() + Myi[i];
 	ComputeCovInverse_NonIter(M, Minv);
 
 	sqrMahalDist = residual*Minv*residual;
@@ -139,17 +147,19 @@ void algICP_IMLP::SetSamples(
   MsmtMxi = argMsmtMxi;
 
   eigMxi.SetSize(nSamples);
-  for (unsigned int s = 0; s < nSamples; s++)
-  {
-    ComputeCovEigenValues_SVD(argMxi[s], eigMxi[s]);
-  }
+  ComputeCovEigenValues_Batch(argMxi.Pointer(), nSamples, eigMxi.Pointer());
 
   R_Mxi_Rt.SetSize(nSamples);
   R_MsmtMxi_Rt.SetSize(nSamples);
   Myi_sigma2.SetSize(nSamples);
   Myi.SetSize(nSamples);
+  Mi.SetSize(nSamples);
+  inv_Mi.SetSize(nSamples);
+  det_Mi.SetSize(nSamples);
   
   outlierFlags.SetSize(nSamples);
+  matchErrorCap.SetSize(nSamples);
+  matchErrorCap.SetAll(std::numeric_limits<double>::max());
 
   residuals_PostMatch.SetSize(nSamples);
   sqrDist_PostMatch.SetSize(nSamples);
@@ -203,14 +213,12 @@ void algICP_IMLP::ICP_InitializeParameters(vctFrm3 &FGuess)
   R_MsmtMxi_Rt.SetAll(vct3x3(0.0));
   
   Myi_sigma2.SetAll(vct3x3::Eye());  
-  Myi.SetAll(NULL);
+  Myi.SetAll(vct3x3(0.0));
 
   outlierFlags.SetAll(0);
-
-  //Mi.SetSize(nSamples);
-  //inv_Mi.SetSize(nSamples);
-  //det_Mi.SetSize(nSamples);
-  //SqrMahalDist.SetSize(nSamples);
+  bCappedSearch = false;
+  matchErrorCap.SetAll(std::numeric_limits<double>::max());
+  bMatchCovCurrent = false;
 
   if (nSamples != Mxi.size() || nSamples != eigMxi.size())
   {
@@ -218,6 +226,79 @@ void algICP_IMLP::ICP_InitializeParameters(vctFrm3 &FGuess)
       << "  Did you forget to call algICP_IMLP::SetSampleCovariances() before starting ICP?" << std::endl;
     assert(0);
   }
+
+  if (bWarmStartNoiseModel)
+  { // continue from the match uncertainty of a previous registration;
+    //  since sigma2 is known, the first match uses the full noise model
+    sigma2 = sigma2WarmStart > sigma2Max ? sigma2Max : sigma2WarmStart;
+    UpdateNoiseModel_SamplesXfmd(FGuess);
+    bFirstIter_Matches = false;
+    bWarmStartNoiseModel = false;
+  }
+}
+
+bool algICP_IMLP::ReturnNoiseModel(double &sigma2, double &k)
+{
+  sigma2 = this->sigma2;
+  k = 0.0;
+  return true;
+}
+
+void algICP_IMLP::SetNoiseModelWarmStart(double sigma2, double k)
+{
+  if (sigma2 > 0.0)
+  {
+    bWarmStartNoiseModel = true;
+    sigma2WarmStart = sigma2;
+  }
+}
+
+void algICP_IMLP::ICP_ComputeMatches()
+{
+  // cap the searches once the noise model is estimated
+  //  (see SetOutlierCappedSearch())
+  bCappedSearch = bOutlierCappedSearch && !bFirstIter_Matches;
+  sigma2_Search = sigma2;
+
+  algICP::ICP_ComputeMatches();
+}
+
+unsigned int algICP_IMLP::ResearchCappedSamples()
+{
+  // the capped samples remain proven outliers if the outlier covariance
+  //  (R*Mxi*Rt + sigma2*I) did not grow since the search
+  if (!bCappedSearch || sigma2 <= sigma2_Search)
+  {
+    return 0;
+  }
+
+  unsigned int nCapped = 0;
+  for (unsigned int s = 0; s < nSamples; s++)
+  {
+    if (MatchCapped(s)) nCapped++;
+  }
+  if (nCapped == 0)
+  {
+    return 0;
+  }
+  cappedSamples.SetSize(nCapped);
+  nCapped = 0;
+  for (unsigned int s = 0; s < nSamples; s++)
+  {
+    if (MatchCapped(s)) cappedSamples.Element(nCapped++) = s;
+  }
+
+  // search under the updated noise model without the cap
+  //  (the pre-match hook clears the caps of these samples)
+  bCappedSearch = false;
+  PDTreeSearchStats researchStats;
+  algICP::pTree->FindClosestDatums(
+    samplePtsXfmd, matchDatums,
+    matchDatums, matchPts, matchErrors,
+    researchStats, this, &cappedSamples, pSearchAlgorithm);
+  matchStats.Merge(researchStats);
+
+  return nCapped;
 }
 
 void algICP_IMLP::ICP_UpdateParameters_PostMatch()
@@ -229,16 +310,20 @@ void algICP_IMLP::ICP_UpdateParameters_PostMatch()
   //ComputeErrors_PostMatch();
 
   // compute sum of square distances of inliers
+  //  (a capped search keeps the previous match of a sample, which is
+  //   left out of the estimate)
   sumSqrDist_Inliers = 0.0;
+  unsigned int nInliers = 0;
   //double sqrDist;
   for (unsigned int s = 0; s < nSamples; s++)
   {
     residuals_PostMatch.Element(s) = samplePtsXfmd.Element(s) - matchPts.Element(s);
     sqrDist_PostMatch.Element(s) = residuals_PostMatch.Element(s).NormSquare();
 
-    if (!outlierFlags[s])
+    if (!outlierFlags[s] && !MatchCapped(s))
     {
       sumSqrDist_Inliers += sqrDist_PostMatch.Element(s);
+      nInliers++;
     }
   }
 
@@ -247,7 +332,10 @@ void algICP_IMLP::ICP_UpdateParameters_PostMatch()
   //  Ans: it should be divide by N, because we actually want the entire
   //       square distance to closest point as the possible variance along
   //       each axis in this case. (See Estepar, et al, "Robust Generalized Total Least Squares...")
-  sigma2 = sumSqrDist_Inliers / (nSamples - nOutliers);
+  if (nInliers > 0)
+  {
+    sigma2 = sumSqrDist_Inliers / nInliers;
+  }
   //sigma2 = sumSqrDist_PostMatch / nSamples;
   
   // apply max threshold
@@ -256,13 +344,22 @@ void algICP_IMLP::ICP_UpdateParameters_PostMatch()
     sigma2 = sigma2Max;
   }
 
+  // matches of capped samples that are no longer proven outliers
+  unsigned int nResearched = ResearchCappedSamples();
+  for (unsigned int i = 0; i < nResearched; i++)
+  {
+    unsigned int s = cappedSamples.Element(i);
+    residuals_PostMatch.Element(s) = samplePtsXfmd.Element(s) - matchPts.Element(s);
+    sqrDist_PostMatch.Element(s) = residuals_PostMatch.Element(s).NormSquare();
+  }
+
   // update noise models of the matches
   for (unsigned int s = 0; s < nSamples; s++)
   {
     // update target covariances
-    Myi[s] = algICP::pTree->DatumCovPtr(matchDatums.Element(s));   // use pointer here for efficiency
+    algICP::pTree->DatumCov(matchDatums.Element(s), Myi[s]);
     // target covariance with match uncertainty
-    Myi_sigma2[s] = *Myi[s];
+    Myi_sigma2[s] = Myi[s];
     Myi_sigma2[s].Element(0, 0) += sigma2;
     Myi_sigma2[s].Element(1, 1) += sigma2;
     Myi_sigma2[s].Element(2, 2) += sigma2;
@@ -288,14 +385,11 @@ void algICP_IMLP::ICP_UpdateParameters_PostMatch()
   //  update measurment noise models of the transformed sample points
   //  not including the surface model covariance
   vctRot3 R(FGuess.Rotation());
-  for (unsigned int s = 0; s < nSamples; s++)
-  {
-    R_MsmtMxi_Rt[s] = R*MsmtMxi[s] * R.Transpose();
-  }
+  Calc_RMRt_Batch(R, MsmtMxi.Pointer(), nSamples, R_MsmtMxi_Rt.Pointer());
 
 #ifdef DEBUG_IMLP
-  std::cout << "My0:" << std::endl << *Myi[0] << std::endl;
-  std::cout << "My1:" << std::endl << *Myi[1] << std::endl;
+  std::cout << "My0:" << std::endl << Myi[0] << std::endl;
+  std::cout << "My1:" << std::endl << Myi[1] << std::endl;
 #endif
 
   bFirstIter_Matches = false;
@@ -307,17 +401,16 @@ void algICP_IMLP::ICP_UpdateParameters_PostRegister(vctFrm3 &Freg)
   algICP::ICP_UpdateParameters_PostRegister(Freg);
 
   UpdateNoiseModel_SamplesXfmd(Freg);
+  // the match covariances change with the registration
+  bMatchCovCurrent = false;
 }
 
 void algICP_IMLP::UpdateNoiseModel_SamplesXfmd(vctFrm3 &Freg)
 {
   // update noise models of the transformed sample points
-  static vctRot3 R;
+  vctRot3 R;
   R = Freg.Rotation();
-  for (unsigned int s = 0; s < nSamples; s++)
-  {
-    R_Mxi_Rt[s] = R*Mxi[s] * R.Transpose();
-  }
+  Calc_RMRt_Batch(R, Mxi.Pointer(), nSamples, R_Mxi_Rt.Pointer());
 #ifdef DEBUG_IMLP
   std::cout << "ComputeParameters_PostReg():" << std::endl
     << "Mx0: " << std::endl << Mxi[0] << std::endl
@@ -363,23 +456,44 @@ double algICP_IMLP::ICP_EvaluateErrorFunction()
   //
   //   Simplified Error = Sum_i[log(Mi) + di'*inv(M)*di]
   //
-  vctDynamicVector<vct3x3>  Mi(nSamples);           // noise covariances of match (R*Mxi*Rt + Myi)
-  vctDynamicVector<vct3x3>  inv_Mi(nSamples);       // inverse noise covariances of match (R*Mxi*Rt + Myi)^-1
-  vctDynamicVector<double>  det_Mi(nSamples);       // determinant of noise covariances of match |R*Mxi*Rt + Myi|
-  vctDynamicVector<double>  SqrMahalDist(nSamples); // square Mahalanobis distance of matches = (yi-Rxi-t)'*inv(Mi)*(yi-Rxi-t)
+  vct3x3  Mis;           // noise covariances of match (R*Mxi*Rt + Myi)
+  vct3x3  inv_Mis;       // inverse noise covariances of match (R*Mxi*Rt + Myi)^-1
+  double  det_Mis;       // determinant of noise covariances of match |R*Mxi*Rt + Myi|
+  double  SqrMahalDist;  // square Mahalanobis distance of matches = (yi-Rxi-t)'*inv(Mi)*(yi-Rxi-t)
+
+  //-- Here We Compute the Full Negative Log-Likelihood --//
+
+  double nklog2PI = nSamples*3.0*log(2.0*cmnPI);
+  double logCost = 0.0;
+  double expCost = 0.0;
 
   // compute mahalanobis distances of the matches
+  //  (the error evaluated before the registration of an iteration reuses the
+  //   match covariances decomposed by the outlier filter)
   vct3 residual;
   for (unsigned int s = 0; s < nSamples; s++)
   {
     residual = samplePtsXfmd.Element(s) - matchPts.Element(s);
 
-    // match covariance
-    Mi.Element(s) = R_Mxi_Rt.Element(s) + Myi_sigma2.Element(s);
-    // match covariance decomposition
-    ComputeCovDecomposition_NonIter(Mi.Element(s), inv_Mi.Element(s), det_Mi.Element(s));
-    // match square Mahalanobis distance
-    SqrMahalDist.Element(s) = residual*inv_Mi.Element(s)*residual;
+    if (bMatchCovCurrent)
+    {
+      SqrMahalDist = residual*inv_Mi.Element(s)*residual;
+      det_Mis = det_Mi.Element(s);
+    }
+    else
+    {
+      // match covariance
+      Mis = R_Mxi_Rt.Element(s) + Myi_sigma2.Element(s);
+      // match covariance decomposition
+      ComputeCovDecomposition_NonIter(Mis, inv_Mis, det_Mis);
+      // match square Mahalanobis distance
+      SqrMahalDist = residual*inv_Mis*residual;
+    }
+
+    // Compute error contribution for this sample
+    //  error: log(detM) + di'*inv(Mi)*di
+    expCost += SqrMahalDist;
+    logCost += log(det_Mis);
   }
 
   //// This is not general enough since we want to computer a correct error
@@ -396,19 +510,6 @@ double algICP_IMLP::ICP_EvaluateErrorFunction()
   //  SqrMahalDist.Element(s) = residuals_PostMatch.Element(s)*inv_Mi.Element(s)*residuals_PostMatch.Element(s);
   //}
 
-  //-- Here We Compute the Full Negative Log-Likelihood --//
-
-  static double nklog2PI = nSamples*3.0*log(2.0*cmnPI);
-  double logCost = 0.0;
-  double expCost = 0.0;
-  for (unsigned int i = 0; i<nSamples; i++)
-  {
-    // Compute error contribution for this sample
-    //  error: log(detM) + di'*inv(Mi)*di
-    expCost += SqrMahalDist.Element(i);
-    logCost += log(det_Mi.Element(i));
-  }
-
   prevCostFuncValue = costFuncValue;
   costFuncValue = (nklog2PI + logCost + expCost) / 2.0;
   //double costFunctionValue = (logCost + expCost);
@@ -466,9 +567,11 @@ vctFrm3 algICP_IMLP::ICP_RegisterMatches()
 {
 #ifndef REMOVE_OUTLIERS
 
+  // (the first step of the registration solves at the current registration,
+  //  whose match covariances were decomposed by the outlier filter)
   vctFrm3 dF;
-  RegisterP2P_TLS(samplePtsXfmd, matchPts,
-    R_Mxi_Rt, Myi_sigma2, dF);
+  RegisterP2P_TLS_Block(samplePtsXfmd, matchPts,
+    R_Mxi_Rt, Myi_sigma2, dF, NULL, bMatchCovCurrent ? &inv_Mi : NULL);
   Freg = dF*Freg;
 
   return Freg;
@@ -486,26 +589,9 @@ vctFrm3 algICP_IMLP::ICP_RegisterMatches()
 #else
 
   // remove outliers from consideration completely
-  unsigned int nGoodSamples = nSamples - nOutliers;
-  vctDynamicVector<vct3>    goodSamplePtsXfmd(nGoodSamples);
-  vctDynamicVector<vct3>    goodMatchPts(nGoodSamples);
-  vctDynamicVector<vct3x3>  goodR_Mxi_Rt(nGoodSamples);
-  vctDynamicVector<vct3x3>  goodMyi_sigma2(nGoodSamples);
-  unsigned int goodIndex = 0;
-  for (unsigned int i = 0; i < nSamples; i++)
-  {
-    if (outlierFlags[i]) continue;
-
-    goodSamplePtsXfmd.at(goodIndex) = samplePtsXfmd[i];
-    goodMatchPts.at(goodIndex) = matchPts[i];
-    goodR_Mxi_Rt.at(goodIndex) = R_Mxi_Rt[i];
-    goodMyi_sigma2.at(goodIndex) = Myi_sigma2[i];
-    goodIndex++;
-  }
-
   vctFrm3 dF;
-  RegisterP2P_TLS(goodSamplePtsXfmd, goodMatchPts,
-    goodR_Mxi_Rt, goodMyi_sigma2, dF);
+  RegisterP2P_TLS_Block(samplePtsXfmd, matchPts,
+    R_Mxi_Rt, Myi_sigma2, dF, &outlierFlags, bMatchCovCurrent ? &inv_Mi : NULL);
   Freg = dF*Freg;
 
   return Freg;
@@ -537,9 +623,15 @@ unsigned int algICP_IMLP::ICP_FilterMatches()
   double varExpansionFactor = StdDevExpansionFactor * StdDevExpansionFactor;
 
   nOutliers = 0;
-  vct3x3 Mo, inv_Mo;
   double sqrMahalDist = 0.0;
 
+  // decompose the match covariances once for this iteration
+  //  (the outlier noise model below equals the match covariance of matches
+  //   having no target covariance, which is all of them for a mesh with
+  //   zero noise model)
+  ComputeMatchCovDecompositions();
+
+  vct3x3 Mo, inv_Mo_s;
   for (unsigned int s = 0; s < nSamples; s++)
   {
     // compute outlier noise model based on mearurment noise and sigma2 only
@@ -550,21 +642,30 @@ unsigned int algICP_IMLP::ICP_FilterMatches()
     //       measurement noise; if this is not true, then the target measurement
     //       noise should be added to the outlier covariance test below as well
     //   
-    Mo = R_Mxi_Rt.Element(s);
-    Mo.Element(0, 0) += sigma2;
-    Mo.Element(1, 1) += sigma2;
-    Mo.Element(2, 2) += sigma2;
     //Mo = R_Mxi_Rt.Element(s) + Myi_sigma2.Element(s);
     //Mo.Element(0, 0) += outlier_alpha;
     //Mo.Element(1, 1) += outlier_alpha;
     //Mo.Element(2, 2) += outlier_alpha;
 
+    const vct3x3 *inv_Mo = &inv_Mi.Element(s);
+    if (Myi.Element(s).MaxAbsElement() > 0.0)
+    {
+      Mo = R_Mxi_Rt.Element(s);
+      Mo.Element(0, 0) += sigma2;
+      Mo.Element(1, 1) += sigma2;
+      Mo.Element(2, 2) += sigma2;
+      ComputeCovInverse_NonIter(Mo, inv_Mo_s);
+      inv_Mo = &inv_Mo_s;
+    }
+
     // compute Mahalanobis distance
-    ComputeCovInverse_NonIter(Mo, inv_Mo);
-    sqrMahalDist = residuals_PostMatch.Element(s)*inv_Mo*residuals_PostMatch.Element(s);
+    sqrMahalDist = residuals_PostMatch.Element(s)*(*inv_Mo)*residuals_PostMatch.Element(s);
 
     // check if outlier
-    if (sqrMahalDist > ChiSquareThresh)
+    //  (a capped search that found no match below the cap has proven
+    //   the match an outlier, as the match uncertainty did not grow since
+    //   the search; see SetOutlierCappedSearch())
+    if (sqrMahalDist > ChiSquareThresh || MatchCapped(s))
     { // an outlier
       nOutliers++;
       outlierFlags[s] = 1;
@@ -577,6 +678,9 @@ unsigned int algICP_IMLP::ICP_FilterMatches()
       R_Mxi_Rt[s].Element(0, 0) += outlierScale;
       R_Mxi_Rt[s].Element(1, 1) += outlierScale;
       R_Mxi_Rt[s].Element(2, 2) += outlierScale;
+      // match covariance with the outlier term
+      Mi[s] = R_Mxi_Rt[s] + Myi_sigma2[s];
+      ComputeCovDecomposition_NonIter(Mi[s], inv_Mi[s], det_Mi[s]);
 
       // This shouldn't be done here, because alpha term is not used
       //  in error function
@@ -597,12 +701,27 @@ unsigned int algICP_IMLP::ICP_FilterMatches()
   return nOutliers;
 }
 
+void algICP_IMLP::ComputeMatchCovDecompositions()
+{
+  for (unsigned int s = 0; s < nSamples; s++)
+  {
+    Mi.Element(s) = R_Mxi_Rt.Element(s) + Myi_sigma2.Element(s);
+  }
+  ComputeCovDecomposition_Batch(Mi.Pointer(), nSamples, inv_Mi.Pointer(), det_Mi.Pointer());
+  bMatchCovCurrent = true;
+}
+
 
 
 // PD Tree Methods
 
-void algICP_IMLP::SamplePreMatch( unsigned int sampleIndex )
+void algICP_IMLP::SamplePreMatch( unsigned int sampleIndex, PDTreeSearchContext &ctx )
 {
+  // the sample noise model is stored in the search context
+  //  (covariance of the transformed sample point plus match uncertainty)
+  vct3x3 &sample_RMxRt_sigma2 = ctx.sampleXfm_M;
+  vct3 &sample_RMxRt_sigma2_Eig = ctx.sample_M_Eig;
+
   // measurement noise
   sample_RMxRt_sigma2 = R_Mxi_Rt[sampleIndex];
 
@@ -620,6 +739,23 @@ void algICP_IMLP::SamplePreMatch( unsigned int sampleIndex )
   sample_RMxRt_sigma2_Eig[1] = sampEig[1] + sigma2;
   sample_RMxRt_sigma2_Eig[2] = sampEig[2] + sigma2;
 
+  // cap the search at the match error above which a match must be an outlier
+  //  the log term of the error is at most log|RMxR' + sigma2*I + EigMax*I|,
+  //  where EigMax is the largest eigenvalue of the target covariances,
+  //  and the square Mahalanobis distance of the outlier test is at least
+  //  that of the match (as its covariance excludes the target covariance)
+  double errorCap = std::numeric_limits<double>::max();
+  if (bCappedSearch)
+  {
+    double eigMax = algICP::pTree->MaxDatumCovEig();
+    errorCap = ChiSquareThresh + log(
+      (sample_RMxRt_sigma2_Eig[0] + eigMax) *
+      (sample_RMxRt_sigma2_Eig[1] + eigMax) *
+      (sample_RMxRt_sigma2_Eig[2] + eigMax));
+  }
+  ctx.ErrorCap = errorCap;
+  matchErrorCap[sampleIndex] = errorCap;
+
   #ifdef DEBUG_IMLP
     if (sampleIndex == 0)
     {
@@ -634,7 +770,8 @@ void algICP_IMLP::SamplePreMatch( unsigned int sampleIndex )
 // fast check if a datum might have smaller match error than error bound
 int algICP_IMLP::DatumMightBeCloser( const vct3 &v,
                                                 int datum,
-                                                double ErrorBound)
+                                                double ErrorBound,
+                                                PDTreeSearchContext &ctx)
 {
   return true;
 }
@@ -643,8 +780,16 @@ int algICP_IMLP::DatumMightBeCloser( const vct3 &v,
 //  than the error bound
 int algICP_IMLP::NodeMightBeCloser( const vct3 &v,
                                                PDTreeNode *node,
-                                               double ErrorBound )
+                                               double ErrorBound,
+                                               PDTreeSearchContext &ctx )
 {
+  // node noise model for this search
+  //  (persists in the context between nodes of the same search so that
+  //   nodes sharing the bound of their parent may reuse its values)
+  vct3x3 &N = ctx.N;
+  double &Dmin = ctx.Dmin;
+  double &MinLogM = ctx.MinLogM;
+  const vct3 &sample_RMxRt_sigma2_Eig = ctx.sample_M_Eig;
 
 // uncomment the desired node bounds check method
 //  NODE_SIMPLE_ELLIPSOID_BOUNDS seems much faster
@@ -750,7 +895,7 @@ int algICP_IMLP::NodeMightBeCloser( const vct3 &v,
     //  share a common covariance bound with its parent
     if (!node->bUseParentEigMaxBound)
     {
-      ComputeNodeMatchCov(node);
+      ComputeNodeMatchCov(node, ctx);
     }
     // update log bound for this node if it does not share a
     //  common log bound with its parent
@@ -807,8 +952,8 @@ int algICP_IMLP::NodeMightBeCloser( const vct3 &v,
       std::cout << "NodeMightBeCloser()" << std::endl;
       std::cout << "EigMax: " << node->EigMax << std::endl;
       std::cout << "R_Mx0_Rt: " << std::endl << R_Mxi_Rt[0] << std::endl;
-      std::cout << "R_Mx_Rt_sigma2: " << std::endl << sample_RMxRt_sigma2 << std::endl;
-      std::cout << "M: " << std::endl << M << std::endl;
+      std::cout << "R_Mx_Rt_sigma2: " << std::endl << ctx.sampleXfm_M << std::endl;
+      std::cout << "M: " << std::endl << ctx.M << std::endl;
       std::cout << "N: " << std::endl << N << std::endl;
   }
 #endif
@@ -827,25 +972,74 @@ int algICP_IMLP::NodeMightBeCloser( const vct3 &v,
 }
 
 
+// same check as above (NODE_SIMPLE_ELLIPSOID_BOUNDS), read directly from the
+//  flattened node
+int algICP_IMLP::FlatNodeMightBeCloser( const vct3 &v,
+                                        const PDTreeFlat &tree,
+                                        int node,
+                                        double ErrorBound,
+                                        PDTreeSearchContext &ctx )
+{
+  const PDTreeFlat::Node &n = tree.GetNode(node);
+  if (n.NData <= 3)
+  { return 1; }
+
+  if (bFirstIter_Matches)
+  { // isotropic noise model for first iteration
+    static const vct3x3 I_7071(vct3x3::Eye()*0.7071);
+    ctx.N = I_7071;
+    ctx.Dmin = 0.7071;
+    ctx.MinLogM = 2.0794;
+  }
+  else
+  { // noise model defined by node
+    const PDTreeFlat::NodeNoise &noise = tree.GetNodeNoise(node);
+    if (!noise.bUseParentEigMaxBound)
+    {
+      ComputeNodeMatchCov(noise.EigMax, ctx);
+    }
+    if (!noise.bUseParentEigRankMinBounds)
+    {
+      double r0,r1,r2;
+      r0 = noise.EigRankMin[0] + ctx.sample_M_Eig[0];
+      r1 = noise.EigRankMin[1] + ctx.sample_M_Eig[1];
+      r2 = noise.EigRankMin[2] + ctx.sample_M_Eig[2];
+      ctx.MinLogM = log(r0*r1*r2);
+    }
+  }
+
+  double NodeErrorBound = ErrorBound - ctx.MinLogM;
+  return IntersectionSolver.Test_Ellipsoid_OBB_Intersection( v, n.Bounds, n.F,
+                                                             NodeErrorBound, ctx.N, ctx.Dmin );
+}
+
+
 // Helper Methods
 
 // Note: this function depends on the SamplePreMatch() function
 //       to set the noise model of the current transformed sample
 //       point before this function is called
-void algICP_IMLP::ComputeNodeMatchCov( PDTreeNode *node )
+void algICP_IMLP::ComputeNodeMatchCov( PDTreeNode *node, PDTreeSearchContext &ctx )
+{
+  ComputeNodeMatchCov(node->EigMax, ctx);
+}
+
+void algICP_IMLP::ComputeNodeMatchCov( double nodeEigMax, PDTreeSearchContext &ctx )
 {
   // Note:  This function is called when searching a node that is using 
   //        its own noise model rather than that of its parent node
 
   // Compute the effective noise model for this node, assuming the noise 
   //  model of the transformed sample point has already been computed
+  vct3x3 &M = ctx.M;
+  vct3x3 &N = ctx.N;
 
   // noise model of transformed sample
-  M = sample_RMxRt_sigma2;
+  M = ctx.sampleXfm_M;
   // add the effective My for this node
-  M.Element(0,0) += node->EigMax;
-  M.Element(1,1) += node->EigMax;
-  M.Element(2,2) += node->EigMax;
+  M.Element(0,0) += nodeEigMax;
+  M.Element(1,1) += nodeEigMax;
+  M.Element(2,2) += nodeEigMax;
 
   // TODO: can this be done using only the eigen decomposition
   //       of RMxRt
@@ -869,7 +1063,7 @@ void algICP_IMLP::ComputeNodeMatchCov( PDTreeNode *node )
   //N.Row(0) = eigenVectors.TransposeRef().Row(0) / Dinv[0];
   //N.Row(1) = eigenVectors.TransposeRef().Row(1) / Dinv[1];
   //N.Row(2) = eigenVectors.TransposeRef().Row(2) / Dinv[2];
-  Dmin = 1.0/Dinv[0]; // eigenvalues are arranged in order of decreasing magnitude
+  ctx.Dmin = 1.0/Dinv[0]; // eigenvalues are arranged in order of decreasing magnitude
 }
 
 
@@ -883,8 +1077,8 @@ void algICP_IMLP::ComputeCovDecomposition_NonIter(const vct3x3 &M, vct3x3 &Minv,
 
   // Compute Minv
   //   Minv = V*diag(1/S)*V'
-  static vctFixedSizeMatrix<double, 3, 3, VCT_COL_MAJOR> V_Sinv;
-  static vct3 Sinv;
+  vctFixedSizeMatrix<double, 3, 3, VCT_COL_MAJOR> V_Sinv;
+  vct3 Sinv;
   Sinv[0] = 1.0 / eigenValues[0];
   Sinv[1] = 1.0 / eigenValues[1];
   Sinv[2] = 1.0 / eigenValues[2];
@@ -907,8 +1101,8 @@ void algICP_IMLP::ComputeCovDecomposition_NonIter(const vct3x3 &M, vct3x3 &Minv,
 
   // Compute Minv
   //   Minv = V*diag(1/S)*V'
-  static vctFixedSizeMatrix<double, 3, 3, VCT_COL_MAJOR> V_Sinv;
-  static vct3 Sinv;
+  vctFixedSizeMatrix<double, 3, 3, VCT_COL_MAJOR> V_Sinv;
+  vct3 Sinv;
   Sinv[0] = 1.0 / eigenValues[0];
   Sinv[1] = 1.0 / eigenValues[1];
   Sinv[2] = 1.0 / eigenValues[2];
@@ -940,11 +1134,11 @@ void algICP_IMLP::ComputeCovDecomposition_NonIter(const vct3x3 &M, vct3x3 &Minv,
 void algICP_IMLP::ComputeCovDecomposition_SVD( const vct3x3 &M, vct3x3 &Minv, double &det_M )
 {
   // Compute SVD of M
-  static vctFixedSizeMatrix<double,3,3,VCT_COL_MAJOR> A;
-  static vctFixedSizeMatrix<double,3,3,VCT_COL_MAJOR> U;
-  static vctFixedSizeMatrix<double,3,3,VCT_COL_MAJOR> Vt;
-  static vct3 S;
-  static nmrSVDFixedSizeData<3,3,VCT_COL_MAJOR>::VectorTypeWorkspace workspace;
+  vctFixedSizeMatrix<double,3,3,VCT_COL_MAJOR> A;
+  vctFixedSizeMatrix<double,3,3,VCT_COL_MAJOR> U;
+  vctFixedSizeMatrix<double,3,3,VCT_COL_MAJOR> Vt;
+  vct3 S;
+  nmrSVDFixedSizeData<3,3,VCT_COL_MAJOR>::VectorTypeWorkspace workspace;
   try 
   {
     A.Assign(M);
@@ -956,8 +1150,8 @@ void algICP_IMLP::ComputeCovDecomposition_SVD( const vct3x3 &M, vct3x3 &Minv, do
   // Compute Minv
   //   M = U*diag(S)*V'   where U = V
   //   Minv = V*diag(1/S)*U' = U*diag(1/S)*V'
-  static vctFixedSizeMatrix<double,3,3,VCT_COL_MAJOR> Sinv_Ut;
-  static vct3 Sinv;
+  vctFixedSizeMatrix<double,3,3,VCT_COL_MAJOR> Sinv_Ut;
+  vct3 Sinv;
   Sinv[0] = 1/S[0];
   Sinv[1] = 1/S[1];
   Sinv[2] = 1/S[2];
@@ -974,11 +1168,11 @@ void algICP_IMLP::ComputeCovDecomposition_SVD( const vct3x3 &M, vct3x3 &Minv,
                                                       vct3x3 &N, vct3x3 &Ninv, double &det_M )
 {
   // Compute SVD of M
-  static vctFixedSizeMatrix<double,3,3,VCT_COL_MAJOR> A;
-  static vctFixedSizeMatrix<double,3,3,VCT_COL_MAJOR> U;
-  static vctFixedSizeMatrix<double,3,3,VCT_COL_MAJOR> Vt;
-  static vct3 S;
-  static nmrSVDFixedSizeData<3,3,VCT_COL_MAJOR>::VectorTypeWorkspace workspace;
+  vctFixedSizeMatrix<double,3,3,VCT_COL_MAJOR> A;
+  vctFixedSizeMatrix<double,3,3,VCT_COL_MAJOR> U;
+  vctFixedSizeMatrix<double,3,3,VCT_COL_MAJOR> Vt;
+  vct3 S;
+  nmrSVDFixedSizeData<3,3,VCT_COL_MAJOR>::VectorTypeWorkspace workspace;
   try 
   {
     A.Assign(M);
@@ -990,8 +1184,8 @@ void algICP_IMLP::ComputeCovDecomposition_SVD( const vct3x3 &M, vct3x3 &Minv,
   // Compute Minv
   //   M = U*diag(S)*V'   where U = V
   //   Minv = V*diag(1/S)*U' = U*diag(1/S)*V'
-  static vctFixedSizeMatrix<double,3,3,VCT_COL_MAJOR> Sinv_Ut;
-  static vct3 Sinv;
+  vctFixedSizeMatrix<double,3,3,VCT_COL_MAJOR> Sinv_Ut;
+  vct3 Sinv;
   Sinv[0] = 1/S[0];
   Sinv[1] = 1/S[1];
   Sinv[2] = 1/S[2];
@@ -1004,7 +1198,7 @@ void algICP_IMLP::ComputeCovDecomposition_SVD( const vct3x3 &M, vct3x3 &Minv,
   //   Minv = R*D^2*R' = N'*N
   //   N = D*R'
   //   Ninv = R*inv(D)
-  static vct3 Dinv; //,D;
+  vct3 Dinv; //,D;
   Dinv[0] = sqrt(S[0]);
   Dinv[1] = sqrt(S[1]);
   Dinv[2] = sqrt(S[2]);
@@ -75,6 +75,8 @@ protected:
   // dynamic noise model
   double sigma2;      // match uncertainty (added to My covariances as sigma2*I)
   double sigma2Max;   // max threshold on match uncertainty
+  bool   bWarmStartNoiseModel;  // begin the next registration from sigma2WarmStart
+  double sigma2WarmStart;       //  (see SetNoiseModelWarmStart())
   vctDynamicVector<vct3>  residuals_PostMatch;    // Pclosest - Psample
   vctDoubleVec            sqrDist_PostMatch;      // ||Pclosest - Psample||^2
 
@@ -83,11 +85,15 @@ protected:
   vctDynamicVector<vct3x3>  Mxi;        // noise covariances of sample points
   vctDynamicVector<vct3>    eigMxi;     // eigenvalues of sample covariances
   vctDynamicVector<vct3x3>  R_Mxi_Rt;   // noise covariances of transformed sample points
-  vctDynamicVector<vct3x3*> Myi;        // noise covariances of target correspondence points
+  vctDynamicVector<vct3x3>  Myi;        // noise covariances of target correspondence points
   vctDynamicVector<vct3x3>  Myi_sigma2; // noise covariances of target correspondence points with match uncertainty added
-  //vctDynamicVector<vct3x3>  Mi;       // noise covariances of match (R*Mxi*Rt + Myi)
-  //vctDynamicVector<vct3x3>  inv_Mi;   // inverse noise covariances of match (R*Mxi*Rt + Myi)^-1
-  //vctDynamicVector<double>  det_Mi;   // determinant of noise covariances of match |R*Mxi*Rt + Myi|
+  // match covariances of the current matches, decomposed once per iteration
+  //  by the outlier filter and reused by the registration and the error function
+  //  (see ComputeMatchCovDecompositions())
+  vctDynamicVector<vct3x3>  Mi;       // noise covariances of match (R*Mxi*Rt + Myi)
+  vctDynamicVector<vct3x3>  inv_Mi;   // inverse noise covariances of match (R*Mxi*Rt + Myi)^-1
+  vctDynamicVector<double>  det_Mi;   // determinant of noise covariances of match |R*Mxi*Rt + Myi|
+  bool bMatchCovCurrent;              // Mi holds the match covariances of the current registration
   //vctDynamicVector<double>  SqrMahalDist;  // square Mahalanobis distance of matches = (yi-Rxi-t)'*inv(Mi)*(yi-Rxi-t)
 
 	// registration statistics
@@ -108,6 +114,12 @@ protected:
   // covariance model for outlier tests
   //  (does not include planar noise model)
   vctDynamicVector<vct3x3> R_MsmtMxi_Rt;
+  // outlier-capped search (see SetOutlierCappedSearch())
+  bool bOutlierCappedSearch;
+  bool bCappedSearch;           // the searches of this iteration are capped
+  double sigma2_Search;         // match uncertainty of the capped searches
+  vctDoubleVec matchErrorCap;   // cap on the match error searched for each sample
+  vctDynamicVector<unsigned int> cappedSamples; // samples re-searched without the cap
 
   // algorithm-specific termination
   bool bTerminateAlgorithm;
@@ -118,21 +130,13 @@ protected:
 
   // Temporary Match Variables
   //
-  // These variables are recomputed each time a new sample point 
-  //  is used in a PD tree search
-  // Variables for current sample point undergoing a match search
-  //  these are set once for each sample point by the pre-match function
-  //  and used whenever a tree search routine is called thereafter.
+  // The noise model of the sample point undergoing a match search
+  //  (covariance of transformed sample point plus registration uncertainty term
+  //   and its eigenvalues) is set once for each sample point by the pre-match
+  //  function and stored in the search context, together with the node
+  //  noise model computed during the search.
   //  These do not change relative to the node being searched => precomputing
   //  these avoids multiple recomputations.
-  vct3x3 sample_RMxRt_sigma2;      // covariance of transformed sample point plus registration uncertainty term
-  vct3   sample_RMxRt_sigma2_Eig;  // eigenvalues of sample_RMxRt_sigma2 in order of decreasing magnitude
-
-  vct3x3 M;       // effective measurement error covariance for a node & sample pair
-  vct3x3 N;       // decomposition of inv(M) = N'N
-  double Dmin;    // inverse sqrt of largest eigenvalue of M
-                  //  (or the sqrt of the smallest eigenvalue of inv(M))
-  double MinLogM; // lower bound on the log component of error for this node
 
 
   //-- Algorithm Methods --//
@@ -179,11 +183,53 @@ public:
   void SetChiSquareThreshold(double ChiSquareValue) { ChiSquareThresh = ChiSquareValue; }
   void SetSigma2Max(double sigma2MaxValue) { sigma2Max = sigma2MaxValue; }
 
+  // Stop the match search of a sample once its match is proven an outlier
+  //  (disabled by default)
+  //  The search is capped at the Chi Square threshold plus an upper bound on
+  //  the log term of the match error. Since the match covariance includes
+  //  the outlier test covariance, a sample having no datum below this cap
+  //  fails the outlier test of the noise model used for the search; the
+  //  search returns immediately and the sample is flagged as an outlier,
+  //  keeping its previous match.
+  //  The capped samples are left out of the match uncertainty estimate.
+  //  The outlier test is made after the match uncertainty is updated from
+  //  the new matches; the proof carries over to the updated noise model
+  //  only if the match uncertainty did not grow, so otherwise the capped
+  //  samples are searched again without the cap under the updated model.
+  //  The search is not capped on the first iteration, when the isotropic
+  //  match model is used.
+  void SetOutlierCappedSearch(bool bEnable) { bOutlierCappedSearch = bEnable; }
+
+  // the match uncertainty (k is not estimated)
+  virtual bool ReturnNoiseModel(double &sigma2, double &k);
+
+  // the first match of a warm-started registration uses the full noise
+  //  model with the given match uncertainty, rather than the isotropic
+  //  model used in the absence of an estimate for sigma2 (k is ignored)
+  virtual void SetNoiseModelWarmStart(double sigma2, double k);
+
 protected:
 
   void UpdateNoiseModel_SamplesXfmd(vctFrm3 &Freg);
 
-  void ComputeNodeMatchCov(PDTreeNode *node);
+  // the capped search of a sample found no match below the cap
+  //  (see SetOutlierCappedSearch())
+  bool MatchCapped(unsigned int s) const
+  {
+    return matchErrors.Element(s) >= matchErrorCap.Element(s);
+  }
+
+  // searches the capped samples again without the cap if the match
+  //  uncertainty has grown since the search; returns the number of samples
+  //  searched, which are listed in cappedSamples
+  unsigned int ResearchCappedSamples();
+
+  // decompose the match covariances R*Mxi*Rt + Myi (+ sigma2*I) of the current
+  //  matches into Mi, inv_Mi and det_Mi
+  void ComputeMatchCovDecompositions();
+
+  void ComputeNodeMatchCov(PDTreeNode *node, PDTreeSearchContext &ctx);
+  void ComputeNodeMatchCov(double nodeEigMax, PDTreeSearchContext &ctx);
 
   void ComputeCovDecomposition_NonIter(const vct3x3 &M, vct3x3 &Minv, double &det_M);
   void ComputeCovDecomposition_NonIter(const vct3x3 &M, vct3x3 &Minv, vct3x3 &N, vct3x3 &Ninv, double &det_M);
@@ -211,7 +257,7 @@ protected:
   inline double SquareDistanceToEdge(const vct3 &p, const vct3 &r);
 
   // virtual standard routines for matching
-  void SamplePreMatch(unsigned int sampleIndex);
+  void SamplePreMatch(unsigned int sampleIndex, PDTreeSearchContext &ctx);
 
 
   //--- ICP Interface Methods ---//
@@ -228,7 +274,7 @@ public:
   virtual double  ICP_EvaluateErrorFunction();
   virtual bool    ICP_Terminate(vctFrm3 &Freg);
 
-  //virtual void  ICP_ComputeMatches();
+  virtual void    ICP_ComputeMatches();
   //virtual std::vector<cisstICP::Callback> ICP_GetIterationCallbacks();
 
 
@@ -237,17 +283,27 @@ public:
   int  NodeMightBeCloser(
     const vct3 &v,
     PDTreeNode *node,
-    double ErrorBound);
+    double ErrorBound,
+    PDTreeSearchContext &ctx);
+
+  int  FlatNodeMightBeCloser(
+    const vct3 &v,
+    const PDTreeFlat &tree,
+    int node,
+    double ErrorBound,
+    PDTreeSearchContext &ctx);
 
   virtual double FindClosestPointOnDatum(
     const vct3 &v,
     vct3 &closest,
-    int datum) = 0;
+    int datum,
+    PDTreeSearchContext &ctx) = 0;
 
   virtual int  DatumMightBeCloser(
     const vct3 &v,
     int datum,
-    double ErrorBound) = 0;
+    double ErrorBound,
+    PDTreeSearchContext &ctx) = 0;
 
 };
 #endif
@@ -32,31 +32,25 @@
 //  
 // ****************************************************************************
 #include "algICP_IMLP_Mesh.h"
+#include <algorithm>
 
 
-// finds the point on this datum with lowest match error
-//  and returns the match error and closest point
-double algICP_IMLP_Mesh::FindClosestPointOnDatum( 
-  const vct3 &point,
-  vct3 &closest,
-  int datum )
+// noise model of the match to a datum and its decomposition
+void algICP_IMLP_Mesh::ComputeDatumMatchCov(
+  int datum,
+  PDTreeSearchContext &ctx,
+  vct3x3 &Minv, vct3x3 &N, vct3x3 &Ninv, double &det_M )
 {
   // first iteration variables that don't change
   static const vct3x3 I_7071(vct3x3::Eye()*0.7071); // sqrt(1/2)*I
   static const vct3x3 I1_4142(vct3x3::Eye()*1.4142); // sqrt(2)*I
-  static const vct3x3 I2(vct3x3::Eye()*2.0); // 2*I
   static const vct3x3 I_5(vct3x3::Eye()*0.5); // 0.5*I
 
-  static vct3 d;
-  static vct3x3 M,Minv,N,Ninv;
-  double det_M;
-  
   if (bFirstIter_Matches)
   { // isotropic noise model for first iteration
 
     // M = Mx + NodeEigMax*I = 2*I = V*S*V'  =>  S = 2*I, V = I
     // Minv = N'*N = I*(1/2)*I  =>  N = sqrt(1/2)*I = 0.7071*I
-    M = I2;
     Minv = I_5;
     N = I_7071;
     Ninv = I1_4142;
@@ -67,10 +61,26 @@ double algICP_IMLP_Mesh::FindClosestPointOnDatum(
 
     // compute noise model for this datum
     //  M = R*Mxi*R' + Myi
-    M = sample_RMxRt_sigma2 + pMesh->TriangleCov[datum];
+    vct3x3 M(ctx.sampleXfm_M);
+    pMesh->AddTriangleCovariance(datum, M);
     ComputeCovDecomposition_NonIter(M,Minv,N,Ninv,det_M);
   }
+}
+
+
+// finds the point on this datum with lowest match error
+//  and returns the match error and closest point
+double algICP_IMLP_Mesh::FindClosestPointOnDatum( 
+  const vct3 &point,
+  vct3 &closest,
+  int datum,
+  PDTreeSearchContext &ctx )
+{
+  vct3 d;
+  vct3x3 Minv,N,Ninv;
+  double det_M;
 
+  ComputeDatumMatchCov(datum, ctx, Minv, N, Ninv, det_M);
 
 #if 1
   // Find the closest point on this triangle in a Mahalanobis distance sense
@@ -88,10 +98,70 @@ double algICP_IMLP_Mesh::FindClosestPointOnDatum(
 }
 
 
+// find the most likely datum of a leaf node
+//  The square Mahalanobis distance to a triangle is the square distance of
+//  the triangle transformed to spherical coords (relative to the sample)
+//  from the origin; these distances are computed in batches, and the most
+//  likely point is found only for the best triangle.
+int algICP_IMLP_Mesh::FindClosestLeafDatum(
+  const vct3 &point,
+  const int *pData,
+  int first,
+  int nData,
+  vct3 &closestPoint,
+  PDTreeSearchContext &ctx )
+{
+  static const vct3 origin(0.0);
+
+  double coords[9][TCPS_BATCH_SIZE];
+  double *pCoords[9];
+  for (int k = 0; k < 9; k++)
+  {
+    pCoords[k] = coords[k];
+  }
+  double logDet_M[TCPS_BATCH_SIZE];
+  double sqrDist[TCPS_BATCH_SIZE];
+  vct3x3 N[TCPS_BATCH_SIZE], Ninv[TCPS_BATCH_SIZE];
+  vct3x3 Minv;
+  double det_M;
+
+  int ClosestDatum = -1;
+  vct3x3 ClosestN, ClosestNinv;
+  for (int i0 = 0; i0 < nData; i0 += TCPS_BATCH_SIZE)
+  {
+    int count = std::min(nData - i0, TCPS_BATCH_SIZE);
+    for (int i = 0; i < count; i++)
+    {
+      int datum = pData[i0 + i];
+      ComputeDatumMatchCov(datum, ctx, Minv, N[i], Ninv[i], det_M);
+      logDet_M[i] = log(det_M);
+      TCPS.TransformedTriangleCoords(datum, point, N[i], pCoords, i);
+    }
+    TriangleClosestPointSolver::ComputeSquareDistances(origin, pCoords, count, sqrDist);
+    for (int i = 0; i < count; i++)
+    {
+      if (ctx.UpdateErrorBound(pData[i0 + i], logDet_M[i] + sqrDist[i]))
+      {
+        ClosestDatum = pData[i0 + i];
+        ClosestN = N[i];
+        ClosestNinv = Ninv[i];
+      }
+    }
+  }
+
+  if (ClosestDatum >= 0)
+  {
+    TCPS.FindMostLikelyPointOnTriangle(point, ClosestDatum, ClosestN, ClosestNinv, closestPoint);
+  }
+  return ClosestDatum;
+}
+
+
 // fast check if a datum might have smaller match error than error bound
 int algICP_IMLP_Mesh::DatumMightBeCloser( const vct3 &point,
                                                      int datum,
-                                                     double ErrorBound)
+                                                     double ErrorBound,
+                                                     PDTreeSearchContext &ctx)
 { 
   return true;
 }
@@ -49,7 +49,7 @@ class algICP_IMLP_Mesh : public algICP_IMLP
 
 protected:
 
-  TriangleClosestPointSolver TCPS;
+  TriangleClosestPointSolver &TCPS;   // shared by the algorithms of the tree (see PDTree_Mesh::SearchTCPS())
   PDTree_Mesh *pTree;
   cisstMesh *pMesh;
 
@@ -69,7 +69,7 @@ public:
     : algICP_IMLP(pTree, samplePts, sampleCov, sampleMsmtCov, outlierChiSquareThreshold, sigma2Max),
     pTree(pTree),
     pMesh(pTree->MeshP),
-	TCPS(*(pTree->MeshP))
+	TCPS(*(pTree->SearchTCPS()))
   {};
 
   // destructor
@@ -78,7 +78,18 @@ public:
 
   //-- PD Tree Methods --//
 
-	double  FindClosestPointOnDatum( const vct3 &v, vct3 &closest, int datum);
-	int     DatumMightBeCloser( const vct3 &v, int datum, double ErrorBound);
+	double  FindClosestPointOnDatum( const vct3 &v, vct3 &closest, int datum, PDTreeSearchContext &ctx);
+	int     DatumMightBeCloser( const vct3 &v, int datum, double ErrorBound, PDTreeSearchContext &ctx);
+
+  // evaluates the square Mahalanobis distances to the triangles of a leaf
+  //  in batches by the batched square distance kernel of the triangle solver
+  int     FindClosestLeafDatum( const vct3 &v, const int *pData, int first, int nData,
+                                vct3 &closestPoint, PDTreeSearchContext &ctx);
+
+protected:
+
+  // noise model of the match to a datum and its decomposition
+  void    ComputeDatumMatchCov( int datum, PDTreeSearchContext &ctx,
+                                vct3x3 &Minv, vct3x3 &N, vct3x3 &Ninv, double &det_M);
 };
 #endif
@@ -40,3 +40,32 @@ algPDTree::algPDTree(PDTreeBase *pTree)
 {
   pTree->SetSearchAlgorithm(this);
 }
+
+int algPDTree::FindClosestLeafDatum(
+  const vct3 &sample,
+  const int *pData,
+  int first,
+  int nData,
+  vct3 &closestPoint,
+  PDTreeSearchContext &ctx)
+{
+  int ClosestDatum = -1;
+  for (int i = 0; i < nData; i++)
+  {
+    int datum = pData[i];
+
+    // fast check if this datum might have a lower match error than error bound
+    if (DatumMightBeCloser(sample, datum, ctx.PruneBound(), ctx))
+    { // a candidate
+      vct3 candidate;
+      // close check if this datum has a lower match error than error bound
+      double err = FindClosestPointOnDatum(sample, candidate, datum, ctx);
+      if (ctx.UpdateErrorBound(datum, err))
+      {
+        closestPoint = candidate;
+        ClosestDatum = datum;
+      }
+    }
+  }
+  return ClosestDatum;
+}
@@ -36,8 +36,10 @@
 
 #include <cisstVector.h>
 #include "PDTreeNode.h"
+#include "PDTreeSearchContext.h"
 
-class PDTreeBase;     // forward decleration for mutual dependency
+class PDTreeBase;     // forward declerations for mutual dependency
+class PDTreeFlat;     //  ''
 
 
 class algPDTree
@@ -65,27 +67,68 @@ public:
   virtual ~algPDTree() {}
 
 
+  // true if the match error of a datum is the Euclidean distance to its
+  //  closest point, such that a sample moving by a distance d changes the
+  //  match error of every datum by at most d
+  //  (permits reusing a match without searching; see algICP::SetMatchReuse())
+  virtual bool MatchErrorIsDistance() const { return false; }
+
+
   //--- PD Tree Interface Methods ---//
+  //
+  // These methods must not modify the algorithm or the tree;
+  //  any state that varies per query is kept in the search context
+  //  so that multiple searches may run concurrently.
+  //
 
   // finds the point on this datum with lowest match error
   //  and returns the match error and closest point
   virtual double FindClosestPointOnDatum(
     const vct3 &sample,
     vct3 &closest,
-    int datum) = 0;
+    int datum,
+    PDTreeSearchContext &ctx) = 0;
 
   // fast check if a datum might have smaller match error than the error bound
   virtual int  DatumMightBeCloser(
     const vct3 &sample,
     int datum,
-    double ErrorBound) = 0;
+    double ErrorBound,
+    PDTreeSearchContext &ctx) = 0;
 
   // fast check if a node might contain a datum having smaller match error
   //  than the error bound
   virtual int  NodeMightBeCloser(
     const vct3 &sample,
     PDTreeNode *node,
-    double ErrorBound) = 0;
+    double ErrorBound,
+    PDTreeSearchContext &ctx) = 0;
+
+  // fast check if a node of the flattened tree might contain a datum having
+  //  smaller match error than the error bound
+  //  (the same check as NodeMightBeCloser(), read directly from the
+  //   flattened node; see PDTreeBase::BuildFlatTree())
+  virtual int  FlatNodeMightBeCloser(
+    const vct3 &sample,
+    const PDTreeFlat &tree,
+    int node,
+    double ErrorBound,
+    PDTreeSearchContext &ctx) = 0;
+
+  // finds the datum of a leaf node with lowest match error below the error
+  //  bound, updating the error bound and closest point; returns -1 if none
+  //  pData holds the nData datums of the leaf, which begin at position first
+  //  in the datum order of the tree (see PDTreeBase::DatumOrder())
+  //  (the default checks each datum by DatumMightBeCloser() followed by
+  //   FindClosestPointOnDatum(); algorithms may override this to process
+  //   the datums of a leaf in batches)
+  virtual int  FindClosestLeafDatum(
+    const vct3 &sample,
+    const int *pData,
+    int first,
+    int nData,
+    vct3 &closestPoint,
+    PDTreeSearchContext &ctx);
 };
 
 #endif
@@ -33,6 +33,7 @@
 // ****************************************************************************
 #include "algPDTree_CP.h"
 #include "PDTreeNode.h"
+#include "PDTreeFlat.h"
 
 
 // fast check if a node might contain a datum having smaller match error
@@ -40,7 +41,8 @@
 int algPDTree_CP::NodeMightBeCloser(
   const vct3 &v,
   PDTreeNode *node,
-  double ErrorBound)
+  double ErrorBound,
+  PDTreeSearchContext &ctx)
 {
   vct3 Fv = node->F*v;          // transform point into local coordinate system of node
 
@@ -54,3 +56,16 @@ int algPDTree_CP::NodeMightBeCloser(
   //  box of this node.
   return node->Bounds.Includes(Fv, ErrorBound);
 }
+
+// same check as above, read directly from the flattened node
+int algPDTree_CP::FlatNodeMightBeCloser(
+  const vct3 &v,
+  const PDTreeFlat &tree,
+  int node,
+  double ErrorBound,
+  PDTreeSearchContext &ctx)
+{
+  const PDTreeFlat::Node &n = tree.GetNode(node);
+  vct3 Fv = n.F*v;
+  return n.Bounds.Includes(Fv, ErrorBound);
+}
@@ -53,23 +53,40 @@ protected:
   // destructor
   virtual ~algPDTree_CP() {}
 
+public:
+
+  // the match error is the distance to the closest point
+  virtual bool MatchErrorIsDistance() const { return true; }
+
+protected:
+
 
   //--- PD Tree Interface Methods ---//
 
   int  NodeMightBeCloser(
     const vct3 &v,
     PDTreeNode *node,
-    double ErrorBound);
+    double ErrorBound,
+    PDTreeSearchContext &ctx);
+
+  int  FlatNodeMightBeCloser(
+    const vct3 &v,
+    const PDTreeFlat &tree,
+    int node,
+    double ErrorBound,
+    PDTreeSearchContext &ctx);
 
   // the routines below require a known datum type
   virtual double FindClosestPointOnDatum(
     const vct3 &v,
     vct3 &closest,
-    int datum) = 0;
+    int datum,
+    PDTreeSearchContext &ctx) = 0;
 
   virtual int DatumMightBeCloser(
     const vct3 &v,
     int datum,
-    double ErrorBound) = 0;
+    double ErrorBound,
+    PDTreeSearchContext &ctx) = 0;
 };
 #endif
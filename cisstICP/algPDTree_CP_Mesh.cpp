@@ -32,6 +32,8 @@
 //  
 // ****************************************************************************
 #include "algPDTree_CP_Mesh.h"
+#include <algorithm>
+#include <math.h>
 
 
 // finds the point on this datum with lowest match error
@@ -39,7 +41,8 @@
 double algPDTree_CP_Mesh::FindClosestPointOnDatum(
     const vct3 &v,
     vct3 &closest,
-    int datum)
+    int datum,
+    PDTreeSearchContext &ctx)
 {
     // set closest point
     TCPS.FindClosestPointOnTriangle(v, datum, closest);
@@ -56,7 +59,8 @@ double algPDTree_CP_Mesh::FindClosestPointOnDatum(
 int algPDTree_CP_Mesh::DatumMightBeCloser(
     const vct3 &v,
     int datum,
-    double ErrorBound)
+    double ErrorBound,
+    PDTreeSearchContext &ctx)
 {
     // create bounding box around triangle
     BoundingBox BB;
@@ -73,3 +77,44 @@ int algPDTree_CP_Mesh::DatumMightBeCloser(
     //  of triangle creation adds 10% to application runtime!
     //return pTree->Triangle(datum).BB.Includes(v,ErrorBound);
 }
+
+
+// find the closest datum of a leaf node by evaluating the distances
+//  to its triangles in batches
+int algPDTree_CP_Mesh::FindClosestLeafDatum(
+    const vct3 &v,
+    const int *pData,
+    int first,
+    int nData,
+    vct3 &closestPoint,
+    PDTreeSearchContext &ctx)
+{
+    if (!pTree->HasLeafCoords())
+    {   // no triangle coordinates in leaf order
+        return algPDTree::FindClosestLeafDatum(v, pData, first, nData, closestPoint, ctx);
+    }
+
+    int ClosestDatum = -1;
+    double sqrDist[TCPS_BATCH_SIZE];
+    for (int i0 = 0; i0 < nData; i0 += TCPS_BATCH_SIZE)
+    {
+        int count = std::min(nData - i0, TCPS_BATCH_SIZE);
+        TCPS.ComputeLeafSquareDistances(v, first + i0, count, sqrDist);
+        for (int i = 0; i < count; i++)
+        {
+            if (ctx.UpdateErrorBound(pData[i0 + i], sqrt(sqrDist[i])))
+            {
+                ClosestDatum = pData[i0 + i];
+            }
+        }
+    }
+
+    // closest point on the best triangle found
+    //  (the error bound keeps the kernel distance, which agrees with
+    //   the distance to this point up to round-off)
+    if (ClosestDatum >= 0)
+    {
+        TCPS.FindClosestPointOnTriangle(v, ClosestDatum, closestPoint);
+    }
+    return ClosestDatum;
+}
@@ -49,7 +49,7 @@ class algPDTree_CP_Mesh : public algPDTree_CP
 
 protected:
 
-  TriangleClosestPointSolver TCPS;
+  TriangleClosestPointSolver &TCPS;   // shared by the algorithms of the tree (see PDTree_Mesh::SearchTCPS())
   PDTree_Mesh *pTree;
 
 
@@ -61,8 +61,18 @@ public:
   algPDTree_CP_Mesh(PDTree_Mesh *pTree) :
     algPDTree_CP(pTree),
     pTree(pTree),
-    TCPS(*(pTree->MeshP))
-  {}
+    TCPS(*(pTree->SearchTCPS()))
+  {
+    // triangle coordinates in leaf order for the batched leaf search
+    //  (held by the shared solver; the tree must be built or loaded before
+    //   the algorithm is created)
+    //  These copy the mesh coordinates (76 bytes per triangle), so a compact
+    //  solver keeps the per-triangle leaf search (see PDTree_Mesh::SetCompactTCPS()).
+    if (!TCPS.IsCompact() && !pTree->HasLeafCoords())
+    {
+      pTree->ComputeLeafCoords();
+    }
+  }
 
   // destructor
   virtual ~algPDTree_CP_Mesh() {}
@@ -72,11 +82,22 @@ public:
 
   double FindClosestPointOnDatum(const vct3 &v,
     vct3 &closest,
-    int datum);
+    int datum,
+    PDTreeSearchContext &ctx);
 
   int  DatumMightBeCloser(const vct3 &v,
     int datum,
-    double ErrorBound);
+    double ErrorBound,
+    PDTreeSearchContext &ctx);
+
+  // evaluates the triangles of a leaf in batches by the batched
+  //  square distance kernel of the triangle solver
+  int  FindClosestLeafDatum(const vct3 &v,
+    const int *pData,
+    int first,
+    int nData,
+    vct3 &closestPoint,
+    PDTreeSearchContext &ctx);
 };
 
 #endif
@@ -39,7 +39,8 @@
 double algPDTree_CP_PointCloud::FindClosestPointOnDatum(
   const vct3 &v,
   vct3 &closest,
-  int datum)
+  int datum,
+  PDTreeSearchContext &ctx)
 {
   // Return distance to the datum point as match error
   //  NOTE: distance is more convenient than square distance
@@ -54,7 +55,8 @@ double algPDTree_CP_PointCloud::FindClosestPointOnDatum(
 int algPDTree_CP_PointCloud::DatumMightBeCloser(
   const vct3 &v,
   int datum,
-  double ErrorBound)
+  double ErrorBound,
+  PDTreeSearchContext &ctx)
 {
   // Since the datum is only a single point, just
   //  compute the match error directly
@@ -63,13 +63,15 @@ public:
   double FindClosestPointOnDatum(
     const vct3 &v,
     vct3 &closest,
-    int datum);
+    int datum,
+    PDTreeSearchContext &ctx);
 
   // fast check if a datum might have smaller match error than error bound
   int  DatumMightBeCloser(
     const vct3 &v,
     int datum,
-    double ErrorBound);
+    double ErrorBound,
+    PDTreeSearchContext &ctx);
 };
 
 #endif
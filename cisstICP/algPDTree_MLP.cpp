@@ -33,21 +33,24 @@
 // ****************************************************************************
 #include "algPDTree_MLP.h"
 #include "PDTreeNode.h"
+#include "PDTreeFlat.h"
 #include "utilities.h"
 
 
 void algPDTree_MLP::InitializeSampleSearch(
-  vct3x3 sampleXfm_M, vct3 sample_M_Eig)
+  PDTreeSearchContext &ctx,
+  const vct3x3 &sampleXfm_M, const vct3 &sample_M_Eig)
 {
-  this->sampleXfm_M = sampleXfm_M;
-  this->sample_M_Eig = sample_M_Eig;
+  ctx.sampleXfm_M = sampleXfm_M;
+  ctx.sample_M_Eig = sample_M_Eig;
 }
 
 
 int algPDTree_MLP::NodeMightBeCloser(
   const vct3 &v,
   PDTreeNode *node,
-  double ErrorBound)
+  double ErrorBound,
+  PDTreeSearchContext &ctx)
 {
   // uncomment the desired node bounds check method
   //  NODE_SIMPLE_ELLIPSOID_BOUNDS seems much faster
@@ -71,7 +74,7 @@ int algPDTree_MLP::NodeMightBeCloser(
   //  do this if node does not share a common bound with its parent
   if (!node->bUseParentEigMaxBound)
   {
-    ComputeNodeMatchCov(node);
+    ComputeNodeMatchCov(node, ctx);
   }
   // update log bound 
   //  do this if node does not share a common log bound with its parent
@@ -82,21 +85,21 @@ int algPDTree_MLP::NodeMightBeCloser(
     //  eigenvalues of RMxR' with the min node eigenvalues of each magnitude 
     //  rank in rank order
     double r0, r1, r2;
-    r0 = node->EigRankMin[0] + sample_M_Eig[0];
-    r1 = node->EigRankMin[1] + sample_M_Eig[1];
-    r2 = node->EigRankMin[2] + sample_M_Eig[2];
-    MinLogM = log(r0*r1*r2);
+    r0 = node->EigRankMin[0] + ctx.sample_M_Eig[0];
+    r1 = node->EigRankMin[1] + ctx.sample_M_Eig[1];
+    r2 = node->EigRankMin[2] + ctx.sample_M_Eig[2];
+    ctx.MinLogM = log(r0*r1*r2);
   }
 
   // get effective Mahalanobis bound
   //  subtract min bound of the log term from the current best match error 
   //  to get the effective Mahalanobis bound for forming the boundary ellipse
-  double NodeErrorBound = ErrorBound - MinLogM;
+  double NodeErrorBound = ErrorBound - ctx.MinLogM;
 
   // test for intersection between the ellipsoid and node
   //  (i.e. the oriented bounding box of the node)
   return IntersectionSolver.Test_Ellipsoid_OBB_Intersection(v, node->Bounds, node->F,
-    NodeErrorBound, N, Dmin);
+    NodeErrorBound, ctx.N, ctx.Dmin);
 
 #endif // NODE_SIMPLE_ELLIPSOID_BOUNDS
 
@@ -160,20 +163,61 @@ int algPDTree_MLP::NodeMightBeCloser(
 }
 
 
+// same check as above (NODE_SIMPLE_ELLIPSOID_BOUNDS), read directly from the
+//  flattened node
+int algPDTree_MLP::FlatNodeMightBeCloser(
+  const vct3 &v,
+  const PDTreeFlat &tree,
+  int node,
+  double ErrorBound,
+  PDTreeSearchContext &ctx)
+{
+  const PDTreeFlat::Node &n = tree.GetNode(node);
+  if (n.NData <= 3)
+  {
+    return 1;
+  }
+
+  const PDTreeFlat::NodeNoise &noise = tree.GetNodeNoise(node);
+  if (!noise.bUseParentEigMaxBound)
+  {
+    ComputeNodeMatchCov(noise.EigMax, ctx);
+  }
+  if (!noise.bUseParentEigRankMinBounds)
+  {
+    double r0, r1, r2;
+    r0 = noise.EigRankMin[0] + ctx.sample_M_Eig[0];
+    r1 = noise.EigRankMin[1] + ctx.sample_M_Eig[1];
+    r2 = noise.EigRankMin[2] + ctx.sample_M_Eig[2];
+    ctx.MinLogM = log(r0*r1*r2);
+  }
+
+  double NodeErrorBound = ErrorBound - ctx.MinLogM;
+  return IntersectionSolver.Test_Ellipsoid_OBB_Intersection(v, n.Bounds, n.F,
+    NodeErrorBound, ctx.N, ctx.Dmin);
+}
+
 // Note: this function depends on the InitializeSampleSearch() function
 //       to set the noise model of the current transformed sample
 //       point before this function is called
-void algPDTree_MLP::ComputeNodeMatchCov(PDTreeNode *node)
+void algPDTree_MLP::ComputeNodeMatchCov(PDTreeNode *node, PDTreeSearchContext &ctx)
+{
+  ComputeNodeMatchCov(node->EigMax, ctx);
+}
+
+void algPDTree_MLP::ComputeNodeMatchCov(double nodeEigMax, PDTreeSearchContext &ctx)
 {
   // Compute the effective noise model for this node, assuming the noise 
   //  model of the transformed sample point has already been computed
+  vct3x3 &M = ctx.M;
+  vct3x3 &N = ctx.N;
 
   // noise model of transformed sample
-  M = sampleXfm_M;
+  M = ctx.sampleXfm_M;
   // add the effective My for this node
-  M.Element(0, 0) += node->EigMax;
-  M.Element(1, 1) += node->EigMax;
-  M.Element(2, 2) += node->EigMax;
+  M.Element(0, 0) += nodeEigMax;
+  M.Element(1, 1) += nodeEigMax;
+  M.Element(2, 2) += nodeEigMax;
 
   // compute eigen decomposition of M
   //   M = V*S*V'
@@ -193,7 +237,7 @@ void algPDTree_MLP::ComputeNodeMatchCov(PDTreeNode *node)
   N.Row(0) = eigenVectors.Column(0) / Dinv[0];
   N.Row(1) = eigenVectors.Column(1) / Dinv[1];
   N.Row(2) = eigenVectors.Column(2) / Dinv[2]; 
-  Dmin = 1.0 / Dinv[0];
+  ctx.Dmin = 1.0 / Dinv[0];
 }
 
 
@@ -205,8 +249,8 @@ void algPDTree_MLP::ComputeCovDecomposition_NonIter(const vct3x3 &M, vct3x3 &Min
   ComputeCovEigenDecomposition_NonIter(M, eigenValues, eigenVectors);
 
   // Compute Minv
-  static vctFixedSizeMatrix<double, 3, 3, VCT_COL_MAJOR> V_Sinv;
-  static vct3 Sinv;
+  vctFixedSizeMatrix<double, 3, 3, VCT_COL_MAJOR> V_Sinv;
+  vct3 Sinv;
   Sinv[0] = 1.0 / eigenValues[0];
   Sinv[1] = 1.0 / eigenValues[1];
   Sinv[2] = 1.0 / eigenValues[2];
@@ -228,8 +272,8 @@ void algPDTree_MLP::ComputeCovDecomposition_NonIter(const vct3x3 &M, vct3x3 &Min
   ComputeCovEigenDecomposition_NonIter(M, eigenValues, eigenVectors);
 
   // Compute Minv
-  static vctFixedSizeMatrix<double, 3, 3, VCT_COL_MAJOR> V_Sinv;
-  static vct3 Sinv;
+  vctFixedSizeMatrix<double, 3, 3, VCT_COL_MAJOR> V_Sinv;
+  vct3 Sinv;
   Sinv[0] = 1.0 / eigenValues[0];
   Sinv[1] = 1.0 / eigenValues[1];
   Sinv[2] = 1.0 / eigenValues[2];
@@ -50,18 +50,8 @@ protected:
 
   Ellipsoid_OBB_Intersection_Solver IntersectionSolver;
 
-
-  // must set these before doing the search using the 
-  //  method for initializing a sample search
-  vct3x3 sampleXfm_M;   // covariance of transformed sample point
-  vct3   sample_M_Eig;  // eigenvalues of sample covariance in order of decreasing magnitude
-
-  // these are computed automatically
-  vct3x3 M;       // effective measurement error covariance for a node & sample pair
-  vct3x3 N;       // decomposition of inv(M) = N'N
-  double Dmin;    // inverse sqrt of largest eigenvalue of M
-                  //  (or the sqrt of the smallest eigenvalue of inv(M))
-  double MinLogM; // lower bound on the log component of error for this node
+  // NOTE: the sample noise model and the node noise model computed
+  //       during a search are stored in the search context
 
 
   //--- Algorithm Methods ---//
@@ -77,13 +67,16 @@ public:
   virtual ~algPDTree_MLP() {}
 
   // must call this prior to beginning search for each sample
+  //   ctx           ~ search context to be used for this sample
   //   sampleXfm_M   ~ noise covariance of the transformed sample point
   //   sample_M_Eig  ~ eigenvalues of the sample covariance (in order of decreasing magnitude)
-  void InitializeSampleSearch(vct3x3 sampleXfm_M, vct3 sample_M_Eig);
+  void InitializeSampleSearch(PDTreeSearchContext &ctx,
+    const vct3x3 &sampleXfm_M, const vct3 &sample_M_Eig);
 
 protected:
 
-  void ComputeNodeMatchCov(PDTreeNode *node);
+  void ComputeNodeMatchCov(PDTreeNode *node, PDTreeSearchContext &ctx);
+  void ComputeNodeMatchCov(double nodeEigMax, PDTreeSearchContext &ctx);
   void ComputeCovDecomposition_NonIter(const vct3x3 &M, vct3x3 &Minv, vct3x3 &N, vct3x3 &Ninv, double &det_M);
   void ComputeCovDecomposition_NonIter(const vct3x3 &M, vct3x3 &Minv, double &det_M);
 
@@ -93,16 +86,26 @@ protected:
   int  NodeMightBeCloser(
     const vct3 &v,
     PDTreeNode *node,
-    double ErrorBound);
+    double ErrorBound,
+    PDTreeSearchContext &ctx);
+
+  int  FlatNodeMightBeCloser(
+    const vct3 &v,
+    const PDTreeFlat &tree,
+    int node,
+    double ErrorBound,
+    PDTreeSearchContext &ctx);
 
   virtual double FindClosestPointOnDatum(
     const vct3 &v,
     vct3 &closest,
-    int datum) = 0;
+    int datum,
+    PDTreeSearchContext &ctx) = 0;
 
   virtual int DatumMightBeCloser(
     const vct3 &v,
     int datum,
-    double ErrorBound) = 0;
+    double ErrorBound,
+    PDTreeSearchContext &ctx) = 0;
 };
 #endif
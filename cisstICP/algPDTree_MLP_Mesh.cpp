@@ -22,19 +22,22 @@
 // ****************************************************************************
 #include "algPDTree_MLP_Mesh.h"
 #include "utilities.h"
+#include <algorithm>
 
 // finds the point on this datum with lowest match error
 double algPDTree_MLP_Mesh::FindClosestPointOnDatum(
   const vct3 &point,
   vct3 &closest,
-  int datum)
+  int datum,
+  PDTreeSearchContext &ctx)
 {
-  static vct3 d;
-  static vct3x3 M, Minv, N, Ninv;
+  vct3 d;
+  vct3x3 M, Minv, N, Ninv;
   double det_M;
 
   // compute noise model for this datum
-  M = sampleXfm_M + pTree->MeshP->TriangleCov[datum];
+  M = ctx.sampleXfm_M;
+  pTree->MeshP->AddTriangleCovariance(datum, M);
   ComputeCovDecomposition_NonIter(M, Minv, N, Ninv, det_M);
 
   // Find the closest point on this triangle in a Mahalanobis distance sense
@@ -48,7 +51,66 @@ double algPDTree_MLP_Mesh::FindClosestPointOnDatum(
 int algPDTree_MLP_Mesh::DatumMightBeCloser(
   const vct3 &point,
   int datum,
-  double ErrorBound)
+  double ErrorBound,
+  PDTreeSearchContext &ctx)
 {
   return true;
 }
+
+
+// find the most likely datum of a leaf node
+//  (see algICP_IMLP_Mesh::FindClosestLeafDatum())
+int algPDTree_MLP_Mesh::FindClosestLeafDatum(
+  const vct3 &point,
+  const int *pData,
+  int first,
+  int nData,
+  vct3 &closestPoint,
+  PDTreeSearchContext &ctx)
+{
+  static const vct3 origin(0.0);
+
+  double coords[9][TCPS_BATCH_SIZE];
+  double *pCoords[9];
+  for (int k = 0; k < 9; k++)
+  {
+    pCoords[k] = coords[k];
+  }
+  double logDet_M[TCPS_BATCH_SIZE];
+  double sqrDist[TCPS_BATCH_SIZE];
+  vct3x3 N[TCPS_BATCH_SIZE], Ninv[TCPS_BATCH_SIZE];
+  vct3x3 M, Minv;
+  double det_M;
+
+  int ClosestDatum = -1;
+  vct3x3 ClosestN, ClosestNinv;
+  for (int i0 = 0; i0 < nData; i0 += TCPS_BATCH_SIZE)
+  {
+    int count = std::min(nData - i0, TCPS_BATCH_SIZE);
+    for (int i = 0; i < count; i++)
+    {
+      int datum = pData[i0 + i];
+      M = ctx.sampleXfm_M;
+      pTree->MeshP->AddTriangleCovariance(datum, M);
+      ComputeCovDecomposition_NonIter(M, Minv, N[i], Ninv[i], det_M);
+      logDet_M[i] = log(det_M);
+      TCPS.TransformedTriangleCoords(datum, point, N[i], pCoords, i);
+    }
+    TriangleClosestPointSolver::ComputeSquareDistances(origin, pCoords, count, sqrDist);
+    for (int i = 0; i < count; i++)
+    {
+      if (ctx.UpdateErrorBound(pData[i0 + i], logDet_M[i] + sqrDist[i]))
+      {
+        ClosestDatum = pData[i0 + i];
+        ClosestN = N[i];
+        ClosestNinv = Ninv[i];
+      }
+    }
+  }
+
+  if (ClosestDatum >= 0)
+  {
+    TCPS.FindMostLikelyPointOnTriangle(point, ClosestDatum, ClosestN, ClosestNinv, closestPoint);
+  }
+  return ClosestDatum;
+}
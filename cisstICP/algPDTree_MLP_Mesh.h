@@ -49,7 +49,7 @@ class algPDTree_MLP_Mesh : public algPDTree_MLP
 
 protected:
 
-  TriangleClosestPointSolver TCPS;
+  TriangleClosestPointSolver &TCPS;   // shared by the algorithms of the tree (see PDTree_Mesh::SearchTCPS())
   PDTree_Mesh *pTree;
 
 
@@ -61,7 +61,7 @@ public:
   algPDTree_MLP_Mesh(PDTree_Mesh *pTree) :
     algPDTree_MLP(pTree),
     pTree(pTree),
-	TCPS(*(pTree->MeshP))
+	TCPS(*(pTree->SearchTCPS()))
   {}
 
   // destructor
@@ -72,11 +72,22 @@ public:
 
   double FindClosestPointOnDatum(const vct3 &v,
     vct3 &closest,
-    int datum);
+    int datum,
+    PDTreeSearchContext &ctx);
 
   int  DatumMightBeCloser(const vct3 &v,
     int datum,
-    double ErrorBound);
+    double ErrorBound,
+    PDTreeSearchContext &ctx);
+
+  // evaluates the square Mahalanobis distances to the triangles of a leaf
+  //  in batches by the batched square distance kernel of the triangle solver
+  int  FindClosestLeafDatum(const vct3 &v,
+    const int *pData,
+    int first,
+    int nData,
+    vct3 &closestPoint,
+    PDTreeSearchContext &ctx);
 };
 
 #endif
@@ -25,14 +25,16 @@
 double algPDTree_MLP_PointCloud::FindClosestPointOnDatum(
   const vct3 &v,
   vct3 &closest,
-  int datum)
+  int datum,
+  PDTreeSearchContext &ctx)
 {
-  static vct3 d;
-  static vct3x3 M, Minv;
+  vct3 d;
+  vct3x3 M, Minv;
   double det_M;
 
   // compute noise model for this datum
-  M = sampleXfm_M + pTree->DatumCov(datum);
+  M = ctx.sampleXfm_M;
+  pTree->AddDatumCov(datum, M);
   ComputeCovDecomposition_NonIter(M, Minv, det_M);
 
   // return match error
@@ -45,7 +47,8 @@ double algPDTree_MLP_PointCloud::FindClosestPointOnDatum(
 int algPDTree_MLP_PointCloud::DatumMightBeCloser(
   const vct3 &v,
   int datum,
-  double ErrorBound)
+  double ErrorBound,
+  PDTreeSearchContext &ctx)
 {
   return true;
 }
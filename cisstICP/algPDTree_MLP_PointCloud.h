@@ -61,12 +61,14 @@ public:
   double FindClosestPointOnDatum(
     const vct3 &v,
     vct3 &closest,
-    int datum);
+    int datum,
+    PDTreeSearchContext &ctx);
 
   int  DatumMightBeCloser(
     const vct3 &v,
     int datum,
-    double ErrorBound);
+    double ErrorBound,
+    PDTreeSearchContext &ctx);
 };
 
 #endif
@@ -37,16 +37,45 @@
 #include <stdio.h>
 #include <sstream>
 #include <limits>
+#include <algorithm>
+#include <omp.h>
 
 #include <cisstOSAbstraction.h>
 
 #include "cisstMesh.h"
 #include "cisstICP.h"
 #include "algICP.h"
+#include "AllocationCounter.h"
+#include "ICPTrace.h"
+
+#define ENABLE_PARALLELIZATION
 
 // debug
 //#define ENABLE_CODE_TRACE
-//#define ENABLE_CODE_PROFILER
+
+// adds the time elapsed since the last mark to a phase time of the current
+//  iteration profile (see Options::profile)
+#define PROFILE_PHASE(phaseTime) \
+  if (opt.profile) \
+  { \
+    rt.profile.iterations.back().phaseTime += phaseTimer.GetElapsedTime(); \
+    phaseTimer.Reset(); \
+    phaseTimer.Start(); \
+  }
+
+#ifdef ENABLE_ALLOCATION_COUNTER
+// adds the heap allocations made since the last mark to the phase total
+//  (only steady-state iterations are counted; the first iteration sizes
+//   the algorithm buffers)
+#define COUNT_ALLOCATIONS(phaseAllocs) \
+  { \
+    unsigned long long allocCount = AllocationCount(); \
+    if (iter >= 2) phaseAllocs += allocCount - allocMark; \
+    allocMark = allocCount; \
+  }
+#else
+#define COUNT_ALLOCATIONS(phaseAllocs)
+#endif
 
 cisstICP::ReturnType cisstICP::RunICP(
   algICP *pAlg,
@@ -81,13 +110,126 @@ cisstICP::ReturnType cisstICP::RunICP(
     AddIterationCallbacks(callbacks);
   }
 
+  // record a timeline of the run
+  //  (includes any events recorded since the previous trace was written,
+  //   such as the tree construction if the application enabled tracing)
+  bool bTrace = !opt.traceFile.empty();
+  if (bTrace) ICPTrace::Enable();
+
   // begin registration
-  return IterateICP();
+  ReturnType rt = IterateICP();
+
+  if (bTrace)
+  {
+    ICPTrace::Write(opt.traceFile);
+    ICPTrace::Disable();
+  }
+  return rt;
+}
+
+
+cisstICP::ReturnType cisstICP::RunICP(
+  const std::vector<PyramidLevel> &levels,
+  const vctFrm3 &FGuess,
+  std::vector<Callback> *pUserCallbacks,
+  bool bEnableAlgorithmCallbacks,
+  std::vector<ReturnType> *pLevelResults)
+{
+  if (pLevelResults)
+  {
+    pLevelResults->clear();
+  }
+  if (levels.empty())
+  {
+    std::cout << "ERROR: no registration levels specified" << std::endl;
+    assert(0);
+    return ReturnType();
+  }
+
+  // a single trace covers all levels
+  const std::string traceFile = levels.back().opt.traceFile;
+  bool bTrace = !traceFile.empty();
+  if (bTrace) ICPTrace::Enable();
+
+  ReturnType rtPyramid;
+  std::stringstream termMsg;
+  vctFrm3 Flevel = FGuess;
+  bool bNoiseModel = false;
+  double sigma2 = 0.0, k = 0.0;
+  unsigned int numLevels = (unsigned int)levels.size();
+  for (unsigned int level = 0; level < numLevels; level++)
+  {
+    ICPTRACE_SCOPE("PyramidLevel", "level", level);
+
+    algICP *pAlg = levels[level].pAlg;
+    Options levelOpt = levels[level].opt;
+    levelOpt.traceFile = "";
+    if (pAlg && levelOpt.printOutput)
+    {
+      std::cout << std::endl << "Pyramid level " << level + 1 << " of " << numLevels
+        << " (" << pAlg->nSamples << " samples)" << std::endl;
+    }
+
+    // warm start from the previous level
+    if (pAlg && bNoiseModel)
+    {
+      pAlg->SetNoiseModelWarmStart(sigma2, k);
+    }
+
+    ReturnType rt = RunICP(pAlg, levelOpt, Flevel, pUserCallbacks, bEnableAlgorithmCallbacks);
+    if (pAlg == NULL)
+    {
+      break;
+    }
+    Flevel = rt.Freg;
+    bNoiseModel = pAlg->ReturnNoiseModel(sigma2, k);
+
+    termMsg << std::endl << "Pyramid level " << level + 1 << " of " << numLevels
+      << " (" << pAlg->nSamples << " samples):" << rt.termMsg;
+
+    // totals over all levels
+    if (level == 0)
+    {
+      rtPyramid.runTimeFirstMatch = rt.runTimeFirstMatch;
+    }
+    rtPyramid.runTime += rt.runTime;
+    rtPyramid.numIter += rt.numIter;
+    rtPyramid.profile.time_Initialize += rt.profile.time_Initialize;
+    rtPyramid.profile.iterations.insert(rtPyramid.profile.iterations.end(),
+      rt.profile.iterations.begin(), rt.profile.iterations.end());
+
+    // the registration and match statistics are those of the finest level
+    if (level + 1 == numLevels)
+    {
+      rtPyramid.Freg = rt.Freg;
+      rtPyramid.MatchPosErrAvg = rt.MatchPosErrAvg;
+      rtPyramid.MatchNormErrAvg = rt.MatchNormErrAvg;
+      rtPyramid.MatchPosErrSD = rt.MatchPosErrSD;
+      rtPyramid.MatchNormErrSD = rt.MatchNormErrSD;
+      rtPyramid.nOutliers = rt.nOutliers;
+      rtPyramid.profile.tag = rt.profile.tag;
+    }
+
+    if (pLevelResults)
+    {
+      pLevelResults->push_back(rt);
+    }
+  }
+  rtPyramid.termMsg = termMsg.str();
+
+  if (bTrace)
+  {
+    ICPTrace::Write(traceFile);
+    ICPTrace::Disable();
+  }
+  return rtPyramid;
 }
 
 
 cisstICP::ReturnType cisstICP::IterateICP()
 {
+  ICPTRACE_SCOPE("IterateICP");
+
   //bool JustDidAccelStep = false;
   std::stringstream termMsg;
   double dAng, dPos;
@@ -106,19 +248,29 @@ cisstICP::ReturnType cisstICP::IterateICP()
   vctDynamicVector<double> sp(opt.numShapeParams);
   double scale;
 
-#ifdef ENABLE_CODE_PROFILER
-  osaStopwatch codeProfiler;
-  double time_Callbacks = 0.0;
-  double time_Extras = 0.0;
-  double time_Match = 0.0;
-  double time_UpdateParams_PostMatch = 0.0;
-  double time_FilterMatches = 0.0;
-  double time_EvalErrorFunc = 0.0;
-  double time_Register = 0.0;
-  double time_UpdateParams_PostRegister = 0.0;
-  codeProfiler.Reset();
-  codeProfiler.Start();
-#endif 
+  // run-time profile
+  //  (the iteration records are reserved up front, so that profiling
+  //   does not allocate within the iterations)
+  osaStopwatch phaseTimer;
+  if (opt.profile)
+  {
+    rt.profile.tag = opt.profileTag;
+    rt.profile.iterations.reserve(opt.maxIter);
+    phaseTimer.Reset();
+    phaseTimer.Start();
+  }
+
+#ifdef ENABLE_ALLOCATION_COUNTER
+  unsigned long long allocMark = 0;
+  unsigned long long allocs_Match = 0;
+  unsigned long long allocs_UpdateParams_PostMatch = 0;
+  unsigned long long allocs_FilterMatches = 0;
+  unsigned long long allocs_Register = 0;
+  unsigned long long allocs_UpdateParams_PostRegister = 0;
+  unsigned long long allocs_EvalErrorFunc = 0;
+  unsigned long long allocs_Callbacks = 0;
+  unsigned int allocIters = 0;
+#endif
 
   if (opt.printOutput)
   {
@@ -145,11 +297,12 @@ cisstICP::ReturnType cisstICP::IterateICP()
 #endif
   pAlgorithm->ICP_InitializeParameters(FGuess);
 
-#ifdef ENABLE_CODE_PROFILER
-  time_Extras = codeProfiler.GetElapsedTime();
-  codeProfiler.Reset();
-  codeProfiler.Start();
-#endif
+  if (opt.profile)
+  {
+    rt.profile.time_Initialize = phaseTimer.GetElapsedTime();
+    phaseTimer.Reset();
+    phaseTimer.Start();
+  }
 
   //------------ ICP Iterate ----------------//
 
@@ -157,39 +310,42 @@ cisstICP::ReturnType cisstICP::IterateICP()
   unsigned int iter;
   for (iter = 1; iter <= opt.maxIter; iter++)
   {
+#ifdef ENABLE_ALLOCATION_COUNTER
+    allocMark = AllocationCount();
+#endif
+    ICPTRACE_SCOPE("Iteration", "iter", iter);
+    if (opt.profile)
+    {
+      rt.profile.iterations.push_back(ICPProfile::Iteration(iter));
+    }
 
 #ifdef ENABLE_CODE_TRACE
     std::cout << "ComputeMatches()" << std::endl;
 #endif
 	pAlgorithm->ICP_ComputeMatches();
+    COUNT_ALLOCATIONS(allocs_Match);
 
-#ifdef ENABLE_CODE_PROFILER
-    time_Match = codeProfiler.GetElapsedTime();
-    codeProfiler.Reset();
-    codeProfiler.Start();
-#endif
+    PROFILE_PHASE(time_Match);
+    if (opt.profile)
+    {
+      rt.profile.iterations.back().SetSearchStats(pAlgorithm->matchStats);
+    }
 
 #ifdef ENABLE_CODE_TRACE
     std::cout << "UpdateParameters_PostMatch()" << std::endl;
 #endif
 	pAlgorithm->ICP_UpdateParameters_PostMatch();
+    COUNT_ALLOCATIONS(allocs_UpdateParams_PostMatch);
 
-#ifdef ENABLE_CODE_PROFILER
-    time_UpdateParams_PostMatch = codeProfiler.GetElapsedTime();
-    codeProfiler.Reset();
-    codeProfiler.Start();
-#endif
+    PROFILE_PHASE(time_UpdateParams_PostMatch);
 
 #ifdef ENABLE_CODE_TRACE
     std::cout << "FilterMatches()" << std::endl;
 #endif
 	nOutliers = pAlgorithm->ICP_FilterMatches();
+    COUNT_ALLOCATIONS(allocs_FilterMatches);
 
-#ifdef ENABLE_CODE_PROFILER
-    time_FilterMatches = codeProfiler.GetElapsedTime();
-    codeProfiler.Reset();
-    codeProfiler.Start();
-#endif
+    PROFILE_PHASE(time_FilterMatches);
 
     //--- First Iteration: report initial match statistics ---//
     if (iter == 1)
@@ -205,11 +361,7 @@ cisstICP::ReturnType cisstICP::IterateICP()
       iterBest = 0;
       Fbest = FGuess;
 
-#ifdef ENABLE_CODE_PROFILER
-      time_EvalErrorFunc = codeProfiler.GetElapsedTime();
-      codeProfiler.Reset();
-      codeProfiler.Start();
-#endif
+      PROFILE_PHASE(time_EvalErrorFunc);
 
 #ifdef ENABLE_CODE_TRACE
       std::cout << "Callbacks" << std::endl;
@@ -225,7 +377,7 @@ cisstICP::ReturnType cisstICP::IterateICP()
       iterData.Freg.Assign(FGuess);
 	  iterData.dF.Assign(FGuess);
 	  iterData.scale = scale;
-	  iterData.S = sp;
+	  iterData.S.ForceAssign(sp);  // reallocates only if the size changes
       iterData.time = iterTimer.GetElapsedTime();
       iterData.nOutliers = nOutliers;
       //iterData.isAccelStep = false;
@@ -239,23 +391,7 @@ cisstICP::ReturnType cisstICP::IterateICP()
 
       rt.runTimeFirstMatch = iterData.time;
 
-#ifdef ENABLE_CODE_PROFILER
-      time_Callbacks = codeProfiler.GetElapsedTime();
-      codeProfiler.Reset();
-      codeProfiler.Start();
-#endif
-
-#ifdef ENABLE_CODE_PROFILER
-      std::cout
-        << " time_Match:              " << time_Match << std::endl
-        << " time_FilterMatches:      " << time_FilterMatches << std::endl
-        << " time_UpdateParams_PostMatch: " << time_UpdateParams_PostMatch << std::endl
-        << " time_EvalErrorFunc:      " << time_EvalErrorFunc << std::endl
-        << " time_Callbacks:          " << time_Callbacks << std::endl
-        << " time_Extras:             " << time_Extras << std::endl;
-      codeProfiler.Reset();
-      codeProfiler.Start();
-#endif
+      PROFILE_PHASE(time_Callbacks);
     }
 
 #ifdef ENABLE_CODE_TRACE
@@ -280,12 +416,9 @@ cisstICP::ReturnType cisstICP::IterateICP()
     // first go back along Freg1 then go forward along Freg2
 	dF = Freg2 * Freg1.Inverse();
 	dS = abs(prevShapeNorm - ShapeNorm);
+    COUNT_ALLOCATIONS(allocs_Register);
 
-#ifdef ENABLE_CODE_PROFILER
-    time_Register = codeProfiler.GetElapsedTime();
-    codeProfiler.Reset();
-    codeProfiler.Start();
-#endif
+    PROFILE_PHASE(time_Register);
 
 #ifdef ENABLE_CODE_TRACE
     std::cout << "UpdateParameters_PostRegister()" << std::endl;
@@ -293,12 +426,9 @@ cisstICP::ReturnType cisstICP::IterateICP()
 
     // update algorithm's post-registration step parameters
     pAlgorithm->ICP_UpdateParameters_PostRegister(Freg);
+    COUNT_ALLOCATIONS(allocs_UpdateParams_PostRegister);
 
-#ifdef ENABLE_CODE_PROFILER
-    time_UpdateParams_PostRegister = codeProfiler.GetElapsedTime();
-    codeProfiler.Reset();
-    codeProfiler.Start();
-#endif
+    PROFILE_PHASE(time_UpdateParams_PostRegister);
 
 #ifdef ENABLE_CODE_TRACE
     std::cout << "EvaluateErrorFunction()" << std::endl;
@@ -328,12 +458,9 @@ cisstICP::ReturnType cisstICP::IterateICP()
       Fbest = Freg;
       iterBest = iter;
     }
+    COUNT_ALLOCATIONS(allocs_EvalErrorFunc);
 
-#ifdef ENABLE_CODE_PROFILER
-    time_EvalErrorFunc = codeProfiler.GetElapsedTime();
-    codeProfiler.Reset();
-    codeProfiler.Start();
-#endif
+    PROFILE_PHASE(time_EvalErrorFunc);
 
 #ifdef ENABLE_CODE_TRACE
     std::cout << "Callbacks" << std::endl;
@@ -346,9 +473,10 @@ cisstICP::ReturnType cisstICP::IterateICP()
     iterData.Freg.Assign(Freg);
     iterData.dF.Assign(dF);
 	iterData.scale = scale;
-	iterData.S = sp;
+	iterData.S.ForceAssign(sp);  // reallocates only if the size changes
     iterData.time = iterTimer.GetElapsedTime();
     iterData.nOutliers = nOutliers;
+    iterData.terminate = false;
     //iterData.isAccelStep = JustDidAccelStep;
     std::vector<Callback>::iterator cbIter;
     for (cbIter = this->iterationCallbacks.begin(); cbIter != this->iterationCallbacks.end(); cbIter++)
@@ -357,27 +485,12 @@ cisstICP::ReturnType cisstICP::IterateICP()
     }
     iterTimer.Reset();
     iterTimer.Start();
-
-#ifdef ENABLE_CODE_PROFILER
-    time_Callbacks = codeProfiler.GetElapsedTime();
-    codeProfiler.Reset();
-    codeProfiler.Start();
-#endif
-
-#ifdef ENABLE_CODE_PROFILER
-    std::cout
-      << " time_Register:                  " << time_Register << std::endl
-      << " time_UpdateParams_PostRegister: " << time_UpdateParams_PostRegister << std::endl
-      << " time_Match:                     " << time_Match << std::endl
-      << " time_UpdateParams_PostMatch:    " << time_UpdateParams_PostMatch << std::endl
-      << " time_FilterMatches:             " << time_FilterMatches << std::endl
-      << " time_EvalErrorFunc:             " << time_EvalErrorFunc << std::endl
-      << " time_Callbacks:                 " << time_Callbacks << std::endl
-      << " time_Extras:                    " << time_Extras << std::endl;
-    codeProfiler.Reset();
-    codeProfiler.Start();
+    COUNT_ALLOCATIONS(allocs_Callbacks);
+#ifdef ENABLE_ALLOCATION_COUNTER
+    if (iter >= 2) allocIters++;
 #endif
 
+    PROFILE_PHASE(time_Callbacks);
 
 #ifdef ENABLE_CODE_TRACE
     std::cout << "Termination Test" << std::endl;
@@ -416,6 +529,14 @@ cisstICP::ReturnType cisstICP::IterateICP()
       break;  // exit iteration loop
     }
 
+    // termination requested by a callback
+    if (iterData.terminate)
+    {
+      totalTimer.Stop();
+      termMsg << std::endl << "Termination Condition:  Termination Requested by Callback" << std::endl;
+      break;  // exit iteration loop
+    }
+
     // Consider termination
     if (dAng < opt.dAngThresh && dPos < opt.dPosThresh && dS < opt.dShapeThresh)
     {
@@ -467,14 +588,15 @@ cisstICP::ReturnType cisstICP::IterateICP()
       termMsg << std::endl << "Termination Condition: reached max iteration (" << opt.maxIter << ")" << std::endl;
     }
 
-#ifdef ENABLE_CODE_PROFILER
-    time_Extras = codeProfiler.GetElapsedTime();
-    codeProfiler.Reset();
-    codeProfiler.Start();
-#endif
+    PROFILE_PHASE(time_Terminate);
 
   }
   iterTimer.Stop();
+  // the iteration loop may exit from within the termination test
+  if (!rt.profile.iterations.empty())
+  {
+    PROFILE_PHASE(time_Terminate);
+  }
 
   // complete termination message
   termMsg << " E: " << E << std::endl;
@@ -498,6 +620,20 @@ cisstICP::ReturnType cisstICP::IterateICP()
   pAlgorithm->ComputeMatchStatistics(rt.MatchPosErrAvg, rt.MatchPosErrSD);
   pAlgorithm->PrintMatchStatistics(termMsg);
 
+#ifdef ENABLE_ALLOCATION_COUNTER
+  if (opt.printOutput)
+  {
+    std::cout << "Heap allocations over " << allocIters << " steady-state iterations:" << std::endl
+      << " allocs_Match:                     " << allocs_Match << std::endl
+      << " allocs_UpdateParams_PostMatch:    " << allocs_UpdateParams_PostMatch << std::endl
+      << " allocs_FilterMatches:             " << allocs_FilterMatches << std::endl
+      << " allocs_Register:                  " << allocs_Register << std::endl
+      << " allocs_UpdateParams_PostRegister: " << allocs_UpdateParams_PostRegister << std::endl
+      << " allocs_EvalErrorFunc:             " << allocs_EvalErrorFunc << std::endl
+      << " allocs_Callbacks:                 " << allocs_Callbacks << std::endl;
+  }
+#endif
+
   rt.termMsg = termMsg.str();
   rt.Freg = Freg;    
   rt.runTime = totalTimer.GetElapsedTime();
@@ -508,6 +644,154 @@ cisstICP::ReturnType cisstICP::IterateICP()
 }
 
 
+namespace
+{
+  // state shared by the starts of a multi-start registration
+  struct MultiStartState
+  {
+    double bestE;                 // lowest error function value of any start
+    unsigned int cancelMinIter;
+    double cancelErrorMargin;
+  };
+
+  // state of one start
+  struct MultiStartRun
+  {
+    MultiStartState *pState;
+    double E;                     // error function value of the last iteration
+    bool bCancelled;
+  };
+
+  // iteration callback of each start: tracks the lowest error of all starts
+  //  and cancels this start once it lags behind
+  void MultiStartCallback(cisstICP::CallbackArg &arg, void *userData)
+  {
+    MultiStartRun *pRun = (MultiStartRun*)userData;
+    MultiStartState *pState = pRun->pState;
+    pRun->E = arg.E;
+
+    double bestE;
+#ifdef ENABLE_PARALLELIZATION
+#pragma omp critical (cisstICP_MultiStartCallback)
+#endif
+    {
+      if (arg.E < pState->bestE) pState->bestE = arg.E;
+      bestE = pState->bestE;
+    }
+
+    if (arg.iter >= pState->cancelMinIter
+      && arg.E - bestE > pState->cancelErrorMargin)
+    {
+      pRun->bCancelled = true;
+      arg.terminate = true;
+    }
+  }
+
+  bool MultiStartRank(const cisstICP::MultiStartResult &a, const cisstICP::MultiStartResult &b)
+  {
+    if (a.bCancelled != b.bCancelled) return b.bCancelled;
+    return a.E < b.E;
+  }
+}
+
+std::vector<cisstICP::MultiStartResult> cisstICP::RunMultiStart(
+  AlgorithmFactory &factory,
+  const std::vector<vctFrm3> &guesses,
+  const Options &opt,
+  const MultiStartOptions &msOpt)
+{
+  int nStarts = (int)guesses.size();
+  std::vector<MultiStartResult> results(nStarts);
+  if (nStarts == 0)
+  {
+    return results;
+  }
+
+  // The algorithm constructors register each instance with its tree, and
+  //  the searches of a tree other than a PDTreeBase go through the registered
+  //  instance; hence, when run one at a time, each instance is created just
+  //  before its start. The algorithm registered with the shared target
+  //  beforehand is restored once the starts complete.
+  PDTreeBase *pTarget = factory.Target();
+  algPDTree *pTargetAlgorithm = pTarget ? pTarget->pAlgorithm : NULL;
+  algICP *pFirstAlg = factory.Create();
+  if (pFirstAlg == NULL)
+  {
+    std::cout << "ERROR: algorithm factory failed to create an instance" << std::endl;
+    return std::vector<MultiStartResult>();
+  }
+  // the instances must search the shared target through their own tree pointer
+  bool bParallel = msOpt.parallel && !opt.deformable
+    && pTarget && pFirstAlg->pTree == pTarget;
+
+  MultiStartState state;
+  state.bestE = std::numeric_limits<double>::max();
+  state.cancelMinIter = msOpt.cancelMinIter;
+  state.cancelErrorMargin = msOpt.cancelErrorMargin;
+  std::vector<MultiStartRun> runs(nStarts);
+
+  // a single trace covers all starts
+  Options startOpt = opt;
+  startOpt.traceFile = "";
+  if (bParallel) startOpt.printOutput = false;
+  bool bTrace = !opt.traceFile.empty();
+  if (bTrace) ICPTrace::Enable();
+
+  // one thread per start; the searches of each start then run on that
+  //  thread alone (unless nested parallelism is enabled)
+  int s;
+#ifdef ENABLE_PARALLELIZATION
+#pragma omp parallel for schedule(dynamic, 1) if (bParallel)
+#endif
+  for (s = 0; s < nStarts; s++)
+  {
+    ICPTRACE_SCOPE("MultiStart", "start", s);
+
+    algICP *pAlg = pFirstAlg;
+    if (s > 0)
+    {
+#ifdef ENABLE_PARALLELIZATION
+#pragma omp critical (cisstICP_RunMultiStart)
+#endif
+      pAlg = factory.Create();
+    }
+
+    results[s].start = s;
+    results[s].FGuess = guesses[s];
+    if (pAlg == NULL || (bParallel && pAlg->pTree != pTarget))
+    {
+      std::cout << "ERROR: algorithm factory failed to create an instance for start " << s << std::endl;
+      results[s].rt.termMsg = "ERROR: no algorithm instance";
+      results[s].bCancelled = true;
+      delete pAlg;
+      continue;
+    }
+
+    runs[s].pState = &state;
+    runs[s].E = std::numeric_limits<double>::max();
+    runs[s].bCancelled = false;
+    std::vector<Callback> callbacks(1, Callback(MultiStartCallback, &runs[s]));
+
+    cisstICP icp;
+    results[s].rt = icp.RunICP(pAlg, startOpt, guesses[s], &callbacks, !bParallel);
+    results[s].E = runs[s].E;
+    results[s].bCancelled = runs[s].bCancelled;
+
+    delete pAlg;
+  }
+
+  if (pTarget) pTarget->SetSearchAlgorithm(pTargetAlgorithm);
+  if (bTrace)
+  {
+    ICPTrace::Write(opt.traceFile);
+    ICPTrace::Disable();
+  }
+
+  std::stable_sort(results.begin(), results.end(), MultiStartRank);
+  return results;
+}
+
+
 void cisstICP::AddIterationCallback(Callback &callback)
 {
   this->iterationCallbacks.push_back(callback);
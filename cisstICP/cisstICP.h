@@ -38,6 +38,7 @@
 #include <limits>
 
 #include "PDTreeBase.h"
+#include "ICPProfile.h"
 //#include "PDTree_Mesh.h"
 //#include "cisstPointCloud.h"
 
@@ -71,10 +72,12 @@ public:
 		std::string ssm;			// file name and location of statistical shape model
 		std::string cov;			// file name and location of covariance matrices of positional noise model
 		std::string axes;			// file name and location of major/minor axes of angular noise model
+		std::string treefile;		// file name and location of saved PD tree of the target
 
 		int modes;
 		int samples;
 		int niters;
+		int tcps;					// triangle solver precomputations of the target mesh (0 = full, 1 = compact, 2 = compact and lazy)
 
 		float scale;
 		float minpos, maxpos;
@@ -86,9 +89,12 @@ public:
 		float noisedeg, noiseecc;
 		float nthresh, diagthresh;
 		float rbounds, tbounds, sbounds, spbounds;
+		float distfield;			// cell size of the distance field searched for the target mesh
 
 		bool deformable;	// is algorithm deformable?
 		bool bScale;
+		bool flatTree;		// search the target PD tree through its flattened nodes only
+		bool searchOrder;	// search the samples in spatially coherent order (see algICP::SetSpatialSearchOrder())
 		bool useDefaultTarget;
 		bool useDefaultInput;
 		bool readModeWeights;
@@ -98,10 +104,13 @@ public:
 		bool useDefaultSSM;
 		bool useDefaultCov;
 		bool useDefaultAxes;
+		bool useDefaultTreeFile;
+		bool useDefaultDistField;
 
 		bool useDefaultNumModes;
 		bool useDefaultNumSamples;
 		bool useDefaultNumIters;
+		bool useDefaultTCPS;
 
 		bool useDefaultScale;
 		bool useDefaultMinPos;
@@ -135,9 +144,11 @@ public:
 			ssm("../../../test_data/atlas_mt.txt"),
 			cov(""),
 			axes(""),
+			treefile(""),
 			modes(3),
 			samples(300),
 			niters(100),
+			tcps(0),
 			scale(1.0),
 			minpos(10.0),
 			maxpos(20.0),
@@ -156,7 +167,10 @@ public:
 			tbounds(DBL_MAX),
 			sbounds(0.3),
 			spbounds(3.0),
+			distfield(1.0),
 			bScale(false),
+			flatTree(false),
+			searchOrder(false),
 			deformable(false),
 			useDefaultTarget(true),
 			useDefaultInput(true),
@@ -167,9 +181,12 @@ public:
 			useDefaultSSM(true),
 			useDefaultCov(true),
 			useDefaultAxes(true),
+			useDefaultTreeFile(true),
+			useDefaultDistField(true),
 			useDefaultNumModes(true),
 			useDefaultNumSamples(true),
 			useDefaultNumIters(true),
+			useDefaultTCPS(true),
 			useDefaultScale(true),
 			useDefaultMinPos(true),
 			useDefaultMaxPos(true),
@@ -198,6 +215,9 @@ public:
     std::string auxOutputDir;		// directory for saving run-time logs
     bool		printOutput;		// print runtime output
 	bool		deformable;
+    bool		profile;			// record the time of each iteration phase (see ReturnType::profile)
+    std::string profileTag;			// label stored with the profile (e.g. algorithm and target names)
+    std::string traceFile;			// if set, write a timeline trace of the run to this file (see ICPTrace.h)
 
     // termination conditions
     unsigned int  maxIter;			// max iterations
@@ -219,6 +239,9 @@ public:
       auxOutputDir(""),
       printOutput(true),
 	  deformable(false),
+      profile(false),
+      profileTag(""),
+      traceFile(""),
       maxIter(100),
       termHoldIter(2),
 	  numShapeParams(0),
@@ -245,6 +268,8 @@ public:
         << " dAngTerm (deg):\t" << dAngTerm * 180.0 / cmnPI << std::endl
         << " auxOutputDir:\t" << auxOutputDir << std::endl
         << " printOutput:\t" << printOutput << std::endl
+        << " profile:\t" << profile << std::endl
+        << " traceFile:\t" << traceFile << std::endl
         ;
       return ss.str();
     };
@@ -263,6 +288,8 @@ public:
     double  MatchPosErrSD;
     double  MatchNormErrSD;
     unsigned int nOutliers;
+    ICPProfile profile;   // per-iteration phase times and search counts
+                          //  (recorded only if Options::profile is set)
 
     ReturnType()
       : termMsg(""), runTime(0.0), runTimeFirstMatch(0.0), numIter(0),
@@ -293,6 +320,8 @@ public:
     double        tolE;               // percent change in error function value
     double        time;               // time transpired for this iteration
     unsigned int  nOutliers;          // number of outliers this iteration
+    bool          terminate;          // set by a callback to end the registration
+                                      //  after this iteration
     
     virtual void ThisMakesMePolymorphic(){};
 
@@ -307,7 +336,8 @@ public:
       E(0.0),
       tolE(0.0),
       time(0.0),
-      nOutliers(0)
+      nOutliers(0),
+      terminate(false)
       {};
   };
 
@@ -329,6 +359,70 @@ public:
         userData(userData) {};
   };
 
+  // one level of a coarse-to-fine registration (see RunICP() for pyramids)
+  struct PyramidLevel
+  {
+    algICP  *pAlg;  // algorithm set up with the samples and target of this level
+                    //  (e.g. samples subsampled by VoxelGridSubsample() and the
+                    //   tree of a mesh decimated by cisstMesh::Decimate())
+    Options opt;    // iteration limit and termination conditions of this level
+
+    PyramidLevel()
+      : pAlg(NULL)
+      {};
+    PyramidLevel(algICP *pAlg, const Options &opt)
+      : pAlg(pAlg), opt(opt)
+      {};
+  };
+
+  // Creates the algorithm instances of a multi-start registration
+  //  (see RunMultiStart())
+  class AlgorithmFactory
+  {
+  public:
+
+    virtual ~AlgorithmFactory() {}
+
+    // target tree searched by every instance
+    //  (NULL if the instances do not share a PD tree; their starts are then
+    //   run one at a time)
+    virtual PDTreeBase *Target() { return NULL; }
+
+    // returns a new algorithm instance, set up with the samples and
+    //  the target (deleted by RunMultiStart())
+    virtual algICP *Create() = 0;
+  };
+
+  // multi-start run options
+  struct MultiStartOptions
+  {
+    bool          parallel;           // run the starts concurrently where possible
+    unsigned int  cancelMinIter;      // iterations before a start may be cancelled
+    double        cancelErrorMargin;  // cancel a start once its error function value
+                                      //  exceeds the lowest value of any start by
+                                      //  this margin (default: never cancel)
+
+    MultiStartOptions()
+      : parallel(true),
+        cancelMinIter(5),
+        cancelErrorMargin(std::numeric_limits<double>::max())
+        {};
+  };
+
+  // result of one start of a multi-start registration
+  struct MultiStartResult
+  {
+    unsigned int  start;        // index of the initial guess
+    vctFrm3       FGuess;       // initial guess
+    double        E;            // final error function value
+    bool          bCancelled;   // start was cancelled by a better start
+    ReturnType    rt;
+
+    MultiStartResult()
+      : start(0), E(std::numeric_limits<double>::max()), bCancelled(false)
+      {};
+  };
+
 
   //--- VARIABLES ---//
 
@@ -366,6 +460,42 @@ public:
     std::vector<Callback> *pUserCallbacks = NULL,
     bool bEnableAlgorithmCallbacks = true);
 
+  // Register coarse to fine through a pyramid of levels, ordered from the
+  //  coarsest to the finest; each level begins from the registration and the
+  //  noise model estimates (sigma2, k) of the previous level (see
+  //  algICP::SetNoiseModelWarmStart()), and terminates by its own options
+  //  Returns the result of the finest level, with the run time, iteration
+  //  count and profile covering all levels (the profile iterations are
+  //  numbered from 1 on each level); the results of the individual levels
+  //  are stored to pLevelResults if given. The iteration callbacks are run on
+  //  every level. A trace file given in the options of the finest level
+  //  covers all levels.
+  //  The levels of a deformable registration do not share the shape
+  //  parameters, so the levels must register a rigid shape.
+  ReturnType RunICP(
+    const std::vector<PyramidLevel> &levels, const vctFrm3 &FGuess,
+    std::vector<Callback> *pUserCallbacks = NULL,
+    bool bEnableAlgorithmCallbacks = true,
+    std::vector<ReturnType> *pLevelResults = NULL);
+
+  // Register from each of a set of initial guesses and return the results
+  //  ranked by final error (the cancelled starts are ranked last)
+  //  Each start runs on its own algorithm instance. The instances search the
+  //  shared target tree through their own search contexts, so the starts run
+  //  concurrently, one thread per start, provided the instances all search
+  //  factory.Target() and the registration is not deformable (a deformable
+  //  registration modifies the target); otherwise the starts run one at a time.
+  //  The error function values of the starts are compared in order to cancel
+  //  the starts lagging behind (see MultiStartOptions), so the instances must
+  //  use the same algorithm and samples.
+  //  Concurrent starts do not print their progress or run the algorithm
+  //  callbacks; a trace file given in the options covers all starts.
+  static std::vector<MultiStartResult> RunMultiStart(
+    AlgorithmFactory &factory,
+    const std::vector<vctFrm3> &guesses,
+    const Options &opt,
+    const MultiStartOptions &msOpt = MultiStartOptions());
+
 protected:
 
   ReturnType IterateICP();
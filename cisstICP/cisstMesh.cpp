@@ -35,6 +35,7 @@
 
 #include "cisstMesh.h"
 #include "utilities.h"
+#include "CovBatchKernels.h"
 
 #include <cisstNumerical/nmrLSSolver.h>
 
@@ -42,6 +43,14 @@
 #undef NDEBUG       // enable assert in release mode
 
 #include <fstream>
+#include <algorithm>
+#include <vector>
+
+#define ENABLE_PARALLELIZATION
+
+// rows of the mode matrix synthesized together in a block
+//  (the block of the shape stays in cache while the modes are accumulated)
+#define MODE_MATRIX_BLOCK_ROWS 512
 
 // compares vertex for storing in std::Map
 //  NOTE: this routine is used for loading a mesh from an STL file;
@@ -73,6 +82,21 @@ struct VertexCompare {
 };
 
 
+namespace {
+
+	// orders the triangles of a decimated mesh by their vertex indices
+	bool TriangleKeyLess(const std::pair<vctInt3, int> &a, const std::pair<vctInt3, int> &b)
+	{
+		for (unsigned int k = 0; k < 3; k++)
+		{
+			if (a.first[k] != b.first[k])
+				return a.first[k] < b.first[k];
+		}
+		return a.second < b.second;
+	}
+
+} // namespace anonymous
+
 void cisstMesh::ResetMesh()
 {
   vertices.SetSize(0);
@@ -82,6 +106,8 @@ void cisstMesh::ResetMesh()
   faceNeighbors.SetSize(0);
   TriangleCov.SetSize(0);
   TriangleCovEig.SetSize(0);
+  TriangleCovPacked.SetSize(0);
+  bParametricCov = false;
 }
 
 void cisstMesh::ResetModel()
@@ -91,16 +117,40 @@ void cisstMesh::ResetModel()
 	modeWeight.SetSize(0);
 	wi.SetSize(0);
 	Si.SetSize(0);
+	modeMatrix.SetSize(0);
+	modeMatrixFloat.SetSize(0);
 	//estVertices.SetSize(0);
 }
 
 void cisstMesh::InitializeNoiseModel()
 {
-  TriangleCov.SetSize(faces.size());
-  TriangleCovEig.SetSize(faces.size());
+  if (faceNormals.size() == faces.size())
+  {
+    InitializeNoiseModel(0.0, 0.0);
+    return;
+  }
+
+  // without face normals the noise model cannot be stored in parametric form
+  bParametricCov = false;
+  if (covStorage == COV_STORAGE_PARAMETRIC)
+  {
+    covStorage = COV_STORAGE_FULL;
+  }
 
-  TriangleCov.SetAll(vct3x3(0.0));
+  TriangleCovEig.SetSize(faces.size());
   TriangleCovEig.SetAll(vct3(0.0));
+  if (covStorage == COV_STORAGE_PACKED)
+  {
+    TriangleCov.SetSize(0);
+    TriangleCovPacked.SetSize(faces.size());
+    TriangleCovPacked.SetAll(PackedCov3(vct3x3(0.0)));
+  }
+  else
+  {
+    TriangleCovPacked.SetSize(0);
+    TriangleCov.SetSize(faces.size());
+    TriangleCov.SetAll(vct3x3(0.0));
+  }
 }
 
 void cisstMesh::InitializeNoiseModel(
@@ -120,24 +170,134 @@ void cisstMesh::InitializeNoiseModel(
     assert(0);
   }
 
-  TriangleCov.SetSize(faces.size());
+  bParametricCov = true;
+  covInPlaneVar = noiseInPlaneVar;
+  covPerpPlaneVar = noisePerpPlaneVar;
+  // covariance eigenvalues (in order of decreasing magnitude)
+  covEigParametric = ParametricCovEig(noisePerpPlaneVar, noiseInPlaneVar);
+
+  if (covStorage == COV_STORAGE_PARAMETRIC)
+  {
+    TriangleCov.SetSize(0);
+    TriangleCovEig.SetSize(0);
+    TriangleCovPacked.SetSize(0);
+    return;
+  }
+
   TriangleCovEig.SetSize(faces.size());
+  TriangleCovEig.SetAll(covEigParametric);
 
-  // set covariance eigenvalues (in order of decreasing magnitude)
-  if (noiseInPlaneVar >= noisePerpPlaneVar)
+  // compute covariance matrices
+  if (covStorage == COV_STORAGE_PACKED)
   {
-    TriangleCovEig.SetAll(vct3(noiseInPlaneVar, noiseInPlaneVar, noisePerpPlaneVar));
+    vct3x3 M;
+    TriangleCov.SetSize(0);
+    TriangleCovPacked.SetSize(faces.size());
+    for (unsigned int i = 0; i < faces.size(); i++)
+    {
+      UnpackParametricCov(faceNormals[i], noisePerpPlaneVar, noiseInPlaneVar, M);
+      TriangleCovPacked[i].Pack(M);
+    }
   }
   else
   {
-    TriangleCovEig.SetAll(vct3(noisePerpPlaneVar, noiseInPlaneVar, noiseInPlaneVar));
+    TriangleCovPacked.SetSize(0);
+    TriangleCov.SetSize(faces.size());
+    ComputePointCovariance_Batch(faceNormals.Pointer(), (int)faces.size(),
+      noisePerpPlaneVar, noiseInPlaneVar, TriangleCov.Pointer());
   }
+}
 
-  // compute covariance matrices
-  for (unsigned int i = 0; i < faces.size(); i++)
+void cisstMesh::SetCovStorage(CovStorageMode mode)
+{
+  if (mode == covStorage)
+  {
+    return;
+  }
+  if (mode == COV_STORAGE_PARAMETRIC)
+  {
+    if (!NoiseModelIsParametric())
+    {
+      // the covariances were assigned since InitializeNoiseModel()
+      bParametricCov = false;
+      std::cout << "ERROR: parametric covariance storage requires the noise model set by InitializeNoiseModel();"
+        << " keeping the current storage" << std::endl;
+      return;
+    }
+    covStorage = COV_STORAGE_PARAMETRIC;
+    TriangleCov.SetSize(0);
+    TriangleCovEig.SetSize(0);
+    TriangleCovPacked.SetSize(0);
+    return;
+  }
+
+  // expand the noise model, if stored in parametric form, to full covariances
+  //  then convert to the new storage
+  unsigned int numCov = faces.size();
+  if (covStorage == COV_STORAGE_PARAMETRIC)
   {
-    TriangleCov[i] = ComputePointCovariance(faceNormals[i], noisePerpPlaneVar, noiseInPlaneVar);
+    TriangleCovEig.SetSize(numCov);
+    TriangleCovEig.SetAll(covEigParametric);
+  }
+  else
+  {
+    numCov = (covStorage == COV_STORAGE_PACKED) ? TriangleCovPacked.size() : TriangleCov.size();
+  }
+
+  if (mode == COV_STORAGE_PACKED)
+  {
+    TriangleCovPacked.SetSize(numCov);
+    for (unsigned int i = 0; i < numCov; i++)
+    {
+      vct3x3 M;
+      TriangleCovariance(i, M);
+      TriangleCovPacked[i].Pack(M);
+    }
+    TriangleCov.SetSize(0);
   }
+  else
+  {
+    TriangleCov.SetSize(numCov);
+    for (unsigned int i = 0; i < numCov; i++)
+    {
+      TriangleCovariance(i, TriangleCov[i]);
+    }
+    TriangleCovPacked.SetSize(0);
+  }
+  covStorage = mode;
+}
+
+bool cisstMesh::NoiseModelIsParametric() const
+{
+  if (!bParametricCov || faceNormals.size() != faces.size())
+  {
+    return false;
+  }
+  if (covStorage == COV_STORAGE_PARAMETRIC)
+  {
+    return true;
+  }
+
+  // the covariance arrays are public and may have been assigned after
+  //  InitializeNoiseModel() => compare them with the parametric form
+  unsigned int numCov = (covStorage == COV_STORAGE_PACKED) ? TriangleCovPacked.size() : TriangleCov.size();
+  if (numCov != faces.size() || TriangleCovEig.size() != faces.size())
+  {
+    return false;
+  }
+  double tol = 1e-9 * std::max(fabs(covInPlaneVar), fabs(covPerpPlaneVar));
+  vct3x3 M, Mp;
+  for (unsigned int i = 0; i < numCov; i++)
+  {
+    TriangleCovariance(i, M);
+    UnpackParametricCov(faceNormals[i], covPerpPlaneVar, covInPlaneVar, Mp);
+    if ((M - Mp).MaxAbsElement() > tol
+      || (TriangleCovEig[i] - covEigParametric).MaxAbsElement() > tol)
+    {
+      return false;
+    }
+  }
+  return true;
 }
 
 void cisstMesh::SaveTriangleCovariances(std::string &filePath)
@@ -149,13 +309,21 @@ void cisstMesh::SaveTriangleCovariances(std::string &filePath)
     std::cout << "ERROR: failed to open file for saving cov: " << filePath << std::endl;
     assert(0);
   }
-  unsigned int numCov = this->TriangleCov.size();
+  unsigned int numCov;
+  switch (covStorage)
+  {
+  case COV_STORAGE_PACKED:      numCov = this->TriangleCovPacked.size(); break;
+  case COV_STORAGE_PARAMETRIC:  numCov = this->faces.size(); break;
+  default:                      numCov = this->TriangleCov.size(); break;
+  }
   //fs << "NUMCOV " << numCov << "\n";
+  vct3x3 M;
   for (unsigned int i = 0; i < numCov; i++)
   {
-    fs << this->TriangleCov.at(i).Row(0) << " "
-      << this->TriangleCov.at(i).Row(1) << " "
-      << this->TriangleCov.at(i).Row(2) << "\n";
+    TriangleCovariance(i, M);
+    fs << M.Row(0) << " "
+      << M.Row(1) << " "
+      << M.Row(2) << "\n";
   }
 }
 
@@ -220,17 +388,228 @@ int cisstMesh::LoadMesh(
   return 0;
 }
 
-int cisstMesh::LoadModelFile(const std::string &modelFilePath, int numModes)
+int cisstMesh::LoadModelFile(const std::string &modelFilePath, int numModes,
+	bool bSinglePrecisionModes)
 {
 	int rv;
 
 	ResetModel();
 
 	rv = AddModelFile(modelFilePath, numModes);
+	if (rv > 0)
+		BuildModeMatrix(bSinglePrecisionModes);
 
 	return rv;
 }
 
+void cisstMesh::BuildModeMatrix(bool bSinglePrecision)
+{
+	int nModes = NumModes();
+	int nRows = 3 * (nModes > 0 ? (int)wi[0].size() : 0);
+
+	modeMatrix.SetSize(0);
+	modeMatrixFloat.SetSize(0);
+	if (bSinglePrecision)
+		modeMatrixFloat.SetSize(nRows * nModes);
+	else
+		modeMatrix.SetSize(nRows * nModes);
+
+	for (int i = 0; i < nModes; i++)
+	{
+		for (int v = 0; v < nRows / 3; v++)
+		{
+			for (int k = 0; k < 3; k++)
+			{
+				if (bSinglePrecision)
+					modeMatrixFloat[i * nRows + 3 * v + k] = (float)wi[i][v][k];
+				else
+					modeMatrix[i * nRows + 3 * v + k] = wi[i][v][k];
+			}
+		}
+	}
+}
+
+namespace {
+
+	// y[r] = mean[r] + sum_i S[i]*M[i*ld + r]   for r in [rowBegin, rowEnd)
+	//  modes are accumulated four at a time to limit the passes over the block
+	template <class T>
+	void SynthesizeRows(const T *M, int ld, int nModes, const double *S,
+		const double *mean, int rowBegin, int rowEnd, double *y)
+	{
+		int r, i;
+		for (r = rowBegin; r < rowEnd; r++)
+			y[r] = mean[r];
+
+		for (i = 0; i + 4 <= nModes; i += 4)
+		{
+			const T *c0 = M + i * ld;
+			const T *c1 = c0 + ld;
+			const T *c2 = c1 + ld;
+			const T *c3 = c2 + ld;
+			double s0 = S[i], s1 = S[i + 1], s2 = S[i + 2], s3 = S[i + 3];
+			for (r = rowBegin; r < rowEnd; r++)
+				y[r] += s0 * c0[r] + s1 * c1[r] + s2 * c2[r] + s3 * c3[r];
+		}
+		for (; i < nModes; i++)
+		{
+			const T *c = M + i * ld;
+			double s = S[i];
+			for (r = rowBegin; r < rowEnd; r++)
+				y[r] += s * c[r];
+		}
+	}
+
+	template <class T>
+	void SynthesizeDense(const T *M, int nRows, int nModes, const double *S,
+		const double *mean, double *y)
+	{
+		int nBlocks = (nRows + MODE_MATRIX_BLOCK_ROWS - 1) / MODE_MATRIX_BLOCK_ROWS;
+		int b;
+#ifdef ENABLE_PARALLELIZATION
+#pragma omp parallel for
+#endif
+		for (b = 0; b < nBlocks; b++)
+		{
+			int rowBegin = b * MODE_MATRIX_BLOCK_ROWS;
+			int rowEnd = std::min(rowBegin + MODE_MATRIX_BLOCK_ROWS, nRows);
+			SynthesizeRows(M, nRows, nModes, S, mean, rowBegin, rowEnd, y);
+		}
+	}
+
+}
+
+void cisstMesh::SynthesizeShape(
+	const vctDynamicVector<vct3> &mean,
+	const vctDynamicVector<double> &S,
+	vctDynamicVector<vct3> &V) const
+{
+	assert(HasModeMatrix() || NumModes() == 0);
+	int nRows = 3 * (int)mean.size();
+	int nModes = std::min(NumModes(), (int)S.size());
+	V.SetSize(mean.size());
+
+	// vct3 elements are stored contiguously => a shape is an array of 3*Nvertices doubles
+	if (modeMatrixFloat.size() > 0)
+		SynthesizeDense(modeMatrixFloat.Pointer(), nRows, nModes, S.Pointer(),
+			mean.Pointer()->Pointer(), V.Pointer()->Pointer());
+	else
+		SynthesizeDense(modeMatrix.Pointer(), nRows, nModes, S.Pointer(),
+			mean.Pointer()->Pointer(), V.Pointer()->Pointer());
+}
+
+int cisstMesh::Decimate(double cellSize, cisstMesh &coarse) const
+{
+	coarse.ResetMesh();
+	coarse.ResetModel();
+
+	// merge the vertices of each grid cell into their mean
+	vctDynamicVector<unsigned int> cells;
+	unsigned int numCells = ComputeVoxelGridCells(vertices, cellSize, cells);
+	bool bVertexNormals = vertexNormals.size() == vertices.size();
+	vctDynamicVector<vct3> coarseVertices(numCells, vct3(0.0));
+	vctDynamicVector<vct3> coarseVertexNormals(bVertexNormals ? numCells : 0, vct3(0.0));
+	std::vector<unsigned int> cellCount(numCells, 0);
+	for (unsigned int v = 0; v < vertices.size(); v++)
+	{
+		coarseVertices[cells[v]].Add(vertices[v]);
+		if (bVertexNormals)
+			coarseVertexNormals[cells[v]].Add(vertexNormals[v]);
+		cellCount[cells[v]]++;
+	}
+	for (unsigned int c = 0; c < numCells; c++)
+	{
+		coarseVertices[c].Divide((double)cellCount[c]);
+		if (bVertexNormals)
+		{
+			double norm = coarseVertexNormals[c].Norm();
+			if (norm > 0.0)
+				coarseVertexNormals[c].Divide(norm);
+		}
+	}
+
+	// keep the triangles spanning three cells, once for each set of cells
+	//  (triangles of the same cells but opposite orientation are both kept)
+	std::vector<std::pair<vctInt3, int> > keys;
+	keys.reserve(faces.size());
+	for (unsigned int f = 0; f < faces.size(); f++)
+	{
+		vctInt3 face(cells[faces[f][0]], cells[faces[f][1]], cells[faces[f][2]]);
+		if (face[0] == face[1] || face[1] == face[2] || face[0] == face[2])
+			continue;
+		// the vertex order up to a cyclic shift preserves the orientation
+		int first = 0;
+		if (face[1] < face[first]) first = 1;
+		if (face[2] < face[first]) first = 2;
+		vctInt3 key(face[first], face[(first + 1) % 3], face[(first + 2) % 3]);
+		keys.push_back(std::make_pair(key, (int)f));
+	}
+	std::sort(keys.begin(), keys.end(), TriangleKeyLess);
+
+	std::vector<vctInt3> coarseFaces;
+	std::vector<vct3> coarseFaceNormals;
+	for (size_t j = 0; j < keys.size(); j++)
+	{
+		if (j > 0 && keys[j].first == keys[j - 1].first)
+			continue;
+		const vctInt3 &face = keys[j].first;
+		vct3 normal = vctCrossProduct(
+			coarseVertices[face[1]] - coarseVertices[face[0]],
+			coarseVertices[face[2]] - coarseVertices[face[0]]);
+		double norm = normal.Norm();
+		if (norm <= 0.0)
+			continue;   // degenerate triangle
+		coarseFaces.push_back(face);
+		coarseFaceNormals.push_back(normal / norm);
+	}
+	if (coarseFaces.empty())
+	{
+		std::cout << "ERROR: no triangles remain after decimating mesh with cell size " << cellSize << std::endl;
+		return -1;
+	}
+
+	// remove the vertices of the cells no longer used by a triangle
+	std::vector<int> vertexMap(numCells, -1);
+	int nUsed = 0;
+	for (size_t f = 0; f < coarseFaces.size(); f++)
+	{
+		for (unsigned int k = 0; k < 3; k++)
+		{
+			int &v = vertexMap[coarseFaces[f][k]];
+			if (v < 0)
+				v = nUsed++;
+		}
+	}
+	coarse.vertices.SetSize(nUsed);
+	if (bVertexNormals)
+		coarse.vertexNormals.SetSize(nUsed);
+	for (unsigned int c = 0; c < numCells; c++)
+	{
+		if (vertexMap[c] < 0)
+			continue;
+		coarse.vertices[vertexMap[c]] = coarseVertices[c];
+		if (bVertexNormals)
+			coarse.vertexNormals[vertexMap[c]] = coarseVertexNormals[c];
+	}
+	coarse.faces.SetSize(coarseFaces.size());
+	coarse.faceNormals.SetSize(coarseFaces.size());
+	for (size_t f = 0; f < coarseFaces.size(); f++)
+	{
+		for (unsigned int k = 0; k < 3; k++)
+			coarse.faces[f][k] = vertexMap[coarseFaces[f][k]];
+		coarse.faceNormals[f] = coarseFaceNormals[f];
+	}
+
+	// noise model
+	coarse.covStorage = covStorage;
+	if (NoiseModelIsParametric())
+		coarse.InitializeNoiseModel(covInPlaneVar, covPerpPlaneVar);
+	else
+		coarse.InitializeNoiseModel();
+
+	return 0;
+}
+
 int cisstMesh::AddModelFile(const std::string &modelFilePath, int modes)
 {
 	//Load model from file having format:
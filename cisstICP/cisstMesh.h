@@ -39,6 +39,7 @@
 #include <cisstVector.h>
 #include <cisstCommon.h>
 #include <ply_io.h>
+#include "PackedCov3.h"
 //#include "cisstTriangle.h"
 
 class cisstMesh
@@ -64,22 +65,44 @@ public:
 	vctDynamicVector<vctDynamicVector<vct3>>	wi;						// weighted modes per vertex
 	vctDynamicVector<double>					Si;						// shape parameter per mode
 
+	// weighted modes stored as one contiguous column-major (3*Nvertices x Nmodes)
+	//  matrix, i.e. column i holds the vertex coordinates of wi[i] (see BuildModeMatrix())
+	vctDynamicVector<double>					modeMatrix;
+	vctDynamicVector<float>						modeMatrixFloat;		// single precision variant
+
 	// mesh noise model
 	//  NOTE: if used, this must be set manually by the user AFTER loading the mesh file
 	//        (defaults to all zeroes, i.e. zero measurement noise on the mesh)
+	//        the covariances are stored in TriangleCov and TriangleCovEig unless
+	//        a compact storage mode is selected (see SetCovStorage()); use the
+	//        TriangleCovariance() accessors to read them in any storage mode
 	vctDynamicVector<vct3x3>  					TriangleCov;			// triangle covariances
 	vctDynamicVector<vct3>    					TriangleCovEig;			// triangle covariance eigenvalues (in decreasing size)
+	vctDynamicVector<PackedCov3>				TriangleCovPacked;		// triangle covariances (COV_STORAGE_PACKED)
 
 private:
 
 	ply_io ply_obj;
 
+	// noise model storage
+	CovStorageMode covStorage;
+	bool	bParametricCov;		// noise model was set by InitializeNoiseModel(inPlane, perpPlane)
+	double	covInPlaneVar;
+	double	covPerpPlaneVar;
+	vct3	covEigParametric;
+
 public:
 
 	//--- Methods ---//
 
 	// constructor
-	cisstMesh() {};
+	cisstMesh() :
+		covStorage(COV_STORAGE_FULL),
+		bParametricCov(false),
+		covInPlaneVar(0.0),
+		covPerpPlaneVar(0.0),
+		covEigParametric(0.0)
+	{};
 
 	// destructor
 	~cisstMesh() {}
@@ -106,6 +129,62 @@ public:
 
 	void SaveTriangleCovariances(std::string &filePath);
 
+	// selects how the triangle noise model is stored and converts the current
+	//  noise model to that form
+	//  NOTE: parametric storage is only available for a noise model set by
+	//        InitializeNoiseModel() (i.e. not for covariances assigned to
+	//        TriangleCov by the user, even after InitializeNoiseModel())
+	void SetCovStorage(CovStorageMode mode);
+	CovStorageMode GetCovStorage() const { return covStorage; }
+
+	// true if the noise model is the parametric form set by
+	//  InitializeNoiseModel(inPlane, perpPlane); the stored covariances
+	//  are compared with that form, since they may have been assigned
+	//  by the user since
+	bool NoiseModelIsParametric() const;
+
+	// noise model of a triangle (in any storage mode)
+	inline void TriangleCovariance(int ti, vct3x3 &M) const
+	{
+		switch (covStorage)
+		{
+		case COV_STORAGE_PACKED:
+			TriangleCovPacked[ti].Unpack(M);
+			break;
+		case COV_STORAGE_PARAMETRIC:
+			UnpackParametricCov(faceNormals[ti], covPerpPlaneVar, covInPlaneVar, M);
+			break;
+		default:
+			M = TriangleCov[ti];
+			break;
+		}
+	}
+	// M += noise model of a triangle
+	inline void AddTriangleCovariance(int ti, vct3x3 &M) const
+	{
+		switch (covStorage)
+		{
+		case COV_STORAGE_PACKED:
+			TriangleCovPacked[ti].AddTo(M);
+			break;
+		case COV_STORAGE_PARAMETRIC:
+			AddParametricCov(faceNormals[ti], covPerpPlaneVar, covInPlaneVar, M);
+			break;
+		default:
+			M.Add(TriangleCov[ti]);
+			break;
+		}
+	}
+	// noise model eigenvalues of a triangle (in decreasing size)
+	inline const vct3& TriangleCovarianceEig(int ti) const
+	{
+		if (covStorage == COV_STORAGE_PARAMETRIC)
+		{
+			return covEigParametric;
+		}
+		return TriangleCovEig[ti];
+	}
+
 	// get coordinates of all three vertices for a given face index
 	inline void FaceCoords(int ti, vct3 &v0, vct3 &v1, vct3 &v2) const
 	{
@@ -142,7 +221,40 @@ public:
 	// Build new mesh from a single .mesh file
 	//int  LoadMeshFile(const std::string &meshFilePath);
 
-	int  LoadModelFile(const std::string &modelFilePath, int numModes);
+	int  LoadModelFile(const std::string &modelFilePath, int numModes,
+		bool bSinglePrecisionModes = false);
+
+	// Statistical shape model
+
+	inline int NumModes() const { return (int)wi.size(); }
+
+	// builds the mode matrix from the weighted modes (wi), in double or single
+	//  precision (the single precision matrix takes half the memory and
+	//  bandwidth, and adds round-off of about 1e-7 times the mode coordinates)
+	void BuildModeMatrix(bool bSinglePrecision = false);
+	inline bool HasModeMatrix() const
+	{
+		return modeMatrix.size() + modeMatrixFloat.size() > 0;
+	}
+
+	// synthesizes the shape V = mean + sum_i S[i]*wi[i] as one blocked
+	//  matrix-vector product with the mode matrix (S holds NumModes() values)
+	void SynthesizeShape(
+		const vctDynamicVector<vct3> &mean,
+		const vctDynamicVector<double> &S,
+		vctDynamicVector<vct3> &V) const;
+
+	// Decimation
+
+	// builds a coarser mesh by vertex clustering: the vertices within each
+	//  cell of a grid of the given cell size are merged into their mean, and
+	//  the triangles collapsed by the merge are removed
+	//  (e.g. for the target levels of a coarse-to-fine registration); the
+	//  decimated mesh has the noise model of this mesh if that was set by
+	//  InitializeNoiseModel(inPlane, perpPlane), and zero noise otherwise;
+	//  the statistical shape model is not carried over
+	//  returns 0 on success and -1 if no triangles remain
+	int  Decimate(double cellSize, cisstMesh &coarse) const;
 
 private:
 
@@ -36,8 +36,14 @@
 
 #include "utilities.h"
 
+#include <algorithm>
+#include <math.h>
+
 cisstPointCloud::cisstPointCloud( vctDynamicVector<vct3> &points ) :
-points(points)
+points(points),
+covStorage(COV_STORAGE_FULL),
+bParametricCov(false),
+covPerpPlaneVar(0.0)
 {
   InitializeNoiseModel();
 }
@@ -46,7 +52,10 @@ cisstPointCloud::cisstPointCloud(
   vctDynamicVector<vct3> &points,
   vctDynamicVector<vct3> &pointOrientations) :
 points(points),
-pointOrientations(pointOrientations)
+pointOrientations(pointOrientations),
+covStorage(COV_STORAGE_FULL),
+bParametricCov(false),
+covPerpPlaneVar(0.0)
 {
   if (points.size() != pointOrientations.size()) 
   {
@@ -60,7 +69,10 @@ pointOrientations(pointOrientations)
   InitializeNoiseModel();
 }
 
-cisstPointCloud::cisstPointCloud(cisstMesh &mesh)
+cisstPointCloud::cisstPointCloud(cisstMesh &mesh) :
+covStorage(COV_STORAGE_FULL),
+bParametricCov(false),
+covPerpPlaneVar(0.0)
 {
   vct3 v0, v1, v2;
 
@@ -80,14 +92,17 @@ cisstPointCloud::cisstPointCloud(cisstMesh &mesh)
     mesh.FaceCoords(i, v0, v1, v2);
     points[i] = (v0 + v1 + v2) / 3.0;
     pointOrientations[i] = mesh.faceNormals[i];
-    pointCov[i] = mesh.TriangleCov[i];
-    pointCovEig[i] = mesh.TriangleCovEig[i];
+    mesh.TriangleCovariance(i, pointCov[i]);
+    pointCovEig[i] = mesh.TriangleCovarianceEig(i);
   }
 }
 
 cisstPointCloud::cisstPointCloud(
   cisstMesh &mesh,
-  double noisePerpPlaneSD)
+  double noisePerpPlaneSD) :
+covStorage(COV_STORAGE_FULL),
+bParametricCov(false),
+covPerpPlaneVar(0.0)
 {
   double noiseInPlaneVar, noisePerpPlaneVar;
   double sqrDist;
@@ -115,6 +130,9 @@ cisstPointCloud::cisstPointCloud(
   //  use triangles to determine in-plane noise
   pointCov.SetSize(NData);
   pointCovEig.SetSize(NData);
+  pointCovInPlaneVar.SetSize(NData);
+  covPerpPlaneVar = noisePerpPlaneVar;
+  bParametricCov = true;
   for (int i = 0; i < NData; i++)
   {
     mesh.FaceCoords(i, v0, v1, v2);
@@ -127,6 +145,7 @@ cisstPointCloud::cisstPointCloud(
     sqrDist += (v2 - c).NormSquare();
     sqrDist /= 3.0;
     noiseInPlaneVar = sqrDist;
+    pointCovInPlaneVar[i] = noiseInPlaneVar;
 
     // set noise model for this point
     pointCov[i] = ComputePointCovariance(
@@ -156,15 +175,133 @@ void cisstPointCloud::ResetPointCloud()
   pointOrientations.SetSize(0);
   pointCov.SetSize(0);
   pointCovEig.SetSize(0);
+  pointCovPacked.SetSize(0);
+  pointCovInPlaneVar.SetSize(0);
+  bParametricCov = false;
 }
 
 void cisstPointCloud::InitializeNoiseModel()
 {
-  pointCov.SetSize(points.size());
-  pointCovEig.SetSize(points.size());
+  bParametricCov = false;
+  pointCovInPlaneVar.SetSize(0);
+  if (covStorage == COV_STORAGE_PARAMETRIC)
+  {
+    covStorage = COV_STORAGE_FULL;
+  }
 
-  pointCov.SetAll(vct3x3(0.0));
+  pointCovEig.SetSize(points.size());
   pointCovEig.SetAll(vct3(0.0));
+  if (covStorage == COV_STORAGE_PACKED)
+  {
+    pointCov.SetSize(0);
+    pointCovPacked.SetSize(points.size());
+    pointCovPacked.SetAll(PackedCov3(vct3x3(0.0)));
+  }
+  else
+  {
+    pointCovPacked.SetSize(0);
+    pointCov.SetSize(points.size());
+    pointCov.SetAll(vct3x3(0.0));
+  }
+}
+
+bool cisstPointCloud::NoiseModelIsParametric() const
+{
+  unsigned int numPoints = pointCovInPlaneVar.size();
+  if (!bParametricCov || pointOrientations.size() != numPoints)
+  {
+    return false;
+  }
+  if (covStorage == COV_STORAGE_PARAMETRIC)
+  {
+    return true;
+  }
+
+  // the covariance arrays are public and may have been assigned after
+  //  the noise model was set => compare them with the parametric form
+  //  (the full covariances are computed by ComputePointCovariance(), which
+  //   agrees with the parametric form up to round-off)
+  unsigned int numCov = (covStorage == COV_STORAGE_PACKED) ? pointCovPacked.size() : pointCov.size();
+  if (numCov != numPoints || pointCovEig.size() != numPoints)
+  {
+    return false;
+  }
+  vct3x3 M, Mp;
+  for (unsigned int i = 0; i < numPoints; i++)
+  {
+    double tol = 1e-9 * std::max(fabs(pointCovInPlaneVar[i]), fabs(covPerpPlaneVar));
+    PointCovariance(i, M);
+    UnpackParametricCov(pointOrientations[i], covPerpPlaneVar, pointCovInPlaneVar[i], Mp);
+    if ((M - Mp).MaxAbsElement() > tol
+      || (pointCovEig[i] - ParametricCovEig(covPerpPlaneVar, pointCovInPlaneVar[i])).MaxAbsElement() > tol)
+    {
+      return false;
+    }
+  }
+  return true;
+}
+
+void cisstPointCloud::SetCovStorage(CovStorageMode mode)
+{
+  if (mode == covStorage)
+  {
+    return;
+  }
+  if (mode == COV_STORAGE_PARAMETRIC)
+  {
+    if (!NoiseModelIsParametric())
+    {
+      // the covariances were assigned since the noise model was set
+      bParametricCov = false;
+      std::cout << "ERROR: parametric covariance storage requires the noise model set from the point orientations;"
+        << " keeping the current storage" << std::endl;
+      return;
+    }
+    covStorage = COV_STORAGE_PARAMETRIC;
+    pointCov.SetSize(0);
+    pointCovEig.SetSize(0);
+    pointCovPacked.SetSize(0);
+    return;
+  }
+
+  // expand the noise model, if stored in parametric form, to full covariances
+  //  then convert to the new storage
+  unsigned int numCov;
+  if (covStorage == COV_STORAGE_PARAMETRIC)
+  {
+    numCov = pointCovInPlaneVar.size();
+    pointCovEig.SetSize(numCov);
+    for (unsigned int i = 0; i < numCov; i++)
+    {
+      pointCovEig[i] = PointCovarianceEig(i);
+    }
+  }
+  else
+  {
+    numCov = (covStorage == COV_STORAGE_PACKED) ? pointCovPacked.size() : pointCov.size();
+  }
+
+  if (mode == COV_STORAGE_PACKED)
+  {
+    pointCovPacked.SetSize(numCov);
+    for (unsigned int i = 0; i < numCov; i++)
+    {
+      vct3x3 M;
+      PointCovariance(i, M);
+      pointCovPacked[i].Pack(M);
+    }
+    pointCov.SetSize(0);
+  }
+  else
+  {
+    pointCov.SetSize(numCov);
+    for (unsigned int i = 0; i < numCov; i++)
+    {
+      PointCovariance(i, pointCov[i]);
+    }
+    pointCovPacked.SetSize(0);
+  }
+  covStorage = mode;
 }
 
 void cisstPointCloud::SavePointCloudCov(std::string &filePath)
@@ -176,13 +313,21 @@ void cisstPointCloud::SavePointCloudCov(std::string &filePath)
     std::cout << "ERROR: failed to open file for saving cov: " << filePath << std::endl;
     assert(0);
   }
-  unsigned int numCov = this->pointCov.size();
+  unsigned int numCov;
+  switch (covStorage)
+  {
+  case COV_STORAGE_PACKED:      numCov = this->pointCovPacked.size(); break;
+  case COV_STORAGE_PARAMETRIC:  numCov = this->pointCovInPlaneVar.size(); break;
+  default:                      numCov = this->pointCov.size(); break;
+  }
   //fs << "NUMCOV " << numCov << "\n";
+  vct3x3 M;
   for (unsigned int i = 0; i < numCov; i++)
   {
-    fs << this->pointCov.at(i).Row(0) << " "
-      << this->pointCov.at(i).Row(1) << " "
-      << this->pointCov.at(i).Row(2) << "\n";
+    PointCovariance(i, M);
+    fs << M.Row(0) << " "
+      << M.Row(1) << " "
+      << M.Row(2) << "\n";
   }
 }
 
@@ -37,6 +37,7 @@
 #include <cisstVector.h>
 
 #include "cisstMesh.h"
+#include "PackedCov3.h"
 
 class cisstPointCloud
 {
@@ -51,14 +52,33 @@ public:
   vctDynamicVector<vct3> pointOrientations;
 
   // point cloud noise model
+  //  NOTE: the covariances are stored in pointCov and pointCovEig unless a
+  //        compact storage mode is selected (see SetCovStorage()); use the
+  //        PointCovariance() accessors to read them in any storage mode
   vctDynamicVector<vct3x3>  pointCov;       // covariance of measurement noise
   vctDynamicVector<vct3>    pointCovEig;    // eigenvalues of covariance
+  vctDynamicVector<PackedCov3> pointCovPacked;  // covariance of measurement noise (COV_STORAGE_PACKED)
+
+private:
+
+  // noise model storage
+  //  the parametric form uses the point orientations as the plane normals
+  CovStorageMode covStorage;
+  bool    bParametricCov;     // noise model was set by cisstPointCloud(mesh, noisePerpPlaneSD)
+  vctDynamicVector<double>  pointCovInPlaneVar;
+  double  covPerpPlaneVar;
+
+public:
 
 
   //--- Methods ---//
   
   // constructors
-  cisstPointCloud() {};
+  cisstPointCloud() :
+    covStorage(COV_STORAGE_FULL),
+    bParametricCov(false),
+    covPerpPlaneVar(0.0)
+  {};
 
   cisstPointCloud(vctDynamicVector<vct3> &points);
 
@@ -93,6 +113,62 @@ public:
   // initializes point cloud noise model to zero (default initializer)
   void InitializeNoiseModel();
 
+  // selects how the point noise model is stored and converts the current
+  //  noise model to that form
+  //  NOTE: parametric storage is only available for a noise model set by
+  //        cisstPointCloud(mesh, noisePerpPlaneSD) (i.e. not for covariances
+  //        assigned to pointCov by the user)
+  void SetCovStorage(CovStorageMode mode);
+  CovStorageMode GetCovStorage() const { return covStorage; }
+
+  // true if the noise model is the parametric form set by
+  //  cisstPointCloud(mesh, noisePerpPlaneSD); the stored covariances are
+  //  compared with that form, since they may have been assigned by the
+  //  user since
+  bool NoiseModelIsParametric() const;
+
+  // noise model of a point (in any storage mode)
+  inline void PointCovariance(int i, vct3x3 &M) const
+  {
+    switch (covStorage)
+    {
+    case COV_STORAGE_PACKED:
+      pointCovPacked[i].Unpack(M);
+      break;
+    case COV_STORAGE_PARAMETRIC:
+      UnpackParametricCov(pointOrientations[i], covPerpPlaneVar, pointCovInPlaneVar[i], M);
+      break;
+    default:
+      M = pointCov[i];
+      break;
+    }
+  }
+  // M += noise model of a point
+  inline void AddPointCovariance(int i, vct3x3 &M) const
+  {
+    switch (covStorage)
+    {
+    case COV_STORAGE_PACKED:
+      pointCovPacked[i].AddTo(M);
+      break;
+    case COV_STORAGE_PARAMETRIC:
+      AddParametricCov(pointOrientations[i], covPerpPlaneVar, pointCovInPlaneVar[i], M);
+      break;
+    default:
+      M.Add(pointCov[i]);
+      break;
+    }
+  }
+  // noise model eigenvalues of a point (in decreasing size)
+  inline vct3 PointCovarianceEig(int i) const
+  {
+    if (covStorage == COV_STORAGE_PARAMETRIC)
+    {
+      return ParametricCovEig(covPerpPlaneVar, pointCovInPlaneVar[i]);
+    }
+    return pointCovEig[i];
+  }
+
 
   // I/O
 
@@ -34,6 +34,7 @@
 #include "utilities.h"
 
 #include <algorithm>
+#include <vector>
 #include <limits>
 
 #include "cisstNumerical.h"
@@ -264,10 +265,10 @@ void ComputeCovEigenDecomposition_SVD(const vct3x3 &M, vct3 &eigenValues, vct3x3
   //
   //  NOTE: matrices must be column major
   //
-  static vctFixedSizeMatrix<double, 3, 3, VCT_COL_MAJOR> Mcopy;
-  static vctFixedSizeMatrix<double, 3, 3, VCT_COL_MAJOR> U;
-  static vctFixedSizeMatrix<double, 3, 3, VCT_COL_MAJOR> Vt;
-  static nmrSVDFixedSizeData<3, 3, VCT_COL_MAJOR>::VectorTypeWorkspace workspace;
+  vctFixedSizeMatrix<double, 3, 3, VCT_COL_MAJOR> Mcopy;
+  vctFixedSizeMatrix<double, 3, 3, VCT_COL_MAJOR> U;
+  vctFixedSizeMatrix<double, 3, 3, VCT_COL_MAJOR> Vt;
+  nmrSVDFixedSizeData<3, 3, VCT_COL_MAJOR>::VectorTypeWorkspace workspace;
   try
   {
     Mcopy.Assign(M);  // must use "assign" rather than equals to properly transfer between different vector orderings
@@ -309,10 +310,10 @@ void ComputeCovEigenDecomposition_SEP(const vct3x3 &M, vct3 &eigenValues, vct3x3
   //   SEP: 9.30579 (sec)
   //
 
-  static vctDynamicMatrix<double> Mcopy(3, 3, VCT_COL_MAJOR);
-  static vctDynamicMatrix<double> eigVct(3, 3, VCT_COL_MAJOR);
-  static vctDynamicVector<double> eigVal(3);
-  static nmrSymmetricEigenProblem::Data workspace = nmrSymmetricEigenProblem::Data(Mcopy, eigVal, eigVct);
+  vctDynamicMatrix<double> Mcopy(3, 3, VCT_COL_MAJOR);
+  vctDynamicMatrix<double> eigVct(3, 3, VCT_COL_MAJOR);
+  vctDynamicVector<double> eigVal(3);
+  nmrSymmetricEigenProblem::Data workspace = nmrSymmetricEigenProblem::Data(Mcopy, eigVal, eigVct);
 
   Mcopy.Assign(M);
   if (nmrSymmetricEigenProblem::EFAILURE == nmrSymmetricEigenProblem(Mcopy, eigVal, eigVct, workspace))
@@ -340,8 +341,8 @@ void ComputeCovInverse_NonIter(const vct3x3 &M, vct3x3 &Minv)
   
   ComputeCovEigenDecomposition_NonIter(M, eigenValues, eigenVectors);
 
-  static vctFixedSizeMatrix<double, 3, 3, VCT_COL_MAJOR> V_Sinv;
-  static vct3 Sinv;
+  vctFixedSizeMatrix<double, 3, 3, VCT_COL_MAJOR> V_Sinv;
+  vct3 Sinv;
   Sinv[0] = 1.0 / eigenValues[0];
   Sinv[1] = 1.0 / eigenValues[1];
   Sinv[2] = 1.0 / eigenValues[2];
@@ -361,8 +362,8 @@ void ComputeCovDecomposition_NonIter(const vct3x3 &M, vct3x3 &Minv, double &det_
 
   // Compute Minv
   //   Minv = V*diag(1/S)*V'
-  static vctFixedSizeMatrix<double, 3, 3, VCT_COL_MAJOR> V_Sinv;
-  static vct3 Sinv;
+  vctFixedSizeMatrix<double, 3, 3, VCT_COL_MAJOR> V_Sinv;
+  vct3 Sinv;
   Sinv[0] = 1.0 / eigenValues[0];
   Sinv[1] = 1.0 / eigenValues[1];
   Sinv[2] = 1.0 / eigenValues[2];
@@ -378,11 +379,11 @@ void ComputeCovDecomposition_NonIter(const vct3x3 &M, vct3x3 &Minv, double &det_
 void ComputeCovInverse_SVD(const vct3x3 &M, vct3x3 &Minv)
 {
   // Compute SVD of M
-  static vctFixedSizeMatrix<double, 3, 3, VCT_COL_MAJOR> Mcopy;
-  static vctFixedSizeMatrix<double, 3, 3, VCT_COL_MAJOR> U;
-  static vctFixedSizeMatrix<double, 3, 3, VCT_COL_MAJOR> Vt;
-  static vct3 S;
-  static nmrSVDFixedSizeData<3, 3, VCT_COL_MAJOR>::VectorTypeWorkspace workspace;
+  vctFixedSizeMatrix<double, 3, 3, VCT_COL_MAJOR> Mcopy;
+  vctFixedSizeMatrix<double, 3, 3, VCT_COL_MAJOR> U;
+  vctFixedSizeMatrix<double, 3, 3, VCT_COL_MAJOR> Vt;
+  vct3 S;
+  nmrSVDFixedSizeData<3, 3, VCT_COL_MAJOR>::VectorTypeWorkspace workspace;
   try
   {
     Mcopy.Assign(M);
@@ -396,8 +397,8 @@ void ComputeCovInverse_SVD(const vct3x3 &M, vct3x3 &Minv)
   // Compute Minv
   //   M = U*diag(S)*V'   where U = V
   //   Minv = V*diag(1/S)*U' = U*diag(1/S)*V'
-  static vctFixedSizeMatrix<double, 3, 3, VCT_COL_MAJOR> Sinv_Ut;
-  static vct3 Sinv;
+  vctFixedSizeMatrix<double, 3, 3, VCT_COL_MAJOR> Sinv_Ut;
+  vct3 Sinv;
   Sinv[0] = 1.0 / S[0];
   Sinv[1] = 1.0 / S[1];
   Sinv[2] = 1.0 / S[2];
@@ -427,10 +428,10 @@ void ComputeCovEigenValues_SVD(const vct3x3 &M, vct3 &eigenValues)
   //  NOTE: matrices must be column major
   //        eigen values are in descending order
   //
-  static vctFixedSizeMatrix<double, 3, 3, VCT_COL_MAJOR> Mcopy;
-  static vctFixedSizeMatrix<double, 3, 3, VCT_COL_MAJOR> U;
-  static vctFixedSizeMatrix<double, 3, 3, VCT_COL_MAJOR> Vt;
-  static nmrSVDFixedSizeData<3, 3, VCT_COL_MAJOR>::VectorTypeWorkspace workspace;
+  vctFixedSizeMatrix<double, 3, 3, VCT_COL_MAJOR> Mcopy;
+  vctFixedSizeMatrix<double, 3, 3, VCT_COL_MAJOR> U;
+  vctFixedSizeMatrix<double, 3, 3, VCT_COL_MAJOR> Vt;
+  nmrSVDFixedSizeData<3, 3, VCT_COL_MAJOR>::VectorTypeWorkspace workspace;
   try
   {
     Mcopy.Assign(M);
@@ -456,7 +457,7 @@ void ComputeCovEigenValues_Trig(const vct3x3 &M, vct3 &eigenValues)
   //  NOTE: eigen values are in descending order
   //
 
-  static vctDeterminant<3> detCalc;
+  vctDeterminant<3> detCalc;
 
   double p, p1, p2;
   double q, q1, q2, q3;
@@ -616,3 +617,174 @@ vct3 vctWeightedMean(const vctDynamicVector<vct3>& A, const vctDoubleVec &W)
   mean.Divide(W.SumOfElements());
   return mean;
 };
+
+namespace {
+
+  // spread the lower 21 bits of a value such that there are two
+  //  zero bits between each bit
+  unsigned long long MortonSpreadBits(unsigned long long x)
+  {
+    x &= 0x1fffff;
+    x = (x | (x << 32)) & 0x001f00000000ffffULL;
+    x = (x | (x << 16)) & 0x001f0000ff0000ffULL;
+    x = (x | (x << 8))  & 0x100f00f00f00f00fULL;
+    x = (x | (x << 4))  & 0x10c30c30c30c30c3ULL;
+    x = (x | (x << 2))  & 0x1249249249249249ULL;
+    return x;
+  }
+
+  struct MortonKey
+  {
+    unsigned long long code;
+    unsigned int index;
+    bool operator<(const MortonKey &other) const
+    {
+      return code < other.code || (code == other.code && index < other.index);
+    }
+  };
+
+} // namespace anonymous
+
+void ComputeMortonOrder(const vctDynamicVector<vct3>& pts, vctDynamicVector<unsigned int> &order)
+{
+  unsigned int N = pts.size();
+  order.SetSize(N);
+  if (N == 0)
+    return;
+
+  // bounding box of the points
+  vct3 minCorner(pts[0]);
+  vct3 maxCorner(pts[0]);
+  for (unsigned int i = 1; i < N; i++)
+  {
+    minCorner.ElementwiseMinOf(minCorner, pts[i]);
+    maxCorner.ElementwiseMaxOf(maxCorner, pts[i]);
+  }
+
+  // quantize each coordinate to 21 bits within the bounding box
+  //  and interleave the bits of the three coordinates
+  const double maxCell = (double)0x1fffff;
+  vct3 scale;
+  for (unsigned int k = 0; k < 3; k++)
+  {
+    double range = maxCorner[k] - minCorner[k];
+    scale[k] = range > 0.0 ? maxCell / range : 0.0;
+  }
+
+  std::vector<MortonKey> keys(N);
+  for (unsigned int i = 0; i < N; i++)
+  {
+    unsigned long long q[3];
+    for (unsigned int k = 0; k < 3; k++)
+    {
+      q[k] = (unsigned long long)((pts[i][k] - minCorner[k]) * scale[k]);
+    }
+    keys[i].code = MortonSpreadBits(q[0])
+      | (MortonSpreadBits(q[1]) << 1)
+      | (MortonSpreadBits(q[2]) << 2);
+    keys[i].index = i;
+  }
+  std::sort(keys.begin(), keys.end());
+
+  for (unsigned int i = 0; i < N; i++)
+  {
+    order[i] = keys[i].index;
+  }
+}
+
+unsigned int ComputeVoxelGridCells(const vctDynamicVector<vct3>& pts, double cellSize,
+  vctDynamicVector<unsigned int> &cells)
+{
+  unsigned int N = pts.size();
+  cells.SetSize(N);
+  if (N == 0)
+    return 0;
+  assert(cellSize > 0.0);
+
+  // bounding box of the points
+  vct3 minCorner(pts[0]);
+  vct3 maxCorner(pts[0]);
+  for (unsigned int i = 1; i < N; i++)
+  {
+    minCorner.ElementwiseMinOf(minCorner, pts[i]);
+    maxCorner.ElementwiseMaxOf(maxCorner, pts[i]);
+  }
+
+  // the cell coordinates are interleaved into a Morton code of 21 bits
+  //  per coordinate; enlarge the cells if the grid would exceed this
+  const double maxCell = (double)0x1fffff;
+  double range = (maxCorner - minCorner).MaxElement();
+  if (range / cellSize > maxCell)
+  {
+    cellSize = range / maxCell;
+  }
+
+  std::vector<MortonKey> keys(N);
+  for (unsigned int i = 0; i < N; i++)
+  {
+    unsigned long long q[3];
+    for (unsigned int k = 0; k < 3; k++)
+    {
+      q[k] = (unsigned long long)((pts[i][k] - minCorner[k]) / cellSize);
+    }
+    keys[i].code = MortonSpreadBits(q[0])
+      | (MortonSpreadBits(q[1]) << 1)
+      | (MortonSpreadBits(q[2]) << 2);
+    keys[i].index = i;
+  }
+  std::sort(keys.begin(), keys.end());
+
+  // number the distinct codes
+  unsigned int numCells = 0;
+  for (unsigned int i = 0; i < N; i++)
+  {
+    if (i > 0 && keys[i].code != keys[i - 1].code)
+    {
+      numCells++;
+    }
+    cells[keys[i].index] = numCells;
+  }
+  return numCells + 1;
+}
+
+void VoxelGridSubsample(const vctDynamicVector<vct3>& pts, double cellSize,
+  vctDynamicVector<unsigned int> &indices)
+{
+  unsigned int N = pts.size();
+  vctDynamicVector<unsigned int> cells;
+  unsigned int numCells = ComputeVoxelGridCells(pts, cellSize, cells);
+
+  // mean of the points in each cell
+  std::vector<vct3> cellMean(numCells, vct3(0.0));
+  std::vector<unsigned int> cellCount(numCells, 0);
+  for (unsigned int i = 0; i < N; i++)
+  {
+    cellMean[cells[i]].Add(pts[i]);
+    cellCount[cells[i]]++;
+  }
+  for (unsigned int c = 0; c < numCells; c++)
+  {
+    cellMean[c].Divide((double)cellCount[c]);
+  }
+
+  // point closest to the mean of each cell
+  std::vector<unsigned int> cellPoint(numCells, 0);
+  std::vector<double> cellDist(numCells, std::numeric_limits<double>::max());
+  for (unsigned int i = 0; i < N; i++)
+  {
+    unsigned int c = cells[i];
+    double dist = (pts[i] - cellMean[c]).NormSquare();
+    if (dist < cellDist[c])
+    {
+      cellDist[c] = dist;
+      cellPoint[c] = i;
+    }
+  }
+  std::sort(cellPoint.begin(), cellPoint.end());
+
+  indices.SetSize(numCells);
+  for (unsigned int c = 0; c < numCells; c++)
+  {
+    indices[c] = cellPoint[c];
+  }
+}
@@ -33,6 +33,7 @@
 // ****************************************************************************
 #include "wrapper_dlib.h"
 #include "algDirICP_GIMLOP.h"
+#include "ICPTrace.h"
 
 #include <assert.h>
 #undef NDEBUG       // enable debug in release mode
@@ -101,6 +102,8 @@ wrapper_dlib::wrapper_dlib()  // algDirICP_GIMLOP *kent )
 //  used with multiple Kent algorithms simultaneously (even if single threaded)
 /*vct6*/ vctDynamicVector<double> wrapper_dlib::ComputeRegistration(const vctDynamicVector<double> &x0, algDirICP_GIMLOP *kent)
 {
+  ICPTRACE_SCOPE("GIMLOP dlib ComputeRegistration");
+
   // initialize global pointer to algorithm
   Kent_dlib = kent;
 
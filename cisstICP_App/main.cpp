@@ -42,6 +42,9 @@
 // Registration Tests
 #include "testICP.h"
 #include "testICPNormals.h"
+#include "testDistanceField.h"
+#include "testCovBatchKernels.h"
+#include "testRegisterP2PBlock.h"
 
 // Command Line Options
 #include "CmdLineParser.h"
@@ -50,11 +53,12 @@ cmdLineString	Alg("alg"), Target("target"), In("in"),
 				Out("out"), Xfm("xfm"), SSM("ssm"),
 				Cov("cov"), Axes("axes"),
 				ModeWeights("modewts"), 
-				WorkingDir("workdir");
+				WorkingDir("workdir"), TreeFile("treefile");
 cmdLineInt 		targetType("targettype"), 
 				nModes("modes"), nSamples("samples"),
 				nThresh("nthresh"), 					// PD-tree variables
-				nIters("iters");
+				nIters("iters"),
+				TCPSMode("tcps");						// triangle solver precomputations
 cmdLineFloat	Scale("scale"),							// transformation offsets
 				MinPos("minpos"), MaxPos("maxpos"),
 				MinAng("minang"), MaxAng("maxang"),
@@ -68,8 +72,9 @@ cmdLineFloat	Scale("scale"),							// transformation offsets
 				RotationBounds("rbounds"),				// optimization bounds
 				TranslationBounds("tbounds"),
 				ScaleBounds("sbounds"),
-				ShapeParamBounds("spbounds");
-cmdLineReadable bScale("bscale"),
+				ShapeParamBounds("spbounds"),
+				DistField("distfield");				// distance field cell size
+cmdLineReadable bScale("bscale"), FlatTree("flattree"), SearchOrder("searchorder"),
 				h("h"), help("help");
 
 cmdLineReadable* params[] =
@@ -79,6 +84,7 @@ cmdLineReadable* params[] =
 	&Cov, &Axes,			/* Positional and angular noise */
 	&ModeWeights,
 	&WorkingDir,
+	&TreeFile,
 	&targetType,			// ints
 	&nModes, &nSamples,
 	&nIters,
@@ -96,7 +102,11 @@ cmdLineReadable* params[] =
 	&TranslationBounds,
 	&ScaleBounds,
 	&ShapeParamBounds,
+	&DistField,
+	&TCPSMode,
 	&bScale,				// readable 
+	&FlatTree,
+	&SearchOrder,
 	&h, &help,				// help
 	NULL
 };
@@ -114,7 +124,10 @@ void SetParams()
 									"\t\t\tDIMLOP: Implements the deformable IMLOP algorithm\n"
 									"\t\t\tGIMLOP: Implements the generalized IMLOP algorithm\n"
 									"\t\t\tGDIMLOP: Implements the deformable generalized IMLOP algorithm\n"
-									"\t\t\tPIMLOP: Implements the projected IMLOP algorithm\n\n"
+									"\t\t\tPIMLOP: Implements the projected IMLOP algorithm\n"
+									"\t\t\tBenchDistField: Compares the closest point search of the target distance field and PD tree\n"
+									"\t\t\tTestCovKernels: Compares the batched covariance kernels with the per-matrix routines\n"
+									"\t\t\tTestRegisterP2PBlock: Compares the block TLS/WTLS registrations with the dense solvers\n\n"
 									/*"\t\t\tVIMLOP: Implements the video IMLOP algorithm\n\n"*/);
 	i++;
 	// Target location
@@ -148,6 +161,10 @@ void SetParams()
 	// Working directory
 	params[i]->description = strdup("Enter the new working directory (default = \"..\\..\\..\\test_data\\LastRun_<algorithm name>\"\n\n");
 	i++;
+	// PD tree file
+	params[i]->description = strdup("Enter the location of a PD tree file for the target mesh. The tree is loaded from this file\n"
+									"\t\tif it exists, otherwise the tree is built and saved to it (default = build the tree)\n\n");
+	i++;
 	// Target type (mesh or point cloud)
 	params[i]->description = strdup("Specify the target type:\n"
 									"\t\tMesh: 1 (default)\n"
@@ -223,10 +240,26 @@ void SetParams()
 	// Shape parameter constraint
 	params[i]->description = strdup("Constrain shape parameter search between [-n, n] (default n = 3.0)\n\n");
 	i++;
+	// Distance field cell size
+	params[i]->description = strdup("Search the target mesh using a distance field having this cell size rather than\n"
+									"\t\tthe PD tree (default = use the PD tree; 1.0 for BenchDistField)\n"
+									"\t\tOnly available for the StdICP algorithm with a mesh target\n\n");
+	i++;
+	// Triangle solver precomputations
+	params[i]->description = strdup("Triangle closest point precomputations of the target mesh: 0 = full, 1 = compact\n"
+									"\t\t(references the mesh; much less memory), 2 = compact and computed on first use (default = 0)\n\n");
+	i++;
 	// Scale optimization
 	params[i]->description = strdup("Optimize over scale in addition to [R,t] and shape parameters (default = false)\n"
 									"\t\tOnly available for D-IMLP, D-IMLOP, G-IMLOP, and GD-IMLOP algorithms\n\n");
 	i++;
+	// Flattened PD tree
+	params[i]->description = strdup("Search the target PD tree through its flattened nodes only; the standard nodes are freed (default = false)\n"
+									"\t\tOnly available for the StdICP, IMLP and DIMLP algorithms\n\n");
+	i++;
+	// Spatial search order
+	params[i]->description = strdup("Search the samples in spatially coherent (Morton) order; the matches are unchanged (default = false)\n\n");
+	i++;
 	// Brief usage directions
 	params[i]->description = strdup("Prints short usage directions\n\n");
 	i++;
@@ -248,11 +281,14 @@ void Usage(const char* exec)
 	printf("\t--%s <axes (angular noise)>\n", Axes.name);
 	printf("\t--%s <mode weights>\n", ModeWeights.name);
 	printf("\t--%s <working directory>\n", WorkingDir.name);
+	printf("\t--%s <PD tree file>\n", TreeFile.name);
 	printf("\t--%s <number of modes>\n", nModes.name);
 	printf("\t--%s <number of samples>\n", nSamples.name);
 	printf("\t--%s <max iterations>\n", nIters.name);
 	printf("\t--%s <scale>\n", Scale.name);
 	printf("\t--%s \n", bScale.name);
+	printf("\t--%s \n", FlatTree.name);
+	printf("\t--%s \n", SearchOrder.name);
 	printf("\t--%s <min pos offset>\n", MinPos.name);
 	printf("\t--%s <max pos offset>\n", MaxPos.name);
 	printf("\t--%s <min ang offset>\n", MinAng.name);
@@ -272,6 +308,8 @@ void Usage(const char* exec)
 	printf("\t--%s <translation constraints>\n", TranslationBounds.name);
 	printf("\t--%s <scale constraints>\n", ScaleBounds.name);
 	printf("\t--%s <shape parameter constraints>\n", ShapeParamBounds.name);
+	printf("\t--%s <distance field cell size>\n", DistField.name);
+	printf("\t--%s <triangle solver mode>\n", TCPSMode.name);
 	printf("\t--%s (Prints usage directions)\n", h.name);
 	printf("\t--%s (Prints detailed usage directions)\n", help.name);
 }
@@ -290,11 +328,14 @@ void Help(const char* exec)
 	printf("\t--%s <axes (angular noise)>\n\t\t%s", Axes.name, Axes.description);
 	printf("\t--%s <mode weights>\n\t\t%s", ModeWeights.name, ModeWeights.description);
 	printf("\t--%s <working directory>\n\t\t%s", WorkingDir.name, WorkingDir.description);
+	printf("\t--%s <PD tree file>\n\t\t%s", TreeFile.name, TreeFile.description);
 	printf("\t--%s <number of modes>\n\t\t%s", nModes.name, nModes.description);
 	printf("\t--%s <number of samples>\n\t\t%s", nSamples.name, nSamples.description);
 	printf("\t--%s <max iterations>\n\t\t%s", nIters.name, nIters.description);
 	printf("\t--%s <scale>\n\t\t%s", Scale.name, Scale.description);
 	printf("\t--%s \n\t\t%s", bScale.name, bScale.description);
+	printf("\t--%s \n\t\t%s", FlatTree.name, FlatTree.description);
+	printf("\t--%s \n\t\t%s", SearchOrder.name, SearchOrder.description);
 	printf("\t--%s <min pos offset>\n\t\t%s", MinPos.name, MinPos.description);
 	printf("\t--%s <max pos offset>\n\t\t%s", MaxPos.name, MaxPos.description);
 	printf("\t--%s <min ang offset>\n\t\t%s", MinAng.name, MinAng.description);
@@ -314,6 +355,8 @@ void Help(const char* exec)
 	printf("\t--%s <translation constraints>\n\t\t%s", TranslationBounds.name, TranslationBounds.description);
 	printf("\t--%s <scale constraints>\n\t\t%s", ScaleBounds.name, ScaleBounds.description);
 	printf("\t--%s <shape parameter constraints>\n\t\t%s", ShapeParamBounds.name, ShapeParamBounds.description);
+	printf("\t--%s <distance field cell size>\n\t\t%s", DistField.name, DistField.description);
+	printf("\t--%s <triangle solver mode>\n\t\t%s", TCPSMode.name, TCPSMode.description);
 	printf("\t--%s \t%s", h.name, h.description);
 	printf("\t--%s \t%s", help.name, help.description);
 }
@@ -438,6 +481,11 @@ int main( int argc, char* argv[] )
 		cmdLineOpts.useDefaultWorkingDir = false;
 	}
 
+	if (TreeFile.set) {
+		cmdLineOpts.treefile = TreeFile.value;
+		cmdLineOpts.useDefaultTreeFile = false;
+	}
+
 	if (targetType.set) {
 		if (targetType.value == 0)
 			TargetShapeAsMesh = false;
@@ -474,6 +522,16 @@ int main( int argc, char* argv[] )
 		cmdLineOpts.bScale = true;
 	}
 
+	if (FlatTree.set)
+	{
+		cmdLineOpts.flatTree = true;
+	}
+
+	if (SearchOrder.set)
+	{
+		cmdLineOpts.searchOrder = true;
+	}
+
 	if (MinPos.set) {
 		cmdLineOpts.minpos = MinPos.value;
 		cmdLineOpts.useDefaultMinPos = false;
@@ -569,6 +627,16 @@ int main( int argc, char* argv[] )
 		cmdLineOpts.useDefaultShapeParamBounds = false;
 	}
 
+	if (DistField.set) {
+		cmdLineOpts.distfield = DistField.value;
+		cmdLineOpts.useDefaultDistField = false;
+	}
+
+	if (TCPSMode.set) {
+		cmdLineOpts.tcps = TCPSMode.value;
+		cmdLineOpts.useDefaultTCPS = false;
+	}
+
 	if (!strcmp(Alg.value, "StdICP") || !strcmp(Alg.value, "IMLP") 
 		|| !strcmp(Alg.value, "DIMLP") || !strcmp(Alg.value, "VIMLOP"))
 		testICP(TargetShapeAsMesh, algType, cmdLineOpts);
@@ -576,6 +644,12 @@ int main( int argc, char* argv[] )
 		|| !strcmp(Alg.value, "DIMLOP")  || !strcmp(Alg.value, "GIMLOP") 
 		|| !strcmp(Alg.value, "GDIMLOP") || !strcmp(Alg.value, "PIMLOP"))
 		testICPNormals(TargetShapeAsMesh, dirAlgType, cmdLineOpts);
+	else if (!strcmp(Alg.value, "BenchDistField"))
+		testDistanceField(cmdLineOpts);
+	else if (!strcmp(Alg.value, "TestCovKernels"))
+		return testCovBatchKernels() ? 0 : 1;
+	else if (!strcmp(Alg.value, "TestRegisterP2PBlock"))
+		return testRegisterP2PBlock() ? 0 : 1;
 
 	return 0;
 }
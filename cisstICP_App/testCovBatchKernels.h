@@ -0,0 +1,230 @@
+// ****************************************************************************
+//
+//    Copyright (c) 2014, Ayushi Sinha, Seth Billings, Russell Taylor, Johns Hopkins University. 
+//	  All rights reserved.
+//
+//    Redistribution and use in source and binary forms, with or without
+//    modification, are permitted provided that the following conditions are
+//    met:
+//
+//    1. Redistributions of source code must retain the above copyright
+//    notice, this list of conditions and the following disclaimer.
+//
+//    2. Redistributions in binary form must reproduce the above copyright
+//    notice, this list of conditions and the following disclaimer in the
+//    documentation and/or other materials provided with the distribution.
+//
+//    3. Neither the name of the copyright holder nor the names of its
+//    contributors may be used to endorse or promote products derived from
+//    this software without specific prior written permission.
+//
+//    THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+//    "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+//    LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+//    A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+//    HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+//    SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+//    LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+//    DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+//    THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+//    (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+//    OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//  
+// ****************************************************************************
+#ifndef _testCovBatchKernels_H
+#define _testCovBatchKernels_H
+
+#include <stdio.h>
+#include <iostream>
+#include <math.h>
+#include <limits>
+#include <algorithm>
+
+#include <cisstCommon.h>
+#include <cisstVector.h>
+
+#include "utilities.h"
+#include "CovBatchKernels.h"
+#include "SimdSupport.h"
+
+// Compares the batched covariance kernels (CovBatchKernels.h) with the
+//  per-matrix routines of utilities.h
+//  The test matrices are random rotations of random eigen values, with
+//  every fourth set of eigen values having a repeated pair, a triple
+//  (isotropic), a nearly repeated pair, or a large spread. The number of
+//  matrices is not a multiple of the SIMD width, so both the SIMD blocks
+//  and the remaining matrices are checked.
+//  Eigen vectors of repeated eigen values are not unique; they are checked
+//  through M = V*diag(S)*V' rather than against the reference vectors.
+//
+//  Returns true if all kernels agree with the reference routines.
+bool testCovBatchKernels()
+{
+	std::cout << "\nRunning batched covariance kernel tests" << std::endl;
+	std::cout << "  SIMD kernels: " << (SimdKernelsSupported() ? "yes" : "no") << std::endl;
+
+	int				nMatrices	= 1003;
+	unsigned int	randSeed	= 0;
+	unsigned int	randSeqPos	= 0;
+
+	cmnRandomSequence &cisstRandomSeq = cmnRandomSequence::GetInstance();
+
+	// generate test matrices
+	vctDynamicVector<vct3x3>	M(nMatrices);
+	vctDynamicVector<vct3>		norms(nMatrices);
+	vctDoubleVec				prllVar(nMatrices), perpVar(nMatrices);
+	for (int i = 0; i < nMatrices; i++)
+	{
+		vctRot3 R;
+		GenerateRandomRotation(randSeed, randSeqPos, 0.0, 180.0, R);
+		cisstRandomSeq.SetSeed(randSeed);
+		cisstRandomSeq.SetSequencePosition(randSeqPos);
+
+		double s[3];
+		for (int k = 0; k < 3; k++)
+			s[k] = pow(10.0, cisstRandomSeq.ExtractRandomDouble(-1.0, 1.0));
+		switch (i % 8)
+		{
+		case 1: s[1] = s[0]; break;					// repeated pair
+		case 3: s[1] = s[0]; s[2] = s[0]; break;	// isotropic
+		case 5: s[2] = s[1] * (1.0 + 1e-9); break;	// nearly repeated pair
+		case 7: s[0] = 1e4; s[1] = 1.0; s[2] = 1e-2; break;
+		default: break;
+		}
+		vct3x3 S(0.0);
+		S.Element(0, 0) = s[0];
+		S.Element(1, 1) = s[1];
+		S.Element(2, 2) = s[2];
+		M[i] = Calc_RMRt(R, S);
+
+		norms[i] = R.Column(2);
+		prllVar[i] = s[0];
+		perpVar[i] = s[1];
+		randSeqPos = cisstRandomSeq.GetSequencePosition();
+	}
+
+	// eigen decomposition
+	//  (eigen values relative to the largest eigen value; eigen vectors
+	//   compared only where the eigen value is separated from the others)
+	vctDynamicVector<vct3>		eigenValues(nMatrices), eigenValuesOnly(nMatrices);
+	vctDynamicVector<vct3x3>	eigenVectors(nMatrices);
+	ComputeCovEigenDecomposition_Batch(M.Pointer(), nMatrices, eigenValues.Pointer(), eigenVectors.Pointer());
+	ComputeCovEigenValues_Batch(M.Pointer(), nMatrices, eigenValuesOnly.Pointer());
+	double maxEigValErr = 0.0, maxEigValOnlyErr = 0.0, maxEigVecErr = 0.0;
+	double maxRecErr = 0.0, maxOrthErr = 0.0, maxDetErr = 0.0;
+	for (int i = 0; i < nMatrices; i++)
+	{
+		vct3	refValues;
+		vct3x3	refVectors;
+		ComputeCovEigenDecomposition_NonIter(M[i], refValues, refVectors);
+		double scale = refValues[0];
+		for (int k = 0; k < 3; k++)
+		{
+			maxEigValErr = std::max(maxEigValErr, fabs(eigenValues[i][k] - refValues[k]) / scale);
+			maxEigValOnlyErr = std::max(maxEigValOnlyErr, fabs(eigenValuesOnly[i][k] - refValues[k]) / scale);
+			double gap = std::numeric_limits<double>::max();
+			for (int j = 0; j < 3; j++)
+				if (j != k) gap = std::min(gap, fabs(refValues[k] - refValues[j]) / scale);
+			if (gap > 1e-3)
+			{
+				double c = fabs(vctDotProduct(eigenVectors[i].Column(k), refVectors.Column(k)));
+				maxEigVecErr = std::max(maxEigVecErr, fabs(1.0 - c));
+			}
+		}
+		vct3x3 V_S;
+		for (int k = 0; k < 3; k++)
+			V_S.Column(k) = eigenVectors[i].Column(k) * eigenValues[i][k];
+		vct3x3 rec = V_S * eigenVectors[i].Transpose();
+		vct3x3 orth = eigenVectors[i].Transpose() * eigenVectors[i];
+		maxRecErr = std::max(maxRecErr, (rec - M[i]).MaxAbsElement() / scale);
+		maxOrthErr = std::max(maxOrthErr, (orth - vct3x3::Eye()).MaxAbsElement());
+		double detV = vctDotProduct(
+			vctCrossProduct(eigenVectors[i].Column(0), eigenVectors[i].Column(1)), eigenVectors[i].Column(2));
+		maxDetErr = std::max(maxDetErr, fabs(detV - 1.0));
+	}
+
+	// inverse and determinant
+	//  (relative to the largest element of the reference inverse; the
+	//   product M*Minv is checked against the identity as well)
+	vctDynamicVector<vct3x3>	Minv(nMatrices), MinvOnly(nMatrices);
+	vctDoubleVec				det(nMatrices);
+	ComputeCovDecomposition_Batch(M.Pointer(), nMatrices, Minv.Pointer(), det.Pointer());
+	ComputeCovInverse_Batch(M.Pointer(), nMatrices, MinvOnly.Pointer());
+	double maxInvErr = 0.0, maxInvOnlyErr = 0.0, maxDetMErr = 0.0, maxIdErr = 0.0;
+	for (int i = 0; i < nMatrices; i++)
+	{
+		vct3x3 refInv, refInvOnly;
+		double refDet;
+		ComputeCovDecomposition_NonIter(M[i], refInv, refDet);
+		ComputeCovInverse_NonIter(M[i], refInvOnly);
+		maxInvErr = std::max(maxInvErr, (Minv[i] - refInv).MaxAbsElement() / refInv.MaxAbsElement());
+		maxInvOnlyErr = std::max(maxInvOnlyErr, (MinvOnly[i] - refInvOnly).MaxAbsElement() / refInvOnly.MaxAbsElement());
+		maxDetMErr = std::max(maxDetMErr, fabs(det[i] - refDet) / refDet);
+		maxIdErr = std::max(maxIdErr, (M[i] * Minv[i] - vct3x3::Eye()).MaxAbsElement());
+		maxIdErr = std::max(maxIdErr, (M[i] * MinvOnly[i] - vct3x3::Eye()).MaxAbsElement());
+	}
+
+	// R*M*R'
+	vctRot3 R;
+	GenerateRandomRotation(randSeed, randSeqPos, 0.0, 180.0, R);
+	vctDynamicVector<vct3x3> RMRt(nMatrices);
+	Calc_RMRt_Batch(R, M.Pointer(), nMatrices, RMRt.Pointer());
+	double maxRMRtErr = 0.0;
+	for (int i = 0; i < nMatrices; i++)
+	{
+		vct3x3 ref = Calc_RMRt(R, M[i]);
+		maxRMRtErr = std::max(maxRMRtErr, (RMRt[i] - ref).MaxAbsElement() / ref.MaxAbsElement());
+	}
+
+	// point covariances
+	vctDynamicVector<vct3x3> Mpt(nMatrices), MptArray(nMatrices);
+	ComputePointCovariance_Batch(norms.Pointer(), nMatrices, 2.0, 0.5, Mpt.Pointer());
+	ComputePointCovariance_Batch(norms.Pointer(), nMatrices,
+		prllVar.Pointer(), perpVar.Pointer(), MptArray.Pointer());
+	double maxPtCovErr = 0.0, maxPtCovArrayErr = 0.0;
+	for (int i = 0; i < nMatrices; i++)
+	{
+		vct3x3 ref = ComputePointCovariance(norms[i], 2.0, 0.5);
+		vct3x3 refArray = ComputePointCovariance(norms[i], prllVar[i], perpVar[i]);
+		maxPtCovErr = std::max(maxPtCovErr, (Mpt[i] - ref).MaxAbsElement() / ref.MaxAbsElement());
+		maxPtCovArrayErr = std::max(maxPtCovArrayErr, (MptArray[i] - refArray).MaxAbsElement() / refArray.MaxAbsElement());
+	}
+
+	// report
+	//  The closed-form solvers, including the reference routine, are
+	//  accurate to ~sqrt(machine eps) near repeated eigen values, which
+	//  bounds the agreement of the eigen values, inverses and determinants
+	//  with the reference; the checks of the batched results against the
+	//  input matrices are held to round-off. (ComputePointCovariance() builds
+	//  the covariance from a rotation, which adds round-off of its own.)
+	struct Check { const char *name; double err; double tol; };
+	Check checks[] = {
+		{ "eigen values",						maxEigValErr,		1e-7 },
+		{ "eigen values (values only)",			maxEigValOnlyErr,	1e-7 },
+		{ "eigen vectors",						maxEigVecErr,		1e-8 },
+		{ "eigen reconstruction V*S*V'",		maxRecErr,			1e-12 },
+		{ "eigen vector orthonormality",		maxOrthErr,			1e-12 },
+		{ "eigen vector determinant",			maxDetErr,			1e-12 },
+		{ "inverse",							maxInvErr,			1e-7 },
+		{ "inverse (inverse only)",				maxInvOnlyErr,		1e-7 },
+		{ "inverse M*Minv = I",					maxIdErr,			1e-9 },
+		{ "determinant",						maxDetMErr,			1e-7 },
+		{ "R*M*R'",								maxRMRtErr,			1e-13 },
+		{ "point covariance",					maxPtCovErr,		1e-12 },
+		{ "point covariance (per-point noise)",	maxPtCovArrayErr,	1e-12 },
+	};
+	bool bPass = true;
+	for (size_t k = 0; k < sizeof(checks) / sizeof(checks[0]); k++)
+	{
+		bool bOk = checks[k].err <= checks[k].tol;
+		printf("  %-36s max error = %-12g (tol = %g)  %s\n",
+			checks[k].name, checks[k].err, checks[k].tol, bOk ? "OK" : "FAILED");
+		bPass = bPass && bOk;
+	}
+	std::cout << (bPass ? "All batched kernels agree with the reference routines" :
+		"ERROR: batched kernels differ from the reference routines") << std::endl;
+	std::cout << "=============================================================\n" << std::endl;
+	return bPass;
+}
+
+#endif // _testCovBatchKernels_H
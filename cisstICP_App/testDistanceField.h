@@ -0,0 +1,186 @@
+// ****************************************************************************
+//
+//    Copyright (c) 2014, Ayushi Sinha, Seth Billings, Russell Taylor, Johns Hopkins University. 
+//	  All rights reserved.
+//
+//    Redistribution and use in source and binary forms, with or without
+//    modification, are permitted provided that the following conditions are
+//    met:
+//
+//    1. Redistributions of source code must retain the above copyright
+//    notice, this list of conditions and the following disclaimer.
+//
+//    2. Redistributions in binary form must reproduce the above copyright
+//    notice, this list of conditions and the following disclaimer in the
+//    documentation and/or other materials provided with the distribution.
+//
+//    3. Neither the name of the copyright holder nor the names of its
+//    contributors may be used to endorse or promote products derived from
+//    this software without specific prior written permission.
+//
+//    THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+//    "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+//    LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+//    A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+//    HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+//    SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+//    LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+//    DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+//    THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+//    (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+//    OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//  
+// ****************************************************************************
+#ifndef _testDistanceField_H
+#define _testDistanceField_H
+
+#include <stdio.h>
+#include <iostream>
+#include <vector>
+#include <limits.h>
+
+#include <cisstOSAbstraction.h>
+
+#include "utility.h"
+#include "cisstICP.h"
+#include "cisstMesh.h"
+#include "PDTree_Mesh.h"
+#include "DistanceField_Mesh.h"
+#include "algPDTree_CP_Mesh.h"
+
+// Compares the closest point search of the distance field and the PD tree
+//  of the target mesh (default: ProximalFemur.ply)
+//  The samples are drawn from the surface and moved by a series of small
+//  random transforms, similar to the sample positions of a tracking loop
+//  registering to the same mesh; each set of transformed samples is matched
+//  using both searches, starting from the matches of the previous set.
+void testDistanceField(cisstICP::CmdLineOptions cmdOpts)
+{
+	std::cout << "\nRunning distance field benchmark" << std::endl;
+
+	std::string loadMeshPath;
+	if (cmdOpts.useDefaultTarget)
+		loadMeshPath = cmdOpts.workingdir + "ProximalFemur.ply";
+	else
+		loadMeshPath = cmdOpts.target;
+
+	// Declare and initialize variables
+	int		nSamples	= 10000;
+	if (!cmdOpts.useDefaultNumSamples)
+		nSamples		= cmdOpts.samples;
+	int		nTrials		= 100;				// transforms applied to the samples
+	int		nThresh		= 5;				// Cov Tree Params
+	if (!cmdOpts.useDefaultNThresh)
+		nThresh			= cmdOpts.nthresh;
+	double	diagThresh	= 5.0;				//  ''
+	if (!cmdOpts.useDefaultDiagThresh)
+		diagThresh		= cmdOpts.diagthresh;
+	double	cellSize	= cmdOpts.distfield;	// 1.0
+	double	bandWidth	= 10.0*cellSize;
+
+	// sample offsets (tracking motion unless specified)
+	double minOffsetPos = cmdOpts.useDefaultMinPos ? 0.0 : (double)cmdOpts.minpos;
+	double maxOffsetPos = cmdOpts.useDefaultMaxPos ? 2.0 : (double)cmdOpts.maxpos;
+	double minOffsetAng = cmdOpts.useDefaultMinAng ? 0.0 : (double)cmdOpts.minang;
+	double maxOffsetAng = cmdOpts.useDefaultMaxAng ? 2.0 : (double)cmdOpts.maxang;
+
+	unsigned int randSeed1		= 0;		// generates samples
+	unsigned int randSeqPos1	= 0;
+	unsigned int randSeed2		= 17;		// generates offsets
+	unsigned int randSeqPos2	= 28;
+
+	osaStopwatch timer;
+
+	// load mesh
+	cisstMesh mesh;
+	CreateMesh(mesh, loadMeshPath);
+
+	// build PD tree
+	timer.Reset();
+	timer.Start();
+	PDTree_Mesh tree(mesh, nThresh, diagThresh);
+	double treeTime = timer.GetElapsedTime();
+	algPDTree_CP_Mesh treeAlg(&tree);
+	printf("Tree built: NNodes=%d  NData=%d  TreeDepth=%d  t=%.3f\n",
+		tree.NumNodes(), tree.NumData(), tree.TreeDepth(), treeTime);
+
+	// build distance field
+	timer.Reset();
+	timer.Start();
+	DistanceField_Mesh distField(mesh, &tree, cellSize, bandWidth);
+	double fieldTime = timer.GetElapsedTime();
+	printf("Distance field built: CellSize=%.2f  BandWidth=%.2f  NBlocks=%d  NCells=%d  NCandidates=%d  AvgCandidates=%.2f  NFallbackCells=%d  t=%.3f\n\n",
+		cellSize, bandWidth, distField.NumBlocks(), distField.NumCells(), distField.NumCandidates(),
+		distField.AvgCandidates(), distField.NumFallbackCells(), fieldTime);
+
+	// generate samples
+	vctDynamicVector<vct3>			samples, sampleNorms, samplesXfmd;
+	vctDynamicVector<unsigned int>	sampleDatums;
+	GenerateSamples(mesh, randSeed1, randSeqPos1, nSamples,
+		samples, sampleNorms, sampleDatums);
+	samplesXfmd.SetSize(nSamples);
+
+	// initial matches
+	vctDynamicVector<int>	treeDatums(nSamples), fieldDatums(nSamples);
+	vctDynamicVector<vct3>	treePts(nSamples), fieldPts(nSamples);
+	vctDoubleVec			treeErrors(nSamples), fieldErrors(nSamples);
+	for (int s = 0; s < nSamples; s++)
+	{
+		treeDatums[s] = sampleDatums[s];
+		fieldDatums[s] = sampleDatums[s];
+	}
+
+	// match the transformed samples
+	double treeRunTime = 0.0, fieldRunTime = 0.0;
+	double treeAvgSearched = 0.0, fieldAvgSearched = 0.0;
+	double maxErrorDiff = 0.0;
+	int nDiffDatums = 0, nDiffErrors = 0;
+	PDTreeSearchStats stats;
+	for (int trial = 0; trial < nTrials; trial++)
+	{
+		vctFrm3 F;
+		GenerateRandomTransform(randSeed2, randSeqPos2,
+			minOffsetPos, maxOffsetPos,
+			minOffsetAng, maxOffsetAng,
+			F);
+		for (int s = 0; s < nSamples; s++)
+			samplesXfmd[s] = F * samples[s];
+
+		timer.Reset();
+		timer.Start();
+		tree.FindClosestDatums(samplesXfmd, treeDatums,
+			treeDatums, treePts, treeErrors, stats);
+		treeRunTime += timer.GetElapsedTime();
+		treeAvgSearched += stats.avgNodesSearched;
+
+		timer.Reset();
+		timer.Start();
+		distField.FindClosestDatums(samplesXfmd, fieldDatums,
+			fieldDatums, fieldPts, fieldErrors, stats);
+		fieldRunTime += timer.GetElapsedTime();
+		fieldAvgSearched += stats.avgNodesSearched;
+
+		// compare the matches
+		//  (the datums may differ where the closest point lies on a shared edge)
+		for (int s = 0; s < nSamples; s++)
+		{
+			double diff = fabs(treeErrors[s] - fieldErrors[s]);
+			if (diff > maxErrorDiff) maxErrorDiff = diff;
+			if (diff > 1e-9) nDiffErrors++;
+			if (treeDatums[s] != fieldDatums[s]) nDiffDatums++;
+		}
+	}
+
+	int nMatches = nSamples*nTrials;
+	std::cout << "Matched " << nSamples << " samples for " << nTrials << " transforms" << std::endl;
+	printf("  PD tree:        t=%.4f  (%.3f us/match)  avg nodes searched=%.2f\n",
+		treeRunTime, 1e6*treeRunTime / nMatches, treeAvgSearched / nTrials);
+	printf("  Distance field: t=%.4f  (%.3f us/match)  avg triangles refined=%.2f\n",
+		fieldRunTime, 1e6*fieldRunTime / nMatches, fieldAvgSearched / nTrials);
+	printf("  Speedup: %.2f\n", fieldRunTime > 0.0 ? treeRunTime / fieldRunTime : 0.0);
+	printf("  Different match errors: %d / %d  (max difference = %g)\n", nDiffErrors, nMatches, maxErrorDiff);
+	printf("  Different match datums: %d / %d\n", nDiffDatums, nMatches);
+	std::cout << "=============================================================\n" << std::endl;
+}
+
+#endif // _testDistanceField_H
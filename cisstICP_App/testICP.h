@@ -47,6 +47,8 @@
 #include "cisstPointCloud.h"
 #include "PDTree_Mesh.h"
 #include "PDTree_PointCloud.h"
+#include "PDTreeFlat.h"
+#include "DistanceField_Mesh.h"
 
 #include "algICP_StdICP_Mesh.h"
 #include "algICP_IMLP_Mesh.h"
@@ -297,9 +299,25 @@ void testICP(bool TargetShapeAsMesh, ICPAlgType algType, cisstICP::CmdLineOption
 		// build PD tree on the mesh directly
 		// Note: defines measurement noise to be zero
 		printf("\nBuilding mesh PD tree with nThresh: %d and diagThresh: %.2f... \n", nThresh, diagThresh);
-		pTree = new PDTree_Mesh(mesh, nThresh, diagThresh);
+		if (!cmdOpts.useDefaultTreeFile && std::ifstream(cmdOpts.treefile.c_str()).good())
+		{ // load the tree saved from a previous run
+			pTree = new PDTree_Mesh(mesh, cmdOpts.treefile, nThresh, diagThresh);
+		}
+		else
+		{
+			pTree = new PDTree_Mesh(mesh, nThresh, diagThresh);
+			if (!cmdOpts.useDefaultTreeFile && pTree->Save(cmdOpts.treefile))
+				std::cout << "WARNING: failed to save PD tree file: " << cmdOpts.treefile << std::endl;
+		}
 		//tree.RecomputeBoundingBoxesUsingExistingCovFrames();      // *** is this ever needed?
 		printf("Tree built: NNodes=%d  NData=%d  TreeDepth=%d\n\n", pTree->NumNodes(), pTree->NumData(), pTree->TreeDepth());
+		if (cmdOpts.tcps > 0)
+		{ // compact triangle solver for the search algorithms
+			PDTree_Mesh *pTreeMesh = dynamic_cast<PDTree_Mesh*>(pTree);
+			pTreeMesh->SetCompactTCPS(cmdOpts.tcps == 2);
+			printf("Compact triangle solver%s built: Memory=%.2f MB\n\n", cmdOpts.tcps == 2 ? " (lazy)" : "",
+				pTreeMesh->PrecomputedTCPS()->MemoryUsage() / (1024.0*1024.0));
+		}
 	}
 	else
 	{
@@ -482,6 +500,7 @@ void testICP(bool TargetShapeAsMesh, ICPAlgType algType, cisstICP::CmdLineOption
 
 	// ICP Algorithm
 	algICP *pICPAlg = NULL;
+	DistanceField_Mesh *pDistField = NULL;
 	switch (algType)
 	{
 	case AlgType_StdICP:
@@ -490,6 +509,15 @@ void testICP(bool TargetShapeAsMesh, ICPAlgType algType, cisstICP::CmdLineOption
 		{ // target shape is a mesh
 			PDTree_Mesh *pTreeMesh = dynamic_cast<PDTree_Mesh*>(pTree);
 			pICPAlg = new algICP_StdICP_Mesh(pTreeMesh, noisySamples);
+			if (!cmdOpts.useDefaultDistField)
+			{ // search a distance field of the mesh rather than the tree
+				double cellSize = cmdOpts.distfield;
+				printf("Building distance field with cell size: %.2f... \n", cellSize);
+				pDistField = new DistanceField_Mesh(mesh, pTreeMesh, cellSize, 10.0*cellSize);
+				printf("Distance field built: NBlocks=%d  NCells=%d  AvgCandidates=%.2f  NFallbackCells=%d\n\n",
+					pDistField->NumBlocks(), pDistField->NumCells(), pDistField->AvgCandidates(), pDistField->NumFallbackCells());
+				pICPAlg->SetDistanceField(pDistField);
+			}
 		}
 		else
 		{ // target shape is a point cloud
@@ -560,6 +588,19 @@ void testICP(bool TargetShapeAsMesh, ICPAlgType algType, cisstICP::CmdLineOption
 	}
 	}
 
+	if (cmdOpts.searchOrder)
+	{
+		pICPAlg->SetSpatialSearchOrder(true);
+	}
+
+	if (cmdOpts.flatTree)
+	{ // flattened tree only (built after the node noise models are set)
+		double stdMemory = pTree->NodeMemory() / (1024.0*1024.0);
+		pTree->BuildFlatTree(true);
+		printf("Flattened tree built: Memory=%.2f MB (standard nodes freed: %.2f MB)\n\n",
+			pTree->FlatTree()->NodeMemory() / (1024.0*1024.0), stdMemory);
+	}
+
 	cisstMesh samplePts;
 	samplePts.vertices.SetSize(noisySamples.size());
 	samplePts.vertexNormals.SetSize(noisySampleNorms.size());
@@ -662,6 +703,7 @@ void testICP(bool TargetShapeAsMesh, ICPAlgType algType, cisstICP::CmdLineOption
 	samplePts.SavePLY(outputDir + "/finalPts.ply");
 
 	if (pICPAlg) delete pICPAlg;
+	if (pDistField) delete pDistField;
 }
 
 #endif // _testICP_H
@@ -340,7 +340,16 @@ void testICPNormals(bool TargetShapeAsMesh, ICPDirAlgType algType, cisstICP::Cmd
 		// build PD tree on the mesh directly
 		//  Note: defines measurement noise to be zero
 		printf("\nBuilding mesh PD tree with nThresh: %d and diagThresh: %.2f... \n", nThresh, diagThresh);
-		pTree = new DirPDTree_Mesh(mesh_target, nThresh, diagThresh);
+		if (!cmdOpts.useDefaultTreeFile && std::ifstream(cmdOpts.treefile.c_str()).good())
+		{ // load the tree saved from a previous run
+			pTree = new DirPDTree_Mesh(mesh_target, cmdOpts.treefile, nThresh, diagThresh);
+		}
+		else
+		{
+			pTree = new DirPDTree_Mesh(mesh_target, nThresh, diagThresh);
+			if (!cmdOpts.useDefaultTreeFile && pTree->Save(cmdOpts.treefile))
+				std::cout << "WARNING: failed to save PD tree file: " << cmdOpts.treefile << std::endl;
+		}
 		//tree.RecomputeBoundingBoxesUsingExistingCovFrames();      //*** is this ever needed?
 		printf("Tree built: NNodes=%d  NData=%d  TreeDepth=%d\n\n", pTree->NumNodes(), pTree->NumData(), pTree->TreeDepth());
 	}
@@ -697,6 +706,11 @@ void testICPNormals(bool TargetShapeAsMesh, ICPDirAlgType algType, cisstICP::Cmd
 	}
 	}
 
+	if (cmdOpts.searchOrder)
+	{
+		pICPAlg->SetSpatialSearchOrder(true);
+	}
+
 	cisstMesh samplePts;
 	samplePts.vertices.SetSize(noisySamples.size());
 	samplePts.vertexNormals.SetSize(noisySamples.size());
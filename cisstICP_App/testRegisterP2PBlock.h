@@ -0,0 +1,188 @@
+// ****************************************************************************
+//
+//    Copyright (c) 2014, Ayushi Sinha, Seth Billings, Russell Taylor, Johns Hopkins University. 
+//	  All rights reserved.
+//
+//    Redistribution and use in source and binary forms, with or without
+//    modification, are permitted provided that the following conditions are
+//    met:
+//
+//    1. Redistributions of source code must retain the above copyright
+//    notice, this list of conditions and the following disclaimer.
+//
+//    2. Redistributions in binary form must reproduce the above copyright
+//    notice, this list of conditions and the following disclaimer in the
+//    documentation and/or other materials provided with the distribution.
+//
+//    3. Neither the name of the copyright holder nor the names of its
+//    contributors may be used to endorse or promote products derived from
+//    this software without specific prior written permission.
+//
+//    THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+//    "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+//    LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+//    A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+//    HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+//    SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+//    LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+//    DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+//    THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+//    (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+//    OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//  
+// ****************************************************************************
+#ifndef _testRegisterP2PBlock_H
+#define _testRegisterP2PBlock_H
+
+#include <stdio.h>
+#include <iostream>
+#include <math.h>
+#include <algorithm>
+
+#include <cisstCommon.h>
+#include <cisstVector.h>
+
+#include "utilities.h"
+#include "RegisterP2P.h"
+
+// difference between two frames (rotation angle in degrees, translation norm)
+void RegisterP2PBlock_FrameDiff(const vctFrm3 &F1, const vctFrm3 &F2,
+	double &dAng, double &dPos)
+{
+	vctFrm3 dF(F1*F2.Inverse());
+	double c = (dF.Rotation().Trace() - 1.0) / 2.0;
+	c = std::max(-1.0, std::min(1.0, c));
+	dAng = acos(c) * 180.0 / cmnPI;
+	dPos = dF.Translation().Norm();
+}
+
+// Compares the block-accumulated TLS and WTLS registrations
+//  (RegisterP2P_TLS_Block / RegisterP2P_WTLS_Block) with the dense solvers
+//  (RegisterP2P_TLS / RegisterP2P_WTLS)
+//  The point pairs are random points related by a random frame plus noise,
+//  with random covariances and weights. The block solvers are run without
+//  and with exclude flags (compared with the dense solvers run on the
+//  remaining pairs) and, for TLS, with precomputed inverses of Mxi + Myi.
+//  The solvers sum the same normal equations in a different order, so the
+//  frames are held to a tolerance well above round-off but far below the
+//  termination thresholds of the solvers.
+//
+//  Returns true if all frames agree.
+bool testRegisterP2PBlock()
+{
+	std::cout << "\nRunning block TLS registration tests" << std::endl;
+
+	int				nPairs		= 1003;
+	unsigned int	randSeed	= 1;
+	unsigned int	randSeqPos	= 0;
+
+	cmnRandomSequence &cisstRandomSeq = cmnRandomSequence::GetInstance();
+
+	// ground truth frame
+	vctFrm3 Fgt;
+	GenerateRandomTransform(randSeed, randSeqPos, 10.0, 20.0, 5.0, 15.0, Fgt);
+
+	// point pairs, covariances and weights
+	vctDynamicVector<vct3>		x(nPairs), y(nPairs);
+	vctDynamicVector<vct3x3>	Mxi(nPairs), Myi(nPairs), invM0(nPairs);
+	vctDoubleVec				Wi(nPairs);
+	vctDynamicVector<int>		exclude(nPairs);
+	for (int i = 0; i < nPairs; i++)
+	{
+		vctRot3 Rx, Ry;
+		GenerateRandomRotation(randSeed, randSeqPos, 0.0, 180.0, Rx);
+		GenerateRandomRotation(randSeed, randSeqPos, 0.0, 180.0, Ry);
+		cisstRandomSeq.SetSeed(randSeed);
+		cisstRandomSeq.SetSequencePosition(randSeqPos);
+
+		vct3x3 Sx(0.0), Sy(0.0);
+		vct3 noise;
+		for (int k = 0; k < 3; k++)
+		{
+			x[i][k] = cisstRandomSeq.ExtractRandomDouble(-50.0, 50.0);
+			noise[k] = cisstRandomSeq.ExtractRandomDouble(-0.5, 0.5);
+			Sx.Element(k, k) = cisstRandomSeq.ExtractRandomDouble(0.1, 2.0);
+			Sy.Element(k, k) = cisstRandomSeq.ExtractRandomDouble(0.1, 2.0);
+		}
+		Wi[i] = cisstRandomSeq.ExtractRandomDouble(0.5, 2.0);
+		randSeqPos = cisstRandomSeq.GetSequencePosition();
+
+		y[i] = Fgt*x[i] + noise;
+		Mxi[i] = Calc_RMRt(Rx, Sx);
+		Myi[i] = Calc_RMRt(Ry, Sy);
+		ComputeCovInverse_NonIter(Mxi[i] + Myi[i], invM0[i]);
+		exclude[i] = (i % 7 == 3) ? 1 : 0;
+	}
+
+	// remaining pairs for the dense solvers
+	int nKept = 0;
+	for (int i = 0; i < nPairs; i++)
+		if (!exclude[i]) nKept++;
+	vctDynamicVector<vct3>		xKept(nKept), yKept(nKept);
+	vctDynamicVector<vct3x3>	MxiKept(nKept), MyiKept(nKept);
+	vctDoubleVec				WiKept(nKept);
+	for (int i = 0, j = 0; i < nPairs; i++)
+	{
+		if (exclude[i]) continue;
+		xKept[j] = x[i];
+		yKept[j] = y[i];
+		MxiKept[j] = Mxi[i];
+		MyiKept[j] = Myi[i];
+		WiKept[j] = Wi[i];
+		j++;
+	}
+
+	// registrations
+	vctFrm3 F_TLS, F_TLS_Kept, F_WTLS, F_WTLS_Kept;
+	RegisterP2P_TLS(x, y, Mxi, Myi, F_TLS);
+	RegisterP2P_TLS(xKept, yKept, MxiKept, MyiKept, F_TLS_Kept);
+	RegisterP2P_WTLS(x, y, Mxi, Myi, Wi, F_WTLS);
+	RegisterP2P_WTLS(xKept, yKept, MxiKept, MyiKept, WiKept, F_WTLS_Kept);
+
+	vctFrm3 F_TLS_Block, F_TLS_BlockExcl, F_TLS_BlockInv, F_TLS_BlockExclInv;
+	vctFrm3 F_WTLS_Block, F_WTLS_BlockExcl;
+	RegisterP2P_TLS_Block(x, y, Mxi, Myi, F_TLS_Block);
+	RegisterP2P_TLS_Block(x, y, Mxi, Myi, F_TLS_BlockExcl, &exclude);
+	RegisterP2P_TLS_Block(x, y, Mxi, Myi, F_TLS_BlockInv, NULL, &invM0);
+	RegisterP2P_TLS_Block(x, y, Mxi, Myi, F_TLS_BlockExclInv, &exclude, &invM0);
+	RegisterP2P_WTLS_Block(x, y, Mxi, Myi, Wi, F_WTLS_Block);
+	RegisterP2P_WTLS_Block(x, y, Mxi, Myi, Wi, F_WTLS_BlockExcl, &exclude);
+
+	// report
+	struct Check { const char *name; const vctFrm3 *pBlock; const vctFrm3 *pDense; };
+	Check checks[] = {
+		{ "TLS",								&F_TLS_Block,			&F_TLS },
+		{ "TLS (exclude flags)",				&F_TLS_BlockExcl,		&F_TLS_Kept },
+		{ "TLS (inverse M0)",					&F_TLS_BlockInv,		&F_TLS },
+		{ "TLS (exclude flags, inverse M0)",	&F_TLS_BlockExclInv,	&F_TLS_Kept },
+		{ "WTLS",								&F_WTLS_Block,			&F_WTLS },
+		{ "WTLS (exclude flags)",				&F_WTLS_BlockExcl,		&F_WTLS_Kept },
+	};
+	double angTol = 1e-6;	// degrees
+	double posTol = 1e-6;	// mm
+	bool bPass = true;
+	for (size_t k = 0; k < sizeof(checks) / sizeof(checks[0]); k++)
+	{
+		double dAng, dPos;
+		RegisterP2PBlock_FrameDiff(*checks[k].pBlock, *checks[k].pDense, dAng, dPos);
+		bool bOk = (dAng <= angTol) && (dPos <= posTol);
+		printf("  %-36s dAng = %-12g dPos = %-12g  %s\n",
+			checks[k].name, dAng, dPos, bOk ? "OK" : "FAILED");
+		bPass = bPass && bOk;
+	}
+	// (the exclude flags must change the result for the check above to
+	//  cover them)
+	double dAngExcl, dPosExcl;
+	RegisterP2PBlock_FrameDiff(F_TLS_Kept, F_TLS, dAngExcl, dPosExcl);
+	if (dAngExcl <= angTol && dPosExcl <= posTol)
+	{
+		std::cout << "  ERROR: excluding point pairs did not change the registration" << std::endl;
+		bPass = false;
+	}
+	std::cout << (bPass ? "All block registrations agree with the dense solvers" :
+		"ERROR: block registrations differ from the dense solvers") << std::endl;
+	std::cout << "=============================================================\n" << std::endl;
+	return bPass;
+}
+
+#endif // _testRegisterP2PBlock_H
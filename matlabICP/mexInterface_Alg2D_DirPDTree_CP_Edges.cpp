@@ -371,28 +371,19 @@ void mexInterface_Alg2D_DirPDTree_CP_Edges::ComputeMatches()
 
   unsigned int nSamples = samplePtsXfmd.size();
 
-  unsigned int nodesSearched = 0;
-  minNodesSearched = std::numeric_limits<unsigned int>::max();
-  maxNodesSearched = std::numeric_limits<unsigned int>::min();
-  avgNodesSearched = 0;
+  PDTreeSearchStats stats;
+  pDirTree->FindClosestDatums(
+    samplePtsXfmd, sampleNormsXfmd,
+    matchDatums,
+    matchDatums, matchPts, matchNorms, matchErrors,
+    stats);
+
+  minNodesSearched = stats.minNodesSearched;
+  maxNodesSearched = stats.maxNodesSearched;
+  avgNodesSearched = stats.avgNodesSearched;
 
   for (unsigned int s = 0; s < nSamples; s++)
   {
-    // inform algorithm beginning new match
-    //SamplePreMatch(s);
-
-    // Find best match for this sample
-    matchDatums.Element(s) = pDirTree->FindClosestDatum(
-      samplePtsXfmd.Element(s), sampleNormsXfmd.Element(s),
-      matchPts.Element(s), matchNorms.Element(s),
-      matchDatums.Element(s),
-      matchErrors.Element(s),
-      nodesSearched);
-
-    avgNodesSearched += nodesSearched;
-    minNodesSearched = (nodesSearched < minNodesSearched) ? nodesSearched : minNodesSearched;
-    maxNodesSearched = (nodesSearched > maxNodesSearched) ? nodesSearched : maxNodesSearched;
-
 #ifdef ValidatePDTreeSearch        
     validDatum = pDirTree->ValidateClosestDatum(
       samplePtsXfmd.Element(s), sampleNormsXfmd.Element(s),
@@ -460,12 +451,11 @@ void mexInterface_Alg2D_DirPDTree_CP_Edges::ComputeMatches()
 #endif
 
     // save lambda value of match for computing 3D match equivalent
-    matchLambdas.Element(s) = pAlg->searchLambdas.Element(matchDatums.Element(s));
+    pDirTree->GetEdge(matchDatums.Element(s)).ProjectOnEdge(
+      samplePtsXfmd.Element(s), &matchLambdas.Element(s));
     //SamplePostMatch(s);
   }
 
-  avgNodesSearched /= nSamples;
-
 #ifdef ValidatePDTreeSearch  
   validPercent = (double)numValidDatums / (double)nSamples * 100.0;
   validFS << "iter " << validIter << ":  NumMatches(valid/invalid): "
@@ -413,6 +413,23 @@ void CommandComputeMatches(int nlhs, mxArray* plhs[], int nrhs, const mxArray* p
 }
 
 
+void mexInterface_Alg2D_DirPDTree_vonMises_Edges::SamplePreMatch(unsigned int s)
+{
+  // clear permitted match flag
+  pAlg->bPermittedMatchFound = false;
+  //pAlg->bPermittedMatchFound = matchPermitted.Element(s);    
+
+  // set noise model for this point
+  pAlg->k = k[s];
+  pAlg->sigma2 = sigma2[s];
+}
+
+void mexInterface_Alg2D_DirPDTree_vonMises_Edges::SamplePostMatch(unsigned int s)
+{
+  // update permitted match value
+  matchPermitted.Element(s) = pAlg->bPermittedMatchFound;
+}
+
 void mexInterface_Alg2D_DirPDTree_vonMises_Edges::ComputeMatches()
 {
   // Find the point on the model having lowest match error
@@ -425,37 +442,22 @@ void mexInterface_Alg2D_DirPDTree_vonMises_Edges::ComputeMatches()
 
   unsigned int nSamples = samplePtsXfmd.size();
 
-  unsigned int nodesSearched = 0;
-  minNodesSearched = std::numeric_limits<unsigned int>::max();
-  maxNodesSearched = std::numeric_limits<unsigned int>::min();
-  avgNodesSearched = 0;
+  // the noise model of each sample is set for its search by SamplePreMatch()
+  //  and the permitted match flag is recorded by SamplePostMatch()
+  PDTreeSearchStats stats;
+  pDirTree->FindClosestDatums(
+    samplePtsXfmd, sampleNormsXfmd,
+    matchDatums,
+    matchDatums, matchPts, matchNorms, matchErrors,
+    stats, this);
+
+  minNodesSearched = stats.minNodesSearched;
+  maxNodesSearched = stats.maxNodesSearched;
+  avgNodesSearched = stats.avgNodesSearched;
 
+#ifdef ValidatePDTreeSearch
   for (unsigned int s = 0; s < nSamples; s++)
   {
-    // inform algorithm beginning new match
-    //SamplePreMatch(s);
-
-    // clear permitted match flag
-    pAlg->bPermittedMatchFound = false;
-    //pAlg->bPermittedMatchFound = matchPermitted.Element(s);    
-
-    // set noise model for this point
-    pAlg->k = k[s];
-    pAlg->sigma2 = sigma2[s];
-
-    // Find best match for this sample
-    matchDatums.Element(s) = pDirTree->FindClosestDatum(
-      samplePtsXfmd.Element(s), sampleNormsXfmd.Element(s),
-      matchPts.Element(s), matchNorms.Element(s),
-      matchDatums.Element(s),
-      matchErrors.Element(s),
-      nodesSearched);
-
-    avgNodesSearched += nodesSearched;
-    minNodesSearched = (nodesSearched < minNodesSearched) ? nodesSearched : minNodesSearched;
-    maxNodesSearched = (nodesSearched > maxNodesSearched) ? nodesSearched : maxNodesSearched;
-
-#ifdef ValidatePDTreeSearch        
     validDatum = pDirTree->ValidateClosestDatum(
       samplePtsXfmd.Element(s), sampleNormsXfmd.Element(s),
       validPoint, validNorm);
@@ -519,15 +521,8 @@ void mexInterface_Alg2D_DirPDTree_vonMises_Edges::ComputeMatches()
     {
       numValidDatums++;
     }
-#endif
-
-    // update permitted match value
-    matchPermitted.Element(s) = pAlg->bPermittedMatchFound;
-
-    //SamplePostMatch(s);
   }
-
-  avgNodesSearched /= nSamples;
+#endif
 
 #ifdef ValidatePDTreeSearch  
   validPercent = (double)numValidDatums / (double)nSamples * 100.0;
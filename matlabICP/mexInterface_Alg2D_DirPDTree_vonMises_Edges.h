@@ -26,7 +26,7 @@ void CommandInitialize(int nlhs, mxArray *plhs[], int nrhs, const mxArray *prhs[
 void CommandComputeMatches(int nlhs, mxArray *plhs[], int nrhs, const mxArray *prhs[]);
 void CommandSetNoiseModel(int nlhs, mxArray* plhs[], int nrhs, const mxArray* prhs[]);
 
-class mexInterface_Alg2D_DirPDTree_vonMises_Edges
+class mexInterface_Alg2D_DirPDTree_vonMises_Edges : public DirPDTreeMatchCallback
 {
 
   //--- Parameters ---//
@@ -88,6 +88,11 @@ public:
 
   void ComputeMatches();
 
+  // set the noise model of each sample for its search and record
+  //  whether a permitted match was found (called by the tree's batch search)
+  void SamplePreMatch(unsigned int sampleIndex);
+  void SamplePostMatch(unsigned int sampleIndex);
+
 };
 
 
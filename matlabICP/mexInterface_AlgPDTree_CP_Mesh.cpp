@@ -337,27 +337,18 @@ void mexInterface_AlgPDTree_CP_Mesh::ComputeMatches()
 
   unsigned int nSamples = samplePtsXfmd.size();
 
-  unsigned int nodesSearched = 0;
-  minNodesSearched = std::numeric_limits<unsigned int>::max();
-  maxNodesSearched = std::numeric_limits<unsigned int>::min();
-  avgNodesSearched = 0;
+  PDTreeSearchStats stats;
+  pTree->FindClosestDatums(
+    samplePtsXfmd, matchDatums,
+    matchDatums, matchPts, matchErrors,
+    stats);
+
+  minNodesSearched = stats.minNodesSearched;
+  maxNodesSearched = stats.maxNodesSearched;
+  avgNodesSearched = stats.avgNodesSearched;
 
   for (unsigned int s = 0; s < nSamples; s++)
   {
-    // inform algorithm beginning new match
-    //SamplePreMatch(s);
-
-    // Find best match for this sample
-    matchDatums.Element(s) = pTree->FindClosestDatum(
-      samplePtsXfmd.Element(s), matchPts.Element(s),
-      matchDatums.Element(s),
-      matchErrors.Element(s),
-      nodesSearched);
-
-    avgNodesSearched += nodesSearched;
-    minNodesSearched = (nodesSearched < minNodesSearched) ? nodesSearched : minNodesSearched;
-    maxNodesSearched = (nodesSearched > maxNodesSearched) ? nodesSearched : maxNodesSearched;
-
 #ifdef ValidatePDTreeSearch        
     validDatum = pDirTree->ValidateClosestDatum(
       samplePtsXfmd.Element(s), sampleNormsXfmd.Element(s),
@@ -429,8 +420,6 @@ void mexInterface_AlgPDTree_CP_Mesh::ComputeMatches()
     //SamplePostMatch(s);
   }
 
-  avgNodesSearched /= nSamples;
-
 #ifdef ValidatePDTreeSearch  
   validPercent = (double)numValidDatums / (double)nSamples;
   validFS << "iter " << validIter << ":  NumMatches(valid/invalid): "
@@ -361,6 +361,14 @@ void CommandComputeMatches(int nlhs, mxArray* plhs[], int nrhs, const mxArray* p
 }
 
 
+void mexInterface_AlgPDTree_MLP_Mesh::SamplePreMatch(unsigned int s, PDTreeSearchContext &ctx)
+{
+  vct3x3 dummyMat;
+  vct3 sampleCovEig;
+  ComputeCovEigenDecomposition_NonIter(sampleCovXfmd[s], sampleCovEig, dummyMat);
+  pAlg->InitializeSampleSearch(ctx, sampleCovXfmd[s], sampleCovEig);
+}
+
 void mexInterface_AlgPDTree_MLP_Mesh::ComputeMatches()
 {
   // Find the point on the model having lowest match error
@@ -373,32 +381,19 @@ void mexInterface_AlgPDTree_MLP_Mesh::ComputeMatches()
 
   unsigned int nSamples = samplePtsXfmd.size();
 
-  unsigned int nodesSearched = 0;
-  minNodesSearched = std::numeric_limits<unsigned int>::max();
-  maxNodesSearched = std::numeric_limits<unsigned int>::min();
-  avgNodesSearched = 0;
+  // the noise model of each sample is set for its search by SamplePreMatch()
+  PDTreeSearchStats stats;
+  pTree->FindClosestDatums(
+    samplePtsXfmd, matchDatums,
+    matchDatums, matchPts, matchErrors,
+    stats, this);
+
+  minNodesSearched = stats.minNodesSearched;
+  maxNodesSearched = stats.maxNodesSearched;
+  avgNodesSearched = stats.avgNodesSearched;
 
-  vct3x3 dummyMat;
-  vct3 sampleCovEig;
   for (unsigned int s = 0; s < nSamples; s++)
   {
-    // inform algorithm beginning new match
-    //SamplePreMatch(s);
-
-    ComputeCovEigenDecomposition_NonIter(sampleCovXfmd[s], sampleCovEig, dummyMat);
-    pAlg->InitializeSampleSearch(sampleCovXfmd[s], sampleCovEig);
-
-    // Find best match for this sample
-    matchDatums.Element(s) = pTree->FindClosestDatum(
-      samplePtsXfmd.Element(s), matchPts.Element(s),
-      matchDatums.Element(s),
-      matchErrors.Element(s),
-      nodesSearched);
-
-    avgNodesSearched += nodesSearched;
-    minNodesSearched = (nodesSearched < minNodesSearched) ? nodesSearched : minNodesSearched;
-    maxNodesSearched = (nodesSearched > maxNodesSearched) ? nodesSearched : maxNodesSearched;
-
 #ifdef ValidatePDTreeSearch
     validDatum = pDirTree->ValidateClosestDatum(
       samplePtsXfmd.Element(s), sampleNormsXfmd.Element(s),
@@ -470,8 +465,6 @@ void mexInterface_AlgPDTree_MLP_Mesh::ComputeMatches()
     //SamplePostMatch(s);
   }
 
-  avgNodesSearched /= nSamples;
-
 #ifdef ValidatePDTreeSearch
   validPercent = (double)numValidDatums / (double)nSamples;
   validFS << "iter " << validIter << ":  NumMatches(valid/invalid): "
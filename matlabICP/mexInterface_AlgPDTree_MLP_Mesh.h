@@ -22,7 +22,7 @@ void CommandDelete(int nlhs, mxArray *plhs[], int nrhs, const mxArray *prhs[]);
 void CommandInitialize(int nlhs, mxArray *plhs[], int nrhs, const mxArray *prhs[]);
 void CommandComputeMatches(int nlhs, mxArray *plhs[], int nrhs, const mxArray *prhs[]);
 
-class mexInterface_AlgPDTree_MLP_Mesh
+class mexInterface_AlgPDTree_MLP_Mesh : public PDTreeMatchCallback
 {
 
   //--- Parameters ---//
@@ -75,6 +75,10 @@ public:
   }
 
   void ComputeMatches();
+
+  // sets the noise model of each sample for its search
+  //  (called by the tree's batch search)
+  void SamplePreMatch(unsigned int sampleIndex, PDTreeSearchContext &ctx);
 };
 
 #endif